@@ -46,11 +46,25 @@ public:
         vnl_diag_matrix <double> workEigenValues;
     };
 
+    //! Work data for a block of in-mask voxels, matrices store one voxel per row
+    struct VoxelBlockDataStructure
+    {
+        unsigned int numberOfVoxels;
+        std::vector <typename OutputImageType::IndexType> indexes;
+        std::vector <bool> validEstimates;
+        vnl_matrix <double> signals, logSignals;
+        vnl_matrix <double> linearEstimates, tensorVectors, predictedSignals;
+    };
+
     void SetBValuesList(std::vector <double> bValuesList ) {m_BValuesList = bValuesList;}
 
     itkSetMacro(B0Threshold, double)
     itkGetMacro(B0Threshold, double)
 
+    //! Number of in-mask voxels gathered to compute linear estimates and predicted signals as matrix products
+    itkSetMacro(VoxelBlockSize, unsigned int)
+    itkGetMacro(VoxelBlockSize, unsigned int)
+
     itkGetMacro(EstimatedB0Image, OutputB0ImageType *)
     itkGetMacro(EstimatedVarianceImage, OutputB0ImageType *)
 
@@ -60,9 +74,12 @@ protected:
     DTIEstimationImageFilter()
         : Superclass()
     {
+        this->SetCompactedMaskExecution(true);
+
         m_BValuesList.clear();
 
         m_B0Threshold = 0;
+        m_VoxelBlockSize = 128;
         m_EstimatedB0Image = NULL;
         m_EstimatedVarianceImage = NULL;
     }
@@ -74,13 +91,19 @@ protected:
     void GenerateOutputInformation() ITK_OVERRIDE;
     void BeforeThreadedGenerateData() ITK_OVERRIDE;
     void DynamicThreadedGenerateData(const OutputImageRegionType &outputRegionForThread) ITK_OVERRIDE;
+    void GenerateDataOnMaskRuns(const OutputImageRegionType *runRegions, unsigned int numRuns) ITK_OVERRIDE;
 
     static double OptimizationFunction(const std::vector<double> &x, std::vector<double> &grad, void *func_data);
     double ComputeCostAtPosition(const std::vector<double> &x, const std::vector <double> &observedData,
                                  std::vector <double> &predictedValues, vnl_matrix <double> &rotationMatrix,
                                  vnl_matrix <double> &workTensor, vnl_diag_matrix <double> &workEigenValues);
 
-    double ComputeB0AndVarianceFromTensorVector(const vnl_matrix <double> &tensorValue, const std::vector <double> &dwiSignal, double &outVarianceValue);
+    void InitializeVoxelBlock(VoxelBlockDataStructure &blockData);
+
+    //! Adds in-mask voxels of a region to the block, estimating it each time it is full
+    void AddRegionToVoxelBlock(const OutputImageRegionType &region, VoxelBlockDataStructure &blockData);
+    void EstimateVoxelBlock(VoxelBlockDataStructure &blockData);
+    void ComputeB0AndVarianceOnVoxelBlock(VoxelBlockDataStructure &blockData);
 
 private:
     ITK_DISALLOW_COPY_AND_ASSIGN(DTIEstimationImageFilter);
@@ -89,11 +112,15 @@ private:
     std::vector< vnl_vector_fixed<double,3> > m_GradientDirections;
 
     double m_B0Threshold;
+    unsigned int m_VoxelBlockSize;
     typename OutputB0ImageType::Pointer m_EstimatedB0Image, m_EstimatedVarianceImage;
 
     static const unsigned int m_NumberOfComponents = 6;
 
     vnl_matrix <double> m_InitialMatrixSolver;
+
+    //! Log-signal attenuations are given by this matrix times the tensor vector representation
+    vnl_matrix <double> m_SignalDesignMatrix;
 };
 
 } // end of namespace anima
@@ -4,7 +4,9 @@
 #include <itkImageRegionIterator.h>
 #include <itkImageRegionIteratorWithIndex.h>
 #include <itkImageRegionConstIterator.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
 
+#include <vnl/vnl_fastops.h>
 #include <vnl/algo/vnl_determinant.h>
 #include <vnl/algo/vnl_matrix_inverse.h>
 #include <vnl/algo/vnl_symmetric_eigensystem.h>
@@ -151,6 +153,11 @@ DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
     vnl_matrix_inverse <double> inverter (initSolverSystem);
     m_InitialMatrixSolver = inverter.pinverse();
 
+    m_SignalDesignMatrix = initSolverSystem.extract(this->GetNumberOfIndexedInputs(),m_NumberOfComponents,0,1);
+
+    // Compacted mask chunks hold at least one full voxel block
+    this->SetMinimumMaskChunkSize(m_VoxelBlockSize);
+
     Superclass::BeforeThreadedGenerateData();
 }
 
@@ -158,31 +165,118 @@ template <class InputPixelScalarType, class OutputPixelScalarType>
 void
 DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
 ::DynamicThreadedGenerateData(const OutputImageRegionType &outputRegionForThread)
+{
+    VoxelBlockDataStructure blockData;
+    this->InitializeVoxelBlock(blockData);
+
+    this->AddRegionToVoxelBlock(outputRegionForThread,blockData);
+
+    if (blockData.numberOfVoxels > 0)
+        this->EstimateVoxelBlock(blockData);
+}
+
+template <class InputPixelScalarType, class OutputPixelScalarType>
+void
+DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
+::GenerateDataOnMaskRuns(const OutputImageRegionType *runRegions, unsigned int numRuns)
+{
+    // Voxel blocks are filled across runs, so that short runs of irregular masks still make full blocks
+    VoxelBlockDataStructure blockData;
+    this->InitializeVoxelBlock(blockData);
+
+    for (unsigned int i = 0;i < numRuns;++i)
+        this->AddRegionToVoxelBlock(runRegions[i],blockData);
+
+    if (blockData.numberOfVoxels > 0)
+        this->EstimateVoxelBlock(blockData);
+}
+
+template <class InputPixelScalarType, class OutputPixelScalarType>
+void
+DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
+::InitializeVoxelBlock(VoxelBlockDataStructure &blockData)
+{
+    unsigned int numInputs = this->GetNumberOfIndexedInputs();
+    unsigned int blockSize = std::max(1u,m_VoxelBlockSize);
+
+    blockData.numberOfVoxels = 0;
+    blockData.indexes.resize(blockSize);
+    blockData.validEstimates.resize(blockSize);
+    blockData.signals.set_size(blockSize,numInputs);
+    blockData.signals.fill(0.0);
+    blockData.logSignals.set_size(blockSize,numInputs);
+    blockData.logSignals.fill(0.0);
+    blockData.linearEstimates.set_size(blockSize,m_NumberOfComponents + 1);
+    blockData.tensorVectors.set_size(blockSize,m_NumberOfComponents);
+    blockData.predictedSignals.set_size(blockSize,numInputs);
+}
+
+template <class InputPixelScalarType, class OutputPixelScalarType>
+void
+DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
+::AddRegionToVoxelBlock(const OutputImageRegionType &region, VoxelBlockDataStructure &blockData)
 {
     typedef itk::ImageRegionConstIterator <InputImageType> ImageIteratorType;
 
     unsigned int numInputs = this->GetNumberOfIndexedInputs();
     std::vector <ImageIteratorType> inIterators;
     for (unsigned int i = 0;i < numInputs;++i)
-        inIterators.push_back(ImageIteratorType(this->GetInput(i),outputRegionForThread));
+        inIterators.push_back(ImageIteratorType(this->GetInput(i),region));
 
-    typedef itk::ImageRegionConstIterator <MaskImageType> MaskIteratorType;
-    MaskIteratorType maskIterator(this->GetComputationMask(),outputRegionForThread);
-    
-    typedef itk::ImageRegionIterator <OutputImageType> OutImageIteratorType;
-    OutImageIteratorType outIterator(this->GetOutput(),outputRegionForThread);
+    typedef itk::ImageRegionConstIteratorWithIndex <MaskImageType> MaskIteratorType;
+    MaskIteratorType maskIterator(this->GetComputationMask(),region);
+
+    // Outputs are zero outside of the mask (filled before threaded generate data), in-mask voxels
+    // are gathered by blocks and processed together. Full blocks are estimated, the last one is left to the caller
+    unsigned int blockSize = blockData.indexes.size();
+    while (!maskIterator.IsAtEnd())
+    {
+        if (maskIterator.Get() != 0)
+        {
+            unsigned int blockPosition = blockData.numberOfVoxels;
+            double *signalRow = blockData.signals[blockPosition];
+            double *logSignalRow = blockData.logSignals[blockPosition];
+            for (unsigned int i = 0;i < numInputs;++i)
+            {
+                signalRow[i] = inIterators[i].Get();
+                logSignalRow[i] = std::log(std::max(1.0e-6,signalRow[i]));
+            }
+
+            blockData.indexes[blockPosition] = maskIterator.GetIndex();
+            ++blockData.numberOfVoxels;
+
+            if (blockData.numberOfVoxels == blockSize)
+            {
+                this->EstimateVoxelBlock(blockData);
+                blockData.numberOfVoxels = 0;
+            }
+        }
+
+        for (unsigned int i = 0;i < numInputs;++i)
+            ++inIterators[i];
+
+        ++maskIterator;
+    }
+}
 
-    typedef itk::ImageRegionIterator <OutputB0ImageType> OutB0ImageIteratorType;
-    OutB0ImageIteratorType outB0Iterator(m_EstimatedB0Image,outputRegionForThread);
-    OutB0ImageIteratorType outVarianceIterator(m_EstimatedVarianceImage,outputRegionForThread);
+template <class InputPixelScalarType, class OutputPixelScalarType>
+void
+DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
+::EstimateVoxelBlock(VoxelBlockDataStructure &blockData)
+{
+    unsigned int numInputs = this->GetNumberOfIndexedInputs();
+
+    // Linear estimates of the whole block as one matrix product, rows past the number of voxels are left-overs
+    vnl_fastops::ABt(blockData.linearEstimates,blockData.logSignals,m_InitialMatrixSolver);
+    blockData.tensorVectors.fill(0.0);
 
     typedef typename OutputImageType::PixelType OutputPixelType;
-    std::vector <double> dwi (numInputs,0);
-    std::vector <double> lnDwi (numInputs,0);
     OutputPixelType resVec(m_NumberOfComponents);
 
-    std::vector <double> predictedValues(numInputs,0);
     OptimizationDataStructure data;
+    data.filter = this;
+    data.dwi.resize(numInputs);
+    data.predictedValues.resize(numInputs);
     data.rotationMatrix.set_size(3,3);
     data.workEigenValues.set_size(3);
     data.workTensor.set_size(3,3);
@@ -190,38 +284,12 @@ DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
     typedef itk::SymmetricEigenAnalysis < vnl_matrix <double>, vnl_diag_matrix<double>, vnl_matrix <double> > EigenAnalysisType;
     EigenAnalysisType eigen(3);
 
-    while (!outIterator.IsAtEnd())
+    for (unsigned int v = 0;v < blockData.numberOfVoxels;++v)
     {
-        resVec.Fill(0.0);
-        
-        if (maskIterator.Get() == 0)
-        {
-            outIterator.Set(resVec);
-            outB0Iterator.Set(0);
-            outVarianceIterator.Set(0);
-
-            for (unsigned int i = 0;i < numInputs;++i)
-                ++inIterators[i];
-
-            ++maskIterator;
-            ++outIterator;
-            ++outB0Iterator;
-            ++outVarianceIterator;
-            
-            continue;
-        }
-
-        for (unsigned int i = 0;i < numInputs;++i)
-        {
-            dwi[i] = inIterators[i].Get();
-            lnDwi[i] = std::log(std::max(1.0e-6,dwi[i]));
-        }
+        blockData.validEstimates[v] = false;
 
         for (unsigned int i = 0;i < m_NumberOfComponents;++i)
-        {
-            for (unsigned int j = 0;j < numInputs;++j)
-                resVec[i] += m_InitialMatrixSolver(i+1,j) * lnDwi[j];
-        }
+            resVec[i] = blockData.linearEstimates(v,i + 1);
 
         anima::GetTensorFromVectorRepresentation(resVec,data.workTensor);
 
@@ -269,9 +337,8 @@ DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
 
         double minf;
 
-        data.filter = this;
-        data.dwi = dwi;
-        data.predictedValues = predictedValues;
+        for (unsigned int i = 0;i < numInputs;++i)
+            data.dwi[i] = blockData.signals(v,i);
 
         opt.set_min_objective(OptimizationFunction, &data);
 
@@ -293,20 +360,8 @@ DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
 
             if (failedOpt)
             {
-                resVec.Fill(0.0);
-                outIterator.Set(resVec);
-                outB0Iterator.Set(0);
-                outVarianceIterator.Set(0);
-
-                for (unsigned int i = 0;i < numInputs;++i)
-                    ++inIterators[i];
-
-                ++maskIterator;
-                ++outIterator;
-                ++outB0Iterator;
-                ++outVarianceIterator;
+                // Outputs are already zero for this voxel
                 this->IncrementNumberOfProcessedPoints();
-
                 continue;
             }
         }
@@ -318,62 +373,55 @@ DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
         anima::RecomposeTensor(data.workEigenValues,data.rotationMatrix,data.workTensor);
         anima::GetVectorRepresentation(data.workTensor,resVec);
 
-        double outVarianceValue;
-        double outB0Value = this->ComputeB0AndVarianceFromTensorVector(data.workTensor,dwi,outVarianceValue);
-
-        outIterator.Set(resVec);
-        outB0Iterator.Set(outB0Value);
-        outVarianceIterator.Set(outVarianceValue);
-
-        for (unsigned int i = 0;i < numInputs;++i)
-            ++inIterators[i];
+        for (unsigned int i = 0;i < m_NumberOfComponents;++i)
+            blockData.tensorVectors(v,i) = resVec[i];
 
+        blockData.validEstimates[v] = true;
+        this->GetOutput()->SetPixel(blockData.indexes[v],resVec);
         this->IncrementNumberOfProcessedPoints();
-        ++maskIterator;
-        ++outIterator;
-        ++outB0Iterator;
-        ++outVarianceIterator;
     }
+
+    this->ComputeB0AndVarianceOnVoxelBlock(blockData);
 }
 
 template <class InputPixelScalarType, class OutputPixelScalarType>
-double
+void
 DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
-::ComputeB0AndVarianceFromTensorVector(const vnl_matrix <double> &tensorValue, const std::vector <double> &dwiSignal, double &outVarianceValue)
+::ComputeB0AndVarianceOnVoxelBlock(VoxelBlockDataStructure &blockData)
 {
-    double sumSquaredObservedSignals = 0;
-    double sumPredictedPerObservedSignals = 0;
-    double sumSquaredPredictedSignals = 0;
-    unsigned int numInputs = dwiSignal.size();
+    unsigned int numInputs = this->GetNumberOfIndexedInputs();
 
-    for (unsigned int i = 0;i < numInputs;++i)
+    // Predicted log-signals of the whole block as one matrix product
+    vnl_fastops::ABt(blockData.predictedSignals,blockData.tensorVectors,m_SignalDesignMatrix);
+
+    for (unsigned int v = 0;v < blockData.numberOfVoxels;++v)
     {
-        double observedValue = dwiSignal[i];
-        double predictedValue = 0;
-        double bValue = m_BValuesList[i];
+        if (!blockData.validEstimates[v])
+            continue;
 
-        if (bValue == 0)
-            predictedValue = 1;
-        else
+        const double *observedRow = blockData.signals[v];
+        const double *predictedRow = blockData.predictedSignals[v];
+
+        double sumSquaredObservedSignals = 0;
+        double sumPredictedPerObservedSignals = 0;
+        double sumSquaredPredictedSignals = 0;
+
+        for (unsigned int i = 0;i < numInputs;++i)
         {
-            for (unsigned int j = 0;j < 3;++j)
-            {
-                predictedValue += tensorValue(j,j) * m_GradientDirections[i][j] * m_GradientDirections[i][j];
-                for (unsigned int k = j + 1;k < 3;++k)
-                    predictedValue += 2.0 * tensorValue(j,k) * m_GradientDirections[i][j] * m_GradientDirections[i][k];
-            }
+            double observedValue = observedRow[i];
+            double predictedValue = std::exp(predictedRow[i]);
 
-            predictedValue = std::exp(- bValue * predictedValue);
+            sumSquaredObservedSignals += observedValue * observedValue;
+            sumSquaredPredictedSignals += predictedValue * predictedValue;
+            sumPredictedPerObservedSignals += predictedValue * observedValue;
         }
-        
-        sumSquaredObservedSignals += observedValue * observedValue;
-        sumSquaredPredictedSignals += predictedValue * predictedValue;
-        sumPredictedPerObservedSignals += predictedValue * observedValue;
-    }
 
-    double outB0Value = sumPredictedPerObservedSignals / sumSquaredPredictedSignals;
-    outVarianceValue = (sumSquaredObservedSignals - 2.0 * outB0Value * sumPredictedPerObservedSignals + outB0Value * outB0Value * sumSquaredPredictedSignals) / (numInputs - 1.0);
-    return outB0Value;
+        double outB0Value = sumPredictedPerObservedSignals / sumSquaredPredictedSignals;
+        double outVarianceValue = (sumSquaredObservedSignals - 2.0 * outB0Value * sumPredictedPerObservedSignals + outB0Value * outB0Value * sumSquaredPredictedSignals) / (numInputs - 1.0);
+
+        m_EstimatedB0Image->SetPixel(blockData.indexes[v],outB0Value);
+        m_EstimatedVarianceImage->SetPixel(blockData.indexes[v],outVarianceValue);
+    }
 }
 
 template <class InputPixelScalarType, class OutputPixelScalarType>
@@ -65,6 +65,8 @@ protected:
     DTINonCentralChiEstimationImageFilter()
         : Superclass()
     {
+        this->SetCompactedMaskExecution(true);
+
         m_BValuesList.clear();
         m_GradientDirections.clear();
 
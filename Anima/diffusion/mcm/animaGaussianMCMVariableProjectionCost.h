@@ -81,6 +81,10 @@ private:
     vnl_matrix <double> m_PredictedSignalAttenuations, m_CholeskyMatrix;
     std::vector< vnl_matrix<double> > m_SignalAttenuationsJacobian;
 
+    //! Work variables for batched compartment evaluations
+    ListType m_CompartmentSignals;
+    vnl_matrix <double> m_CompartmentJacobians;
+
     CholeskyDecomposition m_CholeskySolver;
     LECalculatorPointer m_leCalculator;
 };
@@ -44,6 +44,8 @@ MultiCompartmentModelCreator::MultiCompartmentModelCreator()
     m_RadialDiffusivity2 = 1.5e-4;
     m_ExtraAxonalFraction = 0.1;
     m_OrientationConcentration = 10.0;
+
+    m_NODDISignalTable = ITK_NULLPTR;
 }
 
 MultiCompartmentModelCreator::MCMPointer MultiCompartmentModelCreator::GetNewMultiCompartmentModel()
@@ -206,6 +208,7 @@ void MultiCompartmentModelCreator::CreateNODDICompartment(BaseCompartmentPointer
     noddiComp->SetOrientationConcentration(m_OrientationConcentration);
     noddiComp->SetExtraAxonalFraction(m_ExtraAxonalFraction);
     noddiComp->SetAxialDiffusivity(m_AxialDiffusivity);
+    noddiComp->SetSignalTable(m_NODDISignalTable);
     
     if (applyConstraints)
     {
@@ -2,6 +2,7 @@
 
 #include <animaMultiCompartmentModel.h>
 #include <animaBaseCompartment.h>
+#include <animaNODDISignalTable.h>
 #include <AnimaMCMExport.h>
 
 namespace anima
@@ -65,6 +66,9 @@ public:
     double GetRadialDiffusivity2() {return m_RadialDiffusivity2;}
     double GetExtraAxonalFraction() {return m_ExtraAxonalFraction;}
 
+    //! Shared precomputed table given to created NODDI compartments (exact evaluations if null)
+    void SetNODDISignalTable(const anima::NODDISignalTable *table) {m_NODDISignalTable = table;}
+
     MCMPointer GetNewMultiCompartmentModel();
 
 private:
@@ -96,6 +100,8 @@ private:
     double m_OrientationConcentration, m_ExtraAxonalFraction;
     double m_AxialDiffusivity;
     double m_RadialDiffusivity1, m_RadialDiffusivity2;
+
+    anima::NODDISignalTable::ConstPointer m_NODDISignalTable;
 };
 
 } // end namespace anima
@@ -1,7 +1,6 @@
 #include <animaNODDICompartment.h>
 #include <animaVectorOperations.h>
 #include <animaErrorFunctions.h>
-#include <animaKummerFunctions.h>
 #include <animaWatsonDistribution.h>
 #include <animaMCMConstants.h>
 #include <boost/math/special_functions/legendre.hpp>
@@ -44,15 +43,25 @@ void NODDICompartment::UpdateSignals(double bValue, const Vector3DType &gradient
     m_IntraKappaDerivative = 0;
     m_IntraAxialDerivative = 0;
     double x = bValue * dpara;
+
+    unsigned int numberOfOrders = m_WatsonSHCoefficients.size();
+    bool tabulatedTerms = m_SignalTable && (m_SignalTable->GetNumberOfOrders() == numberOfOrders) &&
+            m_SignalTable->GetKummerTerms(x, m_KummerTerms, m_KummerTermDerivatives);
+
+    if (!tabulatedTerms)
+    {
+        m_KummerTerms.resize(numberOfOrders);
+        m_KummerTermDerivatives.resize(numberOfOrders);
+        for (unsigned int i = 0;i < numberOfOrders;++i)
+            m_KummerTerms[i] = NODDISignalTable::ComputeKummerTerm(x, i, m_KummerTermDerivatives[i], m_EstimateAxialDiffusivity);
+    }
     
-    for (unsigned int i = 0;i < m_WatsonSHCoefficients.size();++i)
+    for (unsigned int i = 0;i < numberOfOrders;++i)
     {
         double coefVal = m_WatsonSHCoefficients[i];
         double sqrtVal = std::sqrt((4.0 * i + 1.0) / (4.0 * M_PI));
         double legendreVal = boost::math::legendre_p(2 * i, innerProd);
-        double kummerVal = anima::GetKummerFunctionValue(-x, i + 0.5, 2.0 * i + 1.5) * std::tgamma(i + 0.5) / std::tgamma(2.0 * i + 1.5);
-        double xPowVal = std::pow(-x, (double)i);
-        double cVal = xPowVal * kummerVal;
+        double cVal = m_KummerTerms[i];
         
         // Signal
         m_IntraAxonalSignal += coefVal * sqrtVal * legendreVal * cVal;
@@ -63,11 +72,7 @@ void NODDICompartment::UpdateSignals(double bValue, const Vector3DType &gradient
         
         double cDerivVal = 0.0;
         if (m_EstimateAxialDiffusivity)
-        {
-            cDerivVal = -xPowVal * anima::GetKummerFunctionValue(-x, i + 1.5, 2.0 * i + 2.5) * std::tgamma(i + 1.5) / std::tgamma(2.0 * i + 2.5);
-            if (i > 0)
-                cDerivVal += xPowVal * i * kummerVal / x;
-        }
+            cDerivVal = m_KummerTermDerivatives[i];
         
         m_IntraAngleDerivative += coefVal * sqrtVal * legendreDerivVal * cVal;
         m_IntraKappaDerivative += coefDerivVal * sqrtVal * legendreVal * cVal;
@@ -494,12 +499,26 @@ void NODDICompartment::UpdateKappaValues()
     double dawsonValue = anima::EvaluateDawsonIntegral(std::sqrt(kappa), true);
     m_Tau1 = (1.0 / dawsonValue - 1.0) / (2.0 * kappa);
     m_Tau1Deriv = (1.0 - (1.0 - dawsonValue * (2.0 * kappa - 1.0)) / (2.0 * dawsonValue * dawsonValue)) / (2.0 * kappa * kappa);
-    m_WatsonDistribution.SetConcentrationParameter(kappa);
-    m_WatsonDistribution.GetStandardWatsonSHCoefficients(m_WatsonSHCoefficients, m_WatsonSHCoefficientDerivatives);
+
+    if (!m_SignalTable || !m_SignalTable->GetWatsonSHCoefficients(kappa, m_WatsonSHCoefficients, m_WatsonSHCoefficientDerivatives))
+    {
+        m_WatsonDistribution.SetConcentrationParameter(kappa);
+        m_WatsonDistribution.GetStandardWatsonSHCoefficients(m_WatsonSHCoefficients, m_WatsonSHCoefficientDerivatives);
+    }
     
     m_ModifiedConcentration = false;
 }
 
+void NODDICompartment::SetSignalTable(const NODDISignalTable *table)
+{
+    if (table == m_SignalTable.GetPointer())
+        return;
+
+    m_SignalTable = table;
+    m_ModifiedParameters = true;
+    m_ModifiedConcentration = true;
+}
+
 double NODDICompartment::GetApparentFractionalAnisotropy()
 {
     double intraFraction = 1.0 - this->GetExtraAxonalFraction();
@@ -3,6 +3,7 @@
 #include <animaBaseCompartment.h>
 #include <AnimaMCMExport.h>
 #include <animaWatsonDistribution.h>
+#include <animaNODDISignalTable.h>
 
 namespace anima
 {
@@ -60,6 +61,9 @@ public:
     const Matrix3DType &GetDiffusionTensor() ITK_OVERRIDE;
     double GetApparentFractionalAnisotropy() ITK_OVERRIDE;
 
+    //! Use tabulated special functions (shared, already initialized) instead of exact evaluations when in range
+    void SetSignalTable(const NODDISignalTable *table);
+
 protected:
     NODDICompartment() : Superclass()
     {
@@ -76,6 +80,9 @@ protected:
         
         m_WatsonSHCoefficients.clear();
         m_WatsonSHCoefficientDerivatives.clear();
+        m_KummerTerms.clear();
+        m_KummerTermDerivatives.clear();
+        m_SignalTable = ITK_NULLPTR;
         
         m_IntraAxonalSignal = 0;
         m_IntraAngleDerivative = 0;
@@ -116,11 +123,13 @@ private:
     
     // Internal work variables for faster processing
     std::vector <double> m_WatsonSHCoefficients, m_WatsonSHCoefficientDerivatives;
+    std::vector <double> m_KummerTerms, m_KummerTermDerivatives;
     double m_Tau1, m_Tau1Deriv;
     double m_ExtraAxonalSignal, m_IntraAxonalSignal;
     double m_IntraAngleDerivative, m_IntraKappaDerivative, m_IntraAxialDerivative;
 
     anima::WatsonDistribution m_WatsonDistribution;
+    NODDISignalTable::ConstPointer m_SignalTable;
 };
 
 } //end namespace anima
@@ -0,0 +1,125 @@
+#include <animaNODDISignalTable.h>
+#include <animaKummerFunctions.h>
+#include <animaWatsonDistribution.h>
+#include <animaMCMConstants.h>
+
+#include <itkMacro.h>
+#include <cmath>
+#include <algorithm>
+
+namespace anima
+{
+
+NODDISignalTable::NODDISignalTable()
+{
+    m_MaximalBDValue = 0.0;
+    m_NumberOfSamples = 2048;
+    m_NumberOfOrders = 0;
+
+    m_BDStep = 0.0;
+    m_KappaStep = 0.0;
+}
+
+double NODDISignalTable::ComputeKummerTerm(double x, unsigned int order, double &derivative, bool computeDerivative)
+{
+    double kummerVal = anima::GetKummerFunctionValue(-x, order + 0.5, 2.0 * order + 1.5) * std::tgamma(order + 0.5) / std::tgamma(2.0 * order + 1.5);
+    double xPowVal = std::pow(-x, (double)order);
+
+    derivative = 0.0;
+    if (computeDerivative)
+    {
+        derivative = -xPowVal * anima::GetKummerFunctionValue(-x, order + 1.5, 2.0 * order + 2.5) * std::tgamma(order + 1.5) / std::tgamma(2.0 * order + 2.5);
+        if (order > 0)
+            derivative -= order * std::pow(-x, order - 1.0) * kummerVal;
+    }
+
+    return xPowVal * kummerVal;
+}
+
+void NODDISignalTable::Initialize()
+{
+    if (m_MaximalBDValue <= 0.0)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Maximal b-value times diffusivity should be positive to build NODDI tables",ITK_LOCATION);
+
+    if (m_NumberOfSamples < 2)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"NODDI tables need at least two samples",ITK_LOCATION);
+
+    anima::WatsonDistribution watsonDistribution;
+    std::vector <double> coefficients, derivatives;
+
+    m_KappaStep = anima::MCMConcentrationUpperBound / (m_NumberOfSamples - 1.0);
+    for (unsigned int i = 0;i < m_NumberOfSamples;++i)
+    {
+        watsonDistribution.SetConcentrationParameter(i * m_KappaStep);
+        watsonDistribution.GetStandardWatsonSHCoefficients(coefficients,derivatives);
+
+        if (i == 0)
+        {
+            m_NumberOfOrders = coefficients.size();
+            m_WatsonValues.resize(m_NumberOfSamples * m_NumberOfOrders);
+            m_WatsonDerivatives.resize(m_NumberOfSamples * m_NumberOfOrders);
+        }
+
+        std::copy(coefficients.begin(),coefficients.end(),m_WatsonValues.begin() + i * m_NumberOfOrders);
+        std::copy(derivatives.begin(),derivatives.end(),m_WatsonDerivatives.begin() + i * m_NumberOfOrders);
+    }
+
+    m_BDStep = m_MaximalBDValue / (m_NumberOfSamples - 1.0);
+    m_KummerValues.resize(m_NumberOfSamples * m_NumberOfOrders);
+    m_KummerDerivatives.resize(m_NumberOfSamples * m_NumberOfOrders);
+    for (unsigned int i = 0;i < m_NumberOfSamples;++i)
+    {
+        for (unsigned int j = 0;j < m_NumberOfOrders;++j)
+        {
+            unsigned int pos = i * m_NumberOfOrders + j;
+            m_KummerValues[pos] = this->ComputeKummerTerm(i * m_BDStep,j,m_KummerDerivatives[pos],true);
+        }
+    }
+}
+
+void NODDISignalTable::InterpolateTable(const std::vector <double> &tableValues, const std::vector <double> &tableDerivatives,
+                                        double step, double position, std::vector <double> &values, std::vector <double> &derivatives) const
+{
+    double samplePosition = position / step;
+    unsigned int sampleIndex = std::min((unsigned int)std::floor(samplePosition),m_NumberOfSamples - 2);
+    double t = samplePosition - sampleIndex;
+
+    // Cubic Hermite basis
+    double oneMinusT = 1.0 - t;
+    double h00 = (1.0 + 2.0 * t) * oneMinusT * oneMinusT;
+    double h10 = t * oneMinusT * oneMinusT * step;
+    double h01 = t * t * (3.0 - 2.0 * t);
+    double h11 = - t * t * oneMinusT * step;
+
+    values.resize(m_NumberOfOrders);
+    derivatives.resize(m_NumberOfOrders);
+
+    unsigned int lowerPos = sampleIndex * m_NumberOfOrders;
+    unsigned int upperPos = lowerPos + m_NumberOfOrders;
+    for (unsigned int i = 0;i < m_NumberOfOrders;++i)
+    {
+        values[i] = h00 * tableValues[lowerPos + i] + h10 * tableDerivatives[lowerPos + i]
+                + h01 * tableValues[upperPos + i] + h11 * tableDerivatives[upperPos + i];
+        derivatives[i] = oneMinusT * tableDerivatives[lowerPos + i] + t * tableDerivatives[upperPos + i];
+    }
+}
+
+bool NODDISignalTable::GetKummerTerms(double x, std::vector <double> &values, std::vector <double> &derivatives) const
+{
+    if ((m_NumberOfOrders == 0) || (x < 0.0) || (x > m_MaximalBDValue))
+        return false;
+
+    this->InterpolateTable(m_KummerValues,m_KummerDerivatives,m_BDStep,x,values,derivatives);
+    return true;
+}
+
+bool NODDISignalTable::GetWatsonSHCoefficients(double kappa, std::vector <double> &coefficients, std::vector <double> &derivatives) const
+{
+    if ((m_NumberOfOrders == 0) || (kappa < 0.0) || (kappa > anima::MCMConcentrationUpperBound))
+        return false;
+
+    this->InterpolateTable(m_WatsonValues,m_WatsonDerivatives,m_KappaStep,kappa,coefficients,derivatives);
+    return true;
+}
+
+} // end namespace anima
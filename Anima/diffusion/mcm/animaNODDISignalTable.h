@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <itkLightObject.h>
+#include <itkObjectFactory.h>
+#include <AnimaMCMExport.h>
+
+namespace anima
+{
+
+/**
+ * \class NODDISignalTable
+ * @brief Tabulated special functions of the NODDI intra-axonal signal series expansion.
+ *
+ * For each order i of the series, the Kummer term C_i(x) = (-x)^i M(-x, i + 1/2, 2i + 3/2) Gamma(i + 1/2) / Gamma(2i + 3/2)
+ * (x = b * d) and the standard Watson SH coefficient of kappa are sampled with their derivatives on regular grids.
+ * Values are then obtained by cubic Hermite interpolation, derivatives by linear interpolation. Once initialized, the
+ * table is only read and may be shared by the compartments of all threads.
+ */
+class ANIMAMCM_EXPORT NODDISignalTable : public itk::LightObject
+{
+public:
+    typedef NODDISignalTable Self;
+    typedef itk::LightObject Superclass;
+    typedef itk::SmartPointer<Self> Pointer;
+    typedef itk::SmartPointer<const Self> ConstPointer;
+
+    itkNewMacro(Self)
+
+    itkTypeMacro(NODDISignalTable, itk::LightObject)
+
+    //! Upper bound of the x = b * d grid, evaluations above it are computed exactly
+    void SetMaximalBDValue(double val) {m_MaximalBDValue = val;}
+    double GetMaximalBDValue() const {return m_MaximalBDValue;}
+
+    void SetNumberOfSamples(unsigned int val) {m_NumberOfSamples = val;}
+
+    //! Samples all tables, to be called once before any interpolation
+    void Initialize();
+
+    unsigned int GetNumberOfOrders() const {return m_NumberOfOrders;}
+
+    //! Exact Kummer term of the given order, its derivative w.r.t. x is computed only if requested
+    static double ComputeKummerTerm(double x, unsigned int order, double &derivative, bool computeDerivative);
+
+    //! Interpolated Kummer terms of all orders, returns false if x is outside of the table
+    bool GetKummerTerms(double x, std::vector <double> &values, std::vector <double> &derivatives) const;
+
+    //! Interpolated standard Watson SH coefficients and their kappa derivatives, returns false if kappa is outside of the table
+    bool GetWatsonSHCoefficients(double kappa, std::vector <double> &coefficients, std::vector <double> &derivatives) const;
+
+protected:
+    NODDISignalTable();
+    virtual ~NODDISignalTable() {}
+
+    //! Interpolates all orders of a table sampled every step from 0, with values and derivatives stored by sample
+    void InterpolateTable(const std::vector <double> &tableValues, const std::vector <double> &tableDerivatives,
+                          double step, double position, std::vector <double> &values, std::vector <double> &derivatives) const;
+
+private:
+    double m_MaximalBDValue;
+    unsigned int m_NumberOfSamples;
+    unsigned int m_NumberOfOrders;
+
+    double m_BDStep, m_KappaStep;
+    std::vector <double> m_KummerValues, m_KummerDerivatives;
+    std::vector <double> m_WatsonValues, m_WatsonDerivatives;
+};
+
+} // end namespace anima
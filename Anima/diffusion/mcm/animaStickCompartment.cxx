@@ -45,6 +45,65 @@ StickCompartment::ListType &StickCompartment::GetSignalAttenuationJacobian(doubl
     return m_JacobianVector;
 }
 
+void StickCompartment::GetFourierTransformedDiffusionProfiles(const AcquisitionSchemeType &scheme, ListType &signals)
+{
+    unsigned int numValues = scheme.GetNumberOfValues();
+    signals.resize(numValues);
+
+    double sinTheta = std::sin(this->GetOrientationTheta());
+    double orientationX = sinTheta * std::cos(this->GetOrientationPhi());
+    double orientationY = sinTheta * std::sin(this->GetOrientationPhi());
+    double orientationZ = std::cos(this->GetOrientationTheta());
+
+    double radialDiff = this->GetRadialDiffusivity1();
+    double diffAxialRadial = this->GetAxialDiffusivity() - radialDiff;
+
+    const double *bValues = scheme.GetBValues().data();
+    const double *gradX = scheme.GetGradientCoordinates(0).data();
+    const double *gradY = scheme.GetGradientCoordinates(1).data();
+    const double *gradZ = scheme.GetGradientCoordinates(2).data();
+
+    for (unsigned int i = 0;i < numValues;++i)
+    {
+        double gradientEigenvector1 = gradX[i] * orientationX + gradY[i] * orientationY + gradZ[i] * orientationZ;
+        signals[i] = std::exp(-bValues[i] * (radialDiff + diffAxialRadial * gradientEigenvector1 * gradientEigenvector1));
+    }
+}
+
+void StickCompartment::GetSignalAttenuationJacobians(const AcquisitionSchemeType &scheme, JacobianMatrixType &jacobians)
+{
+    unsigned int numValues = scheme.GetNumberOfValues();
+    jacobians.set_size(numValues,this->GetNumberOfParameters());
+
+    double cosTheta = std::cos(this->GetOrientationTheta());
+    double sinTheta = std::sin(this->GetOrientationTheta());
+    double cosPhi = std::cos(this->GetOrientationPhi());
+    double sinPhi = std::sin(this->GetOrientationPhi());
+
+    double radialDiff = this->GetRadialDiffusivity1();
+    double diffAxialRadial = this->GetAxialDiffusivity() - radialDiff;
+
+    const double *bValues = scheme.GetBValues().data();
+    const double *gradX = scheme.GetGradientCoordinates(0).data();
+    const double *gradY = scheme.GetGradientCoordinates(1).data();
+    const double *gradZ = scheme.GetGradientCoordinates(2).data();
+
+    for (unsigned int i = 0;i < numValues;++i)
+    {
+        double gradientEigenvector1 = sinTheta * (gradX[i] * cosPhi + gradY[i] * sinPhi) + gradZ[i] * cosTheta;
+        double signalAttenuation = std::exp(-bValues[i] * (radialDiff + diffAxialRadial * gradientEigenvector1 * gradientEigenvector1));
+        double angleFactor = -2.0 * bValues[i] * diffAxialRadial * gradientEigenvector1 * signalAttenuation;
+
+        // Derivatives w.r.t. theta and phi
+        jacobians.put(i,0,angleFactor * (cosTheta * (gradX[i] * cosPhi + gradY[i] * sinPhi) - gradZ[i] * sinTheta));
+        jacobians.put(i,1,angleFactor * sinTheta * (gradY[i] * cosPhi - gradX[i] * sinPhi));
+
+        // Derivative w.r.t. to d1
+        if (m_EstimateAxialDiffusivity)
+            jacobians.put(i,2,-bValues[i] * gradientEigenvector1 * gradientEigenvector1 * signalAttenuation);
+    }
+}
+
 double StickCompartment::GetLogDiffusionProfile(const Vector3DType &sample)
 {
     Vector3DType compartmentOrientation(0.0);
@@ -29,6 +29,8 @@ public:
 
     virtual double GetFourierTransformedDiffusionProfile(double smallDelta, double bigDelta, double gradientStrength, const Vector3DType &gradient) ITK_OVERRIDE;
     virtual ListType &GetSignalAttenuationJacobian(double smallDelta, double bigDelta, double gradientStrength, const Vector3DType &gradient) ITK_OVERRIDE;
+    virtual void GetFourierTransformedDiffusionProfiles(const AcquisitionSchemeType &scheme, ListType &signals) ITK_OVERRIDE;
+    virtual void GetSignalAttenuationJacobians(const AcquisitionSchemeType &scheme, JacobianMatrixType &jacobians) ITK_OVERRIDE;
     virtual double GetLogDiffusionProfile(const Vector3DType &sample) ITK_OVERRIDE;
 
     virtual void SetParametersFromVector(const ListType &params) ITK_OVERRIDE;
@@ -69,6 +69,89 @@ TensorCompartment::ListType &TensorCompartment::GetSignalAttenuationJacobian(dou
     return m_JacobianVector;
 }
 
+void TensorCompartment::GetFourierTransformedDiffusionProfiles(const AcquisitionSchemeType &scheme, ListType &signals)
+{
+    this->UpdateDiffusionTensor();
+
+    unsigned int numValues = scheme.GetNumberOfValues();
+    signals.resize(numValues);
+
+    double dxx = m_DiffusionTensor(0,0);
+    double dyy = m_DiffusionTensor(1,1);
+    double dzz = m_DiffusionTensor(2,2);
+    double dxy = 2.0 * m_DiffusionTensor(0,1);
+    double dxz = 2.0 * m_DiffusionTensor(0,2);
+    double dyz = 2.0 * m_DiffusionTensor(1,2);
+
+    const double *bValues = scheme.GetBValues().data();
+    const double *gradX = scheme.GetGradientCoordinates(0).data();
+    const double *gradY = scheme.GetGradientCoordinates(1).data();
+    const double *gradZ = scheme.GetGradientCoordinates(2).data();
+
+    for (unsigned int i = 0;i < numValues;++i)
+    {
+        double quadForm = dxx * gradX[i] * gradX[i] + dyy * gradY[i] * gradY[i] + dzz * gradZ[i] * gradZ[i]
+                + dxy * gradX[i] * gradY[i] + dxz * gradX[i] * gradZ[i] + dyz * gradY[i] * gradZ[i];
+
+        signals[i] = std::exp(- bValues[i] * quadForm);
+    }
+}
+
+void TensorCompartment::GetSignalAttenuationJacobians(const AcquisitionSchemeType &scheme, JacobianMatrixType &jacobians)
+{
+    this->UpdateDiffusionTensor();
+
+    unsigned int numValues = scheme.GetNumberOfValues();
+    jacobians.set_size(numValues,this->GetNumberOfParameters());
+
+    double diffAxialRadial2 = this->GetAxialDiffusivity() - this->GetRadialDiffusivity2();
+    double diffRadialDiffusivities = this->GetRadialDiffusivity1() - this->GetRadialDiffusivity2();
+
+    double dxx = m_DiffusionTensor(0,0);
+    double dyy = m_DiffusionTensor(1,1);
+    double dzz = m_DiffusionTensor(2,2);
+    double dxy = 2.0 * m_DiffusionTensor(0,1);
+    double dxz = 2.0 * m_DiffusionTensor(0,2);
+    double dyz = 2.0 * m_DiffusionTensor(1,2);
+
+    const double *bValues = scheme.GetBValues().data();
+    const double *gradX = scheme.GetGradientCoordinates(0).data();
+    const double *gradY = scheme.GetGradientCoordinates(1).data();
+    const double *gradZ = scheme.GetGradientCoordinates(2).data();
+
+    for (unsigned int i = 0;i < numValues;++i)
+    {
+        double innerProd1 = gradX[i] * m_EigenVector1[0] + gradY[i] * m_EigenVector1[1] + gradZ[i] * m_EigenVector1[2];
+        double innerProd2 = gradX[i] * m_EigenVector2[0] + gradY[i] * m_EigenVector2[1] + gradZ[i] * m_EigenVector2[2];
+
+        double quadForm = dxx * gradX[i] * gradX[i] + dyy * gradY[i] * gradY[i] + dzz * gradZ[i] * gradZ[i]
+                + dxy * gradX[i] * gradY[i] + dxz * gradX[i] * gradZ[i] + dyz * gradY[i] * gradZ[i];
+        double signalAttenuation = std::exp(- bValues[i] * quadForm);
+
+        double DgTe1DTheta = m_CosTheta * (gradX[i] * m_CosPhi + gradY[i] * m_SinPhi) - gradZ[i] * m_SinTheta;
+        double DgTe1DPhi = m_SinTheta * (gradY[i] * m_CosPhi - gradX[i] * m_SinPhi);
+
+        double DgTe2DTheta = m_SinAlpha * innerProd1;
+        double DgTe2DPhi = gradX[i] * (m_CosTheta * m_SinPhi * m_SinAlpha - m_CosPhi * m_CosAlpha) - gradY[i] * (m_SinPhi * m_CosAlpha + m_CosTheta * m_CosPhi * m_SinAlpha);
+        double DgTe2DAlpha = gradX[i] * (m_SinPhi * m_SinAlpha - m_CosTheta * m_CosPhi * m_CosAlpha) - gradY[i] * (m_CosPhi * m_SinAlpha + m_CosTheta * m_SinPhi * m_CosAlpha) + gradZ[i] * m_SinTheta * m_CosAlpha;
+
+        double angleFactor = -2.0 * bValues[i] * signalAttenuation;
+
+        // Derivatives w.r.t. theta, phi and alpha
+        jacobians.put(i,0,angleFactor * (diffAxialRadial2 * innerProd1 * DgTe1DTheta + diffRadialDiffusivities * innerProd2 * DgTe2DTheta));
+        jacobians.put(i,1,angleFactor * (diffAxialRadial2 * innerProd1 * DgTe1DPhi + diffRadialDiffusivities * innerProd2 * DgTe2DPhi));
+        jacobians.put(i,2,angleFactor * diffRadialDiffusivities * innerProd2 * DgTe2DAlpha);
+
+        if (m_EstimateDiffusivities)
+        {
+            // Derivatives w.r.t. to d1, d2 and d3
+            jacobians.put(i,3,- bValues[i] * innerProd1 * innerProd1 * signalAttenuation);
+            jacobians.put(i,4,- bValues[i] * (innerProd1 * innerProd1 + innerProd2 * innerProd2) * signalAttenuation);
+            jacobians.put(i,5,- bValues[i] * signalAttenuation);
+        }
+    }
+}
+
 double TensorCompartment::GetLogDiffusionProfile(const Vector3DType &sample)
 {
     this->UpdateInverseDiffusionTensor();
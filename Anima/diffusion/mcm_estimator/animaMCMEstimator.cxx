@@ -76,6 +76,9 @@ int main(int argc,  char **argv)
     TCLAP::ValueArg<double> fTolArg("", "f-tol", "Tolerance for relative cost in optimization (default: 0 -> function of position tolerance)", false, 0, "cost relative tolerance", cmd);
     TCLAP::ValueArg<unsigned int> maxEvalArg("e", "max-eval", "Maximum evaluations (default: 0 -> function of number of unknowns)", false, 0, "max evaluations", cmd);
 
+    TCLAP::SwitchArg costOrderArg("", "cost-order", "Process voxels by decreasing estimated cost (better load balance with an input model selection map)", cmd, false);
+    TCLAP::SwitchArg tabulatedSignalsArg("", "tab-signals", "Use tabulated special functions for NODDI signals (faster, interpolated values)", cmd, false);
+    TCLAP::SwitchArg sparseOutputsArg("", "sparse-out", "Store estimates for in-mask voxels only, expanded when written (lower memory footprint). Outputs are uncompressed, MCM images are written as .mha slice by slice, other outputs only if their format streams writes (e.g. .mha, not .nrrd)", cmd, false);
     TCLAP::ValueArg<unsigned int> nbThreadsArg("T", "nb-threads", "Number of threads to run on (default: all cores)", false, itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads(), "number of threads", cmd);
 
     try
@@ -202,6 +205,9 @@ int main(int argc,  char **argv)
     else
         filter->SetUseCommonDiffusivities(false);
 
+    filter->SetCostOrderedVoxelProcessing(costOrderArg.isSet());
+    filter->SetSparseOutputs(sparseOutputsArg.isSet());
+    filter->SetUseTabulatedCompartmentSignals(tabulatedSignalsArg.isSet());
     filter->SetNumberOfWorkUnits(nbThreadsArg.getValue());
     filter->AddObserver(itk::ProgressEvent(), callback);
 
@@ -235,25 +241,25 @@ int main(int argc,  char **argv)
     if (aicArg.getValue() != "")
     {
         std::cout << "Writing AICu image to: " << aicArg.getValue() << std::endl;
-        anima::writeImage(aicArg.getValue(),filter->GetAICcVolume());
+        filter->WriteAICcVolume(aicArg.getValue());
     }
 
     if (outB0Arg.getValue() != "")
     {
         std::cout << "Writing B0 image to: " << outB0Arg.getValue() << std::endl;
-        anima::writeImage(outB0Arg.getValue(),filter->GetB0Volume());
+        filter->WriteB0Volume(outB0Arg.getValue());
     }
 
     if (outSigmaArg.getValue() != "")
     {
         std::cout << "Writing noise sigma square image to: " << outSigmaArg.getValue() << std::endl;
-        anima::writeImage(outSigmaArg.getValue(),filter->GetSigmaSquareVolume());
+        filter->WriteSigmaSquareVolume(outSigmaArg.getValue());
     }
 
     if (outMoseArg.getValue() != "")
     {
         std::cout << "Writing model selection image to: " << outMoseArg.getValue() << std::endl;
-        anima::writeImage(outMoseArg.getValue(),filter->GetMoseVolume());
+        filter->WriteMoseVolume(outMoseArg.getValue());
     }
 
     return EXIT_SUCCESS;
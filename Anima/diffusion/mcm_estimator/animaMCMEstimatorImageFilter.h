@@ -1,9 +1,11 @@
 #pragma once
 #include <cmath>
 #include <random>
+#include <atomic>
 
 #include <animaMaskedImageToImageFilter.h>
 #include <animaMCMImage.h>
+#include <animaInMaskSparseImageSource.h>
 #include <itkImage.h>
 #include <itkSingleValuedCostFunction.h>
 
@@ -40,6 +42,13 @@ public:
     typedef itk::VectorImage<OutputPixelType,3> VectorImageType;
     typedef typename VectorImageType::Pointer VectorImagePointer;
 
+    typedef anima::InMaskSparseImageSource <VectorImageType> SparseVectorImageType;
+    typedef typename SparseVectorImageType::Pointer SparseVectorImagePointer;
+    typedef anima::InMaskSparseImageSource <OutputScalarImageType> SparseScalarImageType;
+    typedef typename SparseScalarImageType::Pointer SparseScalarImagePointer;
+    typedef anima::InMaskSparseImageSource <MoseImageType> SparseMoseImageType;
+    typedef typename SparseMoseImageType::Pointer SparseMoseImagePointer;
+
     typedef anima::MultiCompartmentModelCreator MCMCreatorType;
     typedef anima::MultiCompartmentModelCreator::CompartmentType CompartmentType;
     typedef anima::BaseCompartment BaseCompartmentType;
@@ -148,6 +157,18 @@ public:
     MoseImageType *GetMoseVolume () {return m_MoseVolume;}
 
     void WriteMCMOutput(std::string fileName);
+    void WriteAICcVolume(std::string fileName);
+    void WriteB0Volume(std::string fileName);
+    void WriteSigmaSquareVolume(std::string fileName);
+    void WriteMoseVolume(std::string fileName);
+
+    /**
+     * Sparse outputs: estimates are stored for in-mask voxels only and expanded when written with the Write methods
+     * above. The output image then has a single voxel buffer, and the AICc, B0, sigma and mose volume getters return null
+     * (except for an external mose volume)
+     */
+    itkSetMacro(SparseOutputs, bool)
+    itkGetMacro(SparseOutputs, bool)
 
     itkSetMacro(AxialDiffusivityValue, double)
     itkSetMacro(StaniszDiffusivityValue, double)
@@ -159,13 +180,24 @@ public:
     itkSetMacro(FTolerance, double)
     itkSetMacro(MaxEval, unsigned int)
 
+    //! If set, in-mask voxels are processed one by one in decreasing order of estimated cost instead of slice by slice
+    itkSetMacro(CostOrderedVoxelProcessing, bool)
+    itkGetMacro(CostOrderedVoxelProcessing, bool)
+
+    //! If set, special functions of NODDI signals are tabulated at filter start and interpolated by all threads
+    itkSetMacro(UseTabulatedCompartmentSignals, bool)
+    itkGetMacro(UseTabulatedCompartmentSignals, bool)
+
 protected:
     MCMEstimatorImageFilter() : Superclass()
     {
+        this->SetCompactedMaskExecution(true);
+
         m_AICcVolume = 0;
         m_B0Volume = 0;
         m_SigmaSquareVolume = 0;
         m_MoseVolume = 0;
+        m_SparseOutputs = false;
 
         m_GradientStrengths.clear();
         m_GradientDirections.clear();
@@ -215,6 +247,12 @@ protected:
 
         m_SmallDelta = anima::DiffusionSmallDelta;
         m_BigDelta = anima::DiffusionBigDelta;
+
+        m_CostOrderedVoxelProcessing = false;
+        m_NextCostOrderedVoxel = 0;
+
+        m_UseTabulatedCompartmentSignals = false;
+        m_NODDISignalTable = ITK_NULLPTR;
     }
 
     virtual ~MCMEstimatorImageFilter()
@@ -227,9 +265,19 @@ protected:
     void CheckComputationMask() ITK_OVERRIDE;
 
     void GenerateOutputInformation() ITK_OVERRIDE;
+    void AllocateOutputs() ITK_OVERRIDE;
     virtual void BeforeThreadedGenerateData() ITK_OVERRIDE;
     void DynamicThreadedGenerateData(const OutputImageRegionType &outputRegionForThread) ITK_OVERRIDE;
 
+    //! Dispatches voxels by decreasing estimated cost if cost ordered processing is on, slices otherwise
+    void ThreadProcessSlices() ITK_OVERRIDE;
+
+    //! Relative estimation cost of a voxel, from the number of models it will have to fit
+    virtual double EstimateVoxelCost(unsigned int moseValue);
+
+    //! Builds the list of in-mask non empty voxels, sorted by decreasing estimated cost
+    void ComputeCostOrderedVoxels();
+
     //! Create a cost function following the noise type and estimation mode
     CostFunctionBasePointer CreateCostFunction(std::vector<double> &observedSignals, MCMPointer &mcmModel);
 
@@ -303,6 +351,13 @@ private:
     OutputScalarImagePointer m_AICcVolume;
     MoseImagePointer m_MoseVolume;
 
+    bool m_SparseOutputs;
+    SparseVectorImagePointer m_SparseModelOutput;
+    SparseScalarImagePointer m_SparseB0Volume;
+    SparseScalarImagePointer m_SparseSigmaSquareVolume;
+    SparseScalarImagePointer m_SparseAICcVolume;
+    SparseMoseImagePointer m_SparseMoseVolume;
+
     std::vector <MCMCreatorType *> m_MCMCreators;
 
     std::string m_Optimizer;
@@ -353,6 +408,13 @@ private:
 
     //! Coarse grid values for complex model initialization
     std::vector < std::vector <double> > m_ValuesCoarseGrid;
+
+    bool m_CostOrderedVoxelProcessing;
+    std::vector <typename InputImageType::IndexType> m_CostOrderedVoxels;
+    std::atomic <unsigned int> m_NextCostOrderedVoxel;
+
+    bool m_UseTabulatedCompartmentSignals;
+    anima::NODDISignalTable::Pointer m_NODDISignalTable;
 };
 
 } // end namespace anima
@@ -4,6 +4,7 @@
 
 #include <itkImageRegionIterator.h>
 #include <itkImageRegionConstIterator.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
 #include <itkSymmetricEigenAnalysis.h>
 
 #include <animaNLOPTOptimizers.h>
@@ -22,8 +23,10 @@
 
 #include <animaBaseTensorTools.h>
 #include <animaMCMFileWriter.h>
+#include <animaReadWriteFunctions.h>
 
 #include <limits>
+#include <algorithm>
 
 namespace anima
 {
@@ -88,12 +91,107 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
     typedef anima::MCMFileWriter <OutputPixelType, InputImageType::ImageDimension> MCMFileWriterType;
     MCMFileWriterType writer;
 
-    writer.SetInputImage(this->GetOutput());
+    if (m_SparseOutputs)
+    {
+        m_SparseModelOutput->Modified();
+        writer.SetSparseInputImage(m_SparseModelOutput,this->GetOutput()->GetDescriptionModel());
+    }
+    else
+        writer.SetInputImage(this->GetOutput());
+
     writer.SetFileName(fileName);
 
     writer.Update();
 }
 
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::WriteAICcVolume(std::string fileName)
+{
+    if (!m_SparseOutputs)
+    {
+        anima::writeImage <OutputScalarImageType> (fileName,m_AICcVolume);
+        return;
+    }
+
+    m_SparseAICcVolume->Modified();
+    anima::writeStreamedImage <OutputScalarImageType> (fileName,m_SparseAICcVolume);
+    m_SparseAICcVolume->GetOutput()->Initialize();
+}
+
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::WriteB0Volume(std::string fileName)
+{
+    if (!m_SparseOutputs)
+    {
+        anima::writeImage <OutputScalarImageType> (fileName,m_B0Volume);
+        return;
+    }
+
+    m_SparseB0Volume->Modified();
+    anima::writeStreamedImage <OutputScalarImageType> (fileName,m_SparseB0Volume);
+    m_SparseB0Volume->GetOutput()->Initialize();
+}
+
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::WriteSigmaSquareVolume(std::string fileName)
+{
+    if (!m_SparseOutputs)
+    {
+        anima::writeImage <OutputScalarImageType> (fileName,m_SigmaSquareVolume);
+        return;
+    }
+
+    m_SparseSigmaSquareVolume->Modified();
+    anima::writeStreamedImage <OutputScalarImageType> (fileName,m_SparseSigmaSquareVolume);
+    m_SparseSigmaSquareVolume->GetOutput()->Initialize();
+}
+
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::WriteMoseVolume(std::string fileName)
+{
+    // An external model selection map is updated in place, even with sparse outputs
+    if (!m_SparseMoseVolume)
+    {
+        anima::writeImage <MoseImageType> (fileName,m_MoseVolume);
+        return;
+    }
+
+    m_SparseMoseVolume->Modified();
+    anima::writeStreamedImage <MoseImageType> (fileName,m_SparseMoseVolume);
+    m_SparseMoseVolume->GetOutput()->Initialize();
+}
+
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::AllocateOutputs()
+{
+    if (!m_SparseOutputs)
+    {
+        Superclass::AllocateOutputs();
+        return;
+    }
+
+    // Only geometry and description model of the output are used, estimates go to the sparse model output
+    OutputImageType *output = this->GetOutput();
+    OutputImageRegionType voxelRegion;
+    voxelRegion.SetIndex(output->GetLargestPossibleRegion().GetIndex());
+    typename OutputImageRegionType::SizeType voxelSize;
+    voxelSize.Fill(1);
+    voxelRegion.SetSize(voxelSize);
+
+    output->SetBufferedRegion(voxelRegion);
+    output->Allocate();
+}
+
 template <class InputPixelType, class OutputPixelType>
 void
 MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
@@ -149,49 +247,53 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
     if (m_GradientStrengths.size() != m_NumberOfImages)
         itkExceptionMacro("There should be the same number of input images and input b-values...");
 
-    itk::ImageRegionIterator <OutputImageType> fillOut(this->GetOutput(),this->GetOutput()->GetLargestPossibleRegion());
-    unsigned int outSize = this->GetOutput()->GetNumberOfComponentsPerPixel();
-    typename OutputImageType::PixelType emptyModelVec(outSize);
-    emptyModelVec.Fill(0);
-
-    while (!fillOut.IsAtEnd())
+    // Sparse outputs are created once the computation mask is final
+    if (!m_SparseOutputs)
     {
-        fillOut.Set(emptyModelVec);
-        ++fillOut;
-    }
+        itk::ImageRegionIterator <OutputImageType> fillOut(this->GetOutput(),this->GetOutput()->GetLargestPossibleRegion());
+        unsigned int outSize = this->GetOutput()->GetNumberOfComponentsPerPixel();
+        typename OutputImageType::PixelType emptyModelVec(outSize);
+        emptyModelVec.Fill(0);
 
-    // Create AICc volume
-    m_AICcVolume = OutputScalarImageType::New();
-    m_AICcVolume->Initialize();
-    m_AICcVolume->SetRegions(this->GetInput(0)->GetLargestPossibleRegion());
-    m_AICcVolume->SetSpacing (this->GetInput(0)->GetSpacing());
-    m_AICcVolume->SetOrigin (this->GetInput(0)->GetOrigin());
-    m_AICcVolume->SetDirection (this->GetInput(0)->GetDirection());
-    m_AICcVolume->Allocate();
-    m_AICcVolume->FillBuffer(0);
-
-    // Create B0 volume
-    m_B0Volume = OutputScalarImageType::New();
-    m_B0Volume->Initialize();
-    m_B0Volume->SetRegions(this->GetInput(0)->GetLargestPossibleRegion());
-    m_B0Volume->SetSpacing (this->GetInput(0)->GetSpacing());
-    m_B0Volume->SetOrigin (this->GetInput(0)->GetOrigin());
-    m_B0Volume->SetDirection (this->GetInput(0)->GetDirection());
-    m_B0Volume->Allocate();
-    m_B0Volume->FillBuffer(0);
-
-    // Create sigma volume
-    m_SigmaSquareVolume = OutputScalarImageType::New();
-    m_SigmaSquareVolume->Initialize();
-    m_SigmaSquareVolume->SetRegions(this->GetInput(0)->GetLargestPossibleRegion());
-    m_SigmaSquareVolume->SetSpacing (this->GetInput(0)->GetSpacing());
-    m_SigmaSquareVolume->SetOrigin (this->GetInput(0)->GetOrigin());
-    m_SigmaSquareVolume->SetDirection (this->GetInput(0)->GetDirection());
-    m_SigmaSquareVolume->Allocate();
-    m_SigmaSquareVolume->FillBuffer(0);
+        while (!fillOut.IsAtEnd())
+        {
+            fillOut.Set(emptyModelVec);
+            ++fillOut;
+        }
+
+        // Create AICc volume
+        m_AICcVolume = OutputScalarImageType::New();
+        m_AICcVolume->Initialize();
+        m_AICcVolume->SetRegions(this->GetInput(0)->GetLargestPossibleRegion());
+        m_AICcVolume->SetSpacing (this->GetInput(0)->GetSpacing());
+        m_AICcVolume->SetOrigin (this->GetInput(0)->GetOrigin());
+        m_AICcVolume->SetDirection (this->GetInput(0)->GetDirection());
+        m_AICcVolume->Allocate();
+        m_AICcVolume->FillBuffer(0);
+
+        // Create B0 volume
+        m_B0Volume = OutputScalarImageType::New();
+        m_B0Volume->Initialize();
+        m_B0Volume->SetRegions(this->GetInput(0)->GetLargestPossibleRegion());
+        m_B0Volume->SetSpacing (this->GetInput(0)->GetSpacing());
+        m_B0Volume->SetOrigin (this->GetInput(0)->GetOrigin());
+        m_B0Volume->SetDirection (this->GetInput(0)->GetDirection());
+        m_B0Volume->Allocate();
+        m_B0Volume->FillBuffer(0);
+
+        // Create sigma volume
+        m_SigmaSquareVolume = OutputScalarImageType::New();
+        m_SigmaSquareVolume->Initialize();
+        m_SigmaSquareVolume->SetRegions(this->GetInput(0)->GetLargestPossibleRegion());
+        m_SigmaSquareVolume->SetSpacing (this->GetInput(0)->GetSpacing());
+        m_SigmaSquareVolume->SetOrigin (this->GetInput(0)->GetOrigin());
+        m_SigmaSquareVolume->SetDirection (this->GetInput(0)->GetDirection());
+        m_SigmaSquareVolume->Allocate();
+        m_SigmaSquareVolume->FillBuffer(0);
+    }
 
     // Create mose volume
-    if (!m_MoseVolume)
+    if (!m_MoseVolume && !m_SparseOutputs)
     {
         m_MoseVolume = MoseImageType::New();
         m_MoseVolume->Initialize();
@@ -208,6 +310,26 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
 
     Superclass::BeforeThreadedGenerateData();
 
+    m_SparseMoseVolume = ITK_NULLPTR;
+    if (m_SparseOutputs)
+    {
+        m_SparseModelOutput = SparseVectorImageType::New();
+        m_SparseModelOutput->Initialize(this->GetComputationMask(),this->GetOutput()->GetNumberOfComponentsPerPixel());
+
+        m_SparseAICcVolume = SparseScalarImageType::New();
+        m_SparseAICcVolume->Initialize(this->GetComputationMask(),1);
+        m_SparseB0Volume = SparseScalarImageType::New();
+        m_SparseB0Volume->Initialize(this->GetComputationMask(),1);
+        m_SparseSigmaSquareVolume = SparseScalarImageType::New();
+        m_SparseSigmaSquareVolume->Initialize(this->GetComputationMask(),1);
+
+        if (!m_ExternalMoseVolume)
+        {
+            m_SparseMoseVolume = SparseMoseImageType::New();
+            m_SparseMoseVolume->Initialize(this->GetComputationMask(),1);
+        }
+    }
+
     m_MCMCreators.resize(this->GetNumberOfWorkUnits());
     for (unsigned int i = 0;i < this->GetNumberOfWorkUnits();++i)
         m_MCMCreators[i] = this->GetNewMCMCreatorInstance();
@@ -223,9 +345,26 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
     if (m_ModelWithStaniszComponent)
         std::cout << " - Stanisz diffusivity: " << m_StaniszDiffusivityValue << " mm2/s," << std::endl;
 
+    m_NODDISignalTable = ITK_NULLPTR;
+    if (m_UseTabulatedCompartmentSignals && (m_CompartmentType == NODDI))
+    {
+        double maxBValue = 0.0;
+        for (unsigned int i = 0;i < m_GradientStrengths.size();++i)
+            maxBValue = std::max(maxBValue,anima::GetBValueFromAcquisitionParameters(m_SmallDelta,m_BigDelta,m_GradientStrengths[i]));
+
+        if (maxBValue > 0.0)
+        {
+            std::cout << "Tabulating NODDI signal special functions..." << std::endl;
+            m_NODDISignalTable = anima::NODDISignalTable::New();
+            m_NODDISignalTable->SetMaximalBDValue(maxBValue * anima::MCMDiffusivityUpperBound);
+            m_NODDISignalTable->Initialize();
+        }
+    }
+
     // Setting up creators
     for (unsigned int i = 0;i < this->GetNumberOfWorkUnits();++i)
     {
+        m_MCMCreators[i]->SetNODDISignalTable(m_NODDISignalTable);
         m_MCMCreators[i]->SetAxialDiffusivityValue(m_AxialDiffusivityValue);
         m_MCMCreators[i]->SetFreeWaterDiffusivityValue(3.0e-3);
         m_MCMCreators[i]->SetIRWDiffusivityValue(m_IRWDiffusivityValue);
@@ -253,6 +392,9 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
 
     // Sparse pre-computation
     this->InitializeDictionary();
+
+    if (m_CostOrderedVoxelProcessing)
+        this->ComputeCostOrderedVoxels();
 }
 
 template <class InputPixelType, class OutputPixelType>
@@ -419,6 +561,124 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
     }
 }
 
+template <class InputPixelType, class OutputPixelType>
+double
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::EstimateVoxelCost(unsigned int moseValue)
+{
+    // Anisotropic models are fitted incrementally: stick, then zeppelin, then the final model
+    // (itself preceded by a coarse grid search for tensor, NODDI and DDI)
+    double compartmentCost = 1.0;
+    switch (m_CompartmentType)
+    {
+        case Stick:
+            break;
+
+        case Zeppelin:
+            compartmentCost = 2.0;
+            break;
+
+        default:
+            compartmentCost = 4.0;
+            break;
+    }
+
+    // Isotropic model is always estimated
+    double voxelCost = 1.0;
+    if (m_FindOptimalNumberOfCompartments)
+    {
+        for (unsigned int i = 1;i <= m_NumberOfCompartments;++i)
+            voxelCost += i * compartmentCost;
+    }
+    else
+        voxelCost += moseValue * compartmentCost;
+
+    return voxelCost;
+}
+
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::ComputeCostOrderedVoxels()
+{
+    OutputImageRegionType computationRegion = this->GetComputationRegion();
+
+    typedef itk::ImageRegionConstIterator <InputImageType> ConstImageIteratorType;
+    std::vector <ConstImageIteratorType> inIterators(m_NumberOfImages);
+    for (unsigned int i = 0;i < m_NumberOfImages;++i)
+        inIterators[i] = ConstImageIteratorType(this->GetInput(i),computationRegion);
+
+    typedef itk::ImageRegionConstIteratorWithIndex <MaskImageType> MaskIteratorType;
+    MaskIteratorType maskItr(this->GetComputationMask(),computationRegion);
+
+    std::vector < std::pair <double, typename InputImageType::IndexType> > voxelCosts;
+    while (!maskItr.IsAtEnd())
+    {
+        bool emptyVoxel = true;
+        for (unsigned int i = 0;i < m_NumberOfImages;++i)
+        {
+            if (inIterators[i].Get() != 0)
+                emptyVoxel = false;
+
+            ++inIterators[i];
+        }
+
+        if ((maskItr.Get() != 0)&&(!emptyVoxel))
+        {
+            unsigned int moseValue = m_NumberOfCompartments;
+            if (m_ExternalMoseVolume)
+                moseValue = m_MoseVolume->GetPixel(maskItr.GetIndex());
+
+            voxelCosts.push_back(std::make_pair(this->EstimateVoxelCost(moseValue),maskItr.GetIndex()));
+        }
+
+        ++maskItr;
+    }
+
+    // Stable sort keeps the raster order among voxels of equal cost
+    std::stable_sort(voxelCosts.begin(),voxelCosts.end(),
+                     [](const std::pair <double, typename InputImageType::IndexType> &lhs,
+                        const std::pair <double, typename InputImageType::IndexType> &rhs)
+    {
+        return lhs.first > rhs.first;
+    });
+
+    m_CostOrderedVoxels.resize(voxelCosts.size());
+    for (unsigned int i = 0;i < voxelCosts.size();++i)
+        m_CostOrderedVoxels[i] = voxelCosts[i].second;
+
+    m_NextCostOrderedVoxel = 0;
+}
+
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::ThreadProcessSlices()
+{
+    if (!m_CostOrderedVoxelProcessing)
+    {
+        Superclass::ThreadProcessSlices();
+        return;
+    }
+
+    // Most expensive voxels are dispatched first so that cheap ones fill in the end of the computation
+    OutputImageRegionType voxelRegion;
+    typename OutputImageRegionType::SizeType voxelSize;
+    voxelSize.Fill(1);
+    voxelRegion.SetSize(voxelSize);
+
+    unsigned int numVoxels = m_CostOrderedVoxels.size();
+    while (true)
+    {
+        unsigned int voxelPosition = m_NextCostOrderedVoxel++;
+        if (voxelPosition >= numVoxels)
+            break;
+
+        voxelRegion.SetIndex(m_CostOrderedVoxels[voxelPosition]);
+        this->DynamicThreadedGenerateData(voxelRegion);
+    }
+}
+
 template <class InputPixelType, class OutputPixelType>
 void
 MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
@@ -430,20 +690,10 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
     for (unsigned int i = 0;i < m_NumberOfImages;++i)
         inIterators[i] = ConstImageIteratorType(this->GetInput(i),outputRegionForThread);
 
-    typedef itk::ImageRegionIterator <OutputImageType> OutImageIteratorType;
-    OutImageIteratorType outIterator(this->GetOutput(),outputRegionForThread);
-
-    typedef itk::ImageRegionIterator <MaskImageType> MaskIteratorType;
+    // Outputs are written by index so that full and sparse outputs share the same loop
+    typedef itk::ImageRegionConstIteratorWithIndex <MaskImageType> MaskIteratorType;
     MaskIteratorType maskItr(this->GetComputationMask(),outputRegionForThread);
 
-    typedef itk::ImageRegionIterator <OutputScalarImageType> ImageIteratorType;
-    ImageIteratorType aiccIterator(m_AICcVolume, outputRegionForThread);
-    ImageIteratorType b0Iterator(m_B0Volume, outputRegionForThread);
-    ImageIteratorType sigmaIterator(m_SigmaSquareVolume, outputRegionForThread);
-
-    typedef itk::ImageRegionIterator <MoseImageType> MoseIteratorType;
-    MoseIteratorType moseIterator(m_MoseVolume, outputRegionForThread);
-
     std::vector <double> observedSignals(m_NumberOfImages,0);
 
     typename OutputImageType::PixelType resVec(this->GetOutput()->GetNumberOfComponentsPerPixel());
@@ -456,7 +706,7 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
 
     unsigned int threadId = this->GetSafeThreadId();
 
-    while (!outIterator.IsAtEnd())
+    while (!maskItr.IsAtEnd())
     {
         resVec.Fill(0.0);
 
@@ -472,21 +722,16 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
 
         if ((maskItr.Get() == 0)||(emptyVoxel))
         {
-            outIterator.Set(resVec);
-
+            // Outputs are already zero there
             for (unsigned int i = 0;i < m_NumberOfImages;++i)
                 ++inIterators[i];
 
-            ++outIterator;
             ++maskItr;
-            ++aiccIterator;
-            ++b0Iterator;
-            ++sigmaIterator;
-            ++moseIterator;
-
             continue;
         }
 
+        typename OutputImageType::IndexType currentIndex = maskItr.GetIndex();
+
         // Load DWI
         for (unsigned int i = 0;i < m_NumberOfImages;++i)
             observedSignals[i] = inIterators[i].Get();
@@ -495,7 +740,7 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
         bool estimateNonIsoCompartments = false;
         if (m_ExternalMoseVolume)
         {
-            moseValue = moseIterator.Get();
+            moseValue = m_MoseVolume->GetPixel(currentIndex);
             if (moseValue > 0)
                 estimateNonIsoCompartments = true;
         }
@@ -565,22 +810,32 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
         else
             resVec = mcmData->GetModelVector();
 
-        outIterator.Set(resVec);
-        aiccIterator.Set(aiccValue);
-        b0Iterator.Set(b0Value);
-        sigmaIterator.Set(sigmaSqValue);
-        moseIterator.Set(mcmData->GetNumberOfCompartments() - mcmData->GetNumberOfIsotropicCompartments());
+        unsigned char outputMoseValue = mcmData->GetNumberOfCompartments() - mcmData->GetNumberOfIsotropicCompartments();
+        if (m_SparseOutputs)
+        {
+            m_SparseModelOutput->SetPixel(currentIndex,resVec);
+            m_SparseAICcVolume->SetPixel(currentIndex,aiccValue);
+            m_SparseB0Volume->SetPixel(currentIndex,b0Value);
+            m_SparseSigmaSquareVolume->SetPixel(currentIndex,sigmaSqValue);
+        }
+        else
+        {
+            this->GetOutput()->SetPixel(currentIndex,resVec);
+            m_AICcVolume->SetPixel(currentIndex,aiccValue);
+            m_B0Volume->SetPixel(currentIndex,b0Value);
+            m_SigmaSquareVolume->SetPixel(currentIndex,sigmaSqValue);
+        }
+
+        if (m_SparseMoseVolume)
+            m_SparseMoseVolume->SetPixel(currentIndex,outputMoseValue);
+        else
+            m_MoseVolume->SetPixel(currentIndex,outputMoseValue);
 
         for (unsigned int i = 0;i < m_NumberOfImages;++i)
             ++inIterators[i];
 
         this->IncrementNumberOfProcessedPoints();
-        ++outIterator;
         ++maskItr;
-        ++aiccIterator;
-        ++b0Iterator;
-        ++sigmaIterator;
-        ++moseIterator;
     }
 
     this->SafeReleaseThreadId(threadId);
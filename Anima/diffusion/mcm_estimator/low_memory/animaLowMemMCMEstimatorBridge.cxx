@@ -153,6 +153,14 @@ void LowMemMCMEstimatorBridge::Update(int specificSplitToDo, bool genOutputDescr
             filter->SetMoseVolume(m_InputMoseImage->GetOutput(0));
         }
 
+        // Next block DWIs are read during the estimation on this one
+        if (i + 1 < splitIndexesToProcess.size())
+        {
+            m_DWIImages->PrefetchBlock(splitIndexesToProcess[i + 1]);
+            if (m_InputMoseImage)
+                m_InputMoseImage->PrefetchBlock(splitIndexesToProcess[i + 1]);
+        }
+
         filter->SetComputationMask(m_DWIImages->GetSmallMaskWithMargin());
 
         filter->SetB0Threshold(m_B0Threshold);
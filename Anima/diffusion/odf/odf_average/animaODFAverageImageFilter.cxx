@@ -28,14 +28,13 @@ namespace anima
         unsigned int odfSHOrder = std::round(-1.5 + 0.5 * std::sqrt(8.0 * static_cast<double>(this->GetInput(0)->GetVectorLength()) + 1.0));
         m_VectorLength = (odfSHOrder + 1) * (odfSHOrder + 2) / 2;
 
-        m_SpherHarm.set_size(m_NbSamplesPhi * m_NbSamplesTheta, m_VectorLength);
         m_ODFSHBasis = new anima::ODFSphericalHarmonicBasis(odfSHOrder);
 
         // Discretize SH
-        double sqrt2 = std::sqrt(2.0);
         double deltaPhi = 2.0 * M_PI / (static_cast<double>(m_NbSamplesPhi) - 1.0);
         double deltaTheta = M_PI / (static_cast<double>(m_NbSamplesTheta) - 1.0);
 
+        std::vector<std::vector<double>> sphericalDirs(m_NbSamplesPhi * m_NbSamplesTheta, std::vector<double>(2));
         unsigned int k = 0;
         for (unsigned int i = 0; i < m_NbSamplesTheta; ++i)
         {
@@ -43,15 +42,14 @@ namespace anima
 
             for (unsigned int j = 0; j < m_NbSamplesPhi; ++j)
             {
-                double phi = static_cast<double>(j) * deltaPhi;
-                unsigned int c = 0;
-                for (double l = 0; l <= odfSHOrder; l += 2)
-                    for (double m = -l; m <= l; m++)
-                        m_SpherHarm.put(k, c++, m_ODFSHBasis->getNthSHValueAtPosition(l, m, theta, phi));
+                sphericalDirs[k][0] = theta;
+                sphericalDirs[k][1] = static_cast<double>(j) * deltaPhi;
                 k++;
             }
         }
 
+        m_ODFSHBasis->GetBasisMatrix(sphericalDirs, m_SpherHarm);
+
         m_SolveSHMatrix = vnl_matrix_inverse<double>(m_SpherHarm.transpose() * m_SpherHarm).as_matrix() * m_SpherHarm.transpose();
     }
 
@@ -141,19 +139,14 @@ namespace anima
 
     void ODFAverageImageFilter::DiscretizeODF(const InputPixelType &modelValue, VectorType &odf)
     {
-        unsigned int k = 0;
-        double deltaPhi = 2.0 * M_PI / (static_cast<double>(m_NbSamplesPhi) - 1.0);
-        double deltaTheta = M_PI / (static_cast<double>(m_NbSamplesTheta) - 1.0);
-
-        for (unsigned int i = 0; i < m_NbSamplesTheta; ++i)
+        // Sampling grid is fixed, use the precomputed SH matrix
+        for (unsigned int k = 0; k < m_SpherHarm.rows(); ++k)
         {
-            double theta = static_cast<double>(i) * deltaTheta;
-            for (unsigned int j = 0; j < m_NbSamplesPhi; ++j)
-            {
-                double phi = static_cast<double>(j) * deltaPhi;
-                odf[k] = m_ODFSHBasis->getValueAtPosition(modelValue, theta, phi);
-                k++;
-            }
+            double value = 0;
+            for (unsigned int c = 0; c < m_SpherHarm.cols(); ++c)
+                value += m_SpherHarm(k, c) * modelValue[c];
+
+            odf[k] = value;
         }
     }
 
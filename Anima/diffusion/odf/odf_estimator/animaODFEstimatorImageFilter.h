@@ -53,6 +53,9 @@ namespace anima
         itkSetMacro(UseAganjEstimation, bool);
         itkSetMacro(DeltaAganjRegularization, double);
 
+        //! Number of voxels gathered to compute SH coefficients and simulated signals as matrix products
+        itkSetMacro(VoxelBlockSize, unsigned int);
+
         itkGetMacro(EstimatedB0Image, OutputScalarImageType *);
         itkGetMacro(EstimatedVarianceImage, OutputScalarImageType *);
 
@@ -80,9 +83,10 @@ namespace anima
             m_SharpnessRatio = 0.255;
 
             m_Normalize = false;
-            m_SphereSHSampling.clear();
+            m_SphereSHIntegrationWeights.clear();
 
             m_UseAganjEstimation = false;
+            m_VoxelBlockSize = 128;
         }
 
         virtual ~ODFEstimatorImageFilter() {}
@@ -91,6 +95,18 @@ namespace anima
         void BeforeThreadedGenerateData() ITK_OVERRIDE;
         void DynamicThreadedGenerateData(const OutputImageRegionType &outputRegionForThread) ITK_OVERRIDE;
 
+        //! Work data for a block of voxels, matrices store one voxel per row
+        struct VoxelBlockDataStructure
+        {
+            unsigned int numberOfVoxels;
+            std::vector<typename TOutputImage::IndexType> indexes;
+            std::vector<double> b0Values, b0Residuals;
+            vnl_matrix<double> signals, fitData;
+            vnl_matrix<double> coefficients, simulationCoefficients, simulatedSignals;
+        };
+
+        void EstimateVoxelBlock(VoxelBlockDataStructure &blockData);
+
     private:
         ITK_DISALLOW_COPY_AND_ASSIGN(ODFEstimatorImageFilter);
 
@@ -129,7 +145,7 @@ namespace anima
 
         bool m_Normalize;
         std::string m_FileNameSphereTesselation;
-        std::vector<std::vector<double>> m_SphereSHSampling;
+        std::vector<double> m_SphereSHIntegrationWeights;
 
         double m_Lambda;
         double m_SharpnessRatio; // See Descoteaux et al. TMI 2009, article plus appendix
@@ -137,6 +153,7 @@ namespace anima
         bool m_UseAganjEstimation;
         double m_DeltaAganjRegularization;
         unsigned int m_LOrder;
+        unsigned int m_VoxelBlockSize;
     };
 
 } // end of namespace anima
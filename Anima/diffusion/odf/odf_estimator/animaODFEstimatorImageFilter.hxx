@@ -5,8 +5,9 @@
 #include "animaODFEstimatorImageFilter.h"
 #include <animaODFSphericalHarmonicBasis.h>
 
-#include <itkImageRegionConstIterator.h>
-#include <itkImageRegionIterator.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
+
+#include <vnl/vnl_fastops.h>
 
 #include <boost/math/special_functions/legendre.hpp>
 
@@ -107,20 +108,9 @@ namespace anima
 
         // Compute TMatrix as expressed in Descoteaux MRM 2007
         unsigned int posValue = 0;
-        m_BMatrix.set_size(numGrads, vectorLength);
 
         anima::ODFSphericalHarmonicBasis tmpBasis(m_LOrder);
-
-        for (unsigned int i = 0; i < numGrads; ++i)
-        {
-            posValue = 0;
-            for (int k = 0; k <= (int)m_LOrder; k += 2)
-                for (int m = -k; m <= k; ++m)
-                {
-                    m_BMatrix(i, posValue) = tmpBasis.getNthSHValueAtPosition(k, m, m_GradientDirections[i][0], m_GradientDirections[i][1]);
-                    ++posValue;
-                }
-        }
+        tmpBasis.GetBasisMatrix(m_GradientDirections, m_BMatrix);
 
         std::vector<double> LVector(vectorLength, 0);
         m_PVector.resize(vectorLength);
@@ -214,11 +204,10 @@ namespace anima
         {
             std::ifstream sphereIn(m_FileNameSphereTesselation.c_str());
 
-            m_SphereSHSampling.clear();
 
             std::vector<double> dirTmp(3, 0);
             std::vector<double> sphericalCoords;
-            std::vector<double> shData;
+            std::vector<std::vector<double>> sphereDirections;
 
             while (!sphereIn.eof())
             {
@@ -232,15 +221,23 @@ namespace anima
                 tmpStrStream >> dirTmp[0] >> dirTmp[1] >> dirTmp[2];
 
                 anima::TransformCartesianToSphericalCoordinates(dirTmp, sphericalCoords);
-                shData.clear();
+                sphereDirections.push_back(sphericalCoords);
+            }
+            sphereIn.close();
 
-                for (int k = 0; k <= (int)m_LOrder; k += 2)
-                    for (int m = -k; m <= k; ++m)
-                        shData.push_back(tmpBasis.getNthSHValueAtPosition(k, m, sphericalCoords[0], sphericalCoords[1]));
+            vnl_matrix<double> sphereSHMatrix;
+            tmpBasis.GetBasisMatrix(sphereDirections, sphereSHMatrix);
+
+            // The ODF integral over the sphere samples is linear in the SH coefficients
+            m_SphereSHIntegrationWeights.resize(vectorLength);
+            for (unsigned int j = 0; j < vectorLength; ++j)
+            {
+                long double weight = 0;
+                for (unsigned int i = 0; i < sphereSHMatrix.rows(); ++i)
+                    weight += sphereSHMatrix(i, j);
 
-                m_SphereSHSampling.push_back(shData);
+                m_SphereSHIntegrationWeights[j] = weight;
             }
-            sphereIn.close();
         }
         else
             m_Normalize = false;
@@ -250,18 +247,14 @@ namespace anima
     void
     ODFEstimatorImageFilter<TInputPixelType, TOutputPixelType>::DynamicThreadedGenerateData(const OutputImageRegionType &outputRegionForThread)
     {
-        typedef itk::ImageRegionConstIterator<TInputImage> InputIteratorType;
-        typedef itk::ImageRegionIterator<TOutputImage> OutputIteratorType;
-        typedef itk::ImageRegionIterator<OutputScalarImageType> OutputScalarIteratorType;
+        typedef itk::ImageRegionConstIteratorWithIndex<TInputImage> InputIteratorType;
 
         unsigned int vectorLength = (m_LOrder + 1) * (m_LOrder + 2) / 2;
         unsigned int numGrads = m_GradientIndexes.size();
         unsigned int numB0 = m_B0Indexes.size();
 
-        OutputIteratorType resIt(this->GetOutput(), outputRegionForThread);
-
         std::vector<InputIteratorType> diffusionIts(numGrads);
-        std::vector<InputIteratorType> b0Its(numGrads);
+        std::vector<InputIteratorType> b0Its(numB0);
         for (unsigned int i = 0; i < numGrads; ++i)
             diffusionIts[i] = InputIteratorType(this->GetInput(m_GradientIndexes[i]), outputRegionForThread);
         for (unsigned int i = 0; i < numB0; ++i)
@@ -271,11 +264,24 @@ namespace anima
         if (m_ReferenceB0Image.IsNotNull())
             refB0Itr = InputIteratorType(m_ReferenceB0Image, outputRegionForThread);
 
-        OutputScalarIteratorType varItr(m_EstimatedVarianceImage, outputRegionForThread);
-        OutputScalarIteratorType outB0Itr(m_EstimatedB0Image, outputRegionForThread);
-
         itk::VariableLengthVector<TOutputPixelType> outputData(vectorLength);
-        std::vector<double> tmpData(numGrads, 0);
+        outputData.Fill(0.0);
+
+        // Voxels with a signal are gathered by blocks, one voxel per matrix row
+        unsigned int blockSize = std::max(1u, m_VoxelBlockSize);
+        VoxelBlockDataStructure blockData;
+        blockData.numberOfVoxels = 0;
+        blockData.indexes.resize(blockSize);
+        blockData.b0Values.resize(blockSize);
+        blockData.b0Residuals.resize(blockSize);
+        blockData.signals.set_size(blockSize, numGrads);
+        blockData.signals.fill(0.0);
+        blockData.fitData.set_size(blockSize, numGrads);
+        blockData.fitData.fill(0.0);
+        blockData.coefficients.set_size(blockSize, vectorLength);
+        blockData.simulationCoefficients.set_size(blockSize, vectorLength);
+        blockData.simulatedSignals.set_size(blockSize, numGrads);
+
         while (!diffusionIts[0].IsAtEnd())
         {
             double b0Value = 0;
@@ -289,123 +295,151 @@ namespace anima
                 b0Value /= numB0;
             }
 
+            unsigned int blockPosition = blockData.numberOfVoxels;
+            double *signalRow = blockData.signals[blockPosition];
+            bool zeroSignal = true;
             for (unsigned int i = 0; i < numGrads; ++i)
-                tmpData[i] = diffusionIts[i].Get();
-
-            for (unsigned int i = 0; i < vectorLength; ++i)
-                outputData[i] = 0;
-
-            if ((isZero(tmpData)) || (b0Value <= 0))
             {
-                resIt.Set(outputData);
-                outB0Itr.Set(0.0);
-                varItr.Set(0.0);
-                ++resIt;
-                ++outB0Itr;
-                ++varItr;
-
-                for (unsigned int i = 0; i < numGrads; ++i)
-                    ++diffusionIts[i];
-
-                for (unsigned int i = 0; i < numB0; ++i)
-                    ++b0Its[i];
-
-                continue;
+                signalRow[i] = diffusionIts[i].Get();
+                if (signalRow[i] != 0)
+                    zeroSignal = false;
             }
 
-            if (m_UseAganjEstimation)
+            if (zeroSignal || (b0Value <= 0))
+            {
+                typename TOutputImage::IndexType index = diffusionIts[0].GetIndex();
+                this->GetOutput()->SetPixel(index, outputData);
+                m_EstimatedB0Image->SetPixel(index, 0.0);
+                m_EstimatedVarianceImage->SetPixel(index, 0.0);
+            }
+            else
             {
+                double *fitRow = blockData.fitData[blockPosition];
                 for (unsigned int i = 0; i < numGrads; ++i)
                 {
-                    double e = tmpData[i] / b0Value;
+                    fitRow[i] = signalRow[i];
+                    if (!m_UseAganjEstimation)
+                        continue;
+
+                    double e = signalRow[i] / b0Value;
 
                     if (e < 0)
-                        tmpData[i] = m_DeltaAganjRegularization / 2.0;
+                        fitRow[i] = m_DeltaAganjRegularization / 2.0;
                     else if (e < m_DeltaAganjRegularization)
-                        tmpData[i] = m_DeltaAganjRegularization / 2.0 + e * e / (2.0 * m_DeltaAganjRegularization);
+                        fitRow[i] = m_DeltaAganjRegularization / 2.0 + e * e / (2.0 * m_DeltaAganjRegularization);
                     else if (e < 1.0 - m_DeltaAganjRegularization)
-                        tmpData[i] = e;
+                        fitRow[i] = e;
                     else if (e < 1)
-                        tmpData[i] = 1.0 - m_DeltaAganjRegularization / 2.0 - (1.0 - e) * (1.0 - e) / (2.0 * m_DeltaAganjRegularization);
+                        fitRow[i] = 1.0 - m_DeltaAganjRegularization / 2.0 - (1.0 - e) * (1.0 - e) / (2.0 * m_DeltaAganjRegularization);
                     else
-                        tmpData[i] = 1.0 - m_DeltaAganjRegularization / 2.0;
+                        fitRow[i] = 1.0 - m_DeltaAganjRegularization / 2.0;
 
-                    tmpData[i] = std::log(-std::log(tmpData[i]));
+                    fitRow[i] = std::log(-std::log(fitRow[i]));
                 }
-            }
 
-            double zeroValue = 1.0;
-            if (b0Value > 0)
-            {
-                for (unsigned int i = 0; i < vectorLength; ++i)
-                    for (unsigned int j = 0; j < numGrads; ++j)
-                        outputData[i] += m_TMatrix(i, j) * tmpData[j];
-
-                if (!m_UseAganjEstimation)
-                {
-                    for (unsigned int i = 0; i < vectorLength; ++i)
-                        outputData[i] /= b0Value;
-                }
-                else
+                double b0Residual = 0;
+                for (unsigned int i = 0; i < numB0; ++i)
                 {
-                    zeroValue = outputData[0];
-                    outputData[0] = 1 / (2 * sqrt(M_PI));
+                    double b0Signal = b0Its[i].Get();
+                    b0Residual += (b0Value - b0Signal) * (b0Value - b0Signal);
                 }
+
+                blockData.indexes[blockPosition] = diffusionIts[0].GetIndex();
+                blockData.b0Values[blockPosition] = b0Value;
+                blockData.b0Residuals[blockPosition] = b0Residual;
+                ++blockData.numberOfVoxels;
             }
 
-            double noiseVariance = 0.0;
             for (unsigned int i = 0; i < numGrads; ++i)
+                ++diffusionIts[i];
+
+            for (unsigned int i = 0; i < numB0; ++i)
+                ++b0Its[i];
+
+            if (m_ReferenceB0Image.IsNotNull())
+                ++refB0Itr;
+
+            if ((blockData.numberOfVoxels == blockSize) || ((blockData.numberOfVoxels > 0) && (diffusionIts[0].IsAtEnd())))
             {
-                double signalSim = 0.0;
-                for (unsigned int j = 0; j < vectorLength; ++j)
+                this->EstimateVoxelBlock(blockData);
+                blockData.numberOfVoxels = 0;
+            }
+        }
+    }
+
+    template <typename TInputPixelType, typename TOutputPixelType>
+    void
+    ODFEstimatorImageFilter<TInputPixelType, TOutputPixelType>::EstimateVoxelBlock(VoxelBlockDataStructure &blockData)
+    {
+        unsigned int vectorLength = (m_LOrder + 1) * (m_LOrder + 2) / 2;
+        unsigned int numGrads = m_GradientIndexes.size();
+        unsigned int numB0 = m_B0Indexes.size();
+
+        // SH coefficients of the whole block as one matrix product, rows past the number of voxels are left-overs
+        vnl_fastops::ABt(blockData.coefficients, blockData.fitData, m_TMatrix);
+
+        for (unsigned int v = 0; v < blockData.numberOfVoxels; ++v)
+        {
+            double *coefficientsRow = blockData.coefficients[v];
+            double *simulationRow = blockData.simulationCoefficients[v];
+            double b0Value = blockData.b0Values[v];
+
+            if (!m_UseAganjEstimation)
+            {
+                for (unsigned int i = 0; i < vectorLength; ++i)
                 {
-                    if ((j == 0) && (m_UseAganjEstimation))
-                        signalSim += m_BMatrix(i, j) * zeroValue;
-                    else
-                        signalSim += m_BMatrix(i, j) * outputData[j] / m_PVector[j];
+                    coefficientsRow[i] /= b0Value;
+                    simulationRow[i] = coefficientsRow[i] / m_PVector[i];
                 }
+            }
+            else
+            {
+                simulationRow[0] = coefficientsRow[0];
+                coefficientsRow[0] = 1 / (2 * sqrt(M_PI));
+                for (unsigned int i = 1; i < vectorLength; ++i)
+                    simulationRow[i] = coefficientsRow[i] / m_PVector[i];
+            }
+        }
 
+        // Simulated signals of the whole block as one matrix product
+        vnl_fastops::ABt(blockData.simulatedSignals, blockData.simulationCoefficients, m_BMatrix);
+
+        itk::VariableLengthVector<TOutputPixelType> outputData(vectorLength);
+        for (unsigned int v = 0; v < blockData.numberOfVoxels; ++v)
+        {
+            double b0Value = blockData.b0Values[v];
+            const double *signalRow = blockData.signals[v];
+            const double *simulatedRow = blockData.simulatedSignals[v];
+
+            double noiseVariance = blockData.b0Residuals[v];
+            for (unsigned int i = 0; i < numGrads; ++i)
+            {
+                double signalSim = simulatedRow[i];
                 if (!m_UseAganjEstimation)
                     signalSim *= b0Value;
                 else
                     signalSim = b0Value * std::exp(-std::exp(signalSim));
 
-                double signalValue = diffusionIts[i].Get();
-                noiseVariance += (signalSim - signalValue) * (signalSim - signalValue);
-            }
-
-            for (unsigned int i = 0; i < numB0; ++i)
-            {
-                double b0Signal = b0Its[i].Get();
-                noiseVariance += (b0Value - b0Signal) * (b0Value - b0Signal);
+                noiseVariance += (signalSim - signalRow[i]) * (signalSim - signalRow[i]);
             }
 
             noiseVariance /= (numGrads + numB0);
-            varItr.Set(noiseVariance);
-
-            outB0Itr.Set(b0Value);
 
+            const double *coefficientsRow = blockData.coefficients[v];
+            double integralODF = 1.0;
             if (m_Normalize)
             {
-                long double integralODF = 0;
-                for (unsigned int i = 0; i < m_SphereSHSampling.size(); ++i)
-                    for (unsigned int j = 0; j < vectorLength; ++j)
-                        integralODF += m_SphereSHSampling[i][j] * outputData[j];
-
+                integralODF = 0;
                 for (unsigned int i = 0; i < vectorLength; ++i)
-                    outputData[i] /= integralODF;
+                    integralODF += m_SphereSHIntegrationWeights[i] * coefficientsRow[i];
             }
 
-            resIt.Set(outputData);
-            ++resIt;
-            ++outB0Itr;
-            ++varItr;
-
-            for (unsigned int i = 0; i < numGrads; ++i)
-                ++diffusionIts[i];
+            for (unsigned int i = 0; i < vectorLength; ++i)
+                outputData[i] = coefficientsRow[i] / integralODF;
 
-            for (unsigned int i = 0; i < numB0; ++i)
-                ++b0Its[i];
+            this->GetOutput()->SetPixel(blockData.indexes[v], outputData);
+            m_EstimatedB0Image->SetPixel(blockData.indexes[v], b0Value);
+            m_EstimatedVarianceImage->SetPixel(blockData.indexes[v], noiseVariance);
         }
     }
 
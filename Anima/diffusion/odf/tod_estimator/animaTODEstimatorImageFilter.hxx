@@ -404,39 +404,29 @@ namespace anima
     void
     TODEstimatorImageFilter<ScalarType>::PrecomputeSH()
     {
-        int k = 0;
-
-        std::vector<double> tmpDir(2), revDir(3);
+        std::vector<double> tmpDir(2);
+        std::vector<std::vector<double>> sphericalDirs(static_cast<unsigned int>(m_NbSample));
         for (int i = 0; i < m_NbSample; i++)
         {
             anima::TransformCartesianToSphericalCoordinates(m_SphereSampl[i], tmpDir);
-            int c = 0;
-            for (double l = 0; l <= m_LOrder; l += 2)
-            {
-                for (double m = -l; m <= l; m++)
-                {
-                    m_SpherHarm(k, c++) = m_ODFSHBasis->getNthSHValueAtPosition(l, m, tmpDir[0], tmpDir[1]);
-                }
-            }
-            k++;
+            sphericalDirs[i] = tmpDir;
         }
+
+        m_ODFSHBasis->GetBasisMatrix(sphericalDirs, m_SpherHarm);
     }
 
     template <typename ScalarType>
     void
     TODEstimatorImageFilter<ScalarType>::DiscretizeODF(OutputImagePixelType ODFCoefs, std::vector<double> &ODFDiscret)
     {
-        int k = 0;
-        double resVal2 = 0;
-
-        std::vector<double> tmpDir(2), revDir(3);
+        // Sampling directions are fixed, use the precomputed SH matrix
         for (int i = 0; i < m_NbSample; i++)
         {
-            anima::TransformCartesianToSphericalCoordinates(m_SphereSampl[i], tmpDir);
-            resVal2 = m_ODFSHBasis->getValueAtPosition(ODFCoefs, tmpDir[0], tmpDir[1]);
+            double resVal = 0;
+            for (unsigned int j = 0; j < m_SpherHarm.cols(); ++j)
+                resVal += m_SpherHarm(i, j) * ODFCoefs[j];
 
-            ODFDiscret[i] = resVal2;
-            k++;
+            ODFDiscret[i] = resVal;
         }
     }
 
@@ -9,6 +9,7 @@
 #include <vtkSmartPointer.h>
 #include <itkProcessObject.h>
 #include <itkLinearInterpolateImageFunction.h>
+#include <animaWorkStealingScheduler.h>
 #include <mutex>
 #include <itkProgressReporter.h>
 
@@ -110,9 +111,17 @@ public:
         Weight
     };
 
+    /**
+     * Particle histories are stored in a shared append-only point arena, each point holding the arena index of
+     * its predecessor (-1 for the first seed point). A particle is then only the index of its last point and its
+     * length, so that resampling copies indexes instead of whole fibers.
+     */
     struct FiberWorkType
     {
-        FiberProcessVectorType fiberParticles;
+        FiberType arenaPoints;
+        std::vector <int> arenaParentIndexes;
+        MembershipType particleTails;
+        MembershipType particleLengths;
         MembershipType classMemberships;
         std::vector <MembershipType> reverseClassMemberships;
         MembershipType classSizes;
@@ -199,6 +208,12 @@ protected:
     // Otherwise, returns false and a merge per stopped fiber lengths
     bool MergeParticleClassFibers(FiberWorkType &fiberData, FiberProcessVectorType &outputMerged, unsigned int classNumber);
 
+    //! Appends a point to a particle history in the point arena
+    void AppendParticlePoint(FiberWorkType &fiberData, unsigned int particleIndex, const PointType &point);
+
+    //! Rebuilds a particle fiber, from seed to current point, by walking back the arena parent indexes
+    void GetParticleFiber(const FiberWorkType &fiberData, unsigned int particleIndex, FiberType &fiber);
+
     //! Filter output fibers by ROIs and compute local colors
     FiberProcessVectorType FilterOutputFibers(FiberProcessVectorType &fibers, ListType &weights);
 
@@ -280,8 +295,10 @@ private:
 
     vtkSmartPointer<vtkPolyData> m_Output;
 
-    std::mutex m_LockHighestProcessedSeed;
-    int m_HighestProcessedSeed;
+    // Dynamic scheduling of seeds over threads
+    anima::WorkStealingScheduler m_SeedScheduler;
+
+    std::mutex m_LockProgressReport;
     itk::ProgressReporter *m_ProgressReport;
 };
 
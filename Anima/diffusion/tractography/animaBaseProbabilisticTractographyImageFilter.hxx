@@ -56,7 +56,6 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
 
     m_Generators.clear();
 
-    m_HighestProcessedSeed = 0;
     m_ProgressReport = 0;
 
     m_SampleOfDirections.resize(1);
@@ -81,15 +80,7 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
     if (m_ProgressReport)
         delete m_ProgressReport;
 
-    unsigned int stepData = std::min((int)m_PointsToProcess.size(),100);
-    if (stepData == 0)
-        stepData = 1;
-
-    unsigned int numSteps = std::floor(m_PointsToProcess.size() / (double)stepData);
-    if (m_PointsToProcess.size() % stepData != 0)
-        numSteps++;
-
-    m_ProgressReport = new itk::ProgressReporter(this,0,numSteps);
+    m_ProgressReport = new itk::ProgressReporter(this,0,m_PointsToProcess.size());
 
     FiberProcessVectorType resultFibers;
     ListType resultWeights;
@@ -106,6 +97,7 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
     }
 
     this->GetMultiThreader()->SetNumberOfWorkUnits(this->GetNumberOfWorkUnits());
+    m_SeedScheduler.Initialize(m_PointsToProcess.size(),this->GetNumberOfWorkUnits());
     this->GetMultiThreader()->SetSingleMethod(this->ThreadTracker,&tmpStr);
     this->GetMultiThreader()->SingleMethodExecute();
 
@@ -285,38 +277,16 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
 ::ThreadTrack(unsigned int numThread, FiberProcessVectorType &resultFibers,
               ListType &resultWeights)
 {
-    bool continueLoop = true;
-    unsigned int highestToleratedSeedIndex = m_PointsToProcess.size();
+    unsigned int startPoint, endPoint;
 
-    unsigned int stepData = std::min((int)m_PointsToProcess.size(),100);
-    if (stepData == 0)
-        stepData = 1;
-
-    while (continueLoop)
+    while (m_SeedScheduler.GetNextChunk(numThread,startPoint,endPoint))
     {
-        m_LockHighestProcessedSeed.lock();
-
-        if (m_HighestProcessedSeed >= highestToleratedSeedIndex)
-        {
-            m_LockHighestProcessedSeed.unlock();
-            continueLoop = false;
-            continue;
-        }
-
-        unsigned int startPoint = m_HighestProcessedSeed;
-        unsigned int endPoint = m_HighestProcessedSeed + stepData;
-        if (endPoint > highestToleratedSeedIndex)
-            endPoint = highestToleratedSeedIndex;
-
-        m_HighestProcessedSeed = endPoint;
-
-        m_LockHighestProcessedSeed.unlock();
-
         this->ThreadedTrackComputer(numThread,resultFibers,resultWeights,startPoint,endPoint);
 
-        m_LockHighestProcessedSeed.lock();
-        m_ProgressReport->CompletedPixel();
-        m_LockHighestProcessedSeed.unlock();
+        m_LockProgressReport.lock();
+        for (unsigned int i = startPoint;i < endPoint;++i)
+            m_ProgressReport->CompletedPixel();
+        m_LockProgressReport.unlock();
     }
 }
 
@@ -473,9 +443,15 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
     unsigned int numberOfClasses = 1;
 
     FiberWorkType fiberComputationData;
-    fiberComputationData.fiberParticles.resize(m_NumberOfParticles);
-    for (unsigned int i = 0;i < m_NumberOfParticles;++i)
-        fiberComputationData.fiberParticles[i] = fiber;
+    // Seed points are shared by all particles
+    for (unsigned int i = 0;i < fiber.size();++i)
+    {
+        fiberComputationData.arenaPoints.push_back(fiber[i]);
+        fiberComputationData.arenaParentIndexes.push_back((int)i - 1);
+    }
+
+    fiberComputationData.particleTails = MembershipType(m_NumberOfParticles, fiber.size() - 1);
+    fiberComputationData.particleLengths = MembershipType(m_NumberOfParticles, fiber.size());
 
     fiberComputationData.particleWeights = ListType(m_NumberOfParticles, 1.0 / m_NumberOfParticles);
     fiberComputationData.stoppedParticles = std::vector <bool> (m_NumberOfParticles,false);
@@ -500,11 +476,9 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
     DirectionVectorType previousDirections(m_NumberOfParticles);
 
     // Data structures for resampling
-    FiberProcessVectorType fiberParticlesCopy;
+    MembershipType particleTailsCopy, particleLengthsCopy;
     DirectionVectorType previousDirectionsCopy;
     ListType weightSpecificClassValues;
-    FiberProcessVectorType fiberTrash;
-    std::vector <bool> usedFibers;
 
     // Here to constrain directions to 2D plane if needed
     bool is2d = m_InputModelImage->GetLargestPossibleRegion().GetSize()[2] == 1;
@@ -534,7 +508,7 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
             if (fiberComputationData.stoppedParticles[i])
                 continue;
 
-            currentPoint = fiberComputationData.fiberParticles[i].back();
+            currentPoint = fiberComputationData.arenaPoints[fiberComputationData.particleTails[i]];
 
             m_SeedMask->TransformPhysicalPointToContinuousIndex(currentPoint,currentIndex);
 
@@ -639,7 +613,7 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
                 continue;
             }
 
-            fiberComputationData.fiberParticles[i].push_back(currentPoint);
+            this->AppendParticlePoint(fiberComputationData,i,currentPoint);
 
             this->ComputeModelValue(modelInterpolator, newIndex, modelValue);
             estimatedB0Value = m_B0Interpolator->EvaluateAtContinuousIndex(newIndex);
@@ -753,49 +727,31 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
             {
                 weightSpecificClassValues.resize(fiberComputationData.classSizes[m]);
                 previousDirectionsCopy.resize(fiberComputationData.classSizes[m]);
-                fiberParticlesCopy.resize(fiberComputationData.classSizes[m]);
+                particleTailsCopy.resize(fiberComputationData.classSizes[m]);
+                particleLengthsCopy.resize(fiberComputationData.classSizes[m]);
 
                 for (unsigned int i = 0;i < fiberComputationData.classSizes[m];++i)
                 {
                     unsigned int posIndex = fiberComputationData.reverseClassMemberships[m][i];
                     weightSpecificClassValues[i] = fiberComputationData.particleWeights[posIndex];
                     previousDirectionsCopy[i] = previousDirections[posIndex];
-                    fiberParticlesCopy[i] = fiberComputationData.fiberParticles[posIndex];
+                    particleTailsCopy[i] = fiberComputationData.particleTails[posIndex];
+                    particleLengthsCopy[i] = fiberComputationData.particleLengths[posIndex];
                 }
 
                 std::discrete_distribution<> dist(weightSpecificClassValues.begin(),weightSpecificClassValues.end());
-                usedFibers.resize(fiberComputationData.classSizes[m]);
-                std::fill(usedFibers.begin(),usedFibers.end(),false);
 
                 for (unsigned int i = 0;i < fiberComputationData.classSizes[m];++i)
                 {
                     unsigned int z = dist(m_Generators[numThread]);
                     unsigned int iReal = fiberComputationData.reverseClassMemberships[m][i];
                     previousDirections[iReal] = previousDirectionsCopy[z];
-                    fiberComputationData.fiberParticles[iReal] = fiberParticlesCopy[z];
+                    // Resampled particles share their history with their ancestor in the arena
+                    fiberComputationData.particleTails[iReal] = particleTailsCopy[z];
+                    fiberComputationData.particleLengths[iReal] = particleLengthsCopy[z];
                     // In all of this, we suppose that stopped particles have zero weights and will therefore
                     // be lost when resampling
                     fiberComputationData.stoppedParticles[iReal] = false;
-                    usedFibers[z] = true;
-                }
-
-                for (unsigned int i = 0;i < fiberComputationData.classSizes[m];++i)
-                {
-                    unsigned int iReal = fiberComputationData.reverseClassMemberships[m][i];
-
-                    if (!usedFibers[i])
-                    {
-                        if (oldFiberWeights[iReal] > m_FiberTrashThreshold / m_NumberOfParticles)
-                        {
-                            if (fiberComputationData.particleWeights[iReal] != 0)
-                                fiberParticlesCopy[i].pop_back();
-
-                            // The fiber trash used to contain fibers that were lost with a sufficient weight
-                            // However, using way too much memory so removed for now
-                            //if (fiberParticlesCopy[i].size() > m_MinLengthFiber / m_StepProgression)
-                            //    fiberTrash.push_back(fiberParticlesCopy[i]);
-                        }
-                    }
                 }
 
                 // Update only weightVals, oldWeightVals will get updated when starting back the loop
@@ -821,24 +777,56 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
     }
 
     // Now that we're done, if we don't keep individual particles, merge them cluster by cluster
+    FiberProcessVectorType outputFibers;
     if (m_MAPMergeFibers)
     {
-        FiberProcessVectorType mergedOutput,classMergedOutput;
+        FiberProcessVectorType classMergedOutput;
         for (unsigned int i = 0;i < numberOfClasses;++i)
         {
             this->MergeParticleClassFibers(fiberComputationData,classMergedOutput,i);
-            mergedOutput.insert(mergedOutput.end(),classMergedOutput.begin(),classMergedOutput.end());
+            outputFibers.insert(outputFibers.end(),classMergedOutput.begin(),classMergedOutput.end());
         }
 
-        fiberComputationData.fiberParticles = mergedOutput;
-    }
-
-    if (m_MAPMergeFibers)
         resultWeights = fiberComputationData.classWeights;
+    }
     else
+    {
+        outputFibers.resize(m_NumberOfParticles);
+        for (unsigned int i = 0;i < m_NumberOfParticles;++i)
+            this->GetParticleFiber(fiberComputationData,i,outputFibers[i]);
+
         resultWeights = fiberComputationData.particleWeights;
+    }
+
+    return outputFibers;
+}
 
-    return fiberComputationData.fiberParticles;
+template <class TInputModelImageType>
+void
+BaseProbabilisticTractographyImageFilter <TInputModelImageType>
+::AppendParticlePoint(FiberWorkType &fiberData, unsigned int particleIndex, const PointType &point)
+{
+    fiberData.arenaPoints.push_back(point);
+    fiberData.arenaParentIndexes.push_back(fiberData.particleTails[particleIndex]);
+
+    fiberData.particleTails[particleIndex] = fiberData.arenaPoints.size() - 1;
+    fiberData.particleLengths[particleIndex]++;
+}
+
+template <class TInputModelImageType>
+void
+BaseProbabilisticTractographyImageFilter <TInputModelImageType>
+::GetParticleFiber(const FiberWorkType &fiberData, unsigned int particleIndex, FiberType &fiber)
+{
+    unsigned int particleLength = fiberData.particleLengths[particleIndex];
+    fiber.resize(particleLength);
+
+    int arenaIndex = fiberData.particleTails[particleIndex];
+    for (int i = particleLength - 1;i >= 0;--i)
+    {
+        fiber[i] = fiberData.arenaPoints[arenaIndex];
+        arenaIndex = fiberData.arenaParentIndexes[arenaIndex];
+    }
 }
 
 template <class TInputModelImageType>
@@ -1114,7 +1102,7 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
             {
                 unsigned int classIndex = fusedClassesIndexes[i][j];
                 for (unsigned int k = 0;k < fiberData.reverseClassMemberships[classIndex].size();++k)
-                    vectorToCluster.push_back(fiberData.fiberParticles[fiberData.reverseClassMemberships[classIndex][k]].back());
+                    vectorToCluster.push_back(fiberData.arenaPoints[fiberData.particleTails[fiberData.reverseClassMemberships[classIndex][k]]]);
             }
 
             clustering.resize(vectorToCluster.size());
@@ -1249,7 +1237,7 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
             if (tmpWeight <= 0)
                 continue;
 
-            tmpFiber = fiberData.fiberParticles[runningIndexes[j]];
+            this->GetParticleFiber(fiberData,runningIndexes[j],tmpFiber);
             for (unsigned int k = 0;k < tmpFiber.size();++k)
             {
                 if (k < sizeMerged)
@@ -1285,7 +1273,7 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
     std::vector <unsigned int> particleSizes;
     for (unsigned int i = 0;i < stoppedIndexes.size();++i)
     {
-        unsigned int particleSize = fiberData.fiberParticles[stoppedIndexes[i]].size();
+        unsigned int particleSize = fiberData.particleLengths[stoppedIndexes[i]];
         bool sizeFound = false;
         for (unsigned int j = 0;j < particleSizes.size();++j)
         {
@@ -1314,7 +1302,7 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
 
         for (unsigned int j = 0;j < particleGroups[i].size();++j)
         {
-            tmpFiber = fiberData.fiberParticles[particleGroups[i][j]];
+            this->GetParticleFiber(fiberData,particleGroups[i][j],tmpFiber);
             for (unsigned int k = 0;k < tmpFiber.size();++k)
             {
                 if (k < sizeMerged)
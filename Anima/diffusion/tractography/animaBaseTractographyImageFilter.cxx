@@ -22,7 +22,6 @@ BaseTractographyImageFilter::BaseTractographyImageFilter()
     m_MaxFiberAngle = M_PI / 2.0;
 
     m_ComputeLocalColors = true;
-    m_HighestProcessedSeed = 0;
     m_NumberOfProcessedPoints = 0;
 }
 
@@ -41,6 +40,7 @@ void BaseTractographyImageFilter::Update()
         tmpStr.resultFibersFromThreads.push_back(resultFibers);
 
     this->GetMultiThreader()->SetNumberOfWorkUnits(this->GetNumberOfWorkUnits());
+    m_SeedScheduler.Initialize(m_PointsToProcess.size(),this->GetNumberOfWorkUnits());
     this->GetMultiThreader()->SetSingleMethod(this->ThreadTracker,&tmpStr);
     this->GetMultiThreader()->SingleMethodExecute();
     
@@ -160,35 +160,15 @@ ITK_THREAD_RETURN_FUNCTION_CALL_CONVENTION BaseTractographyImageFilter::ThreadTr
 
 void BaseTractographyImageFilter::ThreadTrack(unsigned int numThread, std::vector <FiberType> &resultFibers)
 {
-    bool continueLoop = true;
     unsigned int highestToleratedSeedIndex = m_PointsToProcess.size();
+    unsigned int startPoint, endPoint;
 
-    unsigned int stepData = std::min(10, (int)highestToleratedSeedIndex);
-
-    while (continueLoop)
+    while (m_SeedScheduler.GetNextChunk(numThread,startPoint,endPoint))
     {
-        m_LockHighestProcessedSeed.lock();
-
-        if (m_HighestProcessedSeed >= (int)highestToleratedSeedIndex)
-        {
-            m_LockHighestProcessedSeed.unlock();
-            continueLoop = false;
-            continue;
-        }
-
-        unsigned int startPoint = m_HighestProcessedSeed;
-        unsigned int endPoint = m_HighestProcessedSeed + stepData;
-        if (endPoint > highestToleratedSeedIndex)
-            endPoint = highestToleratedSeedIndex;
-
-        m_HighestProcessedSeed = endPoint;
-
-        m_LockHighestProcessedSeed.unlock();
-
         this->ThreadedTrackComputer(numThread,resultFibers,startPoint,endPoint);
 
         m_LockProcessedPoints.lock();
-        m_NumberOfProcessedPoints += stepData;
+        m_NumberOfProcessedPoints += endPoint - startPoint;
 
         double ratio = std::floor(m_NumberOfProcessedPoints * 100.0 / highestToleratedSeedIndex) / 100.0;
         ratio = this->progressFixedToFloat(this->progressFloatToFixed(ratio));
@@ -7,6 +7,7 @@
 #include <vtkSmartPointer.h>
 #include <itkLinearInterpolateImageFunction.h>
 #include <itkProcessObject.h>
+#include <animaWorkStealingScheduler.h>
 #include <mutex>
 
 #include "AnimaTractographyExport.h"
@@ -121,9 +122,11 @@ private:
     bool m_ComputeLocalColors;
     vtkSmartPointer<vtkPolyData> m_Output;
 
-    std::mutex m_LockHighestProcessedSeed, m_LockProcessedPoints;
+    // Dynamic scheduling of seeds over threads
+    anima::WorkStealingScheduler m_SeedScheduler;
+
+    std::mutex m_LockProcessedPoints;
     unsigned int m_NumberOfProcessedPoints;
-    int m_HighestProcessedSeed;
 };
 
 } // end of namespace anima
@@ -2,9 +2,6 @@
 #include <cmath>
 #include <random>
 
-#include <animaODFMaximaCostFunction.h>
-#include <animaNLOPTOptimizers.h>
-
 #include <animaVectorOperations.h>
 #include <animaMatrixOperations.h>
 #include <animaWatsonDistribution.h>
@@ -23,6 +20,9 @@ ODFProbabilisticTractographyImageFilter::ODFProbabilisticTractographyImageFilter
 
     m_ODFSHBasis = NULL;
 
+    m_NumberOfSphereGridSubdivisions = 3;
+    m_UseVoxelODFPeaks = false;
+
     this->SetModelDimension(15);
 }
 
@@ -45,6 +45,14 @@ void ODFProbabilisticTractographyImageFilter::PrepareTractography()
         delete m_ODFSHBasis;
 
     m_ODFSHBasis = new anima::ODFSphericalHarmonicBasis(m_ODFSHOrder);
+
+    // Sphere grid shared by all threads for maxima extraction
+    m_ODFMaximaFinder.SetODFSHOrder(m_ODFSHOrder);
+    m_ODFMaximaFinder.SetNumberOfSubdivisions(m_NumberOfSphereGridSubdivisions);
+    m_ODFMaximaFinder.Initialize();
+
+    m_PeakCaches.clear();
+    m_PeakCaches.resize(this->GetNumberOfWorkUnits());
 }
 
 ODFProbabilisticTractographyImageFilter::Vector3DType
@@ -56,15 +64,14 @@ ODFProbabilisticTractographyImageFilter::ProposeNewDirection(Vector3DType &oldDi
     Vector3DType resVec(0.0);
     bool is2d = (this->GetInputModelImage()->GetLargestPossibleRegion().GetSize()[2] == 1);
 
-    DirectionVectorType maximaODF;
-    unsigned int numDirs = this->FindODFMaxima(modelValue,maximaODF,m_MinimalDiffusionProbability,is2d);
-    ListType mixtureWeights(numDirs,0);
-    ListType kappaValues(numDirs,0);
+    const ODFPeaksType &odfPeaks = this->GetODFPeaks(modelValue,true,threadId);
+    DirectionVectorType maximaODF = odfPeaks.directions;
+    unsigned int numDirs = maximaODF.size();
+    ListType mixtureWeights = odfPeaks.values;
+    ListType kappaValues = odfPeaks.kappaValues;
 
     double chosenKappa = 0;
 
-    Vector3DType sphDirection;
-
     double sumWeights = 0;
 
     for (unsigned int i = 0;i < numDirs;++i)
@@ -72,12 +79,6 @@ ODFProbabilisticTractographyImageFilter::ProposeNewDirection(Vector3DType &oldDi
         if (anima::ComputeScalarProduct(oldDirection, maximaODF[i]) < 0)
             maximaODF[i] *= -1;
 
-        anima::TransformCartesianToSphericalCoordinates(maximaODF[i],sphDirection);
-        mixtureWeights[i] = m_ODFSHBasis->getValueAtPosition(modelValue,sphDirection[0],sphDirection[1]);
-
-        // 0.5 is for Watson kappa
-        kappaValues[i] = 0.5 * m_CurvatureScale * m_ODFSHBasis->getCurvatureAtPosition(modelValue,sphDirection[0],sphDirection[1]);
-
         if ((std::isnan(kappaValues[i]))||(kappaValues[i] <= 0)||(kappaValues[i] >= 1000))
             mixtureWeights[i] = 0;
 
@@ -142,8 +143,8 @@ ODFProbabilisticTractographyImageFilter::Vector3DType ODFProbabilisticTractograp
     Vector3DType resVec(0.0), tmpVec;
     bool is2d = (this->GetInputModelImage()->GetLargestPossibleRegion().GetSize()[2] == 1);
 
-    DirectionVectorType maximaODF;
-    unsigned int numDirs = this->FindODFMaxima(modelValue,maximaODF,m_MinimalDiffusionProbability,is2d);
+    const DirectionVectorType &maximaODF = this->GetODFPeaks(modelValue,false,threadId).directions;
+    unsigned int numDirs = maximaODF.size();
 
     if (numDirs == 0)
         return colinearDir;
@@ -225,10 +226,8 @@ double ODFProbabilisticTractographyImageFilter::ComputeLogWeightUpdate(double b0
 {
     double logLikelihood = 0.0;
 
-    bool is2d = (this->GetInputModelImage()->GetLargestPossibleRegion().GetSize()[2] == 1);
-
-    DirectionVectorType maximaODF;
-    unsigned int numDirs = this->FindODFMaxima(modelValue,maximaODF,m_MinimalDiffusionProbability,is2d);
+    const DirectionVectorType &maximaODF = this->GetODFPeaks(modelValue,false,threadId).directions;
+    unsigned int numDirs = maximaODF.size();
 
     double concentrationParameter = b0Value / std::sqrt(noiseValue);
 
@@ -253,115 +252,15 @@ unsigned int ODFProbabilisticTractographyImageFilter::FindODFMaxima(const Vector
     for (unsigned int i = 0;i < modelValue.GetSize();++i)
         modelValueList[i] = modelValue[i];
 
-    std::vector < std::vector <double> > initDirs(15);
-
-    // Find the max of the ODF v, set max to the value...
-    struct XYZ array[] = {
-    {-0.049,0.919,0.391},
-    {-0.726,-0.301,0.618},
-    {0.683,-0.255,0.684},
-    {-0.845,0.502,0.186},
-    {0.730,0.619,0.288},
-    {-0.051,0.039,0.998},
-    {0.018,-0.871,0.491},
-    {-0.444,0.494,0.747},
-    {0.989,0.086,0.116},
-    {-0.470,-0.855,0.221},
-    {0.412,0.400,0.819},
-    {0.552,-0.790,0.267},
-    {-0.123,-0.477,0.871},
-    {-0.848,0.141,0.510},
-    {0.341,0.788,0.512}
-    };
-
-    for (unsigned int i = 0;i < initDirs.size();++i)
-    {
-        initDirs[i].resize(3);
-        initDirs[i][0] = array[i].x;
-        initDirs[i][1] = array[i].y;
-        initDirs[i][2] = array[i].z;
-    }
-
-    typedef anima::ODFMaximaCostFunction CostFunctionType;
-    typedef anima::NLOPTOptimizers OptimizerType;
-
-    OptimizerType::Pointer opt = OptimizerType::New();
-    opt->SetAlgorithm(NLOPT_LN_BOBYQA);
-    opt->SetXTolRel(1.0e-3);
-    opt->SetFTolRel(1.0e-4);
-    opt->SetMaxEval(200);
-    opt->SetVectorStorageSize(2000);
-
-    typedef std::map < double, Vector3DType > MapType;
-    MapType dmap;
-
-    std::vector <double> angle;
-    OptimizerType::ParametersType tmpValue(2);
-    Vector3DType tmpValueVector(1.0);
-    Vector3DType cartesianVector(1.0);
-
-    itk::Array<double> lowerBounds(2);
-    itk::Array<double> upperBounds(2);
+    std::vector <anima::ODFSphereGridMaximaFinder::DirectionType> gridMaxima;
+    ListType gridMaximaValues;
+    unsigned int numMaxima = m_ODFMaximaFinder.FindMaxima(modelValueList,gridMaxima,gridMaximaValues,minVal);
 
-    lowerBounds.fill(0.0);
-    upperBounds[0] = M_PI / 2.0;
-    upperBounds[1] = 2.0 * M_PI;
-
-    opt->SetLowerBoundParameters(lowerBounds);
-    opt->SetUpperBoundParameters(upperBounds);
-
-    CostFunctionType::Pointer cost = CostFunctionType::New();
-    cost->SetODFSHOrder(m_ODFSHOrder);
-    cost->SetBasisParameters(modelValueList);
-
-    opt->SetCostFunction(cost);
-    opt->SetMaximize(true);
-
-    for (unsigned int i = 0; i < initDirs.size();++i)
+    maxima.resize(numMaxima);
+    for (unsigned int i = 0;i < numMaxima;++i)
     {
-        anima::TransformCartesianToSphericalCoordinates(initDirs[i],angle);
-        tmpValue[0] = angle[0];
-        tmpValue[1] = angle[1];
-
-        opt->SetInitialPosition(tmpValue);
-        opt->StartOptimization();
-
-        tmpValue = opt->GetCurrentPosition();
-        tmpValueVector[0] = tmpValue[0];
-        tmpValueVector[1] = tmpValue[1];
-
-        // Some check needed here to see if we really found a maximum
-        anima::TransformSphericalToCartesianCoordinates(tmpValueVector,cartesianVector);
-        dmap[opt->GetValue()] = cartesianVector;
-    }
-
-    // Find true maximas
-    std::vector <bool> usefulMaxima(15,true);
-    unsigned int pos = 0;
-    for (MapType::reverse_iterator it = dmap.rbegin();it != dmap.rend();++it)
-    {
-        unsigned int posIn = pos+1;
-        MapType::reverse_iterator itin = it;
-        ++itin;
-        for (;itin != dmap.rend();++itin)
-        {
-            if (anima::ComputeOrientationAngle((*it).second,(*itin).second) < 15)
-                usefulMaxima[posIn] = false;
-
-            ++posIn;
-        }
-
-        ++pos;
-    }
-
-    pos = 0;
-    maxima.clear();
-    for (MapType::reverse_iterator it = dmap.rbegin();it != dmap.rend();++it)
-    {
-        if ((usefulMaxima[pos])&&((*it).first > minVal))
-            maxima.push_back((*it).second);
-
-        ++pos;
+        for (unsigned int j = 0;j < 3;++j)
+            maxima[i][j] = gridMaxima[i][j];
     }
 
     if (is2d)
@@ -399,13 +298,71 @@ unsigned int ODFProbabilisticTractographyImageFilter::FindODFMaxima(const Vector
     return maxima.size();
 }
 
+const ODFProbabilisticTractographyImageFilter::ODFPeaksType &
+ODFProbabilisticTractographyImageFilter::GetODFPeaks(const VectorType &modelValue, bool computeKappa, unsigned int threadId)
+{
+    // Particles of a filter share their starting point, and the voxel ODFs when UseVoxelODFPeaks is on
+    const unsigned int maximalCacheSize = 4096;
+    PeakCacheType &peakCache = m_PeakCaches[threadId];
+
+    ListType modelValueList(modelValue.GetSize());
+    for (unsigned int i = 0;i < modelValue.GetSize();++i)
+        modelValueList[i] = modelValue[i];
+
+    PeakCacheType::iterator cacheItr = peakCache.find(modelValueList);
+    if (cacheItr == peakCache.end())
+    {
+        if (peakCache.size() >= maximalCacheSize)
+            peakCache.clear();
+
+        bool is2d = (this->GetInputModelImage()->GetLargestPossibleRegion().GetSize()[2] == 1);
+
+        ODFPeaksType newPeaks;
+        newPeaks.kappaComputed = false;
+        this->FindODFMaxima(modelValue,newPeaks.directions,m_MinimalDiffusionProbability,is2d);
+
+        cacheItr = peakCache.insert(std::make_pair(modelValueList,newPeaks)).first;
+    }
+
+    ODFPeaksType &odfPeaks = cacheItr->second;
+    if (computeKappa && !odfPeaks.kappaComputed)
+    {
+        unsigned int numDirs = odfPeaks.directions.size();
+        odfPeaks.values.resize(numDirs);
+        odfPeaks.kappaValues.resize(numDirs);
+
+        Vector3DType sphDirection;
+        for (unsigned int i = 0;i < numDirs;++i)
+        {
+            anima::TransformCartesianToSphericalCoordinates(odfPeaks.directions[i],sphDirection);
+            odfPeaks.values[i] = m_ODFSHBasis->getValueAtPosition(modelValue,sphDirection[0],sphDirection[1]);
+
+            // 0.5 is for Watson kappa
+            odfPeaks.kappaValues[i] = 0.5 * m_CurvatureScale * m_ODFSHBasis->getCurvatureAtPosition(modelValue,sphDirection[0],sphDirection[1]);
+        }
+
+        odfPeaks.kappaComputed = true;
+    }
+
+    return odfPeaks;
+}
+
 void ODFProbabilisticTractographyImageFilter::ComputeModelValue(InterpolatorPointer &modelInterpolator, ContinuousIndexType &index,
                                                                 VectorType &modelValue)
 {
     modelValue.SetSize(this->GetModelDimension());
     modelValue.Fill(0.0);
 
-    if (modelInterpolator->IsInsideBuffer(index))
+    if (!modelInterpolator->IsInsideBuffer(index))
+        return;
+
+    if (m_UseVoxelODFPeaks)
+    {
+        IndexType closestIndex;
+        closestIndex.CopyWithRound(index);
+        modelValue = modelInterpolator->GetInputImage()->GetPixel(closestIndex);
+    }
+    else
         modelValue = modelInterpolator->EvaluateAtContinuousIndex(index);
 }
 
@@ -3,6 +3,9 @@
 #include <itkVectorImage.h>
 #include <animaBaseProbabilisticTractographyImageFilter.h>
 #include <animaODFSphericalHarmonicBasis.h>
+#include <animaODFSphereGridMaximaFinder.h>
+
+#include <map>
 
 #include "AnimaTractographyExport.h"
 
@@ -23,16 +26,17 @@ public:
 
     itkTypeMacro(ODFProbabilisticTractographyImageFilter,BaseProbabilisticTractographyImageFilter)
 
-    struct XYZ
-    {
-        double x, y, z;
-    };
-
     void SetODFSHOrder(unsigned int num);
     itkSetMacro(GFAThreshold,double)
     itkSetMacro(CurvatureScale,double)
     itkSetMacro(MinimalDiffusionProbability,double)
 
+    //! Number of icosahedron subdivisions of the sphere grid used to find ODF maxima
+    itkSetMacro(NumberOfSphereGridSubdivisions,unsigned int)
+
+    //! If true, ODFs are taken at the nearest voxel so that their maxima are computed once per voxel and shared by particles
+    itkSetMacro(UseVoxelODFPeaks,bool)
+
 protected:
     ODFProbabilisticTractographyImageFilter();
     virtual ~ODFProbabilisticTractographyImageFilter();
@@ -57,9 +61,23 @@ protected:
     unsigned int FindODFMaxima(const VectorType &modelValue, DirectionVectorType &maxima, double minVal, bool is2d);
     double GetGeneralizedFractionalAnisotropy(VectorType &modelValue);
 
+    //! ODF maxima with their values and Watson concentrations
+    struct ODFPeaksType
+    {
+        DirectionVectorType directions;
+        ListType values;
+        ListType kappaValues;
+        bool kappaComputed;
+    };
+
+    //! Returns ODF peaks for a model value, looked up first in the peak cache of the calling thread
+    const ODFPeaksType &GetODFPeaks(const VectorType &modelValue, bool computeKappa, unsigned int threadId);
+
 private:
     ITK_DISALLOW_COPY_AND_ASSIGN(ODFProbabilisticTractographyImageFilter);
 
+    typedef std::map <ListType, ODFPeaksType> PeakCacheType;
+
     double m_GFAThreshold;
 
     //! User defined threshold for an ODF maximum to be considered a useful direction
@@ -70,6 +88,14 @@ private:
 
     unsigned int m_ODFSHOrder;
     anima::ODFSphericalHarmonicBasis *m_ODFSHBasis;
+
+    unsigned int m_NumberOfSphereGridSubdivisions;
+    anima::ODFSphereGridMaximaFinder m_ODFMaximaFinder;
+
+    bool m_UseVoxelODFPeaks;
+
+    //! Per thread caches of ODF peaks, indexed by model coefficients
+    std::vector <PeakCacheType> m_PeakCaches;
 };
 
 } // end of namespace anima
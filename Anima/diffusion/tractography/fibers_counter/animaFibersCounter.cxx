@@ -2,6 +2,7 @@
 
 #include <animaReadWriteFunctions.h>
 #include <animaShapesReader.h>
+#include <animaTRKFiberStreamReader.h>
 
 #include <vtkSmartPointer.h>
 #include <vtkPoints.h>
@@ -10,6 +11,29 @@
 #include <vtkCell.h>
 
 #include <itkCastImageFilter.h>
+#include <itkImageRegionIterator.h>
+
+typedef itk::Image <double, 3> OutputImageType;
+
+void CountPoint(OutputImageType *outputImage, const OutputImageType::RegionType &region,
+                const double *ptVals, double incrementFactor)
+{
+    OutputImageType::IndexType currentIndex;
+    OutputImageType::PointType currentPoint;
+
+    for (unsigned int k = 0;k < 3;++k)
+        currentPoint[k] = ptVals[k];
+
+    outputImage->TransformPhysicalPointToIndex(currentPoint,currentIndex);
+    for (unsigned int k = 0;k < 3;++k)
+    {
+        if ((currentIndex[k] < 0)||(currentIndex[k] >= region.GetSize(k)))
+            return;
+    }
+
+    double countIndex = outputImage->GetPixel(currentIndex) + incrementFactor;
+    outputImage->SetPixel(currentIndex, countIndex);
+}
 
 int main(int argc, char **argv)
 {
@@ -31,57 +55,70 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
 
-    typedef itk::Image <double, 3> OutputImageType;
     OutputImageType::Pointer outputImage = anima::readImage <OutputImageType> (geomArg.getValue());
     outputImage->FillBuffer(0.0);
 
-    anima::ShapesReader trackReader;
-    trackReader.SetFileName(inArg.getValue());
-    trackReader.Update();
-
-    vtkSmartPointer <vtkPolyData> tracks = trackReader.GetOutput();
-
-    vtkIdType nbCells = tracks->GetNumberOfCells();
-    double incrementFactor = 1.0;
-    if (proportionArg.isSet())
-        incrementFactor /= nbCells;
-
-    double ptVals[3];
-    OutputImageType::IndexType currentIndex;
-    OutputImageType::PointType currentPoint;
     OutputImageType::RegionType region = outputImage->GetLargestPossibleRegion();
+    std::string inputName = inArg.getValue();
+    std::string extensionName = inputName.substr(inputName.find_last_of('.') + 1);
 
-    // Explores individual fibers
-    for (int j = 0;j < nbCells;++j)
+    if (extensionName == "trk")
     {
-        vtkCell *cell = tracks->GetCell(j);
-        vtkPoints *cellPts = cell->GetPoints();
-        vtkIdType nbPts = cellPts->GetNumberOfPoints();
-
-        // Explores points in fibers
-        for (int i = 0;i < nbPts;++i)
+        // Stream TRK files chunk by chunk, tractograms never have to fit in memory
+        anima::TRKFiberStreamReader trackReader;
+        trackReader.SetFileName(inputName);
+        trackReader.Open();
+
+        anima::TRKFiberChunk chunk;
+        unsigned int nbCells = 0;
+        while (trackReader.ReadNextChunk(chunk))
         {
-            cellPts->GetPoint(i,ptVals);
+            for (unsigned int i = 0;i < chunk.GetNumberOfPoints();++i)
+                CountPoint(outputImage, region, chunk.Points.data() + 3 * i, 1.0);
+
+            nbCells += chunk.GetNumberOfFibers();
+        }
 
-            for (unsigned int k = 0;k < 3;++k)
-                currentPoint[k] = ptVals[k];
+        trackReader.Close();
 
-            outputImage->TransformPhysicalPointToIndex(currentPoint,currentIndex);
-            bool insideBuffer = true;
-            for (unsigned int k = 0;k < 3;++k)
+        if (proportionArg.isSet() && (nbCells > 0))
+        {
+            itk::ImageRegionIterator <OutputImageType> outItr(outputImage, region);
+            while (!outItr.IsAtEnd())
             {
-                if ((currentIndex[k] < 0)||(currentIndex[k] >= region.GetSize(k)))
-                {
-                    insideBuffer = false;
-                    break;
-                }
+                outItr.Set(outItr.Get() / nbCells);
+                ++outItr;
             }
+        }
+    }
+    else
+    {
+        anima::ShapesReader trackReader;
+        trackReader.SetFileName(inputName);
+        trackReader.Update();
+
+        vtkSmartPointer <vtkPolyData> tracks = trackReader.GetOutput();
 
-            if (!insideBuffer)
-                continue;
+        vtkIdType nbCells = tracks->GetNumberOfCells();
+        double incrementFactor = 1.0;
+        if (proportionArg.isSet())
+            incrementFactor /= nbCells;
 
-            double countIndex = outputImage->GetPixel(currentIndex) + incrementFactor;
-            outputImage->SetPixel(currentIndex, countIndex);
+        double ptVals[3];
+
+        // Explores individual fibers
+        for (int j = 0;j < nbCells;++j)
+        {
+            vtkCell *cell = tracks->GetCell(j);
+            vtkPoints *cellPts = cell->GetPoints();
+            vtkIdType nbPts = cellPts->GetNumberOfPoints();
+
+            // Explores points in fibers
+            for (int i = 0;i < nbPts;++i)
+            {
+                cellPts->GetPoint(i,ptVals);
+                CountPoint(outputImage, region, ptVals, incrementFactor);
+            }
         }
     }
 
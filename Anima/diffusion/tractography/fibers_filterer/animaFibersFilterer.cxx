@@ -4,177 +4,152 @@
 #include <animaShapesWriter.h>
 
 #include <animaShapesReader.h>
+#include <animaTRKFiberStreamReader.h>
 #include <vtkSmartPointer.h>
 #include <vtkPoints.h>
 #include <vtkPointData.h>
 #include <vtkPolyData.h>
 #include <vtkCleanPolyData.h>
 #include <vtkGenericCell.h>
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkDoubleArray.h>
 
 #include <itkNearestNeighborInterpolateImageFunction.h>
 #include <itkPoolMultiThreader.h>
 
-void FilterTracks(vtkPolyData *tracks, unsigned int startIndex, unsigned int endIndex,
-                  itk::NearestNeighborInterpolateImageFunction < itk::Image <unsigned short, 3> > * interpolator,
-                  const std::vector <unsigned int> &touchLabels, const std::vector <unsigned int> &endingsLabels,
-                  const std::vector <unsigned int> &forbiddenLabels)
-{
-    std::vector <unsigned int> seenLabels;
-    std::vector <unsigned int> seenEndingsLabels;
-    double pointPositionVTK[3];
-    itk::ContinuousIndex<double, 3> currentIndex;
-    typedef itk::Image <unsigned short, 3>::PointType PointType;
-    PointType pointPosition;
+typedef itk::Image <unsigned short, 3> ROIImageType;
+typedef itk::NearestNeighborInterpolateImageFunction <ROIImageType> InterpolatorType;
 
-    vtkSmartPointer <vtkGenericCell> cell = vtkGenericCell::New();
-    for (unsigned int i = startIndex;i < endIndex;++i)
+void AddSeenLabel(unsigned int value, const std::vector <unsigned int> &labels, std::vector <unsigned int> &seenLabels)
+{
+    for (unsigned int k = 0;k < labels.size();++k)
     {
-        // Inspect i-th cell
-        tracks->GetCell(i,cell);
-        vtkPoints *cellPts = cell->GetPoints();
-        vtkIdType numCellPts = cellPts->GetNumberOfPoints();
-        seenLabels.clear();
-        bool lineOk = true;
-
-        // First test endings, if not right, useless to continue
-        seenEndingsLabels.clear();
-        unsigned int upIndexStart = std::max(5, static_cast <int> (std::floor(numCellPts / 20.0)));
-        unsigned int lowIndexEnd = numCellPts - upIndexStart;
-
-        // Test fiber start
-        for (unsigned int j = 0;j < upIndexStart;++j)
+        if (value == labels[k])
         {
-            cellPts->GetPoint(j, pointPositionVTK);
-            for (unsigned int k = 0; k < 3; ++k)
-                pointPosition[k] = pointPositionVTK[k];
-            interpolator->GetInputImage()->TransformPhysicalPointToContinuousIndex(pointPosition,currentIndex);
-            if (interpolator->IsInsideBuffer(currentIndex))
+            bool alreadyIn = false;
+            for (unsigned int l = 0;l < seenLabels.size();++l)
             {
-                unsigned int value = static_cast <unsigned int> (std::round(interpolator->EvaluateAtContinuousIndex(currentIndex)));
-                for (unsigned int k = 0;k < endingsLabels.size();++k)
+                if (seenLabels[l] == value)
                 {
-                    if (value == endingsLabels[k])
-                    {
-                        bool alreadyIn = false;
-                        for (unsigned int l = 0;l < seenEndingsLabels.size();++l)
-                        {
-                            if (seenEndingsLabels[l] == value)
-                            {
-                                alreadyIn = true;
-                                break;
-                            }
-                        }
-
-                        if (!alreadyIn)
-                            seenEndingsLabels.push_back(value);
-
-                        break;
-                    }
+                    alreadyIn = true;
+                    break;
                 }
             }
-        }
 
-        // Test fiber end
-        for (unsigned int j = lowIndexEnd;j < numCellPts;++j)
-        {
-            cellPts->GetPoint(j, pointPositionVTK);
-            for (unsigned int k = 0; k < 3; ++k)
-                pointPosition[k] = pointPositionVTK[k];
-            interpolator->GetInputImage()->TransformPhysicalPointToContinuousIndex(pointPosition,currentIndex);
-            if (interpolator->IsInsideBuffer(currentIndex))
-            {
-                unsigned int value = static_cast <unsigned int> (std::round(interpolator->EvaluateAtContinuousIndex(currentIndex)));
-                for (unsigned int k = 0;k < endingsLabels.size();++k)
-                {
-                    if (value == endingsLabels[k])
-                    {
-                        bool alreadyIn = false;
-                        for (unsigned int l = 0;l < seenEndingsLabels.size();++l)
-                        {
-                            if (seenEndingsLabels[l] == value)
-                            {
-                                alreadyIn = true;
-                                break;
-                            }
-                        }
-
-                        if (!alreadyIn)
-                            seenEndingsLabels.push_back(value);
-
-                        break;
-                    }
-                }
-            }
+            if (!alreadyIn)
+                seenLabels.push_back(value);
+
+            break;
         }
+    }
+}
+
+//! Tests a fiber given as contiguous (x,y,z) points against the labels constraints
+bool IsFiberKept(const double *fiberPoints, unsigned int numCellPts, InterpolatorType *interpolator,
+                 const std::vector <unsigned int> &touchLabels, const std::vector <unsigned int> &endingsLabels,
+                 const std::vector <unsigned int> &forbiddenLabels, std::vector <unsigned int> &seenLabels,
+                 std::vector <unsigned int> &seenEndingsLabels)
+{
+    itk::ContinuousIndex<double, 3> currentIndex;
+    ROIImageType::PointType pointPosition;
 
-        if (seenEndingsLabels.size() != endingsLabels.size())
-            lineOk = false;
+    // First test endings, if not right, useless to continue
+    seenEndingsLabels.clear();
+    unsigned int upIndexStart = std::max(5, static_cast <int> (std::floor(numCellPts / 20.0)));
+    upIndexStart = std::min(upIndexStart, numCellPts);
+    unsigned int lowIndexEnd = numCellPts - upIndexStart;
 
-        // Then test forbidden and touched labels
-        if (lineOk)
+    for (unsigned int j = 0;j < numCellPts;++j)
+    {
+        // Test fiber start and end
+        if ((j >= upIndexStart) && (j < lowIndexEnd))
+            continue;
+
+        for (unsigned int k = 0; k < 3; ++k)
+            pointPosition[k] = fiberPoints[3 * j + k];
+        interpolator->GetInputImage()->TransformPhysicalPointToContinuousIndex(pointPosition,currentIndex);
+        if (interpolator->IsInsideBuffer(currentIndex))
         {
-            for (unsigned int j = 0;j < numCellPts;++j)
-            {
-                cellPts->GetPoint(j, pointPositionVTK);
-                for (unsigned int k = 0; k < 3; ++k)
-                    pointPosition[k] = pointPositionVTK[k];
+            unsigned int value = static_cast <unsigned int> (std::round(interpolator->EvaluateAtContinuousIndex(currentIndex)));
+            AddSeenLabel(value, endingsLabels, seenEndingsLabels);
+        }
+    }
 
-                interpolator->GetInputImage()->TransformPhysicalPointToContinuousIndex(pointPosition,currentIndex);
+    if (seenEndingsLabels.size() != endingsLabels.size())
+        return false;
 
-                if (!interpolator->IsInsideBuffer(currentIndex))
-                    continue;
+    // Then test forbidden and touched labels
+    seenLabels.clear();
+    for (unsigned int j = 0;j < numCellPts;++j)
+    {
+        for (unsigned int k = 0; k < 3; ++k)
+            pointPosition[k] = fiberPoints[3 * j + k];
 
-                unsigned int value = static_cast <unsigned int> (std::round(interpolator->EvaluateAtContinuousIndex(currentIndex)));
+        interpolator->GetInputImage()->TransformPhysicalPointToContinuousIndex(pointPosition,currentIndex);
 
-                for (unsigned int k = 0;k < forbiddenLabels.size();++k)
-                {
-                    if (value == forbiddenLabels[k])
-                    {
-                        lineOk = false;
-                        break;
-                    }
-                }
+        if (!interpolator->IsInsideBuffer(currentIndex))
+            continue;
 
-                if (!lineOk)
-                    break;
+        unsigned int value = static_cast <unsigned int> (std::round(interpolator->EvaluateAtContinuousIndex(currentIndex)));
 
-                for (unsigned int k = 0;k < touchLabels.size();++k)
-                {
-                    if (value == touchLabels[k])
-                    {
-                        bool alreadyIn = false;
-                        for (unsigned int l = 0;l < seenLabels.size();++l)
-                        {
-                            if (seenLabels[l] == value)
-                            {
-                                alreadyIn = true;
-                                break;
-                            }
-                        }
-
-                        if (!alreadyIn)
-                            seenLabels.push_back(value);
-
-                        break;
-                    }
-                }
-            }
+        for (unsigned int k = 0;k < forbiddenLabels.size();++k)
+        {
+            if (value == forbiddenLabels[k])
+                return false;
         }
 
-        if (!lineOk || (seenLabels.size() != touchLabels.size()))
-            tracks->DeleteCell(i);
+        AddSeenLabel(value, touchLabels, seenLabels);
     }
+
+    return (seenLabels.size() == touchLabels.size());
 }
 
 typedef struct
 {
     vtkPolyData *tracks;
-    itk::NearestNeighborInterpolateImageFunction < itk::Image <unsigned short, 3> > *interpolator;
+    const anima::TRKFiberChunk *chunk;
+    std::vector <unsigned char> *keptFibers;
+    InterpolatorType *interpolator;
     std::vector <unsigned int> touchLabels;
     std::vector <unsigned int> endingsLabels;
     std::vector <unsigned int> forbiddenLabels;
 } ThreaderArguments;
 
+void FilterTracks(ThreaderArguments *args, unsigned int startIndex, unsigned int endIndex)
+{
+    std::vector <unsigned int> seenLabels;
+    std::vector <unsigned int> seenEndingsLabels;
+    std::vector <double> fiberPoints;
+
+    vtkSmartPointer <vtkGenericCell> cell = vtkGenericCell::New();
+    for (unsigned int i = startIndex;i < endIndex;++i)
+    {
+        if (args->chunk)
+        {
+            unsigned int fiberStart = args->chunk->FiberOffsets[i];
+            unsigned int numCellPts = args->chunk->FiberOffsets[i + 1] - fiberStart;
+            (*args->keptFibers)[i] = IsFiberKept(args->chunk->Points.data() + 3 * fiberStart, numCellPts, args->interpolator,
+                                                 args->touchLabels, args->endingsLabels, args->forbiddenLabels,
+                                                 seenLabels, seenEndingsLabels);
+            continue;
+        }
+
+        // Inspect i-th cell
+        args->tracks->GetCell(i,cell);
+        vtkPoints *cellPts = cell->GetPoints();
+        vtkIdType numCellPts = cellPts->GetNumberOfPoints();
+
+        fiberPoints.resize(3 * numCellPts);
+        for (vtkIdType j = 0;j < numCellPts;++j)
+            cellPts->GetPoint(j, fiberPoints.data() + 3 * j);
+
+        if (!IsFiberKept(fiberPoints.data(), numCellPts, args->interpolator, args->touchLabels, args->endingsLabels,
+                         args->forbiddenLabels, seenLabels, seenEndingsLabels))
+            args->tracks->DeleteCell(i);
+    }
+}
+
 ITK_THREAD_RETURN_FUNCTION_CALL_CONVENTION ThreadFilterer(void *arg)
 {
     itk::MultiThreaderBase::WorkUnitInfo *threadArgs = (itk::MultiThreaderBase::WorkUnitInfo *)arg;
@@ -182,7 +157,11 @@ ITK_THREAD_RETURN_FUNCTION_CALL_CONVENTION ThreadFilterer(void *arg)
     unsigned int numTotalThread = threadArgs->NumberOfWorkUnits;
 
     ThreaderArguments *tmpArg = (ThreaderArguments *)threadArgs->UserData;
-    unsigned int nbTotalCells = tmpArg->tracks->GetNumberOfCells();
+    unsigned int nbTotalCells = 0;
+    if (tmpArg->chunk)
+        nbTotalCells = tmpArg->chunk->GetNumberOfFibers();
+    else
+        nbTotalCells = tmpArg->tracks->GetNumberOfCells();
 
     unsigned int step = nbTotalCells / numTotalThread;
     unsigned int startIndex = nbThread * step;
@@ -191,11 +170,87 @@ ITK_THREAD_RETURN_FUNCTION_CALL_CONVENTION ThreadFilterer(void *arg)
     if (nbThread == numTotalThread - 1)
         endIndex = nbTotalCells;
 
-    FilterTracks(tmpArg->tracks, startIndex, endIndex, tmpArg->interpolator, tmpArg->touchLabels, tmpArg->endingsLabels, tmpArg->forbiddenLabels);
+    FilterTracks(tmpArg, startIndex, endIndex);
 
     return ITK_THREAD_RETURN_DEFAULT_VALUE;
 }
 
+//! Streams a TRK file chunk by chunk, keeping only fibers that pass the filter
+vtkSmartPointer <vtkPolyData> FilterTRKTracks(const std::string &fileName, ThreaderArguments &tmpStr, unsigned int numThreads)
+{
+    anima::TRKFiberStreamReader trackReader;
+    trackReader.SetFileName(fileName);
+    trackReader.Open();
+
+    unsigned int numScalars = trackReader.GetNumberOfScalars();
+    unsigned int numProperties = trackReader.GetNumberOfProperties();
+
+    vtkSmartPointer <vtkPoints> keptPoints = vtkSmartPointer <vtkPoints>::New();
+    keptPoints->SetDataTypeToDouble();
+    vtkSmartPointer <vtkCellArray> keptCells = vtkSmartPointer <vtkCellArray>::New();
+
+    std::vector < vtkSmartPointer <vtkDoubleArray> > scalarArrays(numScalars);
+    for (unsigned int i = 0;i < numScalars;++i)
+    {
+        scalarArrays[i] = vtkSmartPointer <vtkDoubleArray>::New();
+        scalarArrays[i]->SetName(trackReader.GetHeader().scalar_name[i]);
+    }
+
+    std::vector < vtkSmartPointer <vtkDoubleArray> > propertyArrays(numProperties);
+    for (unsigned int i = 0;i < numProperties;++i)
+    {
+        propertyArrays[i] = vtkSmartPointer <vtkDoubleArray>::New();
+        propertyArrays[i]->SetName(trackReader.GetHeader().property_name[i]);
+    }
+
+    anima::TRKFiberChunk chunk;
+    std::vector <unsigned char> keptFibers;
+    tmpStr.chunk = &chunk;
+    tmpStr.keptFibers = &keptFibers;
+
+    itk::PoolMultiThreader::Pointer mThreader = itk::PoolMultiThreader::New();
+    mThreader->SetNumberOfWorkUnits(numThreads);
+    mThreader->SetSingleMethod(ThreadFilterer,&tmpStr);
+
+    while (trackReader.ReadNextChunk(chunk))
+    {
+        keptFibers.resize(chunk.GetNumberOfFibers());
+        mThreader->SingleMethodExecute();
+
+        for (unsigned int i = 0;i < chunk.GetNumberOfFibers();++i)
+        {
+            if (!keptFibers[i])
+                continue;
+
+            unsigned int fiberStart = chunk.FiberOffsets[i];
+            unsigned int numCellPts = chunk.FiberOffsets[i + 1] - fiberStart;
+
+            keptCells->InsertNextCell(numCellPts);
+            for (unsigned int j = fiberStart;j < fiberStart + numCellPts;++j)
+            {
+                keptCells->InsertCellPoint(keptPoints->InsertNextPoint(chunk.Points.data() + 3 * j));
+                for (unsigned int k = 0;k < numScalars;++k)
+                    scalarArrays[k]->InsertNextValue(chunk.PointScalars[j * numScalars + k]);
+            }
+
+            for (unsigned int k = 0;k < numProperties;++k)
+                propertyArrays[k]->InsertNextValue(chunk.FiberProperties[i * numProperties + k]);
+        }
+    }
+
+    trackReader.Close();
+
+    vtkSmartPointer <vtkPolyData> tracks = vtkSmartPointer <vtkPolyData>::New();
+    tracks->SetPoints(keptPoints);
+    tracks->SetLines(keptCells);
+    for (unsigned int k = 0;k < numScalars;++k)
+        tracks->GetPointData()->AddArray(scalarArrays[k]);
+    for (unsigned int k = 0;k < numProperties;++k)
+        tracks->GetCellData()->AddArray(propertyArrays[k]);
+
+    return tracks;
+}
+
 int main(int argc, char **argv)
 {
     TCLAP::CmdLine cmd("Filters fibers from a vtp file using a label image and specifying with several -t and -f which labels should be touched or are forbidden for each fiber. INRIA / IRISA - VisAGeS/Empenn Team", ' ',ANIMA_VERSION);
@@ -219,23 +274,11 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
 
-    typedef itk::Image <unsigned short, 3> ROIImageType;
     ROIImageType::Pointer roiImage = anima::readImage <ROIImageType> (roiArg.getValue());
 
-    typedef itk::NearestNeighborInterpolateImageFunction <ROIImageType> InterpolatorType;
     InterpolatorType::Pointer interpolator = InterpolatorType::New();
     interpolator->SetInputImage(roiImage);
 
-    anima::ShapesReader trackReader;
-    trackReader.SetFileName(inArg.getValue());
-    trackReader.Update();
-
-    vtkSmartPointer <vtkPolyData> tracks = trackReader.GetOutput();
-
-    // Get dummy cell so that it's thread safe
-    vtkSmartPointer <vtkGenericCell> dummyCell = vtkGenericCell::New();
-    tracks->GetCell(0,dummyCell);
-
     std::vector <unsigned int> touchLabels = touchArg.getValue();
     std::vector <unsigned int> endingsLabels = endingsArg.getValue();
     std::vector <unsigned int> forbiddenLabels = forbiddenArg.getValue();
@@ -245,24 +288,47 @@ int main(int argc, char **argv)
 
     ThreaderArguments tmpStr;
     tmpStr.interpolator = interpolator;
-    tmpStr.tracks = tracks;
+    tmpStr.tracks = 0;
+    tmpStr.chunk = 0;
+    tmpStr.keptFibers = 0;
     tmpStr.touchLabels = touchLabels;
     tmpStr.endingsLabels = endingsLabels;
     tmpStr.forbiddenLabels = forbiddenLabels;
 
-    itk::PoolMultiThreader::Pointer mThreader = itk::PoolMultiThreader::New();
-    mThreader->SetNumberOfWorkUnits(nbThreadsArg.getValue());
-    mThreader->SetSingleMethod(ThreadFilterer,&tmpStr);
-    mThreader->SingleMethodExecute();
+    std::string inputName = inArg.getValue();
+    std::string extensionName = inputName.substr(inputName.find_last_of('.') + 1);
+
+    vtkSmartPointer <vtkPolyData> tracks;
+    if (extensionName == "trk")
+        tracks = FilterTRKTracks(inputName, tmpStr, nbThreadsArg.getValue());
+    else
+    {
+        anima::ShapesReader trackReader;
+        trackReader.SetFileName(inputName);
+        trackReader.Update();
+
+        tracks = trackReader.GetOutput();
+
+        // Get dummy cell so that it's thread safe
+        vtkSmartPointer <vtkGenericCell> dummyCell = vtkGenericCell::New();
+        tracks->GetCell(0,dummyCell);
 
-    // Final pruning of removed cells
-    tracks->RemoveDeletedCells();
+        tmpStr.tracks = tracks;
 
-    // Out of security, but apparently does not do much
-    vtkSmartPointer <vtkCleanPolyData> vtkCleaner = vtkSmartPointer <vtkCleanPolyData>::New();
-    vtkCleaner->SetInputData(tracks);
-    vtkCleaner->Update();
-    tracks->ShallowCopy(vtkCleaner->GetOutput());
+        itk::PoolMultiThreader::Pointer mThreader = itk::PoolMultiThreader::New();
+        mThreader->SetNumberOfWorkUnits(nbThreadsArg.getValue());
+        mThreader->SetSingleMethod(ThreadFilterer,&tmpStr);
+        mThreader->SingleMethodExecute();
+
+        // Final pruning of removed cells
+        tracks->RemoveDeletedCells();
+
+        // Out of security, but apparently does not do much
+        vtkSmartPointer <vtkCleanPolyData> vtkCleaner = vtkSmartPointer <vtkCleanPolyData>::New();
+        vtkCleaner->SetInputData(tracks);
+        vtkCleaner->Update();
+        tracks->ShallowCopy(vtkCleaner->GetOutput());
+    }
 
     std::cout << "Kept " << tracks->GetNumberOfCells() << " after filtering" << std::endl;
 
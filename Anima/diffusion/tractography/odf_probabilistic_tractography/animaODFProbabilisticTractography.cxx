@@ -57,6 +57,8 @@ int main(int argc,  char*  argv[])
     TCLAP::ValueArg<double> trashThrArg("","trash-thr","Relative threshold to keep fibers in trash (default: 0.1)",false,0.1,"trash threshold",cmd);
     TCLAP::ValueArg<double> kappaPriorArg("k","kappa-prior","Kappa of prior distribution (default: 15)",false,15.0,"prior kappa",cmd);
     TCLAP::ValueArg<double> curvScaleArg("","cs","Scale for ODF curvature to get vMF kappa (default: 6)",false,6.0,"scale for ODF curvature",cmd);
+    TCLAP::ValueArg<unsigned int> sphereSubdivArg("","sphere-subdiv","Number of icosahedron subdivisions of the sphere grid used to find ODF maxima (default: 3)",false,3,"sphere grid subdivisions",cmd);
+    TCLAP::SwitchArg voxelPeaksArg("","voxel-peaks","Use ODFs of the nearest voxel instead of interpolated ones, so that their maxima are computed once per voxel",cmd,false);
 
     TCLAP::ValueArg<double> distThrArg("","dist-thr","Hausdorff distance threshold for mergine clusters (default: 0.5)",false,0.5,"merging threshold",cmd);
     TCLAP::ValueArg<double> kappaThrArg("","kappa-thr","Kappa threshold for splitting clusters (default: 30)",false,30.0,"splitting threshold",cmd);
@@ -128,6 +130,8 @@ int main(int argc,  char*  argv[])
     odfTracker->SetKappaSplitThreshold(kappaThrArg.getValue());
     odfTracker->SetClusterDistance(clusterDistArg.getValue());
     odfTracker->SetCurvatureScale(curvScaleArg.getValue());
+    odfTracker->SetNumberOfSphereGridSubdivisions(sphereSubdivArg.getValue());
+    odfTracker->SetUseVoxelODFPeaks(voxelPeaksArg.isSet());
     
     bool computeLocalColors = (fibersArg.getValue().find(".fds") != std::string::npos) && (addLocalDataArg.isSet());
     odfTracker->SetComputeLocalColors(computeLocalColors);
@@ -1,9 +1,19 @@
 #pragma once
 
 #include <vector>
+#include <random>
+
+#include <itkMacro.h>
+#include <itkMultiThreaderBase.h>
 
 namespace anima {
 
+/**
+ * @brief K-means clustering of points. Iterations use Hamerly's bounds (distance to the assigned centroid and lower
+ * bound on the distance to the others) to skip distance computations, results being the same as Lloyd iterations.
+ * Without initial memberships, centroids are seeded by k-means++. Assignment and centroid sums may be split between
+ * threads, and a mini-batch mode estimates centroids from random subsets of the inputs.
+ */
 template <class DataType, unsigned int PointDimension>
 class KMeansFilter
 {
@@ -20,16 +30,32 @@ public:
     {
         m_NbClass = nbC;
         m_NumberPerClass.resize(m_NbClass);
+        m_BoundsValid = false;
     }
 
     void SetMaxIterations(unsigned int mIt) {m_MaxIterations = mIt;}
 
+    //! Number of threads used for assignment and centroid computation (default 1)
+    void SetNumberOfWorkUnits(unsigned int num) {m_NumberOfWorkUnits = num;}
+
+    //! Size of random subsets used for centroid updates, 0 (default) uses all inputs at each iteration
+    void SetMiniBatchSize(unsigned int size) {m_MiniBatchSize = size;}
+
+    //! Mini-batches stop when no centroid moves by more than this ratio of the smallest distance between centroids
+    void SetMiniBatchTolerance(double val) {m_MiniBatchTolerance = val;}
+
+    void SetRandomSeed(unsigned int seed) {m_Generator.seed(seed);}
+
     void ComputeCentroids();
     void UpdateMemberships();
 
     void InitializeKMeansFromData();
     void InitializeClassesMemberships(MembershipType &classM);
-    void ResetClassesMemberships() {m_ClassesMembership.clear();}
+    void ResetClassesMemberships()
+    {
+        m_ClassesMembership.clear();
+        m_BoundsValid = false;
+    }
 
     bool endConditionReached(MembershipType &oldMemberships);
     void SetVerbose(bool verb) {m_Verbose = verb;}
@@ -42,8 +68,39 @@ public:
 
     unsigned int GetNumberPerClass(unsigned int i) {return m_NumberPerClass[i];}
 
+protected:
+    enum ThreadedStepType
+    {
+        CentroidsStep = 0,
+        MembershipsStep,
+        BoundedMembershipsStep
+    };
+
+    struct KMeansThreadStruct
+    {
+        KMeansFilter *Filter;
+        ThreadedStepType Step;
+    };
+
+    static ITK_THREAD_RETURN_FUNCTION_CALL_CONVENTION ThreadedStep(void *arg);
+
+    //! Runs a step on all inputs, split between threads if more than one work unit is requested
+    void RunThreadedStep(ThreadedStepType step);
+    void ProcessInputs(ThreadedStepType step, unsigned int startInput, unsigned int endInput, unsigned int threadId);
+
+    //! Seeds centroids from the data with k-means++
+    void SeedCentroids();
+
+    //! Lloyd iteration with Hamerly's bounds, returns the number of membership changes
+    unsigned int UpdateMembershipsWithBounds(DataHolderType &oldCentroids);
+
+    void RunMiniBatchIterations();
+
 private:
-    double computeDistance(VectorType &vec1, VectorType &vec2);
+    double computeDistance(const VectorType &vec1, const VectorType &vec2) const;
+
+    //! Finds the two closest centroids of a point, distances are not squared
+    void FindClosestCentroids(const VectorType &point, unsigned int &bestClass, double &bestDistance, double &secondDistance) const;
 
     MembershipType m_ClassesMembership;
     DataHolderType m_Centroids;
@@ -53,6 +110,23 @@ private:
 
     unsigned int m_NbClass, m_NbInputs;
     unsigned int m_MaxIterations;
+    unsigned int m_NumberOfWorkUnits;
+    unsigned int m_MiniBatchSize;
+    double m_MiniBatchTolerance;
+
+    std::mt19937 m_Generator;
+
+    //! Hamerly's bounds: distance to the assigned centroid (upper) and to any other centroid (lower)
+    std::vector <double> m_UpperBounds, m_LowerBounds;
+    //! True only if bounds were computed from the current inputs, memberships and centroids
+    bool m_BoundsValid;
+    std::vector <double> m_CentroidDisplacements, m_CentroidHalfSeparations;
+    unsigned int m_MaximalDisplacementIndex;
+    double m_MaximalDisplacement, m_SecondMaximalDisplacement;
+
+    std::vector < std::vector <double> > m_ThreadSums;
+    std::vector < std::vector <unsigned int> > m_ThreadCounts;
+    std::vector <unsigned int> m_ThreadChanges;
 
     bool m_Verbose;
 };
@@ -1,6 +1,12 @@
 #pragma once
 #include "animaKMeansFilter.h"
 
+#include <itkPoolMultiThreader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 namespace anima {
 
 template <class DataType, unsigned int PointDimension>
@@ -15,6 +21,14 @@ KMeansFilter()
     m_NbClass = 0;
     m_NbInputs = 0;
     m_MaxIterations = 100;
+    m_NumberOfWorkUnits = 1;
+    m_MiniBatchSize = 0;
+    m_MiniBatchTolerance = 1.0e-4;
+    m_BoundsValid = false;
+
+    m_MaximalDisplacementIndex = 0;
+    m_MaximalDisplacement = 0;
+    m_SecondMaximalDisplacement = 0;
 
     m_Verbose = true;
 }
@@ -35,6 +49,7 @@ SetInputData(DataHolderType &data)
 
     m_InputData = data;
     m_NbInputs = m_InputData.size();
+    m_BoundsValid = false;
 }
 
 template <class DataType, unsigned int PointDimension>
@@ -46,7 +61,22 @@ Update()
         throw itk::ExceptionObject(__FILE__, __LINE__,"More classes than inputs...",ITK_LOCATION);
 
     this->InitializeKMeansFromData();
-    MembershipType oldMemberships = m_ClassesMembership;
+
+    if ((m_MiniBatchSize > 0) && (m_MiniBatchSize < m_NbInputs))
+    {
+        this->RunMiniBatchIterations();
+        return;
+    }
+
+    // Unless bounds come from UpdateMemberships on the current centroids, first iteration computes all distances
+    if (!m_BoundsValid)
+    {
+        m_UpperBounds.assign(m_NbInputs,std::numeric_limits<double>::max());
+        m_LowerBounds.assign(m_NbInputs,0.0);
+        m_BoundsValid = true;
+    }
+
+    DataHolderType oldCentroids;
     unsigned int itncount = 0;
     bool continueLoop = true;
 
@@ -57,34 +87,174 @@ Update()
         if (m_Verbose)
             std::cout << "Iteration " << itncount << "..." << std::endl;
 
+        oldCentroids = m_Centroids;
         this->ComputeCentroids();
-        this->UpdateMemberships();
 
-        continueLoop = !this->endConditionReached(oldMemberships);
-        oldMemberships = m_ClassesMembership;
+        continueLoop = (this->UpdateMembershipsWithBounds(oldCentroids) != 0);
     }
 }
 
 template <class DataType, unsigned int PointDimension>
 void
 KMeansFilter <DataType,PointDimension>::
-ComputeCentroids()
+RunThreadedStep(ThreadedStepType step)
 {
-    for (unsigned int i = 0;i < m_NbClass;++i)
-        m_Centroids[i].Fill(0);
+    unsigned int actualNumberOfThreads = std::max(1u,std::min(m_NumberOfWorkUnits,m_NbInputs));
 
-    for (unsigned int j = 0;j < m_NbInputs;++j)
+    if (actualNumberOfThreads == 1)
     {
-        for (unsigned int k = 0;k < PointDimension;++k)
-            m_Centroids[m_ClassesMembership[j]][k] += m_InputData[j][k];
+        m_ThreadSums.resize(1);
+        m_ThreadCounts.resize(1);
+        m_ThreadChanges.resize(1);
+        this->ProcessInputs(step,0,m_NbInputs,0);
+        return;
+    }
+
+    itk::PoolMultiThreader::Pointer threaderStep = itk::PoolMultiThreader::New();
+    threaderStep->SetNumberOfWorkUnits(actualNumberOfThreads);
+
+    m_ThreadSums.resize(threaderStep->GetNumberOfWorkUnits());
+    m_ThreadCounts.resize(threaderStep->GetNumberOfWorkUnits());
+    m_ThreadChanges.resize(threaderStep->GetNumberOfWorkUnits());
+
+    KMeansThreadStruct *tmpStr = new KMeansThreadStruct;
+    tmpStr->Filter = this;
+    tmpStr->Step = step;
+
+    threaderStep->SetSingleMethod(this->ThreadedStep,tmpStr);
+    threaderStep->SingleMethodExecute();
+
+    delete tmpStr;
+}
+
+template <class DataType, unsigned int PointDimension>
+ITK_THREAD_RETURN_FUNCTION_CALL_CONVENTION
+KMeansFilter <DataType,PointDimension>::
+ThreadedStep(void *arg)
+{
+    itk::MultiThreaderBase::WorkUnitInfo *threadArgs = (itk::MultiThreaderBase::WorkUnitInfo *)arg;
+
+    unsigned int nbThread = threadArgs->WorkUnitID;
+    unsigned int nbProcs = threadArgs->NumberOfWorkUnits;
+
+    KMeansThreadStruct *tmpStr = (KMeansThreadStruct *)threadArgs->UserData;
+    unsigned int numInputs = tmpStr->Filter->m_NbInputs;
+
+    unsigned int startInput = (unsigned int)std::floor((double)nbThread*numInputs/nbProcs);
+    unsigned int endInput = (unsigned int)std::floor((double)(nbThread + 1.0)*numInputs/nbProcs);
+    endInput = std::min(numInputs,endInput);
+
+    tmpStr->Filter->ProcessInputs(tmpStr->Step,startInput,endInput,nbThread);
+
+    return ITK_THREAD_RETURN_DEFAULT_VALUE;
+}
+
+template <class DataType, unsigned int PointDimension>
+void
+KMeansFilter <DataType,PointDimension>::
+ProcessInputs(ThreadedStepType step, unsigned int startInput, unsigned int endInput, unsigned int threadId)
+{
+    std::vector <unsigned int> &threadCounts = m_ThreadCounts[threadId];
+    threadCounts.assign(m_NbClass,0);
+    m_ThreadChanges[threadId] = 0;
+
+    switch (step)
+    {
+        case CentroidsStep:
+        {
+            std::vector <double> &threadSums = m_ThreadSums[threadId];
+            threadSums.assign(m_NbClass * PointDimension,0.0);
+
+            for (unsigned int i = startInput;i < endInput;++i)
+            {
+                unsigned int classIndex = m_ClassesMembership[i];
+                ++threadCounts[classIndex];
+                for (unsigned int k = 0;k < PointDimension;++k)
+                    threadSums[classIndex * PointDimension + k] += m_InputData[i][k];
+            }
+            break;
+        }
+
+        case MembershipsStep:
+        {
+            for (unsigned int i = startInput;i < endInput;++i)
+            {
+                unsigned int bestClass;
+                this->FindClosestCentroids(m_InputData[i],bestClass,m_UpperBounds[i],m_LowerBounds[i]);
+
+                if (bestClass != m_ClassesMembership[i])
+                    ++m_ThreadChanges[threadId];
+
+                m_ClassesMembership[i] = bestClass;
+                ++threadCounts[bestClass];
+            }
+            break;
+        }
+
+        case BoundedMembershipsStep:
+        {
+            for (unsigned int i = startInput;i < endInput;++i)
+            {
+                unsigned int classIndex = m_ClassesMembership[i];
+
+                // Move bounds with centroids
+                m_UpperBounds[i] += m_CentroidDisplacements[classIndex];
+                if (classIndex == m_MaximalDisplacementIndex)
+                    m_LowerBounds[i] -= m_SecondMaximalDisplacement;
+                else
+                    m_LowerBounds[i] -= m_MaximalDisplacement;
+
+                double boundValue = std::max(m_CentroidHalfSeparations[classIndex],m_LowerBounds[i]);
+                if (m_UpperBounds[i] > boundValue)
+                {
+                    // Tighten upper bound, then compute all distances only if still needed
+                    m_UpperBounds[i] = std::sqrt(this->computeDistance(m_InputData[i],m_Centroids[classIndex]));
+                    if (m_UpperBounds[i] > boundValue)
+                    {
+                        unsigned int bestClass;
+                        this->FindClosestCentroids(m_InputData[i],bestClass,m_UpperBounds[i],m_LowerBounds[i]);
+
+                        if (bestClass != classIndex)
+                        {
+                            ++m_ThreadChanges[threadId];
+                            m_ClassesMembership[i] = bestClass;
+                            classIndex = bestClass;
+                        }
+                    }
+                }
+
+                ++threadCounts[classIndex];
+            }
+            break;
+        }
+
+        default:
+            break;
     }
+}
 
-    for (unsigned int j = 0;j < m_NbClass;++j)
+template <class DataType, unsigned int PointDimension>
+void
+KMeansFilter <DataType,PointDimension>::
+ComputeCentroids()
+{
+    this->RunThreadedStep(CentroidsStep);
+
+    std::fill(m_NumberPerClass.begin(),m_NumberPerClass.end(),0);
+    for (unsigned int i = 0;i < m_NbClass;++i)
     {
-        if (m_NumberPerClass[j] != 0)
+        m_Centroids[i].Fill(0);
+        for (unsigned int t = 0;t < m_ThreadSums.size();++t)
+        {
+            m_NumberPerClass[i] += m_ThreadCounts[t][i];
+            for (unsigned int k = 0;k < PointDimension;++k)
+                m_Centroids[i][k] += m_ThreadSums[t][i * PointDimension + k];
+        }
+
+        if (m_NumberPerClass[i] != 0)
         {
             for (unsigned int k = 0;k < PointDimension;++k)
-                m_Centroids[j][k] /= m_NumberPerClass[j];
+                m_Centroids[i][k] /= m_NumberPerClass[i];
         }
     }
 }
@@ -94,25 +264,122 @@ void
 KMeansFilter <DataType,PointDimension>::
 UpdateMemberships()
 {
+    m_UpperBounds.resize(m_NbInputs);
+    m_LowerBounds.resize(m_NbInputs);
+
+    this->RunThreadedStep(MembershipsStep);
+    m_BoundsValid = true;
+
     std::fill(m_NumberPerClass.begin(),m_NumberPerClass.end(),0);
-    for (unsigned int i = 0;i < m_NbInputs;++i)
+    for (unsigned int t = 0;t < m_ThreadCounts.size();++t)
     {
-        unsigned int bestClass = 0;
-        double bestDistance = this->computeDistance(m_InputData[i],m_Centroids[0]);
+        for (unsigned int i = 0;i < m_NbClass;++i)
+            m_NumberPerClass[i] += m_ThreadCounts[t][i];
+    }
+}
 
-        for (unsigned int j = 1;j < m_NbClass;++j)
+template <class DataType, unsigned int PointDimension>
+unsigned int
+KMeansFilter <DataType,PointDimension>::
+UpdateMembershipsWithBounds(DataHolderType &oldCentroids)
+{
+    m_CentroidDisplacements.resize(m_NbClass);
+    m_MaximalDisplacementIndex = 0;
+    m_MaximalDisplacement = 0;
+    m_SecondMaximalDisplacement = 0;
+
+    for (unsigned int i = 0;i < m_NbClass;++i)
+    {
+        m_CentroidDisplacements[i] = std::sqrt(this->computeDistance(oldCentroids[i],m_Centroids[i]));
+        if (m_CentroidDisplacements[i] > m_MaximalDisplacement)
         {
-            double tmpDist = this->computeDistance(m_InputData[i],m_Centroids[j]);
-            if (tmpDist < bestDistance)
-            {
-                bestDistance = tmpDist;
-                bestClass = j;
-            }
+            m_SecondMaximalDisplacement = m_MaximalDisplacement;
+            m_MaximalDisplacement = m_CentroidDisplacements[i];
+            m_MaximalDisplacementIndex = i;
         }
+        else if (m_CentroidDisplacements[i] > m_SecondMaximalDisplacement)
+            m_SecondMaximalDisplacement = m_CentroidDisplacements[i];
+    }
 
-        m_ClassesMembership[i] = bestClass;
-        ++m_NumberPerClass[bestClass];
+    // A point is closer to its centroid than to any other one if within half the distance to the closest other centroid
+    m_CentroidHalfSeparations.assign(m_NbClass,std::numeric_limits<double>::max());
+    for (unsigned int i = 0;i < m_NbClass;++i)
+    {
+        for (unsigned int j = i + 1;j < m_NbClass;++j)
+        {
+            double halfDistance = std::sqrt(this->computeDistance(m_Centroids[i],m_Centroids[j])) / 2.0;
+            m_CentroidHalfSeparations[i] = std::min(m_CentroidHalfSeparations[i],halfDistance);
+            m_CentroidHalfSeparations[j] = std::min(m_CentroidHalfSeparations[j],halfDistance);
+        }
     }
+
+    this->RunThreadedStep(BoundedMembershipsStep);
+
+    unsigned int numChanges = 0;
+    std::fill(m_NumberPerClass.begin(),m_NumberPerClass.end(),0);
+    for (unsigned int t = 0;t < m_ThreadCounts.size();++t)
+    {
+        numChanges += m_ThreadChanges[t];
+        for (unsigned int i = 0;i < m_NbClass;++i)
+            m_NumberPerClass[i] += m_ThreadCounts[t][i];
+    }
+
+    return numChanges;
+}
+
+template <class DataType, unsigned int PointDimension>
+void
+KMeansFilter <DataType,PointDimension>::
+RunMiniBatchIterations()
+{
+    // Centroids from initial memberships, then updated with per centroid learning rates (Sculley, 2010). Counts
+    // start from class sizes, so that batch samples refine the full data centroids instead of replacing them
+    this->ComputeCentroids();
+
+    std::vector <unsigned int> centroidCounts(m_NumberPerClass);
+    DataHolderType oldCentroids;
+    std::vector <unsigned int> batchIndexes(m_MiniBatchSize);
+    std::vector <unsigned int> batchMemberships(m_MiniBatchSize);
+    std::uniform_int_distribution <unsigned int> uniInt(0,m_NbInputs - 1);
+
+    double bestDistance, secondDistance;
+    for (unsigned int itncount = 0;itncount < m_MaxIterations;++itncount)
+    {
+        if (m_Verbose)
+            std::cout << "Mini-batch iteration " << itncount + 1 << "..." << std::endl;
+
+        for (unsigned int i = 0;i < m_MiniBatchSize;++i)
+        {
+            batchIndexes[i] = uniInt(m_Generator);
+            this->FindClosestCentroids(m_InputData[batchIndexes[i]],batchMemberships[i],bestDistance,secondDistance);
+        }
+
+        oldCentroids = m_Centroids;
+        for (unsigned int i = 0;i < m_MiniBatchSize;++i)
+        {
+            unsigned int classIndex = batchMemberships[i];
+            ++centroidCounts[classIndex];
+            double learningRate = 1.0 / centroidCounts[classIndex];
+
+            for (unsigned int k = 0;k < PointDimension;++k)
+                m_Centroids[classIndex][k] += learningRate * (m_InputData[batchIndexes[i]][k] - m_Centroids[classIndex][k]);
+        }
+
+        double maximalDisplacement = 0;
+        double minimalSeparation = std::numeric_limits<double>::max();
+        for (unsigned int i = 0;i < m_NbClass;++i)
+        {
+            maximalDisplacement = std::max(maximalDisplacement,this->computeDistance(oldCentroids[i],m_Centroids[i]));
+            for (unsigned int j = i + 1;j < m_NbClass;++j)
+                minimalSeparation = std::min(minimalSeparation,this->computeDistance(m_Centroids[i],m_Centroids[j]));
+        }
+
+        // Squared distances, hence the squared tolerance
+        if (maximalDisplacement <= m_MiniBatchTolerance * m_MiniBatchTolerance * minimalSeparation)
+            break;
+    }
+
+    this->UpdateMemberships();
 }
 
 template <class DataType, unsigned int PointDimension>
@@ -132,21 +399,70 @@ endConditionReached(MembershipType &oldMemberships)
 template <class DataType, unsigned int PointDimension>
 void
 KMeansFilter <DataType,PointDimension>::
-InitializeKMeansFromData()
+SeedCentroids()
 {
     m_Centroids.clear();
 
-    for (unsigned int i = 0;i < m_NbClass;++i)
-        m_Centroids.push_back(m_InputData[i]);
+    std::uniform_int_distribution <unsigned int> uniInt(0,m_NbInputs - 1);
+    m_Centroids.push_back(m_InputData[uniInt(m_Generator)]);
 
-    //Centroids initialized, now compute memberships
-    if (m_ClassesMembership.size() != m_NbInputs)
+    // Squared distances to the closest chosen centroid, next centroids are drawn proportionally to them
+    std::vector <double> closestDistances(m_NbInputs);
+    for (unsigned int i = 0;i < m_NbInputs;++i)
+        closestDistances[i] = this->computeDistance(m_InputData[i],m_Centroids[0]);
+
+    std::uniform_real_distribution <double> uniReal(0.0,1.0);
+    for (unsigned int j = 1;j < m_NbClass;++j)
+    {
+        double sumDistances = 0;
+        for (unsigned int i = 0;i < m_NbInputs;++i)
+            sumDistances += closestDistances[i];
+
+        unsigned int chosenInput = uniInt(m_Generator);
+        if (sumDistances > 0)
+        {
+            double threshold = uniReal(m_Generator) * sumDistances;
+            double cumulatedDistance = 0;
+            for (unsigned int i = 0;i < m_NbInputs;++i)
+            {
+                cumulatedDistance += closestDistances[i];
+                if ((cumulatedDistance >= threshold) && (closestDistances[i] > 0))
+                {
+                    chosenInput = i;
+                    break;
+                }
+            }
+        }
+
+        m_Centroids.push_back(m_InputData[chosenInput]);
+        for (unsigned int i = 0;i < m_NbInputs;++i)
+            closestDistances[i] = std::min(closestDistances[i],this->computeDistance(m_InputData[i],m_Centroids[j]));
+    }
+}
+
+template <class DataType, unsigned int PointDimension>
+void
+KMeansFilter <DataType,PointDimension>::
+InitializeKMeansFromData()
+{
+    //Initial memberships given, centroids are computed from them
+    if (m_ClassesMembership.size() == m_NbInputs)
     {
-        m_ClassesMembership.resize(m_NbInputs);
-        std::fill(m_ClassesMembership.begin(),m_ClassesMembership.end(),0);
-        
-        this->UpdateMemberships();
+        m_BoundsValid = false;
+        m_Centroids.clear();
+        for (unsigned int i = 0;i < m_NbClass;++i)
+            m_Centroids.push_back(m_InputData[i]);
+
+        return;
     }
+
+    this->SeedCentroids();
+
+    //Centroids initialized, now compute memberships
+    m_ClassesMembership.resize(m_NbInputs);
+    std::fill(m_ClassesMembership.begin(),m_ClassesMembership.end(),0);
+
+    this->UpdateMemberships();
 }
 
 template <class DataType, unsigned int PointDimension>
@@ -157,14 +473,45 @@ InitializeClassesMemberships(MembershipType &classM)
     if (classM.size() == m_NbInputs)
         m_ClassesMembership = classM;
 
+    // Bounds do not hold for these memberships
+    m_BoundsValid = false;
+
+    std::fill(m_NumberPerClass.begin(),m_NumberPerClass.end(),0);
     for (unsigned int i = 0;i < m_NbInputs;++i)
         m_NumberPerClass[m_ClassesMembership[i]]++;
 }
 
+template <class DataType, unsigned int PointDimension>
+void
+KMeansFilter <DataType,PointDimension>::
+FindClosestCentroids(const VectorType &point, unsigned int &bestClass, double &bestDistance, double &secondDistance) const
+{
+    bestClass = 0;
+    bestDistance = this->computeDistance(point,m_Centroids[0]);
+    secondDistance = std::numeric_limits<double>::max();
+
+    for (unsigned int j = 1;j < m_NbClass;++j)
+    {
+        double tmpDist = this->computeDistance(point,m_Centroids[j]);
+        if (tmpDist < bestDistance)
+        {
+            secondDistance = bestDistance;
+            bestDistance = tmpDist;
+            bestClass = j;
+        }
+        else if (tmpDist < secondDistance)
+            secondDistance = tmpDist;
+    }
+
+    bestDistance = std::sqrt(bestDistance);
+    if (secondDistance < std::numeric_limits<double>::max())
+        secondDistance = std::sqrt(secondDistance);
+}
+
 template <class DataType, unsigned int PointDimension>
 double
 KMeansFilter <DataType,PointDimension>::
-computeDistance(VectorType &vec1, VectorType &vec2)
+computeDistance(const VectorType &vec1, const VectorType &vec2) const
 {
     double resVal = 0;
 
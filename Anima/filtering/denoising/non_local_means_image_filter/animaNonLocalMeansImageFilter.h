@@ -26,6 +26,8 @@ public:
     typedef typename InputImageType::Pointer InputImagePointer;
     typedef typename InputImageType::RegionType InputImageRegionType;
     typedef typename InputImageType::IndexType InputImageIndexType;
+    typedef typename InputImageType::SizeType InputImageSizeType;
+    typedef typename InputImageType::OffsetType InputImageOffsetType;
 
     typedef InputImageType OutputImageType;
     typedef typename OutputImageType::Pointer OutputImagePointer;
@@ -67,6 +69,13 @@ public:
     itkSetMacro(VarMinThreshold, double)
     itkSetMacro(WeightMethod, WEIGHT)
 
+    //! Computes patch distances per displacement with integral images instead of patch by patch
+    itkSetMacro(UseIntegralImages, bool)
+
+    //! Blockwise variant (implies integral images): patches centered on a grid are denoised and averaged where they overlap
+    itkSetMacro(BlockwiseAggregation, bool)
+    itkSetMacro(BlockStepSize, unsigned int)
+
 protected:
     NonLocalMeansImageFilter() :
         m_MeanMinThreshold(0.95),
@@ -77,6 +86,9 @@ protected:
         m_SearchStepSize(3),
         m_SearchNeighborhood(6),
         m_WeightMethod(EXP),
+        m_UseIntegralImages(false),
+        m_BlockwiseAggregation(false),
+        m_BlockStepSize(2),
         m_localNeighborhood(1)
 
     {}
@@ -92,6 +104,16 @@ private:
     void computeAverageLocalVariance();
     void computeMeanAndVarImages();
 
+    //! Integral images version of the threaded generate data, optionally blockwise
+    void integralImagesThreadedGenerateData(const OutputImageRegionType& outputRegionForThread);
+
+    //! Integral image of values stored in a region of given size, with an extra leading zero along each dimension
+    void computeIntegralImage(const std::vector <double> &values, const InputImageSizeType &size, std::vector <double> &integral);
+
+    //! Sum of values in the box [startIndex, endIndex] (inclusive, relative to the region start) from an integral image
+    double getBoxSum(const std::vector <double> &integral, const InputImageSizeType &size,
+                     const InputImageIndexType &startIndex, const InputImageIndexType &endIndex);
+
     double m_MeanMinThreshold;
     double m_VarMinThreshold;
     double m_WeightThreshold;
@@ -102,6 +124,11 @@ private:
     unsigned int m_SearchNeighborhood;
     WEIGHT m_WeightMethod;
 
+    bool m_UseIntegralImages;
+    bool m_BlockwiseAggregation;
+    unsigned int m_BlockStepSize;
+    std::vector <InputImageOffsetType> m_searchDisplacements;
+
     double m_noiseCovariance;
     OutputImagePointer m_meanImage;
     OutputImagePointer m_varImage;
@@ -22,6 +22,34 @@ NonLocalMeansImageFilter <TInputImage>
     this->computeAverageLocalVariance();
     this->computeMeanAndVarImages();
     m_maxAbsDisp = std::floor((double)(m_SearchNeighborhood / m_SearchStepSize)) * m_SearchStepSize;
+
+    // List of non zero displacements, on the search step grid, for the integral images version
+    m_searchDisplacements.clear();
+    if (!m_UseIntegralImages && !m_BlockwiseAggregation)
+        return;
+
+    int numStepsPerDimension = 2 * m_maxAbsDisp / m_SearchStepSize + 1;
+    unsigned int numDisplacements = 1;
+    for (unsigned int d = 0;d < InputImageDimension;++d)
+        numDisplacements *= numStepsPerDimension;
+
+    for (unsigned int i = 0;i < numDisplacements;++i)
+    {
+        InputImageOffsetType displacement;
+        unsigned int remainder = i;
+        bool isCentral = true;
+        for (unsigned int d = 0;d < InputImageDimension;++d)
+        {
+            displacement[d] = (int)(remainder % numStepsPerDimension) * (int)m_SearchStepSize - m_maxAbsDisp;
+            remainder /= numStepsPerDimension;
+
+            if (displacement[d] != 0)
+                isCentral = false;
+        }
+
+        if (!isCentral)
+            m_searchDisplacements.push_back(displacement);
+    }
 }
 
 template <class TInputImage>
@@ -103,6 +131,12 @@ void
 NonLocalMeansImageFilter < TInputImage >
 ::DynamicThreadedGenerateData(const OutputImageRegionType &outputRegionForThread)
 {
+    if (m_UseIntegralImages || m_BlockwiseAggregation)
+    {
+        this->integralImagesThreadedGenerateData(outputRegionForThread);
+        return;
+    }
+
     // Allocate output
     typename OutputImageType::Pointer output = this->GetOutput();
     typename InputImageType::Pointer input = const_cast<InputImageType *> (this->GetInput());
@@ -191,4 +225,410 @@ NonLocalMeansImageFilter < TInputImage >
     }
 }
 
+template <class TInputImage>
+void
+NonLocalMeansImageFilter <TInputImage>
+::computeIntegralImage(const std::vector <double> &values, const InputImageSizeType &size, std::vector <double> &integral)
+{
+    unsigned int integralStrides[InputImageDimension];
+    unsigned int integralLength = 1;
+    for (unsigned int d = 0;d < InputImageDimension;++d)
+    {
+        integralStrides[d] = integralLength;
+        integralLength *= size[d] + 1;
+    }
+
+    integral.assign(integralLength,0.0);
+
+    // Copy values shifted by one along each dimension
+    InputImageIndexType position;
+    position.Fill(0);
+    for (unsigned int i = 0;i < values.size();++i)
+    {
+        unsigned int integralIndex = 0;
+        for (unsigned int d = 0;d < InputImageDimension;++d)
+            integralIndex += (position[d] + 1) * integralStrides[d];
+
+        integral[integralIndex] = values[i];
+
+        for (unsigned int d = 0;d < InputImageDimension;++d)
+        {
+            ++position[d];
+            if (position[d] < (int)size[d])
+                break;
+
+            position[d] = 0;
+        }
+    }
+
+    // Separable cumulative sums, leading zeros are left untouched
+    for (unsigned int d = 0;d < InputImageDimension;++d)
+    {
+        unsigned int stride = integralStrides[d];
+        unsigned int dimSize = size[d] + 1;
+        for (unsigned int i = stride;i < integralLength;++i)
+        {
+            if ((i / stride) % dimSize != 0)
+                integral[i] += integral[i - stride];
+        }
+    }
+}
+
+template <class TInputImage>
+double
+NonLocalMeansImageFilter <TInputImage>
+::getBoxSum(const std::vector <double> &integral, const InputImageSizeType &size,
+            const InputImageIndexType &startIndex, const InputImageIndexType &endIndex)
+{
+    unsigned int numCorners = 1 << InputImageDimension;
+    double boxSum = 0.0;
+
+    for (unsigned int c = 0;c < numCorners;++c)
+    {
+        unsigned int integralIndex = 0;
+        unsigned int stride = 1;
+        bool positiveSign = true;
+        for (unsigned int d = 0;d < InputImageDimension;++d)
+        {
+            if (c & (1 << d))
+                integralIndex += (endIndex[d] + 1) * stride;
+            else
+            {
+                integralIndex += startIndex[d] * stride;
+                positiveSign = !positiveSign;
+            }
+
+            stride *= size[d] + 1;
+        }
+
+        if (positiveSign)
+            boxSum += integral[integralIndex];
+        else
+            boxSum -= integral[integralIndex];
+    }
+
+    return boxSum;
+}
+
+template <class TInputImage>
+void
+NonLocalMeansImageFilter <TInputImage>
+::integralImagesThreadedGenerateData(const OutputImageRegionType &outputRegionForThread)
+{
+    const InputImageType *input = this->GetInput();
+    OutputImageType *output = this->GetOutput();
+    InputImageRegionType largestRegion = input->GetLargestPossibleRegion();
+
+    InputImageIndexType imageStart = largestRegion.GetIndex();
+    InputImageIndexType imageEnd;
+    for (unsigned int d = 0;d < InputImageDimension;++d)
+        imageEnd[d] = imageStart[d] + largestRegion.GetSize()[d] - 1;
+
+    int patchHalfSize = m_PatchHalfSize;
+    int blockStepSize = std::max(1,std::min((int)m_BlockStepSize,patchHalfSize + 1));
+
+    // Compared patches are centered on output voxels, or on grid voxels close enough to overlap them in blockwise mode
+    InputImageRegionType centerRegion = outputRegionForThread;
+    if (m_BlockwiseAggregation)
+    {
+        centerRegion.PadByRadius(patchHalfSize);
+        centerRegion.Crop(largestRegion);
+    }
+
+    InputImageRegionType distanceRegion = centerRegion;
+    distanceRegion.PadByRadius(patchHalfSize);
+    distanceRegion.Crop(largestRegion);
+
+    InputImageIndexType distanceStart = distanceRegion.GetIndex();
+    InputImageSizeType distanceSize = distanceRegion.GetSize();
+    unsigned int numDistanceVoxels = distanceRegion.GetNumberOfPixels();
+
+    InputImageIndexType centerStart = centerRegion.GetIndex();
+    InputImageSizeType centerSize = centerRegion.GetSize();
+    unsigned int numCenterVoxels = centerRegion.GetNumberOfPixels();
+
+    InputImageIndexType outputStart = outputRegionForThread.GetIndex();
+    InputImageSizeType outputSize = outputRegionForThread.GetSize();
+    unsigned int numOutputVoxels = outputRegionForThread.GetNumberOfPixels();
+
+    bool ricianWeights = (m_WeightMethod == RICIAN);
+    double weightNormalization = 2.0 * m_BetaParameter * m_noiseCovariance;
+
+    // Reference values and buffer offsets on the distance region
+    std::vector <double> referenceValues(numDistanceVoxels);
+    std::vector <long> referenceOffsets(numDistanceVoxels);
+    InputImageIndexType position = distanceStart;
+    for (unsigned int i = 0;i < numDistanceVoxels;++i)
+    {
+        referenceOffsets[i] = input->ComputeOffset(position);
+        referenceValues[i] = input->GetBufferPointer()[referenceOffsets[i]];
+
+        for (unsigned int d = 0;d < InputImageDimension;++d)
+        {
+            ++position[d];
+            if (position[d] < distanceStart[d] + (int)distanceSize[d])
+                break;
+
+            position[d] = distanceStart[d];
+        }
+    }
+
+    const InputPixelType *inputBuffer = input->GetBufferPointer();
+    const typename InputImageType::OffsetValueType *offsetTable = input->GetOffsetTable();
+
+    // Accumulators, on centers for the pixelwise version, on output voxels for the blockwise version
+    std::vector <double> weightedSums(numOutputVoxels,0.0);
+    std::vector <double> weightSums(numOutputVoxels,0.0);
+    std::vector <double> maxWeights(numCenterVoxels,0.0);
+
+    std::vector <double> squaredDifferences(numDistanceVoxels);
+    std::vector <double> distanceIntegral, blockWeights, blockWeightsIntegral;
+    if (m_BlockwiseAggregation)
+        blockWeights.resize(numCenterVoxels);
+
+    InputImageIndexType patchStart, patchEnd, movingIndex;
+
+    for (unsigned int k = 0;k < m_searchDisplacements.size();++k)
+    {
+        const InputImageOffsetType &displacement = m_searchDisplacements[k];
+        long displacementOffset = 0;
+        for (unsigned int d = 0;d < InputImageDimension;++d)
+            displacementOffset += displacement[d] * offsetTable[d];
+
+        // Squared differences for this displacement, computed once for all patches
+        position = distanceStart;
+        for (unsigned int i = 0;i < numDistanceVoxels;++i)
+        {
+            bool insideImage = true;
+            for (unsigned int d = 0;d < InputImageDimension;++d)
+            {
+                int movingPosition = position[d] + displacement[d];
+                if ((movingPosition < imageStart[d]) || (movingPosition > imageEnd[d]))
+                {
+                    insideImage = false;
+                    break;
+                }
+            }
+
+            squaredDifferences[i] = 0.0;
+            if (insideImage)
+            {
+                double diffValue = referenceValues[i] - (double)inputBuffer[referenceOffsets[i] + displacementOffset];
+                squaredDifferences[i] = diffValue * diffValue;
+            }
+
+            for (unsigned int d = 0;d < InputImageDimension;++d)
+            {
+                ++position[d];
+                if (position[d] < distanceStart[d] + (int)distanceSize[d])
+                    break;
+
+                position[d] = distanceStart[d];
+            }
+        }
+
+        this->computeIntegralImage(squaredDifferences,distanceSize,distanceIntegral);
+
+        // Patch weights at each center
+        position = centerStart;
+        for (unsigned int i = 0;i < numCenterVoxels;++i)
+        {
+            double weightValue = 0.0;
+            bool computeWeight = true;
+
+            if (m_BlockwiseAggregation)
+            {
+                for (unsigned int d = 0;d < InputImageDimension;++d)
+                {
+                    if ((position[d] - imageStart[d]) % blockStepSize != 0)
+                    {
+                        computeWeight = false;
+                        break;
+                    }
+                }
+            }
+
+            unsigned int numPatchVoxels = 1;
+            for (unsigned int d = 0;(d < InputImageDimension) && computeWeight;++d)
+            {
+                patchStart[d] = std::max(position[d] - patchHalfSize,imageStart[d]);
+                patchEnd[d] = std::min(position[d] + patchHalfSize,imageEnd[d]);
+                movingIndex[d] = position[d] + displacement[d];
+
+                // Moving patch has to be inside the image
+                if ((patchStart[d] + displacement[d] < imageStart[d]) || (patchEnd[d] + displacement[d] > imageEnd[d]))
+                    computeWeight = false;
+
+                numPatchVoxels *= patchEnd[d] - patchStart[d] + 1;
+                patchStart[d] -= distanceStart[d];
+                patchEnd[d] -= distanceStart[d];
+            }
+
+            if (computeWeight)
+            {
+                double meanRate = m_meanImage->GetPixel(position) / m_meanImage->GetPixel(movingIndex);
+                double varianceRate = m_varImage->GetPixel(position) / m_varImage->GetPixel(movingIndex);
+
+                computeWeight = (meanRate > m_MeanMinThreshold) && (meanRate < (1.0 / m_MeanMinThreshold)) &&
+                        (varianceRate > m_VarMinThreshold) && (varianceRate < (1.0 / m_VarMinThreshold));
+            }
+
+            if (computeWeight)
+            {
+                double patchDistance = this->getBoxSum(distanceIntegral,distanceSize,patchStart,patchEnd);
+                weightValue = std::exp(- patchDistance / (weightNormalization * numPatchVoxels));
+                if (weightValue <= m_WeightThreshold)
+                    weightValue = 0.0;
+            }
+
+            if (weightValue > maxWeights[i])
+                maxWeights[i] = weightValue;
+
+            if (m_BlockwiseAggregation)
+                blockWeights[i] = weightValue;
+            else if (weightValue > 0.0)
+            {
+                double sampleValue = inputBuffer[input->ComputeOffset(position) + displacementOffset];
+                if (ricianWeights)
+                    sampleValue *= sampleValue;
+
+                weightedSums[i] += weightValue * sampleValue;
+                weightSums[i] += weightValue;
+            }
+
+            for (unsigned int d = 0;d < InputImageDimension;++d)
+            {
+                ++position[d];
+                if (position[d] < centerStart[d] + (int)centerSize[d])
+                    break;
+
+                position[d] = centerStart[d];
+            }
+        }
+
+        if (!m_BlockwiseAggregation)
+            continue;
+
+        // Each output voxel gathers the displaced values of all the block patches covering it
+        this->computeIntegralImage(blockWeights,centerSize,blockWeightsIntegral);
+
+        position = outputStart;
+        for (unsigned int i = 0;i < numOutputVoxels;++i)
+        {
+            for (unsigned int d = 0;d < InputImageDimension;++d)
+            {
+                patchStart[d] = std::max(position[d] - patchHalfSize,centerStart[d]) - centerStart[d];
+                patchEnd[d] = std::min(position[d] + patchHalfSize,centerStart[d] + (int)centerSize[d] - 1) - centerStart[d];
+            }
+
+            double coveringWeight = this->getBoxSum(blockWeightsIntegral,centerSize,patchStart,patchEnd);
+            if (coveringWeight > 0.0)
+            {
+                double sampleValue = inputBuffer[input->ComputeOffset(position) + displacementOffset];
+                if (ricianWeights)
+                    sampleValue *= sampleValue;
+
+                weightedSums[i] += coveringWeight * sampleValue;
+                weightSums[i] += coveringWeight;
+            }
+
+            for (unsigned int d = 0;d < InputImageDimension;++d)
+            {
+                ++position[d];
+                if (position[d] < outputStart[d] + (int)outputSize[d])
+                    break;
+
+                position[d] = outputStart[d];
+            }
+        }
+    }
+
+    // Central patches get the maximal weight of their neighbors
+    std::vector <double> centralWeights(numOutputVoxels,0.0);
+    if (m_BlockwiseAggregation)
+    {
+        position = centerStart;
+        for (unsigned int i = 0;i < numCenterVoxels;++i)
+        {
+            bool onGrid = true;
+            for (unsigned int d = 0;d < InputImageDimension;++d)
+            {
+                if ((position[d] - imageStart[d]) % blockStepSize != 0)
+                {
+                    onGrid = false;
+                    break;
+                }
+            }
+
+            blockWeights[i] = 0.0;
+            if (onGrid)
+                blockWeights[i] = (maxWeights[i] > 0.0) ? maxWeights[i] : 1.0;
+
+            for (unsigned int d = 0;d < InputImageDimension;++d)
+            {
+                ++position[d];
+                if (position[d] < centerStart[d] + (int)centerSize[d])
+                    break;
+
+                position[d] = centerStart[d];
+            }
+        }
+
+        this->computeIntegralImage(blockWeights,centerSize,blockWeightsIntegral);
+
+        position = outputStart;
+        for (unsigned int i = 0;i < numOutputVoxels;++i)
+        {
+            for (unsigned int d = 0;d < InputImageDimension;++d)
+            {
+                patchStart[d] = std::max(position[d] - patchHalfSize,centerStart[d]) - centerStart[d];
+                patchEnd[d] = std::min(position[d] + patchHalfSize,centerStart[d] + (int)centerSize[d] - 1) - centerStart[d];
+            }
+
+            centralWeights[i] = this->getBoxSum(blockWeightsIntegral,centerSize,patchStart,patchEnd);
+
+            for (unsigned int d = 0;d < InputImageDimension;++d)
+            {
+                ++position[d];
+                if (position[d] < outputStart[d] + (int)outputSize[d])
+                    break;
+
+                position[d] = outputStart[d];
+            }
+        }
+    }
+    else
+        centralWeights = maxWeights;
+
+    typedef itk::ImageRegionConstIterator< InputImageType > InIteratorType;
+    typedef itk::ImageRegionIterator< OutputImageType > OutRegionIteratorType;
+
+    InIteratorType inputIterator(input, outputRegionForThread);
+    OutRegionIteratorType outputIterator(output, outputRegionForThread);
+
+    for (unsigned int i = 0;i < numOutputVoxels;++i)
+    {
+        double inputValue = inputIterator.Get();
+
+        if (weightSums[i] == 0)
+            outputIterator.Set(inputIterator.Get());
+        else if (ricianWeights)
+        {
+            double t = ((weightedSums[i] + inputValue * inputValue * centralWeights[i]) / (weightSums[i] + centralWeights[i]))
+                    - (2.0 * m_noiseCovariance);
+
+            if (t < 0)
+                t = 0;
+
+            outputIterator.Set(std::sqrt(t));
+        }
+        else
+            outputIterator.Set((weightedSums[i] + centralWeights[i] * inputValue) / (weightSums[i] + centralWeights[i]));
+
+        this->IncrementNumberOfProcessedPoints();
+        ++outputIterator;
+        ++inputIterator;
+    }
+}
+
 } // end of namespace anima
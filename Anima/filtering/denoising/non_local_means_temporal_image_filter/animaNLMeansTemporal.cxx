@@ -106,6 +106,26 @@ int main(int ac, const char** av)
                                                 "Patch search neighborhood size",
                                                 cmd);
 
+    TCLAP::SwitchArg integralArg("",
+                                 "integral",
+                                 "Compute patch distances with integral images (faster)",
+                                 cmd,
+                                 false);
+
+    TCLAP::SwitchArg blockwiseArg("",
+                                  "blockwise",
+                                  "Blockwise non local means: denoise patches on a grid and average them where they overlap",
+                                  cmd,
+                                  false);
+
+    TCLAP::ValueArg<unsigned int> blockStepArg("",
+                                               "block-step",
+                                               "Grid step between block centers in blockwise mode -> default: 2",
+                                               false,
+                                               2,
+                                               "block step size",
+                                               cmd);
+
     try
     {
         cmd.parse(ac,av);
@@ -182,6 +202,10 @@ int main(int ac, const char** av)
             if (weightMethod.getValue())
                 filter->SetWeightMethod(FilterType::RICIAN);
 
+            filter->SetUseIntegralImages(integralArg.isSet());
+            filter->SetBlockwiseAggregation(blockwiseArg.isSet());
+            filter->SetBlockStepSize(blockStepArg.getValue());
+
             filter->SetNumberOfWorkUnits(nbpArg.getValue());
 
             filter->Update();
@@ -219,6 +243,10 @@ int main(int ac, const char** av)
             if (weightMethod.getValue())
                 filter->SetWeightMethod(FilterType::RICIAN);
 
+            filter->SetUseIntegralImages(integralArg.isSet());
+            filter->SetBlockwiseAggregation(blockwiseArg.isSet());
+            filter->SetBlockStepSize(blockStepArg.getValue());
+
             filter->SetNumberOfWorkUnits(nbpArg.getValue());
 
             filter->AddObserver(itk::ProgressEvent(), callback );
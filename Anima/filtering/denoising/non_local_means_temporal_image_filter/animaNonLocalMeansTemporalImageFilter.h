@@ -66,6 +66,10 @@ public:
     itkSetMacro(VarMinThreshold, double)
     itkSetMacro(WeightMethod, WEIGHT)
 
+    itkSetMacro(UseIntegralImages, bool)
+    itkSetMacro(BlockwiseAggregation, bool)
+    itkSetMacro(BlockStepSize, unsigned int)
+
 protected:
     NonLocalMeansTemporalImageFilter() :
         m_MeanMinThreshold(0.95),
@@ -75,7 +79,10 @@ protected:
         m_PatchHalfSize(1),
         m_SearchStepSize(1),
         m_SearchNeighborhood(5),
-        m_WeightMethod(EXP)
+        m_WeightMethod(EXP),
+        m_UseIntegralImages(false),
+        m_BlockwiseAggregation(false),
+        m_BlockStepSize(2)
     {}
 
     virtual ~NonLocalMeansTemporalImageFilter() {}
@@ -94,6 +101,10 @@ private:
     unsigned int m_SearchStepSize;
     unsigned int m_SearchNeighborhood;
     WEIGHT m_WeightMethod;
+
+    bool m_UseIntegralImages;
+    bool m_BlockwiseAggregation;
+    unsigned int m_BlockStepSize;
 };
 
 } //end of namespace anima
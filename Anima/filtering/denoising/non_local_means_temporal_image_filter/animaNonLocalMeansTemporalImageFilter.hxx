@@ -72,6 +72,10 @@ NonLocalMeansTemporalImageFilter < TInputImage >
                 nLMeansFilter->SetWeightMethod(NLMEansFilterType::EXP);
         else nLMeansFilter->SetWeightMethod(NLMEansFilterType::RICIAN);
 
+        nLMeansFilter->SetUseIntegralImages(m_UseIntegralImages);
+        nLMeansFilter->SetBlockwiseAggregation(m_BlockwiseAggregation);
+        nLMeansFilter->SetBlockStepSize(m_BlockStepSize);
+
         nLMeansFilter->SetNumberOfWorkUnits(this->GetNumberOfWorkUnits());
 
         nLMeansFilter->Update();
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <itkImage.h>
+#include <itkImageFileWriter.h>
+
+namespace anima
+{
+
+/**
+ * \class BlockImageWriter
+ * @brief Assembles an output image from block results (e.g. of ImageDataSplitter blocks) into a single file.
+ *
+ * If the image IO of the output file supports streamed writing, each block is pasted directly into the file
+ * (uncompressed, e.g. MetaImage .mha files) and only one block is in memory at a time. Otherwise (e.g. NRRD) blocks
+ * are copied into a full size image that is written by Finalize(). Voxels not covered by any block are zero.
+ */
+template <class TImageType> class BlockImageWriter
+{
+public:
+    typedef TImageType ImageType;
+    typedef typename ImageType::Pointer ImagePointer;
+    typedef typename ImageType::RegionType RegionType;
+    typedef typename ImageType::IndexType IndexType;
+    typedef typename ImageType::InternalPixelType InternalPixelType;
+
+    typedef itk::ImageBase <ImageType::ImageDimension> ReferenceImageType;
+
+    BlockImageWriter();
+    ~BlockImageWriter() {}
+
+    void SetFileName(std::string fileName) {m_FileName = fileName;}
+    std::string GetFileName() {return m_FileName;}
+
+    //! Geometry of the final image, copied at initialization
+    void SetReferenceImage(ReferenceImageType *refImage) {m_ReferenceImage = refImage;}
+    void SetNumberOfComponentsPerPixel(unsigned int val) {m_NumberOfComponentsPerPixel = val;}
+
+    //! Chooses direct or buffered writing and creates the output (zero filled)
+    void Initialize();
+    bool GetDirectFileWriting() {return m_DirectFileWriting;}
+
+    //! Writes region blockRegion of blockImage at outputIndex in the final image
+    void WriteBlock(ImageType *blockImage, const RegionType &blockRegion, const IndexType &outputIndex);
+
+    //! Writes the buffered image if needed and releases it
+    void Finalize();
+
+private:
+    //! Allocates an image with the final geometry, buffered only on bufferedRegion, and zero filled
+    ImagePointer CreateZeroImage(const RegionType &bufferedRegion);
+
+    //! Pastes an image buffered on pasteRegion into the output file
+    void PasteIntoFile(ImageType *pasteImage, const RegionType &pasteRegion);
+
+    std::string m_FileName;
+    typename ReferenceImageType::Pointer m_ReferenceImage;
+    unsigned int m_NumberOfComponentsPerPixel;
+
+    bool m_Initialized;
+    bool m_DirectFileWriting;
+    RegionType m_LargestRegion;
+    ImagePointer m_OutputImage;
+};
+
+} // end namespace anima
+
+#include "animaBlockImageWriter.hxx"
@@ -0,0 +1,138 @@
+#pragma once
+#include "animaBlockImageWriter.h"
+
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIterator.h>
+#include <itkImageIOFactory.h>
+#include <itkImageIORegion.h>
+#include <animaReadWriteFunctions.h>
+
+namespace anima
+{
+
+template <class TImageType> BlockImageWriter<TImageType>::BlockImageWriter()
+{
+    m_FileName = "";
+    m_ReferenceImage = ITK_NULLPTR;
+    m_NumberOfComponentsPerPixel = 1;
+
+    m_Initialized = false;
+    m_DirectFileWriting = false;
+    m_OutputImage = ITK_NULLPTR;
+}
+
+template <class TImageType> typename TImageType::Pointer BlockImageWriter<TImageType>::CreateZeroImage(const RegionType &bufferedRegion)
+{
+    ImagePointer resImage = ImageType::New();
+    resImage->Initialize();
+    resImage->SetLargestPossibleRegion(m_LargestRegion);
+    resImage->SetBufferedRegion(bufferedRegion);
+    resImage->SetRequestedRegion(bufferedRegion);
+    resImage->SetOrigin(m_ReferenceImage->GetOrigin());
+    resImage->SetDirection(m_ReferenceImage->GetDirection());
+    resImage->SetSpacing(m_ReferenceImage->GetSpacing());
+    resImage->SetNumberOfComponentsPerPixel(m_NumberOfComponentsPerPixel);
+    resImage->Allocate();
+
+    InternalPixelType *resBuffer = resImage->GetBufferPointer();
+    std::fill(resBuffer,resBuffer + bufferedRegion.GetNumberOfPixels() * m_NumberOfComponentsPerPixel,
+              itk::NumericTraits <InternalPixelType>::ZeroValue());
+
+    return resImage;
+}
+
+template <class TImageType> void BlockImageWriter<TImageType>::PasteIntoFile(ImageType *pasteImage, const RegionType &pasteRegion)
+{
+    itk::ImageIORegion ioRegion(ImageType::ImageDimension);
+    itk::ImageIORegionAdaptor <ImageType::ImageDimension>::Convert(pasteRegion,ioRegion,m_LargestRegion.GetIndex());
+
+    typedef itk::ImageFileWriter <ImageType> WriterType;
+    typename WriterType::Pointer writer = WriterType::New();
+    writer->SetFileName(m_FileName);
+    writer->SetInput(pasteImage);
+    writer->SetIORegion(ioRegion);
+    writer->SetUseCompression(false);
+
+    writer->Update();
+}
+
+template <class TImageType> void BlockImageWriter<TImageType>::Initialize()
+{
+    if (!m_ReferenceImage)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"No reference image for block writing",ITK_LOCATION);
+
+    if (m_FileName == "")
+        throw itk::ExceptionObject(__FILE__, __LINE__,"No filename specified for block writing",ITK_LOCATION);
+
+    m_LargestRegion = m_ReferenceImage->GetLargestPossibleRegion();
+
+    itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(m_FileName.c_str(), itk::IOFileModeEnum::WriteMode);
+
+    // Gzipped files cannot be written in place
+    bool compressedFile = (m_FileName.size() > 3) && (m_FileName.compare(m_FileName.size() - 3,3,".gz") == 0);
+    m_DirectFileWriting = imageIO && imageIO->CanStreamWrite() && !compressedFile;
+
+    if (m_DirectFileWriting)
+    {
+        // Create the file slice by slice, blocks are then pasted over it
+        unsigned int lastDimension = ImageType::ImageDimension - 1;
+        RegionType sliceRegion = m_LargestRegion;
+        sliceRegion.SetSize(lastDimension,1);
+
+        ImagePointer zeroSlice = this->CreateZeroImage(sliceRegion);
+        for (unsigned int i = 0;i < m_LargestRegion.GetSize(lastDimension);++i)
+        {
+            sliceRegion.SetIndex(lastDimension,m_LargestRegion.GetIndex(lastDimension) + i);
+            zeroSlice->SetBufferedRegion(sliceRegion);
+            zeroSlice->SetRequestedRegion(sliceRegion);
+            this->PasteIntoFile(zeroSlice,sliceRegion);
+        }
+    }
+    else
+        m_OutputImage = this->CreateZeroImage(m_LargestRegion);
+
+    m_Initialized = true;
+}
+
+template <class TImageType> void BlockImageWriter<TImageType>::WriteBlock(ImageType *blockImage, const RegionType &blockRegion,
+                                                                         const IndexType &outputIndex)
+{
+    if (!m_Initialized)
+        this->Initialize();
+
+    RegionType outputRegion(outputIndex,blockRegion.GetSize());
+
+    ImagePointer targetImage = m_OutputImage;
+    if (m_DirectFileWriting)
+        targetImage = this->CreateZeroImage(outputRegion);
+
+    itk::ImageRegionConstIterator <ImageType> blockItr(blockImage,blockRegion);
+    itk::ImageRegionIterator <ImageType> targetItr(targetImage,outputRegion);
+
+    while (!blockItr.IsAtEnd())
+    {
+        targetItr.Set(blockItr.Get());
+
+        ++blockItr;
+        ++targetItr;
+    }
+
+    if (m_DirectFileWriting)
+        this->PasteIntoFile(targetImage,outputRegion);
+}
+
+template <class TImageType> void BlockImageWriter<TImageType>::Finalize()
+{
+    if (!m_Initialized)
+        this->Initialize();
+
+    if (!m_DirectFileWriting)
+    {
+        anima::writeImage <ImageType> (m_FileName,m_OutputImage);
+        m_OutputImage = ITK_NULLPTR;
+    }
+
+    m_Initialized = false;
+}
+
+} // end namespace anima
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <string>
+#include <future>
 #include <itkVectorImage.h>
 #include <itkImageFileReader.h>
 #include <itkImage.h>
@@ -35,6 +36,12 @@ public:
 
     bool EmptyMask(TInputIndexType &bIndex);
 
+    /**
+     * Starts reading the images of another block in a background thread, so that it overlaps with the processing
+     * of the current block. Update() on that block index then waits for and uses the prefetched images
+     */
+    void PrefetchBlock(TInputIndexType &bIndex);
+
     void Update();
 
     TInputRegionType GetSpecificBlockRegion(TInputIndexType &block);
@@ -48,6 +55,12 @@ public:
     unsigned int GetNbImages() {return m_NbImages;}
 
 private:
+    //! Computes a block region and its extension by the margin, clamped to the image
+    void ComputeBlockRegions(const TInputIndexType &block, TInputRegionType &blockRegion, TInputRegionType &blockRegionWithMargin);
+
+    //! Reads the region with margin of every input file, only this region is read when the image IO supports streaming
+    std::vector <TInputPointer> ReadBlockImages(TInputRegionType blockRegionWithMargin);
+
     unsigned int m_NbImages;
     bool m_NeedsUpdate;
     TInputIndexType m_NbBlocks;
@@ -58,6 +71,10 @@ private:
     TInputRegionType m_BlockRegion, m_BlockRegionWithMargin;
 
     std::vector <TInputPointer> m_Images;
+
+    bool m_PrefetchRunning;
+    TInputIndexType m_PrefetchedBlock;
+    std::future < std::vector <TInputPointer> > m_PrefetchedImages;
     std::vector <std::string> m_FileNames;
     MaskImagePointer m_MaskImage, m_SmallMask, m_SmallMaskWithMargin;
 };
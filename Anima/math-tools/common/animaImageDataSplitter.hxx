@@ -18,6 +18,9 @@ template <typename TInputImage> ImageDataSplitter<TInputImage>::ImageDataSplitte
     m_Block.Fill (0);
     m_Margin.Fill (0);
 
+    m_PrefetchRunning = false;
+    m_PrefetchedBlock.Fill (0);
+
     for (unsigned int i = 0;i < m_GlobalRegionOfInterest.GetImageDimension();++i)
     {
         m_GlobalRegionOfInterest.SetIndex(i,0);
@@ -36,6 +39,9 @@ template <typename TInputImage> ImageDataSplitter<TInputImage>::ImageDataSplitte
 
 template <typename TInputImage> ImageDataSplitter<TInputImage>::~ImageDataSplitter()
 {
+    if (m_PrefetchRunning)
+        m_PrefetchedImages.wait();
+
     m_Images.clear();
     m_FileNames.clear();
 }
@@ -190,39 +196,106 @@ template <typename TInputImage> bool ImageDataSplitter<TInputImage>::EmptyMask(T
     return (!hasNonNullValue);
 }
 
-template <typename TInputImage> void ImageDataSplitter<TInputImage>::Update()
+template <typename TInputImage> void ImageDataSplitter<TInputImage>::ComputeBlockRegions(const TInputIndexType &block, TInputRegionType &blockRegion,
+                                                                                         TInputRegionType &blockRegionWithMargin)
 {
-    if (!m_NeedsUpdate)
-        return;
-
-    m_Images.clear();
-
-    if (!m_MaskImage)
-        throw itk::ExceptionObject(__FILE__, __LINE__,"No mask input. This is required. Exiting...",ITK_LOCATION);
-
     for (unsigned int i = 0;i < m_GlobalRegionOfInterest.GetImageDimension();++i)
     {
-        m_BlockRegion.SetIndex(i,m_GlobalRegionOfInterest.GetIndex(i) + m_GlobalRegionOfInterest.GetSize(i)*m_Block[i]/m_NbBlocks[i]);
-        unsigned int tmpMax = m_GlobalRegionOfInterest.GetIndex(i) + m_GlobalRegionOfInterest.GetSize(i)*(1+m_Block[i])/m_NbBlocks[i] - m_BlockRegion.GetIndex(i);
-        m_BlockRegion.SetSize(i,tmpMax);
+        blockRegion.SetIndex(i,m_GlobalRegionOfInterest.GetIndex(i) + m_GlobalRegionOfInterest.GetSize(i)*block[i]/m_NbBlocks[i]);
+        unsigned int tmpMax = m_GlobalRegionOfInterest.GetIndex(i) + m_GlobalRegionOfInterest.GetSize(i)*(1+block[i])/m_NbBlocks[i] - blockRegion.GetIndex(i);
+        blockRegion.SetSize(i,tmpMax);
     }
 
-    m_BlockRegionWithMargin = m_BlockRegion;
+    blockRegionWithMargin = blockRegion;
+    TInputRegionType largestRegion = m_MaskImage->GetLargestPossibleRegion();
     for (unsigned int i = 0;i < m_GlobalRegionOfInterest.GetImageDimension();++i)
     {
         if (m_Margin[i] != 0)
         {
-            unsigned int tmpMin = m_BlockRegion.GetIndex()[i] - m_Margin[i];
-            if (tmpMin < m_MaskImage->GetLargestPossibleRegion().GetIndex()[i])
-                tmpMin = m_MaskImage->GetLargestPossibleRegion().GetIndex()[i];
-            unsigned int tmpMax = m_BlockRegion.GetIndex()[i] + m_BlockRegion.GetSize()[i] + m_Margin[i] - 1;
-            if (tmpMax >= m_MaskImage->GetLargestPossibleRegion().GetIndex()[i] + m_MaskImage->GetLargestPossibleRegion().GetSize()[i])
-                tmpMax = m_MaskImage->GetLargestPossibleRegion().GetIndex()[i] + m_MaskImage->GetLargestPossibleRegion().GetSize()[i] - 1;
-
-            m_BlockRegionWithMargin.SetIndex(i,tmpMin);
-            m_BlockRegionWithMargin.SetSize(i,tmpMax - tmpMin + 1);
+            itk::IndexValueType tmpMin = blockRegion.GetIndex()[i] - m_Margin[i];
+            if (tmpMin < largestRegion.GetIndex()[i])
+                tmpMin = largestRegion.GetIndex()[i];
+            itk::IndexValueType tmpMax = blockRegion.GetIndex()[i] + blockRegion.GetSize()[i] + m_Margin[i] - 1;
+            if (tmpMax >= (itk::IndexValueType)(largestRegion.GetIndex()[i] + largestRegion.GetSize()[i]))
+                tmpMax = largestRegion.GetIndex()[i] + largestRegion.GetSize()[i] - 1;
+
+            blockRegionWithMargin.SetIndex(i,tmpMin);
+            blockRegionWithMargin.SetSize(i,tmpMax - tmpMin + 1);
         }
     }
+}
+
+template <typename TInputImage> std::vector <typename TInputImage::Pointer> ImageDataSplitter<TInputImage>::ReadBlockImages(TInputRegionType blockRegionWithMargin)
+{
+    TInputRegionType tmpRegion = blockRegionWithMargin;
+    for (unsigned int i = 0;i < TInputImage::GetImageDimension();++i)
+        tmpRegion.SetIndex(i,0);
+
+    std::vector <TInputPointer> blockImages(m_FileNames.size());
+    for (unsigned int i = 0;i < m_FileNames.size();++i)
+    {
+        InputReaderPointer tmpImReader = InputReaderType::New();
+        tmpImReader->SetFileName(m_FileNames[i]);
+
+        // Request only the block, the reader falls back to the whole image if its image IO cannot stream
+        tmpImReader->UpdateOutputInformation();
+        tmpImReader->GetOutput()->SetRequestedRegion(blockRegionWithMargin);
+        tmpImReader->Update();
+
+        blockImages[i] = TInputImage::New();
+        blockImages[i]->Initialize();
+        blockImages[i]->SetRegions(tmpRegion);
+        blockImages[i]->SetOrigin(m_MaskImage->GetOrigin());
+        blockImages[i]->SetDirection(m_MaskImage->GetDirection());
+        blockImages[i]->SetSpacing(m_MaskImage->GetSpacing());
+
+        blockImages[i]->SetNumberOfComponentsPerPixel(tmpImReader->GetOutput()->GetNumberOfComponentsPerPixel());
+
+        blockImages[i]->Allocate();
+
+        itk::ImageRegionIterator <TInputImage> cropImIt(blockImages[i],tmpRegion);
+        itk::ImageRegionConstIterator <TInputImage> reImIt(tmpImReader->GetOutput(),blockRegionWithMargin);
+
+        while (!cropImIt.IsAtEnd())
+        {
+            cropImIt.Set(reImIt.Get());
+
+            ++cropImIt;
+            ++reImIt;
+        }
+    }
+
+    return blockImages;
+}
+
+template <typename TInputImage> void ImageDataSplitter<TInputImage>::PrefetchBlock(TInputIndexType &bIndex)
+{
+    if (!m_MaskImage)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"No mask input. This is required. Exiting...",ITK_LOCATION);
+
+    // A previous prefetch that was not used is dropped
+    if (m_PrefetchRunning)
+        m_PrefetchedImages.wait();
+
+    TInputRegionType blockRegion, blockRegionWithMargin;
+    this->ComputeBlockRegions(bIndex,blockRegion,blockRegionWithMargin);
+
+    m_PrefetchedBlock = bIndex;
+    m_PrefetchedImages = std::async(std::launch::async,&ImageDataSplitter<TInputImage>::ReadBlockImages,this,blockRegionWithMargin);
+    m_PrefetchRunning = true;
+}
+
+template <typename TInputImage> void ImageDataSplitter<TInputImage>::Update()
+{
+    if (!m_NeedsUpdate)
+        return;
+
+    m_Images.clear();
+
+    if (!m_MaskImage)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"No mask input. This is required. Exiting...",ITK_LOCATION);
+
+    this->ComputeBlockRegions(m_Block,m_BlockRegion,m_BlockRegionWithMargin);
 
     MaskImageType::RegionType tmpRegion = m_BlockRegion;
     for (unsigned int i = 0;i < MaskImageType::GetImageDimension();++i)
@@ -267,36 +340,22 @@ template <typename TInputImage> void ImageDataSplitter<TInputImage>::Update()
         ++maskItWM;
     }
 
+    // Printed here rather than while reading, which may happen in the prefetch thread
     for (unsigned int i = 0;i < m_FileNames.size();++i)
-    {
         std::cout << "Processing image file " << m_FileNames[i] << "..." << std::endl;
-        InputReaderPointer tmpImReader = InputReaderType::New();
-        tmpImReader->SetFileName(m_FileNames[i]);
-        tmpImReader->Update();
-
-        m_Images.push_back(TInputImage::New());
-        m_Images[i]->Initialize();
-        m_Images[i]->SetRegions(tmpRegion);
-        m_Images[i]->SetOrigin(m_MaskImage->GetOrigin());
-        m_Images[i]->SetDirection(m_MaskImage->GetDirection());
-        m_Images[i]->SetSpacing(m_MaskImage->GetSpacing());
-
-        m_Images[i]->SetNumberOfComponentsPerPixel(tmpImReader->GetOutput()->GetNumberOfComponentsPerPixel());
-
-        m_Images[i]->Allocate();
 
-        itk::ImageRegionIterator <TInputImage> cropImIt(m_Images[i],tmpRegion);
-        itk::ImageRegionConstIterator <TInputImage> reImIt(tmpImReader->GetOutput(),m_BlockRegionWithMargin);
-
-        while (!cropImIt.IsAtEnd())
-        {
-            cropImIt.Set(reImIt.Get());
+    if (m_PrefetchRunning)
+    {
+        std::vector <TInputPointer> prefetchedImages = m_PrefetchedImages.get();
+        m_PrefetchRunning = false;
 
-            ++cropImIt;
-            ++reImIt;
-        }
+        if (m_PrefetchedBlock == m_Block)
+            m_Images = prefetchedImages;
     }
 
+    if (m_Images.size() != m_FileNames.size())
+        m_Images = this->ReadBlockImages(m_BlockRegionWithMargin);
+
     m_NeedsUpdate = false;
 }
 
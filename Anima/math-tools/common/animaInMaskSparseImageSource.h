@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+#include <itkImageSource.h>
+#include <itkImage.h>
+
+namespace anima
+{
+
+/**
+ * \class InMaskSparseImageSource
+ * @brief Holds image values only for voxels inside a mask, as a sorted list of voxel offsets and a packed
+ * array of pixel components, and expands them as a regular image on request.
+ *
+ * Estimators use it to store their outputs without allocating full size images. SetPixel may be called
+ * concurrently for distinct voxels. The output is generated only on the requested region, with zeros outside
+ * of the mask, so that a streaming writer expands the data slab by slab. A range of components may be selected
+ * to expand only part of vector pixels.
+ */
+template <class TOutputImage>
+class InMaskSparseImageSource :
+        public itk::ImageSource <TOutputImage>
+{
+public:
+    /** Standard class typedefs. */
+    typedef InMaskSparseImageSource Self;
+    typedef itk::ImageSource <TOutputImage> Superclass;
+    typedef itk::SmartPointer<Self> Pointer;
+    typedef itk::SmartPointer<const Self> ConstPointer;
+
+    /** Method for creation through the object factory. */
+    itkNewMacro(Self)
+
+    /** Run-time type information (and related methods) */
+    itkTypeMacro(InMaskSparseImageSource, itk::ImageSource)
+
+    typedef TOutputImage OutputImageType;
+    typedef typename OutputImageType::PixelType PixelType;
+    typedef typename OutputImageType::InternalPixelType InternalPixelType;
+    typedef typename OutputImageType::RegionType RegionType;
+    typedef typename OutputImageType::IndexType IndexType;
+
+    typedef itk::Image <unsigned char, OutputImageType::ImageDimension> MaskImageType;
+
+    /**
+     * Copies geometry from the mask, lists its non zero voxels and allocates numberOfComponents values for each
+     * of them, set to zero
+     */
+    void Initialize(MaskImageType *mask, unsigned int numberOfComponents);
+
+    unsigned int GetNumberOfComponents() const {return m_NumberOfComponents;}
+    unsigned int GetNumberOfInMaskVoxels() const {return m_VoxelOffsets.size();}
+
+    //! Sets the value of a voxel, nothing is stored if the voxel is outside of the mask
+    void SetPixel(const IndexType &index, const PixelType &value);
+
+    //! Returns false and leaves value untouched if the voxel is outside of the mask
+    bool GetPixel(const IndexType &index, PixelType &value) const;
+
+    //! Components expanded in the output, [firstComponent, firstComponent + numberOfComponents). Default: all components
+    void SetOutputComponentRange(unsigned int firstComponent, unsigned int numberOfComponents);
+
+protected:
+    InMaskSparseImageSource();
+    virtual ~InMaskSparseImageSource() {}
+
+    void GenerateOutputInformation() ITK_OVERRIDE;
+    void GenerateData() ITK_OVERRIDE;
+
+    //! Position of a voxel in the packed arrays, -1 if outside of the mask
+    int GetVoxelPosition(const IndexType &index) const;
+
+    //! Offset of an index in the full image grid
+    itk::OffsetValueType ComputeOffset(const IndexType &index) const;
+
+private:
+    ITK_DISALLOW_COPY_AND_ASSIGN(InMaskSparseImageSource);
+
+    typename MaskImageType::Pointer m_GeometryImage;
+    RegionType m_LargestRegion;
+
+    std::vector <itk::OffsetValueType> m_VoxelOffsets;
+    std::vector <InternalPixelType> m_Values;
+
+    unsigned int m_NumberOfComponents;
+    unsigned int m_FirstOutputComponent;
+    unsigned int m_NumberOfOutputComponents;
+};
+
+} // end namespace anima
+
+#include "animaInMaskSparseImageSource.hxx"
@@ -0,0 +1,192 @@
+#pragma once
+#include "animaInMaskSparseImageSource.h"
+
+#include <itkImageRegionConstIteratorWithIndex.h>
+#include <itkDefaultConvertPixelTraits.h>
+#include <algorithm>
+
+namespace anima
+{
+
+template <class TOutputImage>
+InMaskSparseImageSource <TOutputImage>
+::InMaskSparseImageSource()
+{
+    m_GeometryImage = ITK_NULLPTR;
+    m_NumberOfComponents = 0;
+    m_FirstOutputComponent = 0;
+    m_NumberOfOutputComponents = 0;
+}
+
+template <class TOutputImage>
+void
+InMaskSparseImageSource <TOutputImage>
+::Initialize(MaskImageType *mask, unsigned int numberOfComponents)
+{
+    if (!mask)
+        itkExceptionMacro("No mask provided for sparse image initialization");
+
+    if (numberOfComponents == 0)
+        itkExceptionMacro("Sparse image pixels should have at least one component");
+
+    m_LargestRegion = mask->GetLargestPossibleRegion();
+    m_GeometryImage = MaskImageType::New();
+    m_GeometryImage->Initialize();
+    m_GeometryImage->SetRegions(m_LargestRegion);
+    m_GeometryImage->SetSpacing(mask->GetSpacing());
+    m_GeometryImage->SetOrigin(mask->GetOrigin());
+    m_GeometryImage->SetDirection(mask->GetDirection());
+
+    m_NumberOfComponents = numberOfComponents;
+    m_FirstOutputComponent = 0;
+    m_NumberOfOutputComponents = numberOfComponents;
+
+    // Mask is traversed in buffer order, offsets come out sorted
+    m_VoxelOffsets.clear();
+    typedef itk::ImageRegionConstIteratorWithIndex <MaskImageType> MaskIteratorType;
+    MaskIteratorType maskItr(mask,m_LargestRegion);
+    while (!maskItr.IsAtEnd())
+    {
+        if (maskItr.Get() != 0)
+            m_VoxelOffsets.push_back(this->ComputeOffset(maskItr.GetIndex()));
+
+        ++maskItr;
+    }
+
+    m_Values.resize(m_VoxelOffsets.size() * m_NumberOfComponents);
+    std::fill(m_Values.begin(),m_Values.end(),itk::NumericTraits <InternalPixelType>::ZeroValue());
+
+    this->Modified();
+}
+
+template <class TOutputImage>
+void
+InMaskSparseImageSource <TOutputImage>
+::SetOutputComponentRange(unsigned int firstComponent, unsigned int numberOfComponents)
+{
+    if ((numberOfComponents == 0) || (firstComponent + numberOfComponents > m_NumberOfComponents))
+        itkExceptionMacro("Invalid output component range");
+
+    m_FirstOutputComponent = firstComponent;
+    m_NumberOfOutputComponents = numberOfComponents;
+
+    this->Modified();
+}
+
+template <class TOutputImage>
+itk::OffsetValueType
+InMaskSparseImageSource <TOutputImage>
+::ComputeOffset(const IndexType &index) const
+{
+    itk::OffsetValueType offset = 0;
+    itk::OffsetValueType stride = 1;
+    for (unsigned int i = 0;i < OutputImageType::ImageDimension;++i)
+    {
+        offset += (index[i] - m_LargestRegion.GetIndex()[i]) * stride;
+        stride *= m_LargestRegion.GetSize()[i];
+    }
+
+    return offset;
+}
+
+template <class TOutputImage>
+int
+InMaskSparseImageSource <TOutputImage>
+::GetVoxelPosition(const IndexType &index) const
+{
+    if (!m_LargestRegion.IsInside(index))
+        return -1;
+
+    itk::OffsetValueType offset = this->ComputeOffset(index);
+    typename std::vector <itk::OffsetValueType>::const_iterator offsetItr = std::lower_bound(m_VoxelOffsets.begin(),m_VoxelOffsets.end(),offset);
+
+    if ((offsetItr == m_VoxelOffsets.end()) || (*offsetItr != offset))
+        return -1;
+
+    return offsetItr - m_VoxelOffsets.begin();
+}
+
+template <class TOutputImage>
+void
+InMaskSparseImageSource <TOutputImage>
+::SetPixel(const IndexType &index, const PixelType &value)
+{
+    int position = this->GetVoxelPosition(index);
+    if (position < 0)
+        return;
+
+    typedef itk::DefaultConvertPixelTraits <PixelType> PixelTraitsType;
+    InternalPixelType *voxelValues = m_Values.data() + position * m_NumberOfComponents;
+    for (unsigned int i = 0;i < m_NumberOfComponents;++i)
+        voxelValues[i] = PixelTraitsType::GetNthComponent(i,value);
+}
+
+template <class TOutputImage>
+bool
+InMaskSparseImageSource <TOutputImage>
+::GetPixel(const IndexType &index, PixelType &value) const
+{
+    int position = this->GetVoxelPosition(index);
+    if (position < 0)
+        return false;
+
+    typedef itk::DefaultConvertPixelTraits <PixelType> PixelTraitsType;
+    const InternalPixelType *voxelValues = m_Values.data() + position * m_NumberOfComponents;
+    for (unsigned int i = 0;i < m_NumberOfComponents;++i)
+        PixelTraitsType::SetNthComponent(i,value,voxelValues[i]);
+
+    return true;
+}
+
+template <class TOutputImage>
+void
+InMaskSparseImageSource <TOutputImage>
+::GenerateOutputInformation()
+{
+    if (!m_GeometryImage)
+        itkExceptionMacro("Sparse image not initialized");
+
+    OutputImageType *output = this->GetOutput();
+    output->CopyInformation(m_GeometryImage);
+    output->SetNumberOfComponentsPerPixel(m_NumberOfOutputComponents);
+}
+
+template <class TOutputImage>
+void
+InMaskSparseImageSource <TOutputImage>
+::GenerateData()
+{
+    this->AllocateOutputs();
+
+    OutputImageType *output = this->GetOutput();
+    RegionType outputRegion = output->GetBufferedRegion();
+    InternalPixelType *outputBuffer = output->GetBufferPointer();
+
+    std::fill(outputBuffer,outputBuffer + outputRegion.GetNumberOfPixels() * m_NumberOfOutputComponents,
+              itk::NumericTraits <InternalPixelType>::ZeroValue());
+
+    // In-mask voxels of the requested region lie between the offsets of its first and last voxels
+    typedef typename std::vector <itk::OffsetValueType>::const_iterator OffsetIteratorType;
+    OffsetIteratorType firstItr = std::lower_bound(m_VoxelOffsets.begin(),m_VoxelOffsets.end(),this->ComputeOffset(outputRegion.GetIndex()));
+    OffsetIteratorType lastItr = std::upper_bound(firstItr,m_VoxelOffsets.end(),this->ComputeOffset(outputRegion.GetUpperIndex()));
+
+    IndexType voxelIndex;
+    for (OffsetIteratorType offsetItr = firstItr;offsetItr != lastItr;++offsetItr)
+    {
+        itk::OffsetValueType remainingOffset = *offsetItr;
+        for (unsigned int i = 0;i < OutputImageType::ImageDimension;++i)
+        {
+            voxelIndex[i] = m_LargestRegion.GetIndex()[i] + remainingOffset % m_LargestRegion.GetSize()[i];
+            remainingOffset /= m_LargestRegion.GetSize()[i];
+        }
+
+        if (!outputRegion.IsInside(voxelIndex))
+            continue;
+
+        const InternalPixelType *voxelValues = m_Values.data() + (offsetItr - m_VoxelOffsets.begin()) * m_NumberOfComponents + m_FirstOutputComponent;
+        InternalPixelType *outputValues = outputBuffer + output->ComputeOffset(voxelIndex) * m_NumberOfOutputComponents;
+        std::copy(voxelValues,voxelValues + m_NumberOfOutputComponents,outputValues);
+    }
+}
+
+} // end namespace anima
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <atomic>
 #include <animaNumberedThreadImageToImageFilter.h>
 #include <itkNumericTraits.h>
 
@@ -40,10 +41,26 @@ public:
     itkSetMacro(ComputationMask, MaskImagePointer)
     itkGetMacro(ComputationMask, MaskImageType *)
 
+    /**
+     * Compacted masked execution: in-mask voxels are listed once as runs along the first image axis, and
+     * threads process chunks of runs with balanced voxel counts instead of slices of the mask bounding box.
+     * Chunks are given to GenerateDataOnMaskRuns, only regions fully inside the mask are thus processed. Outputs
+     * outside of the mask keep the zero value they get before threaded generate data
+     */
+    itkSetMacro(CompactedMaskExecution, bool)
+    itkGetMacro(CompactedMaskExecution, bool)
+
+    //! Minimal number of in-mask voxels in a chunk of runs (e.g. the voxel batch size of a subclass), except for the last chunk
+    itkSetMacro(MinimumMaskChunkSize, unsigned int)
+    itkGetMacro(MinimumMaskChunkSize, unsigned int)
+
 protected:
     MaskedImageToImageFilter()
     {
         m_ComputationMask = ITK_NULLPTR;
+        m_CompactedMaskExecution = false;
+        m_MinimumMaskChunkSize = 1;
+        m_NextMaskRunChunk = 0;
     }
 
     virtual ~MaskedImageToImageFilter() {}
@@ -52,10 +69,31 @@ protected:
     void InitializeComputationRegionFromMask();
     virtual void BeforeThreadedGenerateData() ITK_OVERRIDE;
 
+    //! Builds in-mask voxel runs and their chunks, called once the mask is final, before threads are launched
+    void InitializeMaskRuns();
+    virtual void ResetMultiThreadingPart() ITK_OVERRIDE;
+    virtual void ThreadProcessSlices() ITK_OVERRIDE;
+
+    /**
+     * Processes a chunk of in-mask runs in compacted execution. Calls DynamicThreadedGenerateData on each run by
+     * default, subclasses batching voxels may override it to gather voxels across runs
+     */
+    virtual void GenerateDataOnMaskRuns(const OutputImageRegionType *runRegions, unsigned int numRuns);
+
 private:
     ITK_DISALLOW_COPY_AND_ASSIGN(MaskedImageToImageFilter);
 
     MaskImagePointer m_ComputationMask;
+
+    bool m_CompactedMaskExecution;
+    unsigned int m_MinimumMaskChunkSize;
+
+    //! In-mask runs along the first axis
+    std::vector <OutputImageRegionType> m_MaskRunRegions;
+
+    //! Index of the first run of each chunk, followed by the number of runs
+    std::vector <unsigned int> m_MaskRunChunkStarts;
+    std::atomic <unsigned int> m_NextMaskRunChunk;
 };
 
 } //end namespace anima
@@ -2,6 +2,9 @@
 #include "animaMaskedImageToImageFilter.h"
 
 #include <itkImageRegionConstIterator.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
+
+#include <algorithm>
 
 namespace anima
 {
@@ -92,4 +95,115 @@ MaskedImageToImageFilter < TInputImage, TOutputImage >
     this->SetComputationRegion(computationRegion);
 }
 
+template< typename TInputImage, typename TOutputImage >
+void
+MaskedImageToImageFilter < TInputImage, TOutputImage >
+::ResetMultiThreadingPart()
+{
+    Superclass::ResetMultiThreadingPart();
+
+    if (m_CompactedMaskExecution)
+        this->InitializeMaskRuns();
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+MaskedImageToImageFilter < TInputImage, TOutputImage >
+::InitializeMaskRuns()
+{
+    this->CheckComputationMask();
+
+    m_MaskRunRegions.clear();
+    m_MaskRunChunkStarts.clear();
+    m_NextMaskRunChunk = 0;
+
+    OutputImageRegionType computationRegion = this->GetComputationRegion();
+    if (computationRegion.GetSize(0) == 0)
+        computationRegion = this->GetOutput(0)->GetRequestedRegion();
+
+    typedef itk::ImageRegionConstIteratorWithIndex< MaskImageType > MaskRegionIteratorType;
+    MaskRegionIteratorType maskItr(m_ComputationMask,computationRegion);
+
+    typename OutputImageRegionType::SizeType runSize;
+    runSize.Fill(1);
+
+    unsigned int numPoints = 0;
+    bool inRun = false;
+    while (!maskItr.IsAtEnd())
+    {
+        MaskIndexType currentIndex = maskItr.GetIndex();
+        if (currentIndex[0] == computationRegion.GetIndex()[0])
+            inRun = false;
+
+        if (maskItr.Get() != 0)
+        {
+            if (inRun)
+                m_MaskRunRegions.back().SetSize(0,m_MaskRunRegions.back().GetSize(0) + 1);
+            else
+            {
+                m_MaskRunRegions.push_back(OutputImageRegionType(currentIndex,runSize));
+                inRun = true;
+            }
+
+            ++numPoints;
+        }
+        else
+            inRun = false;
+
+        ++maskItr;
+    }
+
+    // A few chunks per work unit, so that threads end up at the same time, but at least the minimal chunk size
+    const unsigned int numChunksPerWorkUnit = 16;
+    unsigned int numWorkUnits = std::max(1u,(unsigned int)this->GetNumberOfWorkUnits());
+    unsigned int chunkTargetSize = std::max(1u,numPoints / (numChunksPerWorkUnit * numWorkUnits));
+    chunkTargetSize = std::max(chunkTargetSize,m_MinimumMaskChunkSize);
+
+    unsigned int currentChunkSize = 0;
+    for (unsigned int i = 0;i < m_MaskRunRegions.size();++i)
+    {
+        if (currentChunkSize == 0)
+            m_MaskRunChunkStarts.push_back(i);
+
+        currentChunkSize += m_MaskRunRegions[i].GetSize(0);
+        if (currentChunkSize >= chunkTargetSize)
+            currentChunkSize = 0;
+    }
+
+    m_MaskRunChunkStarts.push_back(m_MaskRunRegions.size());
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+MaskedImageToImageFilter < TInputImage, TOutputImage >
+::ThreadProcessSlices()
+{
+    if ((!m_CompactedMaskExecution) || (m_MaskRunChunkStarts.size() == 0))
+    {
+        Superclass::ThreadProcessSlices();
+        return;
+    }
+
+    unsigned int numChunks = m_MaskRunChunkStarts.size() - 1;
+    while (true)
+    {
+        unsigned int chunkPosition = m_NextMaskRunChunk++;
+        if (chunkPosition >= numChunks)
+            break;
+
+        unsigned int firstRun = m_MaskRunChunkStarts[chunkPosition];
+        unsigned int numRuns = m_MaskRunChunkStarts[chunkPosition + 1] - firstRun;
+        this->GenerateDataOnMaskRuns(m_MaskRunRegions.data() + firstRun,numRuns);
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+MaskedImageToImageFilter < TInputImage, TOutputImage >
+::GenerateDataOnMaskRuns(const OutputImageRegionType *runRegions, unsigned int numRuns)
+{
+    for (unsigned int i = 0;i < numRuns;++i)
+        this->DynamicThreadedGenerateData(runRegions[i]);
+}
+
 } // end namespace anima
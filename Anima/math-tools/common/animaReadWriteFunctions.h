@@ -3,6 +3,8 @@
 #include <itkImageFileReader.h>
 #include <itkImageFileWriter.h>
 #include <itkExtractImageFilter.h>
+#include <itkImageSource.h>
+#include <itkImageIOFactory.h>
 
 namespace anima
 {
@@ -36,6 +38,37 @@ writeImage(std::string filename, OutputImageType* img)
     writer->Update();
 }
 
+/**
+ * Write the output of an image source uncompressed, generated slice by slice if the image IO of the file is able to
+ * stream its writing (e.g. MetaImage .mha). Other formats such as NRRD cannot, the whole image is then generated
+ */
+template <class OutputImageType>
+void
+writeStreamedImage(std::string filename, itk::ImageSource <OutputImageType> *source)
+{
+    typedef itk::ImageFileWriter<OutputImageType> WriterType;
+    typename WriterType::Pointer writer = WriterType::New();
+    writer->SetUseCompression(false);
+    writer->SetFileName(filename);
+    writer->SetInput(source->GetOutput());
+
+    itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(filename.c_str(), itk::IOFileModeEnum::WriteMode);
+    if (imageIO)
+    {
+        imageIO->SetUseCompression(false);
+        writer->SetImageIO(imageIO);
+    }
+
+    if (imageIO && imageIO->CanStreamWrite())
+    {
+        source->UpdateOutputInformation();
+        unsigned int lastDimension = OutputImageType::ImageDimension - 1;
+        writer->SetNumberOfStreamDivisions(source->GetOutput()->GetLargestPossibleRegion().GetSize()[lastDimension]);
+    }
+
+    writer->Update();
+}
+
 //! Get a vector of input images from a higher dimensional image
 template <class InputImageType, class OutputImageType>
 std::vector < itk::SmartPointer <OutputImageType> >
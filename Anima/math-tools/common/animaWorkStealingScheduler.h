@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+
+namespace anima
+{
+
+/**
+ * @brief Lock-free dynamic scheduler of an index range [0, N) over a fixed number of workers.
+ * Each worker owns a contiguous range of indexes, from the front of which it claims chunks whose size
+ * decreases with the amount of work left (guided scheduling). When its range is empty, a worker steals
+ * the back half of another worker range. Ranges are packed in one 64 bits atomic per worker, so that
+ * claims and steals are single compare and swap operations, without any mutex.
+ * Worker ids are expected to be in [0, number of workers), e.g. work unit ids of an itk::MultiThreaderBase.
+ */
+class WorkStealingScheduler
+{
+public:
+    WorkStealingScheduler()
+    {
+        m_NumberOfWorkers = 0;
+        m_MinimumChunkSize = 1;
+        m_ChunkDivisor = 8;
+    }
+
+    virtual ~WorkStealingScheduler() {}
+
+    //! Minimal number of indexes claimed at once (except for the last indexes of a range)
+    void SetMinimumChunkSize(unsigned int val) {m_MinimumChunkSize = std::max(val,(unsigned int)1);}
+    unsigned int GetMinimumChunkSize() {return m_MinimumChunkSize;}
+
+    //! Chunks claimed by a worker are the remaining size of its range divided by this value
+    void SetChunkDivisor(unsigned int val) {m_ChunkDivisor = std::max(val,(unsigned int)1);}
+    unsigned int GetChunkDivisor() {return m_ChunkDivisor;}
+
+    unsigned int GetNumberOfWorkers() {return m_NumberOfWorkers;}
+
+    //! Splits [0, numberOfIndexes) evenly between workers. Not thread safe, call before launching workers
+    void Initialize(unsigned int numberOfIndexes, unsigned int numberOfWorkers)
+    {
+        m_NumberOfWorkers = std::max(numberOfWorkers,(unsigned int)1);
+        m_WorkerRanges.reset(new WorkerRange[m_NumberOfWorkers]);
+
+        for (unsigned int i = 0;i < m_NumberOfWorkers;++i)
+        {
+            uint32_t rangeStart = (uint64_t)numberOfIndexes * i / m_NumberOfWorkers;
+            uint32_t rangeEnd = (uint64_t)numberOfIndexes * (i + 1) / m_NumberOfWorkers;
+            m_WorkerRanges[i].Range.store(PackRange(rangeStart,rangeEnd));
+        }
+    }
+
+    /**
+     * Claims the next chunk [startIndex, endIndex) to be processed by a worker, stealing from other
+     * workers if needed. Returns false when there is nothing left to process.
+     */
+    bool GetNextChunk(unsigned int workerId, unsigned int &startIndex, unsigned int &endIndex)
+    {
+        if (m_NumberOfWorkers == 0)
+            return false;
+
+        workerId = workerId % m_NumberOfWorkers;
+
+        if (this->ClaimFromOwnRange(workerId,startIndex,endIndex))
+            return true;
+
+        while (this->StealRange(workerId))
+        {
+            if (this->ClaimFromOwnRange(workerId,startIndex,endIndex))
+                return true;
+        }
+
+        return false;
+    }
+
+private:
+    struct alignas(64) WorkerRange
+    {
+        std::atomic <uint64_t> Range;
+    };
+
+    static uint64_t PackRange(uint32_t rangeStart, uint32_t rangeEnd)
+    {
+        return ((uint64_t)rangeStart << 32) | rangeEnd;
+    }
+
+    static void UnpackRange(uint64_t range, uint32_t &rangeStart, uint32_t &rangeEnd)
+    {
+        rangeStart = (uint32_t)(range >> 32);
+        rangeEnd = (uint32_t)(range & 0xFFFFFFFF);
+    }
+
+    bool ClaimFromOwnRange(unsigned int workerId, unsigned int &startIndex, unsigned int &endIndex)
+    {
+        std::atomic <uint64_t> &ownRange = m_WorkerRanges[workerId].Range;
+        uint64_t currentRange = ownRange.load();
+
+        while (true)
+        {
+            uint32_t rangeStart, rangeEnd;
+            UnpackRange(currentRange,rangeStart,rangeEnd);
+
+            if (rangeStart >= rangeEnd)
+                return false;
+
+            uint32_t chunkSize = std::max((rangeEnd - rangeStart) / m_ChunkDivisor,m_MinimumChunkSize);
+            uint32_t chunkEnd = std::min(rangeEnd,rangeStart + chunkSize);
+
+            if (ownRange.compare_exchange_weak(currentRange,PackRange(chunkEnd,rangeEnd)))
+            {
+                startIndex = rangeStart;
+                endIndex = chunkEnd;
+                return true;
+            }
+        }
+    }
+
+    /**
+     * Moves the back half of the first non empty range of another worker into the (empty) worker range.
+     * The victim range is shrunk by a compare and swap, so that the stolen indexes cannot be claimed by its
+     * owner anymore, and the own range is then replaced by a compare and swap against its empty value.
+     */
+    bool StealRange(unsigned int workerId)
+    {
+        std::atomic <uint64_t> &ownRange = m_WorkerRanges[workerId].Range;
+
+        for (unsigned int i = 1;i < m_NumberOfWorkers;++i)
+        {
+            unsigned int victimId = (workerId + i) % m_NumberOfWorkers;
+            std::atomic <uint64_t> &victimRange = m_WorkerRanges[victimId].Range;
+            uint64_t currentRange = victimRange.load();
+
+            while (true)
+            {
+                uint32_t rangeStart, rangeEnd;
+                UnpackRange(currentRange,rangeStart,rangeEnd);
+
+                if (rangeStart >= rangeEnd)
+                    break;
+
+                uint32_t splitIndex = rangeStart + (rangeEnd - rangeStart) / 2;
+                if (!victimRange.compare_exchange_weak(currentRange,PackRange(rangeStart,splitIndex)))
+                    continue;
+
+                // Other workers never modify an empty range: the exchange only fails spuriously
+                uint64_t emptyRange = ownRange.load();
+                while (!ownRange.compare_exchange_weak(emptyRange,PackRange(splitIndex,rangeEnd)));
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    unsigned int m_NumberOfWorkers;
+    unsigned int m_MinimumChunkSize;
+    unsigned int m_ChunkDivisor;
+
+    std::unique_ptr <WorkerRange[]> m_WorkerRanges;
+};
+
+} // end namespace anima
@@ -0,0 +1,122 @@
+#include <animaTRKFiberStreamReader.h>
+
+#include <itkMacro.h>
+
+namespace anima
+{
+
+TRKFiberStreamReader::TRKFiberStreamReader()
+{
+    m_FileName = "";
+    m_MaximalNumberOfFibersPerChunk = 100000;
+    m_NumberOfReadFibers = 0;
+
+    for (unsigned int i = 0;i < 3;++i)
+    {
+        for (unsigned int j = 0;j < 4;++j)
+            m_VoxToRAS[i][j] = (i == j);
+    }
+}
+
+void TRKFiberStreamReader::Open()
+{
+    this->Close();
+
+    // Large stream buffer so that fibers are read in big blocks from the disk
+    m_StreamBuffer.resize(1 << 23);
+    m_InputFile.rdbuf()->pubsetbuf(m_StreamBuffer.data(),m_StreamBuffer.size());
+
+    m_InputFile.open(m_FileName,std::ios::binary);
+    if (!m_InputFile.is_open())
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Unable to open file " + m_FileName,ITK_LOCATION);
+
+    m_InputFile.read((char *) &m_Header, sizeof(anima::TRKHeaderStructure));
+    if (!m_InputFile)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Unable to read TRK header from " + m_FileName,ITK_LOCATION);
+
+    if (m_Header.version != 2)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"TRK reader only supports version 2",ITK_LOCATION);
+
+    for (unsigned int i = 0;i < 3;++i)
+    {
+        for (unsigned int j = 0;j < 4;++j)
+            m_VoxToRAS[i][j] = m_Header.vox_to_ras[i][j];
+    }
+
+    m_NumberOfReadFibers = 0;
+}
+
+void TRKFiberStreamReader::Close()
+{
+    if (m_InputFile.is_open())
+        m_InputFile.close();
+
+    m_InputFile.clear();
+}
+
+bool TRKFiberStreamReader::ReadNextChunk(TRKFiberChunk &chunk)
+{
+    chunk.FiberOffsets.assign(1,0);
+    chunk.Points.clear();
+    chunk.PointScalars.clear();
+    chunk.FiberProperties.clear();
+    m_RawPointValues.clear();
+
+    if (!m_InputFile.is_open())
+        return false;
+
+    unsigned int numScalars = m_Header.n_scalars;
+    unsigned int numProperties = m_Header.n_properties;
+    unsigned int pointSize = 3 + numScalars;
+
+    while (chunk.GetNumberOfFibers() < m_MaximalNumberOfFibersPerChunk)
+    {
+        if ((m_Header.n_count > 0) && (m_NumberOfReadFibers >= (unsigned int)m_Header.n_count))
+            break;
+
+        int npts;
+        if (!m_InputFile.read((char *) &npts, sizeof(int)))
+            break;
+
+        if (npts < 0)
+            throw itk::ExceptionObject(__FILE__, __LINE__,"Negative fiber size in " + m_FileName,ITK_LOCATION);
+
+        std::size_t previousSize = m_RawPointValues.size();
+        m_RawPointValues.resize(previousSize + npts * pointSize);
+        m_InputFile.read((char *) (m_RawPointValues.data() + previousSize), npts * pointSize * sizeof(float));
+
+        previousSize = chunk.FiberProperties.size();
+        chunk.FiberProperties.resize(previousSize + numProperties);
+        m_InputFile.read((char *) (chunk.FiberProperties.data() + previousSize), numProperties * sizeof(float));
+
+        if (!m_InputFile)
+            throw itk::ExceptionObject(__FILE__, __LINE__,"Truncated TRK file " + m_FileName,ITK_LOCATION);
+
+        chunk.FiberOffsets.push_back(chunk.FiberOffsets.back() + npts);
+        ++m_NumberOfReadFibers;
+    }
+
+    // Bulk conversion of the whole chunk to RAS coordinates
+    unsigned int numPoints = chunk.GetNumberOfPoints();
+    chunk.Points.resize(3 * numPoints);
+    chunk.PointScalars.resize(numScalars * numPoints);
+
+    for (unsigned int i = 0;i < numPoints;++i)
+    {
+        const float *rawValues = m_RawPointValues.data() + i * pointSize;
+        double *pointValues = chunk.Points.data() + 3 * i;
+
+        for (unsigned int k = 0;k < 3;++k)
+        {
+            pointValues[k] = m_VoxToRAS[k][3] + m_VoxToRAS[k][0] * rawValues[0]
+                    + m_VoxToRAS[k][1] * rawValues[1] + m_VoxToRAS[k][2] * rawValues[2];
+        }
+
+        for (unsigned int k = 0;k < numScalars;++k)
+            chunk.PointScalars[i * numScalars + k] = rawValues[3 + k];
+    }
+
+    return chunk.GetNumberOfFibers() > 0;
+}
+
+} // end namespace anima
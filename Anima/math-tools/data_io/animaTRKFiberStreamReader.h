@@ -0,0 +1,74 @@
+#pragma once
+
+#include <AnimaDataIOExport.h>
+#include <animaTRKHeaderStructure.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace anima
+{
+
+/**
+ * @brief Chunk of fibers read from a TRK file. Fiber i spans points [FiberOffsets[i], FiberOffsets[i+1]).
+ * Points are stored as contiguous (x,y,z) RAS coordinates, point scalars and fiber properties are interleaved
+ * (number of scalars values per point, number of properties values per fiber).
+ */
+struct TRKFiberChunk
+{
+    std::vector <unsigned int> FiberOffsets;
+    std::vector <double> Points;
+    std::vector <float> PointScalars;
+    std::vector <float> FiberProperties;
+
+    unsigned int GetNumberOfFibers() const {return (FiberOffsets.size() > 0) ? FiberOffsets.size() - 1 : 0;}
+    unsigned int GetNumberOfPoints() const {return (FiberOffsets.size() > 0) ? FiberOffsets.back() : 0;}
+};
+
+/**
+ * @brief Streaming reader of TRK files. Fibers are read chunk by chunk (one bulk read per fiber through a large
+ * stream buffer), and their coordinates converted to RAS for the whole chunk at once. This allows processing
+ * tractograms that do not fit in memory as a single vtkPolyData.
+ */
+class ANIMADATAIO_EXPORT TRKFiberStreamReader
+{
+public:
+    TRKFiberStreamReader();
+    ~TRKFiberStreamReader() {}
+
+    void SetFileName(const std::string &name) {m_FileName = name;}
+
+    //! Maximal number of fibers returned by each call to ReadNextChunk
+    void SetMaximalNumberOfFibersPerChunk(unsigned int val) {m_MaximalNumberOfFibersPerChunk = (val > 0) ? val : 1;}
+
+    //! Opens the file and reads its header, throws an itk::ExceptionObject on error
+    void Open();
+    void Close();
+
+    const TRKHeaderStructure &GetHeader() const {return m_Header;}
+    unsigned int GetNumberOfScalars() const {return m_Header.n_scalars;}
+    unsigned int GetNumberOfProperties() const {return m_Header.n_properties;}
+
+    //! Number of fibers stored in the header, 0 if unknown
+    unsigned int GetNumberOfFibers() const {return (m_Header.n_count > 0) ? m_Header.n_count : 0;}
+
+    //! Reads the next fibers into chunk, returns false when no fiber is left
+    bool ReadNextChunk(TRKFiberChunk &chunk);
+
+private:
+    std::string m_FileName;
+    std::ifstream m_InputFile;
+    std::vector <char> m_StreamBuffer;
+
+    TRKHeaderStructure m_Header;
+    double m_VoxToRAS[3][4];
+
+    unsigned int m_MaximalNumberOfFibersPerChunk;
+    unsigned int m_NumberOfReadFibers;
+
+    // Raw (x,y,z,scalars) values of the current chunk as stored in the file
+    std::vector <float> m_RawPointValues;
+};
+
+} // end namespace anima
@@ -1,104 +1,133 @@
 #include <animaTRKReader.h>
-#include <animaTRKHeaderStructure.h>
-#include <vnl_matrix.h>
-#include <fstream>
+#include <animaTRKFiberStreamReader.h>
+#include <algorithm>
 
 #include <vtkPoints.h>
+#include <vtkCellArray.h>
 #include <vtkPointData.h>
 #include <vtkCellData.h>
 #include <vtkDoubleArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
 
 #include <itkMacro.h>
 
 namespace anima
 {
 
-void TRKReader::Update()
+//! Sets the number of tuples of an array, growing its capacity geometrically so that chunk appends stay linear
+static void growNumberOfTuples(vtkDataArray *array, vtkIdType numTuples)
 {
-    anima::TRKHeaderStructure headerStr;
+    if (numTuples * array->GetNumberOfComponents() > array->GetSize())
+        array->Resize(std::max(numTuples,2 * array->GetNumberOfTuples()));
 
-    std::ifstream inFile(m_FileName,std::ios::binary);
-    if (!inFile.is_open())
-        throw itk::ExceptionObject(__FILE__, __LINE__,"Unable to open file " + m_FileName,ITK_LOCATION);
+    array->SetNumberOfTuples(numTuples);
+}
 
-    inFile.read((char *) &headerStr, sizeof(anima::TRKHeaderStructure));
+void TRKReader::Update()
+{
+    anima::TRKFiberStreamReader streamReader;
+    streamReader.SetFileName(m_FileName);
+    streamReader.Open();
 
-    if (headerStr.version != 2)
-        throw itk::ExceptionObject(__FILE__, __LINE__,"TRK reader only supports version 2",ITK_LOCATION);
+    const anima::TRKHeaderStructure &headerStr = streamReader.GetHeader();
+    unsigned int numScalars = streamReader.GetNumberOfScalars();
+    unsigned int numProperties = streamReader.GetNumberOfProperties();
 
-    // Now create polydata and fill it
-    m_OutputData = vtkSmartPointer <vtkPolyData>::New();
-    m_OutputData->Initialize();
-    m_OutputData->Allocate();
+    // Points and cells are filled chunk by chunk directly in VTK buffers, points are stored as float as in TRK files
+    vtkSmartPointer <vtkFloatArray> pointsData = vtkSmartPointer <vtkFloatArray>::New();
+    pointsData->SetNumberOfComponents(3);
+    vtkSmartPointer <vtkIdTypeArray> cellsData = vtkSmartPointer <vtkIdTypeArray>::New();
 
-    vtkSmartPointer <vtkPoints> myPoints = vtkSmartPointer <vtkPoints>::New();
-    std::vector < vtkSmartPointer <vtkDoubleArray> > scalarArrays(headerStr.n_scalars);
-    for (unsigned int i = 0;i < headerStr.n_scalars;++i)
+    std::vector < vtkSmartPointer <vtkDoubleArray> > scalarArrays(numScalars);
+    for (unsigned int i = 0;i < numScalars;++i)
     {
         scalarArrays[i] = vtkSmartPointer <vtkDoubleArray>::New();
         scalarArrays[i]->SetNumberOfComponents(1);
         scalarArrays[i]->SetName(headerStr.scalar_name[i]);
     }
 
-    std::vector < vtkSmartPointer <vtkDoubleArray> > cellArrays(headerStr.n_properties);
-    for (unsigned int i = 0;i < headerStr.n_properties;++i)
+    std::vector < vtkSmartPointer <vtkDoubleArray> > cellArrays(numProperties);
+    for (unsigned int i = 0;i < numProperties;++i)
     {
         cellArrays[i] = vtkSmartPointer <vtkDoubleArray>::New();
         cellArrays[i]->SetNumberOfComponents(1);
         cellArrays[i]->SetName(headerStr.property_name[i]);
     }
 
-    unsigned int nCells = headerStr.n_count;
-    std::vector <float> pointValues(3 + headerStr.n_scalars);
-    std::vector <float> cellScalars(headerStr.n_properties);
-    vnl_matrix <double> vox_to_ras(4,4);
-    for (unsigned int i = 0;i < 4;++i)
+    if (streamReader.GetNumberOfFibers() > 0)
     {
-        for (unsigned int j = 0;j < 4;++j)
-            vox_to_ras(i,j) = headerStr.vox_to_ras[i][j];
+        for (unsigned int i = 0;i < numProperties;++i)
+            cellArrays[i]->Allocate(streamReader.GetNumberOfFibers());
     }
 
-    for (unsigned int i = 0;i < nCells;++i)
+    vtkIdType numPoints = 0;
+    vtkIdType numCells = 0;
+    anima::TRKFiberChunk chunk;
+    while (streamReader.ReadNextChunk(chunk))
     {
-        int npts;
-        inFile.read((char *) &npts, sizeof(int));
+        vtkIdType chunkPoints = chunk.GetNumberOfPoints();
+        vtkIdType chunkCells = chunk.GetNumberOfFibers();
+
+        growNumberOfTuples(pointsData,numPoints + chunkPoints);
+        std::copy(chunk.Points.begin(),chunk.Points.end(),pointsData->GetPointer(3 * numPoints));
 
-        vtkIdType* ids = new vtkIdType[npts];
+        for (unsigned int k = 0;k < numScalars;++k)
+        {
+            growNumberOfTuples(scalarArrays[k],numPoints + chunkPoints);
+            double *scalarPtr = scalarArrays[k]->GetPointer(numPoints);
+            for (vtkIdType j = 0;j < chunkPoints;++j)
+                scalarPtr[j] = chunk.PointScalars[j * numScalars + k];
+        }
 
-        for (unsigned int j = 0;j < npts;++j)
+        for (unsigned int k = 0;k < numProperties;++k)
         {
-            inFile.read((char *) pointValues.data(), (3 + headerStr.n_scalars) * sizeof(float));
-
-            double xValue = vox_to_ras(0,3);
-            double yValue = vox_to_ras(1,3);
-            double zValue = vox_to_ras(2,3);
-
-            for (unsigned int k = 0;k < 3;++k)
-            {
-                xValue += vox_to_ras(0,k) * pointValues[k];
-                yValue += vox_to_ras(1,k) * pointValues[k];
-                zValue += vox_to_ras(2,k) * pointValues[k];
-            }
-
-            ids[j] = myPoints->InsertNextPoint(xValue, yValue, zValue);
-            for (unsigned int k = 0;k < headerStr.n_scalars;++k)
-                scalarArrays[k]->InsertNextValue(pointValues[3 + k]);
+            for (vtkIdType j = 0;j < chunkCells;++j)
+                cellArrays[k]->InsertNextValue(chunk.FiberProperties[j * numProperties + k]);
         }
 
-        inFile.read((char *) cellScalars.data(), headerStr.n_properties * sizeof(float));
-        for (unsigned int k = 0;k < headerStr.n_properties;++k)
-            cellArrays[k]->InsertNextValue(cellScalars[k]);
+        // Legacy cell array layout: (npts, id_0, ..., id_npts-1) for each fiber
+        vtkIdType cellsDataSize = cellsData->GetNumberOfTuples();
+        growNumberOfTuples(cellsData,cellsDataSize + chunkCells + chunkPoints);
+        vtkIdType *cellsPtr = cellsData->GetPointer(cellsDataSize);
+        for (vtkIdType j = 0;j < chunkCells;++j)
+        {
+            vtkIdType npts = chunk.FiberOffsets[j + 1] - chunk.FiberOffsets[j];
+            *cellsPtr = npts;
+            ++cellsPtr;
+
+            for (vtkIdType k = 0;k < npts;++k)
+                cellsPtr[k] = numPoints + chunk.FiberOffsets[j] + k;
+            cellsPtr += npts;
+        }
 
-        m_OutputData->InsertNextCell (VTK_POLY_LINE, npts, ids);
-        delete[] ids;
+        numPoints += chunkPoints;
+        numCells += chunkCells;
     }
 
-    inFile.close();
+    streamReader.Close();
 
+    // Release the extra capacity left by geometric growth
+    pointsData->Squeeze();
+    cellsData->Squeeze();
+    for (unsigned int k = 0;k < numScalars;++k)
+        scalarArrays[k]->Squeeze();
+
+    // Now create polydata and fill it
+    vtkSmartPointer <vtkPoints> myPoints = vtkSmartPointer <vtkPoints>::New();
+    myPoints->SetData(pointsData);
+
+    vtkSmartPointer <vtkCellArray> myCells = vtkSmartPointer <vtkCellArray>::New();
+    myCells->SetCells(numCells, cellsData);
+
+    m_OutputData = vtkSmartPointer <vtkPolyData>::New();
+    m_OutputData->Initialize();
     m_OutputData->SetPoints(myPoints);
-    for (unsigned int k = 0;k < headerStr.n_scalars;++k)
+    m_OutputData->SetLines(myCells);
+
+    for (unsigned int k = 0;k < numScalars;++k)
         m_OutputData->GetPointData()->AddArray(scalarArrays[k]);
-    for (unsigned int k = 0;k < headerStr.n_properties;++k)
+    for (unsigned int k = 0;k < numProperties;++k)
         m_OutputData->GetCellData()->AddArray(cellArrays[k]);
 }
 
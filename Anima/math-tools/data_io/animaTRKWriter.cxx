@@ -5,6 +5,8 @@
 #include <vtkPointData.h>
 #include <vtkCellData.h>
 #include <vtkDoubleArray.h>
+#include <vtkIdList.h>
+#include <vtkPoints.h>
 
 #include <itkSpatialOrientationAdapter.h>
 
@@ -142,7 +144,8 @@ void TRKWriter::Update()
 
     // handle individual tracks now : transform and store
     std::vector <float> cellData;
-    std::vector <float> cellScalars(numPropertyFields);
+    std::vector <double> cellPoints;
+    std::vector <float> cellScalars(headerStr.n_properties);
     vnl_matrix <double> directionMatrix(4,4);
 
     for (unsigned int i = 0;i < 4;++i)
@@ -153,35 +156,47 @@ void TRKWriter::Update()
 
     directionMatrix = vnl_matrix_inverse<double>(directionMatrix).inverse();
 
+    unsigned int pointSize = 3 + headerStr.n_scalars;
+    vtkPoints *trackPoints = m_TrackData->GetPoints();
+    vtkSmartPointer <vtkIdList> cellPointIds = vtkSmartPointer <vtkIdList>::New();
+
     for (unsigned int i = 0;i < headerStr.n_count;++i)
     {
-        int cellSize = m_TrackData->GetCell(i)->GetNumberOfPoints();
-        outFile.write((char *) &cellSize, sizeof(int));
+        m_TrackData->GetCellPoints(i,cellPointIds);
+        int cellSize = cellPointIds->GetNumberOfIds();
 
-        cellData.resize(3 + headerStr.n_scalars);
-        for (unsigned int j = 0;j < cellSize;++j)
+        // Gather the fiber points, then transform and write them at once
+        cellPoints.resize(3 * cellSize);
+        for (int j = 0;j < cellSize;++j)
+            trackPoints->GetPoint(cellPointIds->GetId(j),cellPoints.data() + 3 * j);
+
+        cellData.resize(pointSize * cellSize);
+        for (int j = 0;j < cellSize;++j)
         {
-            vtkIdType idPoint = m_TrackData->GetCell(i)->GetPointId(j);
-            double *point = m_TrackData->GetPoint(m_TrackData->GetCell(i)->GetPointId(j));
+            const double *point = cellPoints.data() + 3 * j;
+            float *pointData = cellData.data() + pointSize * j;
             for (unsigned int k = 0;k < 3;++k)
             {
-                cellData[k] = directionMatrix(k,3);
-                for (unsigned int l = 0;l < 3;++l)
-                    cellData[k] += directionMatrix(k,l) * point[l];
+                pointData[k] = directionMatrix(k,3) + directionMatrix(k,0) * point[0]
+                        + directionMatrix(k,1) * point[1] + directionMatrix(k,2) * point[2];
             }
+        }
 
-                for (unsigned int k = 0;k < numScalarFields;++k)
-                    cellData[k + 3] = scalarArrays[k]->GetValue(idPoint);
-
-                outFile.write((char *) cellData.data(), (numScalarFields + 3) * sizeof(float));
+        for (unsigned int k = 0;k < headerStr.n_scalars;++k)
+        {
+            for (int j = 0;j < cellSize;++j)
+                cellData[pointSize * j + 3 + k] = scalarArrays[k]->GetValue(cellPointIds->GetId(j));
         }
 
-        if (numPropertyFields > 0)
+        outFile.write((char *) &cellSize, sizeof(int));
+        outFile.write((char *) cellData.data(), cellData.size() * sizeof(float));
+
+        if (headerStr.n_properties > 0)
         {
-            for (unsigned int j = 0;j < numPropertyFields;++j)
+            for (unsigned int j = 0;j < headerStr.n_properties;++j)
                 cellScalars[j] = propertyArrays[j]->GetValue(i);
 
-            outFile.write((char *) cellScalars.data(), numPropertyFields * sizeof(float));
+            outFile.write((char *) cellScalars.data(), headerStr.n_properties * sizeof(float));
         }
     }
 
@@ -13,6 +13,30 @@ double BaseCompartment::GetPredictedSignal(double smallDelta, double bigDelta, d
     return std::abs(ftDiffusionProfile);
 }
 
+void BaseCompartment::GetFourierTransformedDiffusionProfiles(const AcquisitionSchemeType &scheme, ListType &signals)
+{
+    unsigned int numValues = scheme.GetNumberOfValues();
+    signals.resize(numValues);
+
+    for (unsigned int i = 0;i < numValues;++i)
+        signals[i] = this->GetFourierTransformedDiffusionProfile(scheme.GetSmallDelta(), scheme.GetBigDelta(),
+                                                                 scheme.GetGradientStrengths()[i], scheme.GetGradients()[i]);
+}
+
+void BaseCompartment::GetSignalAttenuationJacobians(const AcquisitionSchemeType &scheme, JacobianMatrixType &jacobians)
+{
+    unsigned int numValues = scheme.GetNumberOfValues();
+    jacobians.set_size(numValues,this->GetNumberOfParameters());
+
+    for (unsigned int i = 0;i < numValues;++i)
+    {
+        ListType &jacobianVector = this->GetSignalAttenuationJacobian(scheme.GetSmallDelta(), scheme.GetBigDelta(),
+                                                                      scheme.GetGradientStrengths()[i], scheme.GetGradients()[i]);
+        for (unsigned int j = 0;j < jacobianVector.size();++j)
+            jacobians.put(i,j,jacobianVector[j]);
+    }
+}
+
 bool BaseCompartment::IsEqual(Self *rhs, double tolerance, double absoluteTolerance)
 {
     if (this->GetTensorCompatible() && rhs->GetTensorCompatible())
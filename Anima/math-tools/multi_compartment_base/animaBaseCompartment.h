@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <vnl/vnl_vector_fixed.h>
+#include <vnl/vnl_matrix.h>
 #include <itkMatrix.h>
 #include <itkLightObject.h>
 #include <itkObjectFactory.h>
@@ -9,6 +10,7 @@
 
 #include <AnimaMCMBaseExport.h>
 #include <animaMCMConstants.h>
+#include <animaMCMAcquisitionScheme.h>
 
 namespace anima
 {
@@ -46,9 +48,18 @@ public:
     typedef vnl_vector_fixed <double,3> Vector3DType;
     typedef std::vector <double> ListType;
     typedef itk::VariableLengthVector <double> ModelOutputVectorType;
+    typedef anima::MCMAcquisitionScheme AcquisitionSchemeType;
+    typedef vnl_matrix <double> JacobianMatrixType;
 
     virtual double GetFourierTransformedDiffusionProfile(double smallDelta, double bigDelta, double gradientStrength, const Vector3DType &gradient) = 0;
     virtual ListType &GetSignalAttenuationJacobian(double smallDelta, double bigDelta, double gradientStrength, const Vector3DType &gradient) = 0;
+
+    //! Signal attenuations for all values of an acquisition scheme. Default implementation calls GetFourierTransformedDiffusionProfile for each value
+    virtual void GetFourierTransformedDiffusionProfiles(const AcquisitionSchemeType &scheme, ListType &signals);
+
+    //! Jacobians for all values of an acquisition scheme (one row per value). Default implementation calls GetSignalAttenuationJacobian for each value
+    virtual void GetSignalAttenuationJacobians(const AcquisitionSchemeType &scheme, JacobianMatrixType &jacobians);
+
     virtual double GetLogDiffusionProfile(const Vector3DType &sample) = 0;
 
     //! Various methods for optimization parameters setting and getting
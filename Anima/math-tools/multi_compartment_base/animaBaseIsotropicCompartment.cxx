@@ -26,6 +26,31 @@ BaseCompartment::ListType &BaseIsotropicCompartment::GetSignalAttenuationJacobia
     return m_JacobianVector;
 }
     
+void BaseIsotropicCompartment::GetFourierTransformedDiffusionProfiles(const AcquisitionSchemeType &scheme, ListType &signals)
+{
+    unsigned int numValues = scheme.GetNumberOfValues();
+    signals.resize(numValues);
+
+    const double *bValues = scheme.GetBValues().data();
+    double diffusivity = this->GetAxialDiffusivity();
+    for (unsigned int i = 0;i < numValues;++i)
+        signals[i] = std::exp(- bValues[i] * diffusivity);
+}
+
+void BaseIsotropicCompartment::GetSignalAttenuationJacobians(const AcquisitionSchemeType &scheme, JacobianMatrixType &jacobians)
+{
+    unsigned int numValues = scheme.GetNumberOfValues();
+    jacobians.set_size(numValues,this->GetNumberOfParameters());
+
+    if (jacobians.cols() == 0)
+        return;
+
+    const double *bValues = scheme.GetBValues().data();
+    double diffusivity = this->GetAxialDiffusivity();
+    for (unsigned int i = 0;i < numValues;++i)
+        jacobians.put(i,0,- bValues[i] * std::exp(- bValues[i] * diffusivity));
+}
+
 double BaseIsotropicCompartment::GetLogDiffusionProfile(const Vector3DType &sample)
 {
     double resVal = - 1.5 * std::log(2.0 * M_PI * this->GetAxialDiffusivity());
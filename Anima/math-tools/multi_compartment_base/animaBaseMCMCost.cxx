@@ -10,6 +10,19 @@ BaseMCMCost::BaseMCMCost()
 
     m_SmallDelta = anima::DiffusionSmallDelta;
     m_BigDelta = anima::DiffusionBigDelta;
+
+    m_ModifiedAcquisitionScheme = true;
+}
+
+const BaseMCMCost::AcquisitionSchemeType &BaseMCMCost::GetAcquisitionScheme()
+{
+    if (m_ModifiedAcquisitionScheme)
+    {
+        m_AcquisitionScheme.Initialize(m_SmallDelta,m_BigDelta,m_GradientStrengths,m_Gradients);
+        m_ModifiedAcquisitionScheme = false;
+    }
+
+    return m_AcquisitionScheme;
 }
 
 } // end namespace anima
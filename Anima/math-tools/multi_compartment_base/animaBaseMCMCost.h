@@ -5,6 +5,7 @@
 #include <itkOptimizerParameters.h>
 
 #include <animaMultiCompartmentModel.h>
+#include <animaMCMAcquisitionScheme.h>
 #include <AnimaMCMBaseExport.h>
 
 namespace anima
@@ -34,10 +35,11 @@ public:
     typedef MCMType::Pointer MCMPointer;
     typedef MCMType::Vector3DType Vector3DType;
     typedef MCMType::ListType ListType;
+    typedef anima::MCMAcquisitionScheme AcquisitionSchemeType;
 
     void SetObservedSignals(ListType &value) {m_ObservedSignals = value;}
-    void SetGradients(std::vector<Vector3DType> &value) {m_Gradients = value;}
-    void SetGradientStrengths(ListType &value) {m_GradientStrengths = value;}
+    void SetGradients(std::vector<Vector3DType> &value) {m_Gradients = value; m_ModifiedAcquisitionScheme = true;}
+    void SetGradientStrengths(ListType &value) {m_GradientStrengths = value; m_ModifiedAcquisitionScheme = true;}
 
     void SetMCMStructure(MCMType *model) {m_MCMStructure = model;}
     MCMPointer &GetMCMStructure() {return m_MCMStructure;}
@@ -70,13 +72,16 @@ public:
 
     virtual double GetSigmaSquare() {return m_SigmaSquare;}
 
-    void SetSmallDelta(double val) {m_SmallDelta = val;}
-    void SetBigDelta(double val) {m_BigDelta = val;}
+    void SetSmallDelta(double val) {m_SmallDelta = val; m_ModifiedAcquisitionScheme = true;}
+    void SetBigDelta(double val) {m_BigDelta = val; m_ModifiedAcquisitionScheme = true;}
 
 protected:
     BaseMCMCost();
     virtual ~BaseMCMCost() {}
 
+    //! Acquisition scheme for batched compartment evaluations, rebuilt only when gradients or timings changed
+    const AcquisitionSchemeType &GetAcquisitionScheme();
+
     double m_SigmaSquare;
     std::vector <double> m_PredictedSignals;
 
@@ -89,6 +94,9 @@ protected:
     double m_BigDelta;
     ListType m_GradientStrengths;
 
+    AcquisitionSchemeType m_AcquisitionScheme;
+    bool m_ModifiedAcquisitionScheme;
+
     MCMPointer m_MCMStructure;
 
 private:
@@ -0,0 +1,39 @@
+#include <animaMCMAcquisitionScheme.h>
+#include <animaMCMConstants.h>
+
+#include <itkMacro.h>
+
+namespace anima
+{
+
+MCMAcquisitionScheme::MCMAcquisitionScheme()
+{
+    m_SmallDelta = anima::DiffusionSmallDelta;
+    m_BigDelta = anima::DiffusionBigDelta;
+}
+
+void MCMAcquisitionScheme::Initialize(double smallDelta, double bigDelta, const std::vector <double> &gradientStrengths,
+                                      const std::vector <Vector3DType> &gradients)
+{
+    if (gradientStrengths.size() != gradients.size())
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Gradient strengths and directions should have the same size",ITK_LOCATION);
+
+    m_SmallDelta = smallDelta;
+    m_BigDelta = bigDelta;
+    m_GradientStrengths = gradientStrengths;
+    m_Gradients = gradients;
+
+    unsigned int numValues = gradients.size();
+    m_BValues.resize(numValues);
+    for (unsigned int j = 0;j < 3;++j)
+        m_GradientCoordinates[j].resize(numValues);
+
+    for (unsigned int i = 0;i < numValues;++i)
+    {
+        m_BValues[i] = anima::GetBValueFromAcquisitionParameters(smallDelta, bigDelta, gradientStrengths[i]);
+        for (unsigned int j = 0;j < 3;++j)
+            m_GradientCoordinates[j][i] = gradients[i][j];
+    }
+}
+
+} // end namespace anima
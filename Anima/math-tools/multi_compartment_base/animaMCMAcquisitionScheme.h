@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <vnl/vnl_vector_fixed.h>
+
+#include <AnimaMCMBaseExport.h>
+
+namespace anima
+{
+
+/**
+ * @brief Diffusion acquisition scheme stored as separate arrays (b-values and gradient coordinates),
+ * used by batched compartment signal evaluations. The original gradient strengths and directions are kept
+ * for per-gradient evaluations.
+ */
+class ANIMAMCMBASE_EXPORT MCMAcquisitionScheme
+{
+public:
+    typedef vnl_vector_fixed <double,3> Vector3DType;
+
+    MCMAcquisitionScheme();
+    ~MCMAcquisitionScheme() {}
+
+    //! Computes b-values and splits gradient coordinates
+    void Initialize(double smallDelta, double bigDelta, const std::vector <double> &gradientStrengths,
+                    const std::vector <Vector3DType> &gradients);
+
+    unsigned int GetNumberOfValues() const {return m_BValues.size();}
+
+    double GetSmallDelta() const {return m_SmallDelta;}
+    double GetBigDelta() const {return m_BigDelta;}
+
+    const std::vector <double> &GetBValues() const {return m_BValues;}
+    //! Coordinate dim (0, 1 or 2) of all gradient directions
+    const std::vector <double> &GetGradientCoordinates(unsigned int dim) const {return m_GradientCoordinates[dim];}
+
+    const std::vector <double> &GetGradientStrengths() const {return m_GradientStrengths;}
+    const std::vector <Vector3DType> &GetGradients() const {return m_Gradients;}
+
+private:
+    double m_SmallDelta, m_BigDelta;
+    std::vector <double> m_BValues;
+    std::vector <double> m_GradientCoordinates[3];
+
+    std::vector <double> m_GradientStrengths;
+    std::vector <Vector3DType> m_Gradients;
+};
+
+} // end namespace anima
@@ -2,6 +2,7 @@
 
 #include <animaMultiCompartmentModel.h>
 #include <animaMCMImage.h>
+#include <animaInMaskSparseImageSource.h>
 
 namespace anima
 {
@@ -18,16 +19,32 @@ public:
     typedef itk::VectorImage <PixelType, ImageDimension> BaseOutputImageType;
     typedef typename BaseOutputImageType::Pointer BaseOutputImagePointer;
 
+    typedef anima::InMaskSparseImageSource <BaseOutputImageType> SparseInputImageType;
+    typedef typename SparseInputImageType::Pointer SparseInputImagePointer;
+
     MCMFileWriter();
     ~MCMFileWriter();
 
     void SetInputImage(InputImageType *input) {m_InputImage = input;}
+
+    //! Sparse model vectors to write instead of an input image, expanded one weights or compartment image at a time
+    void SetSparseInputImage(SparseInputImageType *input, ModelType *descriptionModel)
+    {
+        m_SparseInputImage = input;
+        m_SparseDescriptionModel = descriptionModel;
+    }
+
     void SetFileName(std::string fileName);
 
     void Update();
 
 private:
+    //! Writes components [firstComponent, firstComponent + numberOfComponents) of the input as a vector image
+    void WriteComponents(std::string fileName, unsigned int firstComponent, unsigned int numberOfComponents);
+
     InputImagePointer m_InputImage;
+    SparseInputImagePointer m_SparseInputImage;
+    ModelPointer m_SparseDescriptionModel;
     std::string m_FileName;
 };
 
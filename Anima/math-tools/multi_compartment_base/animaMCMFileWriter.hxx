@@ -46,10 +46,11 @@ MCMFileWriter <PixelType, ImageDimension>
     if (m_FileName == "")
         throw itk::ExceptionObject(__FILE__, __LINE__,"No filename specified for writing",ITK_LOCATION);
 
-    if (!m_InputImage)
+    if (!m_InputImage && !m_SparseInputImage)
         throw itk::ExceptionObject(__FILE__, __LINE__,"No input file to write",ITK_LOCATION);
 
-    if (!m_InputImage->GetDescriptionModel())
+    ModelPointer descriptionModel = m_SparseInputImage ? m_SparseDescriptionModel : m_InputImage->GetDescriptionModel();
+    if (!descriptionModel)
         throw itk::ExceptionObject(__FILE__, __LINE__,"No reference model provided for writing MCM file",ITK_LOCATION);
 
     std::string noPathName = m_FileName;
@@ -61,6 +62,9 @@ MCMFileWriter <PixelType, ImageDimension>
         noPathName.append(m_FileName.begin() + lastSlashPos + 1,m_FileName.end());
     }
 
+    // Sparse models are expanded while written, which is only done slice by slice by stream writable formats
+    std::string imageExtension = m_SparseInputImage ? ".mha" : ".nrrd";
+
     itk::FileTools::CreateDirectory(m_FileName.c_str());
     std::string headerName = m_FileName + ".mcm";
     std::ofstream outputHeaderFile(headerName.c_str());
@@ -68,46 +72,14 @@ MCMFileWriter <PixelType, ImageDimension>
     outputHeaderFile << "<Model>" << std::endl;
 
     // Output weights image
-    ModelPointer descriptionModel = m_InputImage->GetDescriptionModel();
-
     unsigned int numberOfCompartments = descriptionModel->GetNumberOfCompartments();
-    BaseOutputImagePointer weightsImage = BaseOutputImageType::New();
-    weightsImage->Initialize();
-    weightsImage->SetRegions(m_InputImage->GetLargestPossibleRegion());
-    weightsImage->SetSpacing (m_InputImage->GetSpacing());
-    weightsImage->SetOrigin (m_InputImage->GetOrigin());
-    weightsImage->SetDirection (m_InputImage->GetDirection());
-    weightsImage->SetVectorLength(numberOfCompartments);
-    weightsImage->Allocate();
-
-    typedef itk::ImageRegionIterator <InputImageType> InputImageIteratorType;
-    typedef itk::ImageRegionIterator <BaseOutputImageType> BaseOutputImageIteratorType;
-    typedef typename InputImageType::PixelType VectorType;
-
-    BaseOutputImageIteratorType weightsItr(weightsImage,m_InputImage->GetLargestPossibleRegion());
-    InputImageIteratorType inputItr(m_InputImage,m_InputImage->GetLargestPossibleRegion());
-
-    VectorType tmpWeights(numberOfCompartments);
-    VectorType workVector;
-    while (!weightsItr.IsAtEnd())
-    {
-        workVector = inputItr.Get();
-
-        for (unsigned int i = 0;i < numberOfCompartments;++i)
-            tmpWeights[i] = workVector[i];
-
-        weightsItr.Set(tmpWeights);
-
-        ++weightsItr;
-        ++inputItr;
-    }
 
     std::string weightsName = m_FileName + "/";
     weightsName += noPathName;
-    weightsName += "_weights.nrrd";
+    weightsName += "_weights" + imageExtension;
 
-    anima::writeImage <BaseOutputImageType> (weightsName,weightsImage);
-    std::string xmlFileNameWeights = noPathName + "_weights.nrrd";
+    this->WriteComponents(weightsName,0,numberOfCompartments);
+    std::string xmlFileNameWeights = noPathName + "_weights" + imageExtension;
 
     outputHeaderFile << "<Weights>" << xmlFileNameWeights << "</Weights>" << std::endl;
 
@@ -160,47 +132,21 @@ MCMFileWriter <PixelType, ImageDimension>
         // Output compartment image
         unsigned int compartmentSize = descriptionModel->GetCompartment(i)->GetCompartmentSize();
 
-        BaseOutputImagePointer compartmentImage = BaseOutputImageType::New();
-        compartmentImage->Initialize();
-        compartmentImage->SetRegions(m_InputImage->GetLargestPossibleRegion());
-        compartmentImage->SetSpacing (m_InputImage->GetSpacing());
-        compartmentImage->SetOrigin (m_InputImage->GetOrigin());
-        compartmentImage->SetDirection (m_InputImage->GetDirection());
-        compartmentImage->SetVectorLength(compartmentSize);
-        compartmentImage->Allocate();
-
-        inputItr.GoToBegin();
-        BaseOutputImageIteratorType compartmentItr(compartmentImage,m_InputImage->GetLargestPossibleRegion());
-
-        VectorType tmpCompartment(compartmentSize);
-        while (!compartmentItr.IsAtEnd())
-        {
-            workVector = inputItr.Get();
-
-            for (unsigned int j = 0;j < compartmentSize;++j)
-                tmpCompartment[j] = workVector[pos + j];
-
-            compartmentItr.Set(tmpCompartment);
-
-            ++compartmentItr;
-            ++inputItr;
-        }
-
-        pos += compartmentSize;
-
         std::string fullPathCompartmentName = m_FileName + "/";
         std::string compartmentName = noPathName + "_";
 
         char tmpStr[2048];
         sprintf(tmpStr,"%d",i);
         compartmentName += tmpStr;
-        compartmentName += ".nrrd";
+        compartmentName += imageExtension;
 
         fullPathCompartmentName += compartmentName;
 
         std::string xmlFileNameCompartment = compartmentName;
 
-        anima::writeImage <BaseOutputImageType> (fullPathCompartmentName,compartmentImage);
+        this->WriteComponents(fullPathCompartmentName,pos,compartmentSize);
+        pos += compartmentSize;
+
         outputHeaderFile << "<FileName>" << xmlFileNameCompartment << "</FileName>" << std::endl;
 
         outputHeaderFile << "</Compartment>" << std::endl;
@@ -210,4 +156,53 @@ MCMFileWriter <PixelType, ImageDimension>
     outputHeaderFile.close();
 }
 
+template <class PixelType, unsigned int ImageDimension>
+void
+MCMFileWriter <PixelType, ImageDimension>
+::WriteComponents(std::string fileName, unsigned int firstComponent, unsigned int numberOfComponents)
+{
+    if (m_SparseInputImage)
+    {
+        m_SparseInputImage->SetOutputComponentRange(firstComponent,numberOfComponents);
+        anima::writeStreamedImage <BaseOutputImageType> (fileName,m_SparseInputImage);
+
+        // Releases the expanded image before the next one is generated
+        m_SparseInputImage->GetOutput()->Initialize();
+        return;
+    }
+
+    BaseOutputImagePointer componentsImage = BaseOutputImageType::New();
+    componentsImage->Initialize();
+    componentsImage->SetRegions(m_InputImage->GetLargestPossibleRegion());
+    componentsImage->SetSpacing (m_InputImage->GetSpacing());
+    componentsImage->SetOrigin (m_InputImage->GetOrigin());
+    componentsImage->SetDirection (m_InputImage->GetDirection());
+    componentsImage->SetVectorLength(numberOfComponents);
+    componentsImage->Allocate();
+
+    typedef itk::ImageRegionIterator <InputImageType> InputImageIteratorType;
+    typedef itk::ImageRegionIterator <BaseOutputImageType> BaseOutputImageIteratorType;
+    typedef typename InputImageType::PixelType VectorType;
+
+    BaseOutputImageIteratorType componentsItr(componentsImage,m_InputImage->GetLargestPossibleRegion());
+    InputImageIteratorType inputItr(m_InputImage,m_InputImage->GetLargestPossibleRegion());
+
+    VectorType tmpComponents(numberOfComponents);
+    VectorType workVector;
+    while (!componentsItr.IsAtEnd())
+    {
+        workVector = inputItr.Get();
+
+        for (unsigned int i = 0;i < numberOfComponents;++i)
+            tmpComponents[i] = workVector[firstComponent + i];
+
+        componentsItr.Set(tmpComponents);
+
+        ++componentsItr;
+        ++inputItr;
+    }
+
+    anima::writeImage <BaseOutputImageType> (fileName,componentsImage);
+}
+
 } // end namespace anima
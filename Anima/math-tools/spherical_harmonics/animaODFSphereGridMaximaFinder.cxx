@@ -0,0 +1,399 @@
+#include "animaODFSphereGridMaximaFinder.h"
+#include <animaRealSphericalHarmonicKernel.h>
+#include <animaVectorOperations.h>
+
+#include <vnl/vnl_cross.h>
+#include <vnl/algo/vnl_svd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+namespace anima
+{
+
+ODFSphereGridMaximaFinder::ODFSphereGridMaximaFinder()
+{
+    m_ODFSHOrder = 4;
+    m_NumberOfSubdivisions = 3;
+    m_NumberOfCoefficients = 15;
+    m_Initialized = false;
+}
+
+void ODFSphereGridMaximaFinder::SetODFSHOrder(unsigned int val)
+{
+    if (val == m_ODFSHOrder)
+        return;
+
+    m_ODFSHOrder = val;
+    m_Initialized = false;
+}
+
+void ODFSphereGridMaximaFinder::SetNumberOfSubdivisions(unsigned int val)
+{
+    if (val == m_NumberOfSubdivisions)
+        return;
+
+    m_NumberOfSubdivisions = val;
+    m_Initialized = false;
+}
+
+void ODFSphereGridMaximaFinder::Initialize()
+{
+    if (m_Initialized)
+        return;
+
+    this->BuildSphereGrid();
+    this->ComputeBasisMatrix();
+
+    m_Initialized = true;
+}
+
+void ODFSphereGridMaximaFinder::BuildSphereGrid()
+{
+    // Icosahedron
+    double t = (1.0 + std::sqrt(5.0)) / 2.0;
+    double icoVertices[12][3] = {
+        {-1,t,0}, {1,t,0}, {-1,-t,0}, {1,-t,0},
+        {0,-1,t}, {0,1,t}, {0,-1,-t}, {0,1,-t},
+        {t,0,-1}, {t,0,1}, {-t,0,-1}, {-t,0,1}
+    };
+
+    unsigned int icoFaces[20][3] = {
+        {0,11,5}, {0,5,1}, {0,1,7}, {0,7,10}, {0,10,11},
+        {1,5,9}, {5,11,4}, {11,10,2}, {10,7,6}, {7,1,8},
+        {3,9,4}, {3,4,2}, {3,2,6}, {3,6,8}, {3,8,9},
+        {4,9,5}, {2,4,11}, {6,2,10}, {8,6,7}, {9,8,1}
+    };
+
+    std::vector <DirectionType> vertices(12);
+    for (unsigned int i = 0;i < 12;++i)
+    {
+        for (unsigned int j = 0;j < 3;++j)
+            vertices[i][j] = icoVertices[i][j];
+
+        vertices[i].normalize();
+    }
+
+    std::vector < std::vector <unsigned int> > faces(20,std::vector <unsigned int> (3));
+    for (unsigned int i = 0;i < 20;++i)
+    {
+        for (unsigned int j = 0;j < 3;++j)
+            faces[i][j] = icoFaces[i][j];
+    }
+
+    // Subdivide each face in four, sharing edge midpoints
+    for (unsigned int s = 0;s < m_NumberOfSubdivisions;++s)
+    {
+        std::map < std::pair <unsigned int, unsigned int>, unsigned int > midPoints;
+        std::vector < std::vector <unsigned int> > newFaces;
+        newFaces.reserve(4 * faces.size());
+
+        for (unsigned int i = 0;i < faces.size();++i)
+        {
+            unsigned int midIndexes[3];
+            for (unsigned int j = 0;j < 3;++j)
+            {
+                unsigned int firstIndex = std::min(faces[i][j],faces[i][(j + 1) % 3]);
+                unsigned int secondIndex = std::max(faces[i][j],faces[i][(j + 1) % 3]);
+                std::pair <unsigned int, unsigned int> edge(firstIndex,secondIndex);
+
+                std::map < std::pair <unsigned int, unsigned int>, unsigned int >::iterator edgeItr = midPoints.find(edge);
+                if (edgeItr != midPoints.end())
+                {
+                    midIndexes[j] = edgeItr->second;
+                    continue;
+                }
+
+                DirectionType midPoint = vertices[firstIndex] + vertices[secondIndex];
+                midPoint.normalize();
+                midIndexes[j] = vertices.size();
+                vertices.push_back(midPoint);
+                midPoints[edge] = midIndexes[j];
+            }
+
+            unsigned int subFaces[4][3] = {
+                {faces[i][0],midIndexes[0],midIndexes[2]},
+                {faces[i][1],midIndexes[1],midIndexes[0]},
+                {faces[i][2],midIndexes[2],midIndexes[1]},
+                {midIndexes[0],midIndexes[1],midIndexes[2]}
+            };
+
+            for (unsigned int j = 0;j < 4;++j)
+                newFaces.push_back(std::vector <unsigned int> (subFaces[j],subFaces[j] + 3));
+        }
+
+        faces = newFaces;
+    }
+
+    unsigned int numVertices = vertices.size();
+    std::vector < std::set <unsigned int> > fullNeighbours(numVertices);
+    for (unsigned int i = 0;i < faces.size();++i)
+    {
+        for (unsigned int j = 0;j < 3;++j)
+        {
+            fullNeighbours[faces[i][j]].insert(faces[i][(j + 1) % 3]);
+            fullNeighbours[faces[i][j]].insert(faces[i][(j + 2) % 3]);
+        }
+    }
+
+    // Keep one direction per antipodal pair: ODFs are symmetric
+    const double epsilon = 1.0e-9;
+    m_Directions.clear();
+    std::vector <int> halfIndexes(numVertices,-1);
+    for (unsigned int i = 0;i < numVertices;++i)
+    {
+        const DirectionType &v = vertices[i];
+        bool isUpper = (v[2] > epsilon) || ((std::abs(v[2]) <= epsilon) && ((v[1] > epsilon) || ((std::abs(v[1]) <= epsilon) && (v[0] > 0))));
+
+        if (!isUpper)
+            continue;
+
+        halfIndexes[i] = m_Directions.size();
+        m_Directions.push_back(v);
+    }
+
+    for (unsigned int i = 0;i < numVertices;++i)
+    {
+        if (halfIndexes[i] >= 0)
+            continue;
+
+        for (unsigned int j = 0;j < m_Directions.size();++j)
+        {
+            if (dot_product(vertices[i],m_Directions[j]) < epsilon - 1.0)
+            {
+                halfIndexes[i] = j;
+                break;
+            }
+        }
+
+        if (halfIndexes[i] < 0)
+            throw std::runtime_error("Sphere grid is not antipodally symmetric");
+    }
+
+    // Neighbourhoods and quadratic fitting operators, in gnomonic coordinates of the tangent plane
+    unsigned int numDirections = m_Directions.size();
+    m_NeighbourOffsets.resize(numDirections + 1);
+    m_Neighbours.clear();
+    m_FitOffsets.resize(numDirections + 1);
+    m_FitOperators.clear();
+    m_TangentFrames.resize(2 * numDirections);
+    m_MaximalSteps.resize(numDirections);
+
+    std::vector <unsigned int> fullIndexes(numDirections);
+    for (unsigned int i = 0;i < numVertices;++i)
+    {
+        if ((halfIndexes[i] >= 0) && (dot_product(vertices[i],m_Directions[halfIndexes[i]]) > 0))
+            fullIndexes[halfIndexes[i]] = i;
+    }
+
+    for (unsigned int i = 0;i < numDirections;++i)
+    {
+        const DirectionType &v = m_Directions[i];
+
+        DirectionType helper(1.0,0.0,0.0);
+        if (std::abs(v[0]) > 0.9)
+            helper = DirectionType(0.0,1.0,0.0);
+
+        DirectionType firstTangent = vnl_cross_3d(v,helper);
+        firstTangent.normalize();
+        DirectionType secondTangent = vnl_cross_3d(v,firstTangent);
+
+        m_TangentFrames[2 * i] = firstTangent;
+        m_TangentFrames[2 * i + 1] = secondTangent;
+
+        const std::set <unsigned int> &neighbours = fullNeighbours[fullIndexes[i]];
+        unsigned int numNeighbours = neighbours.size();
+
+        m_NeighbourOffsets[i] = m_Neighbours.size();
+        m_FitOffsets[i] = m_FitOperators.size();
+
+        vnl_matrix <double> fitMatrix(numNeighbours + 1,6,0.0);
+        fitMatrix(0,0) = 1.0;
+
+        double maximalStep = 0;
+        unsigned int pos = 1;
+        for (std::set <unsigned int>::const_iterator it = neighbours.begin();it != neighbours.end();++it,++pos)
+        {
+            m_Neighbours.push_back(halfIndexes[*it]);
+
+            const DirectionType &neighbour = vertices[*it];
+            double projection = dot_product(neighbour,v);
+            double u = dot_product(neighbour,firstTangent) / projection;
+            double w = dot_product(neighbour,secondTangent) / projection;
+
+            fitMatrix(pos,0) = 1.0;
+            fitMatrix(pos,1) = u;
+            fitMatrix(pos,2) = w;
+            fitMatrix(pos,3) = u * u;
+            fitMatrix(pos,4) = u * w;
+            fitMatrix(pos,5) = w * w;
+
+            maximalStep = std::max(maximalStep,std::sqrt(u * u + w * w));
+        }
+
+        m_MaximalSteps[i] = maximalStep;
+
+        vnl_matrix <double> fitOperator = vnl_svd <double> (fitMatrix).pinverse();
+        for (unsigned int j = 0;j < 6;++j)
+        {
+            for (unsigned int k = 0;k <= numNeighbours;++k)
+                m_FitOperators.push_back(fitOperator(j,k));
+        }
+    }
+
+    m_NeighbourOffsets[numDirections] = m_Neighbours.size();
+    m_FitOffsets[numDirections] = m_FitOperators.size();
+}
+
+void ODFSphereGridMaximaFinder::ComputeBasisMatrix()
+{
+    m_NumberOfCoefficients = (m_ODFSHOrder + 1) * (m_ODFSHOrder + 2) / 2;
+    unsigned int numDirections = m_Directions.size();
+    m_BasisMatrix.resize(numDirections * m_NumberOfCoefficients);
+
+    std::vector <double> cartesianDirection(3), sphericalDirection(3);
+    std::vector <double> thetas(numDirections), phis(numDirections);
+
+    for (unsigned int i = 0;i < numDirections;++i)
+    {
+        for (unsigned int j = 0;j < 3;++j)
+            cartesianDirection[j] = m_Directions[i][j];
+
+        anima::TransformCartesianToSphericalCoordinates(cartesianDirection,sphericalDirection);
+        thetas[i] = sphericalDirection[0];
+        phis[i] = sphericalDirection[1];
+    }
+
+    anima::RealSphericalHarmonicKernel shKernel(m_ODFSHOrder);
+    if (numDirections > 0)
+        shKernel.Evaluate(thetas.data(),phis.data(),numDirections,m_BasisMatrix.data());
+}
+
+void ODFSphereGridMaximaFinder::ComputeGridValues(const std::vector <double> &coefficients, std::vector <double> &gridValues) const
+{
+    unsigned int numDirections = m_Directions.size();
+    unsigned int numCoefficients = std::min(m_NumberOfCoefficients,(unsigned int)coefficients.size());
+    gridValues.resize(numDirections);
+
+    for (unsigned int i = 0;i < numDirections;++i)
+    {
+        const double *basisRow = m_BasisMatrix.data() + i * m_NumberOfCoefficients;
+        double value = 0;
+        for (unsigned int j = 0;j < numCoefficients;++j)
+            value += basisRow[j] * coefficients[j];
+
+        gridValues[i] = value;
+    }
+}
+
+unsigned int ODFSphereGridMaximaFinder::FindMaxima(const std::vector <double> &coefficients, std::vector <DirectionType> &maxima,
+                                                   std::vector <double> &maximaValues, double minimalValue,
+                                                   double minimalAngle) const
+{
+    if (!m_Initialized)
+        throw std::runtime_error("ODF sphere grid has to be initialized before looking for maxima");
+
+    std::vector <double> gridValues;
+    this->ComputeGridValues(coefficients,gridValues);
+
+    typedef std::pair <double, DirectionType> PeakType;
+    std::vector <PeakType> peaks;
+
+    double values[7];
+    unsigned int numDirections = m_Directions.size();
+    for (unsigned int i = 0;i < numDirections;++i)
+    {
+        double centerValue = gridValues[i];
+        bool isMaximum = true;
+        for (unsigned int j = m_NeighbourOffsets[i];j < m_NeighbourOffsets[i + 1];++j)
+        {
+            unsigned int neighbour = m_Neighbours[j];
+            if ((gridValues[neighbour] > centerValue) || ((gridValues[neighbour] == centerValue) && (neighbour < i)))
+            {
+                isMaximum = false;
+                break;
+            }
+        }
+
+        if (!isMaximum)
+            continue;
+
+        // Newton step on the quadratic fitted to the neighbourhood
+        unsigned int numValues = m_NeighbourOffsets[i + 1] - m_NeighbourOffsets[i] + 1;
+        values[0] = centerValue;
+        for (unsigned int j = 1;j < numValues;++j)
+            values[j] = gridValues[m_Neighbours[m_NeighbourOffsets[i] + j - 1]];
+
+        double q[6];
+        const double *fitOperator = m_FitOperators.data() + m_FitOffsets[i];
+        for (unsigned int j = 0;j < 6;++j)
+        {
+            q[j] = 0;
+            for (unsigned int k = 0;k < numValues;++k)
+                q[j] += fitOperator[j * numValues + k] * values[k];
+        }
+
+        DirectionType peakDirection = m_Directions[i];
+        double peakValue = centerValue;
+
+        double determinant = 4.0 * q[3] * q[5] - q[4] * q[4];
+        if ((q[3] < 0) && (determinant > 0))
+        {
+            double stepU = - (2.0 * q[5] * q[1] - q[4] * q[2]) / determinant;
+            double stepW = - (2.0 * q[3] * q[2] - q[4] * q[1]) / determinant;
+
+            double stepNorm = std::sqrt(stepU * stepU + stepW * stepW);
+            if (stepNorm > m_MaximalSteps[i])
+            {
+                stepU *= m_MaximalSteps[i] / stepNorm;
+                stepW *= m_MaximalSteps[i] / stepNorm;
+            }
+
+            double refinedValue = q[0] + q[1] * stepU + q[2] * stepW + q[3] * stepU * stepU
+                    + q[4] * stepU * stepW + q[5] * stepW * stepW;
+
+            if (refinedValue >= centerValue)
+            {
+                peakDirection += stepU * m_TangentFrames[2 * i] + stepW * m_TangentFrames[2 * i + 1];
+                peakDirection.normalize();
+                peakValue = refinedValue;
+            }
+        }
+
+        peaks.push_back(PeakType(peakValue,peakDirection));
+    }
+
+    std::sort(peaks.begin(),peaks.end(),[](const PeakType &a, const PeakType &b) {return a.first > b.first;});
+
+    // Discard maxima too close to a higher one, then those below the minimal value
+    maxima.clear();
+    maximaValues.clear();
+    for (unsigned int i = 0;i < peaks.size();++i)
+    {
+        if (peaks[i].first <= minimalValue)
+            break;
+
+        bool usefulMaximum = true;
+        for (unsigned int j = 0;j < i;++j)
+        {
+            if (anima::ComputeOrientationAngle(peaks[i].second,peaks[j].second) < minimalAngle)
+            {
+                usefulMaximum = false;
+                break;
+            }
+        }
+
+        if (!usefulMaximum)
+            continue;
+
+        maxima.push_back(peaks[i].second);
+        maximaValues.push_back(peaks[i].first);
+    }
+
+    return maxima.size();
+}
+
+} // end namespace anima
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include <vnl/vnl_vector_fixed.h>
+#include "AnimaSHToolsExport.h"
+
+namespace anima
+{
+
+/**
+ * \class ODFSphereGridMaximaFinder
+ * @brief Finds maxima of symmetric real SH ODFs on a precomputed sphere grid.
+ *
+ * The grid is a subdivided icosahedron, reduced to one direction per antipodal pair. SH basis values on the
+ * grid are tabulated once, so that ODF values on the whole grid are given by a single matrix-vector product.
+ * Local maxima are the grid directions larger than all their neighbours, refined by one Newton step on a
+ * quadratic fitted to the neighbourhood (fitting operators are also precomputed). Once initialized, the
+ * finder is only read and may be shared between threads.
+ */
+class ANIMASHTOOLS_EXPORT ODFSphereGridMaximaFinder
+{
+public:
+    typedef vnl_vector_fixed <double,3> DirectionType;
+
+    ODFSphereGridMaximaFinder();
+    virtual ~ODFSphereGridMaximaFinder() {}
+
+    void SetODFSHOrder(unsigned int val);
+
+    //! Number of icosahedron subdivisions (default: 3, i.e. 321 directions on the half sphere)
+    void SetNumberOfSubdivisions(unsigned int val);
+
+    //! Builds the grid, neighbourhoods, fitting operators and SH basis matrix
+    void Initialize();
+    bool IsInitialized() const {return m_Initialized;}
+
+    unsigned int GetNumberOfDirections() const {return m_Directions.size();}
+    const DirectionType &GetDirection(unsigned int i) const {return m_Directions[i];}
+
+    /**
+     * Computes ODF maxima sorted by decreasing ODF value. Maxima less than minimalAngle degrees away from a
+     * higher one, or with value below minimalValue, are discarded. Returns the number of maxima
+     */
+    unsigned int FindMaxima(const std::vector <double> &coefficients, std::vector <DirectionType> &maxima,
+                            std::vector <double> &maximaValues, double minimalValue = 0,
+                            double minimalAngle = 15.0) const;
+
+    //! ODF values on all grid directions
+    void ComputeGridValues(const std::vector <double> &coefficients, std::vector <double> &gridValues) const;
+
+private:
+    void BuildSphereGrid();
+    void ComputeBasisMatrix();
+
+    unsigned int m_ODFSHOrder;
+    unsigned int m_NumberOfSubdivisions;
+    bool m_Initialized;
+
+    std::vector <DirectionType> m_Directions;
+
+    //! Neighbours of each direction, as indexes in m_Directions, stored as [m_NeighbourOffsets[i], m_NeighbourOffsets[i+1])
+    std::vector <unsigned int> m_NeighbourOffsets;
+    std::vector <unsigned int> m_Neighbours;
+
+    //! Tangent frames used for refinement, two vectors per direction
+    std::vector <DirectionType> m_TangentFrames;
+
+    //! Least squares operators (6 x (1 + number of neighbours)) giving quadratic coefficients from neighbourhood values
+    std::vector <unsigned int> m_FitOffsets;
+    std::vector <double> m_FitOperators;
+
+    //! Maximal refinement step (in tangent plane coordinates) for each direction
+    std::vector <double> m_MaximalSteps;
+
+    //! Row major (number of directions x number of coefficients) SH basis matrix
+    std::vector <double> m_BasisMatrix;
+    unsigned int m_NumberOfCoefficients;
+};
+
+} // end namespace anima
@@ -11,6 +11,8 @@ ODFSphericalHarmonicBasis::ODFSphericalHarmonicBasis(unsigned int L)
 
 void ODFSphericalHarmonicBasis::SetOrder(unsigned int L)
 {
+    m_SHKernel.SetOrder(L);
+
     if (m_LOrder == L)
         return;
 
@@ -27,23 +29,24 @@ void ODFSphericalHarmonicBasis::SetOrder(unsigned int L)
 
 double ODFSphericalHarmonicBasis::getNthSHValueAtPosition(int k, int m, double theta, double phi)
 {
-    int absm = std::abs(m);
-    std::complex <double> tmpVal = m_SphericalHarmonics[k * k / 4 + absm].Value(theta,phi);
-
-    double resVal = 0;
+    return m_SHKernel.GetValue(k,m,theta,phi);
+}
 
-    if (m > 0)
-        resVal = sqrt(2.0)*imag(tmpVal);
-    else if (m < 0)
+void ODFSphericalHarmonicBasis::GetBasisMatrix(const std::vector < std::vector <double> > &sphericalDirections,
+                                               vnl_matrix <double> &basisMatrix)
+{
+    unsigned int numDirections = sphericalDirections.size();
+    std::vector <double> thetas(numDirections), phis(numDirections);
+    for (unsigned int i = 0;i < numDirections;++i)
     {
-        resVal = sqrt(2.0)*real(tmpVal);
-        if (m % 2 != 0)
-            resVal *= -1;
+        thetas[i] = sphericalDirections[i][0];
+        phis[i] = sphericalDirections[i][1];
     }
-    else
-        resVal = real(tmpVal);
 
-    return resVal;
+    // vnl matrices are row major, as the kernel output
+    basisMatrix.set_size(numDirections,m_SHKernel.GetNumberOfCoefficients());
+    if (numDirections > 0)
+        m_SHKernel.Evaluate(thetas.data(),phis.data(),numDirections,basisMatrix.data_block());
 }
 
 } // end namespace anima
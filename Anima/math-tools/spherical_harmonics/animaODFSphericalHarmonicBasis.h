@@ -1,7 +1,9 @@
 #pragma once
 
 #include <animaSphericalHarmonic.h>
+#include <animaRealSphericalHarmonicKernel.h>
 #include <itkVariableLengthVector.h>
+#include <vnl/vnl_matrix.h>
 #include <vector>
 #include <AnimaSHToolsExport.h>
 
@@ -38,12 +40,18 @@ public:
 
     double getNthSHValueAtPosition(int k, int m, double theta, double phi);
 
+    //! Fills a (number of directions x number of coefficients) matrix with basis values at (theta, phi) directions
+    void GetBasisMatrix(const std::vector < std::vector <double> > &sphericalDirections, vnl_matrix <double> &basisMatrix);
+
     template <class T> itk::VariableLengthVector <T>
     GetSampleValues(itk::VariableLengthVector <T> &data,
                     std::vector < std::vector <double> > &m_SampleDirections);
 private:
     unsigned int m_LOrder;
     std::vector < SphericalHarmonic > m_SphericalHarmonics;
+
+    //! Recurrence based kernel used for all value computations
+    RealSphericalHarmonicKernel m_SHKernel;
 };
 
 } // end namespace odf
@@ -9,35 +9,7 @@ double
 ODFSphericalHarmonicBasis::
 getValueAtPosition(const T &coefficients, double theta, double phi)
 {
-    double resVal = 0;
-    std::complex <double> tmpVal;
-
-    for (unsigned int k = 0;k <= m_LOrder;k += 2)
-    {
-        unsigned int kIndexCoef = k * (k + 1) / 2;
-        unsigned int kIndexSH = k * k / 4;
-
-        for (unsigned int m = 0;m <= k;++m)
-        {
-            tmpVal = m_SphericalHarmonics[kIndexSH + m].Value(theta,phi);
-
-            if (m != 0)
-            {
-                // Part for m > 0
-                resVal += sqrt(2.0) * coefficients[kIndexCoef + m] * imag(tmpVal);
-
-                // Part for m < 0
-                if (m % 2 == 0)
-                    resVal += sqrt(2.0) * coefficients[kIndexCoef - m] * real(tmpVal);
-                else
-                    resVal -= sqrt(2.0) * coefficients[kIndexCoef - m] * real(tmpVal);
-            }
-            else
-                resVal += coefficients[kIndexCoef]*real(tmpVal);
-        }
-    }
-
-    return resVal;
+    return m_SHKernel.GetSeriesValue(coefficients,theta,phi);
 }
 
 template <class T>
@@ -48,8 +20,18 @@ GetSampleValues(itk::VariableLengthVector <T> &data,
 {
     itk::VariableLengthVector <T> resVal(m_SampleDirections.size());
 
+    vnl_matrix <double> basisMatrix;
+    this->GetBasisMatrix(m_SampleDirections,basisMatrix);
+
+    unsigned int numCoefficients = std::min((unsigned int)basisMatrix.cols(),(unsigned int)data.GetSize());
     for (unsigned int i = 0;i < m_SampleDirections.size();++i)
-        resVal[i] = this->getValueAtPosition(data,m_SampleDirections[i][0],m_SampleDirections[i][1]);
+    {
+        double value = 0;
+        for (unsigned int j = 0;j < numCoefficients;++j)
+            value += basisMatrix(i,j) * data[j];
+
+        resVal[i] = value;
+    }
 
     return resVal;
 }
@@ -0,0 +1,284 @@
+#include "animaRealSphericalHarmonicKernel.h"
+
+#include <algorithm>
+
+namespace anima
+{
+
+RealSphericalHarmonicKernel::RealSphericalHarmonicKernel(unsigned int L)
+{
+    m_LOrder = 0;
+    this->SetOrder(L);
+}
+
+void RealSphericalHarmonicKernel::SetOrder(unsigned int L)
+{
+    if ((m_LOrder == L) && (m_DiagonalFactors.size() != 0))
+        return;
+
+    m_LOrder = L;
+
+    m_DiagonalFactors.resize(m_LOrder + 1);
+    m_SubDiagonalFactors.resize(m_LOrder + 1);
+    m_DiagonalFactors[0] = 1.0;
+    for (unsigned int m = 0;m <= m_LOrder;++m)
+    {
+        // Includes the Condon-Shortley phase
+        if (m > 0)
+            m_DiagonalFactors[m] = - std::sqrt((2.0 * m + 1.0) / (2.0 * m));
+
+        m_SubDiagonalFactors[m] = std::sqrt(2.0 * m + 3.0);
+    }
+
+    unsigned int triangleSize = this->GetTriangleIndex(m_LOrder + 1,0);
+    m_AFactors.resize(triangleSize);
+    m_BFactors.resize(triangleSize);
+    m_LadderUpFactors.resize(triangleSize);
+    m_LadderDownFactors.resize(triangleSize);
+
+    for (unsigned int l = 0;l <= m_LOrder;++l)
+    {
+        for (unsigned int m = 0;m <= l;++m)
+        {
+            unsigned int triangleIndex = this->GetTriangleIndex(l,m);
+            double lVal = l;
+            double mVal = m;
+
+            m_AFactors[triangleIndex] = 0;
+            m_BFactors[triangleIndex] = 0;
+            if (l >= m + 2)
+            {
+                m_AFactors[triangleIndex] = std::sqrt((4.0 * lVal * lVal - 1.0) / (lVal * lVal - mVal * mVal));
+                m_BFactors[triangleIndex] = std::sqrt(((lVal - 1.0) * (lVal - 1.0) - mVal * mVal) / (4.0 * (lVal - 1.0) * (lVal - 1.0) - 1.0));
+            }
+
+            m_LadderUpFactors[triangleIndex] = std::sqrt((lVal + mVal + 1.0) * (lVal - mVal));
+            m_LadderDownFactors[triangleIndex] = std::sqrt((lVal + mVal) * (lVal - mVal + 1.0));
+        }
+    }
+}
+
+double RealSphericalHarmonicKernel::GetValue(int k, int m, double theta, double phi) const
+{
+    unsigned int absm = std::abs(m);
+    if ((k < 0) || (absm > (unsigned int)k) || ((unsigned int)k > m_LOrder))
+        return 0;
+
+    double x = std::cos(theta);
+    double s = std::sin(theta);
+
+    double pmm = 1.0 / std::sqrt(4.0 * M_PI);
+    for (unsigned int i = 1;i <= absm;++i)
+        pmm *= m_DiagonalFactors[i] * s;
+
+    double previousValue = 0;
+    double currentValue = pmm;
+    for (unsigned int l = absm + 1;l <= (unsigned int)k;++l)
+    {
+        double nextValue = (l == absm + 1) ? m_SubDiagonalFactors[absm] * x * pmm :
+                                             m_AFactors[this->GetTriangleIndex(l,absm)] * (x * currentValue - m_BFactors[this->GetTriangleIndex(l,absm)] * previousValue);
+        previousValue = currentValue;
+        currentValue = nextValue;
+    }
+
+    if (m > 0)
+        return std::sqrt(2.0) * currentValue * std::sin(absm * phi);
+    else if (m < 0)
+    {
+        double resVal = std::sqrt(2.0) * currentValue * std::cos(absm * phi);
+        if (absm % 2 != 0)
+            resVal *= -1;
+
+        return resVal;
+    }
+
+    return currentValue;
+}
+
+void RealSphericalHarmonicKernel::Evaluate(const double *thetas, const double *phis, unsigned int numDirections, double *values,
+                                           double *thetaDerivatives, double *phiDerivatives) const
+{
+    const unsigned int blockSize = 64;
+    unsigned int numCoefficients = this->GetNumberOfCoefficients();
+    unsigned int triangleSize = this->GetTriangleIndex(m_LOrder + 1,0);
+
+    // Block buffers, stored as [row * blockSize + direction]
+    std::vector <double> cosThetas(blockSize), sinThetas(blockSize);
+    std::vector <double> cosMPhis((m_LOrder + 1) * blockSize), sinMPhis((m_LOrder + 1) * blockSize);
+    std::vector <double> legendreValues(triangleSize * blockSize);
+    std::vector <double> legendreDerivatives;
+    if (thetaDerivatives)
+        legendreDerivatives.resize(triangleSize * blockSize);
+
+    const double sqrt2 = std::sqrt(2.0);
+
+    for (unsigned int blockStart = 0;blockStart < numDirections;blockStart += blockSize)
+    {
+        unsigned int blockLength = std::min(blockSize,numDirections - blockStart);
+        const double *blockThetas = thetas + blockStart;
+        const double *blockPhis = phis + blockStart;
+
+        for (unsigned int d = 0;d < blockLength;++d)
+        {
+            cosThetas[d] = std::cos(blockThetas[d]);
+            sinThetas[d] = std::sin(blockThetas[d]);
+            cosMPhis[d] = 1.0;
+            sinMPhis[d] = 0.0;
+        }
+
+        if (m_LOrder > 0)
+        {
+            double *cosRow = cosMPhis.data() + blockSize;
+            double *sinRow = sinMPhis.data() + blockSize;
+            for (unsigned int d = 0;d < blockLength;++d)
+            {
+                cosRow[d] = std::cos(blockPhis[d]);
+                sinRow[d] = std::sin(blockPhis[d]);
+            }
+        }
+
+        // Angle addition for multiples of phi
+        for (unsigned int m = 2;m <= m_LOrder;++m)
+        {
+            const double *cosFirst = cosMPhis.data() + blockSize;
+            const double *sinFirst = sinMPhis.data() + blockSize;
+            const double *cosPrevious = cosMPhis.data() + (m - 1) * blockSize;
+            const double *sinPrevious = sinMPhis.data() + (m - 1) * blockSize;
+            double *cosRow = cosMPhis.data() + m * blockSize;
+            double *sinRow = sinMPhis.data() + m * blockSize;
+
+            for (unsigned int d = 0;d < blockLength;++d)
+            {
+                cosRow[d] = cosPrevious[d] * cosFirst[d] - sinPrevious[d] * sinFirst[d];
+                sinRow[d] = sinPrevious[d] * cosFirst[d] + cosPrevious[d] * sinFirst[d];
+            }
+        }
+
+        // Normalized associated Legendre functions
+        double *p00 = legendreValues.data();
+        for (unsigned int d = 0;d < blockLength;++d)
+            p00[d] = 1.0 / std::sqrt(4.0 * M_PI);
+
+        for (unsigned int m = 1;m <= m_LOrder;++m)
+        {
+            const double *previousDiagonal = legendreValues.data() + this->GetTriangleIndex(m - 1,m - 1) * blockSize;
+            double *diagonal = legendreValues.data() + this->GetTriangleIndex(m,m) * blockSize;
+            double factor = m_DiagonalFactors[m];
+
+            for (unsigned int d = 0;d < blockLength;++d)
+                diagonal[d] = factor * sinThetas[d] * previousDiagonal[d];
+        }
+
+        for (unsigned int m = 0;m < m_LOrder;++m)
+        {
+            const double *diagonal = legendreValues.data() + this->GetTriangleIndex(m,m) * blockSize;
+            double *subDiagonal = legendreValues.data() + this->GetTriangleIndex(m + 1,m) * blockSize;
+            double factor = m_SubDiagonalFactors[m];
+
+            for (unsigned int d = 0;d < blockLength;++d)
+                subDiagonal[d] = factor * cosThetas[d] * diagonal[d];
+        }
+
+        for (unsigned int l = 2;l <= m_LOrder;++l)
+        {
+            for (unsigned int m = 0;m + 2 <= l;++m)
+            {
+                unsigned int triangleIndex = this->GetTriangleIndex(l,m);
+                const double *firstPrevious = legendreValues.data() + this->GetTriangleIndex(l - 1,m) * blockSize;
+                const double *secondPrevious = legendreValues.data() + this->GetTriangleIndex(l - 2,m) * blockSize;
+                double *current = legendreValues.data() + triangleIndex * blockSize;
+                double aFactor = m_AFactors[triangleIndex];
+                double bFactor = m_BFactors[triangleIndex];
+
+                for (unsigned int d = 0;d < blockLength;++d)
+                    current[d] = aFactor * (cosThetas[d] * firstPrevious[d] - bFactor * secondPrevious[d]);
+            }
+        }
+
+        // Theta derivatives from ladder relations, well defined at the poles
+        if (thetaDerivatives)
+        {
+            for (unsigned int l = 0;l <= m_LOrder;++l)
+            {
+                for (unsigned int m = 0;m <= l;++m)
+                {
+                    unsigned int triangleIndex = this->GetTriangleIndex(l,m);
+                    double *derivative = legendreDerivatives.data() + triangleIndex * blockSize;
+                    const double *upper = (m < l) ? legendreValues.data() + (triangleIndex + 1) * blockSize : 0;
+
+                    if (m == 0)
+                    {
+                        for (unsigned int d = 0;d < blockLength;++d)
+                            derivative[d] = upper ? m_LadderUpFactors[triangleIndex] * upper[d] : 0.0;
+
+                        continue;
+                    }
+
+                    const double *lower = legendreValues.data() + (triangleIndex - 1) * blockSize;
+                    double upFactor = 0.5 * m_LadderUpFactors[triangleIndex];
+                    double downFactor = 0.5 * m_LadderDownFactors[triangleIndex];
+
+                    for (unsigned int d = 0;d < blockLength;++d)
+                    {
+                        derivative[d] = - downFactor * lower[d];
+                        if (upper)
+                            derivative[d] += upFactor * upper[d];
+                    }
+                }
+            }
+        }
+
+        // Real basis functions
+        for (unsigned int k = 0;k <= m_LOrder;k += 2)
+        {
+            unsigned int kIndexCoef = k * (k + 1) / 2;
+            for (unsigned int m = 0;m <= k;++m)
+            {
+                unsigned int triangleIndex = this->GetTriangleIndex(k,m);
+                const double *legendreRow = legendreValues.data() + triangleIndex * blockSize;
+                const double *derivativeRow = thetaDerivatives ? legendreDerivatives.data() + triangleIndex * blockSize : 0;
+                const double *cosRow = cosMPhis.data() + m * blockSize;
+                const double *sinRow = sinMPhis.data() + m * blockSize;
+
+                double *valuesOutput = values + blockStart * numCoefficients;
+                double *thetaOutput = thetaDerivatives ? thetaDerivatives + blockStart * numCoefficients : 0;
+                double *phiOutput = phiDerivatives ? phiDerivatives + blockStart * numCoefficients : 0;
+
+                if (m == 0)
+                {
+                    for (unsigned int d = 0;d < blockLength;++d)
+                    {
+                        valuesOutput[d * numCoefficients + kIndexCoef] = legendreRow[d];
+                        if (thetaOutput)
+                            thetaOutput[d * numCoefficients + kIndexCoef] = derivativeRow[d];
+                        if (phiOutput)
+                            phiOutput[d * numCoefficients + kIndexCoef] = 0.0;
+                    }
+
+                    continue;
+                }
+
+                double cosSign = (m % 2 != 0) ? - sqrt2 : sqrt2;
+                for (unsigned int d = 0;d < blockLength;++d)
+                {
+                    valuesOutput[d * numCoefficients + kIndexCoef + m] = sqrt2 * legendreRow[d] * sinRow[d];
+                    valuesOutput[d * numCoefficients + kIndexCoef - m] = cosSign * legendreRow[d] * cosRow[d];
+
+                    if (thetaOutput)
+                    {
+                        thetaOutput[d * numCoefficients + kIndexCoef + m] = sqrt2 * derivativeRow[d] * sinRow[d];
+                        thetaOutput[d * numCoefficients + kIndexCoef - m] = cosSign * derivativeRow[d] * cosRow[d];
+                    }
+
+                    if (phiOutput)
+                    {
+                        phiOutput[d * numCoefficients + kIndexCoef + m] = sqrt2 * m * legendreRow[d] * cosRow[d];
+                        phiOutput[d * numCoefficients + kIndexCoef - m] = - cosSign * m * legendreRow[d] * sinRow[d];
+                    }
+                }
+            }
+        }
+    }
+}
+
+} // end namespace anima
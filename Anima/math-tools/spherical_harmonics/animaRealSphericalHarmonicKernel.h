@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include "AnimaSHToolsExport.h"
+
+namespace anima
+{
+
+/**
+ * \class RealSphericalHarmonicKernel
+ * @brief Evaluation of the real symmetric SH basis used for ODFs (even orders, coefficient k(k+1)/2 + m for
+ * degree m in [-k,k]), computed with normalized associated Legendre and sin/cos recurrences instead of term by
+ * term Legendre functions and complex exponentials.
+ *
+ * Batched evaluation works on blocks of directions stored contiguously, so that inner loops run over
+ * directions and vectorize. All methods are const, a kernel may be shared between threads.
+ */
+class ANIMASHTOOLS_EXPORT RealSphericalHarmonicKernel
+{
+public:
+    RealSphericalHarmonicKernel(unsigned int L = 4);
+    virtual ~RealSphericalHarmonicKernel() {}
+
+    void SetOrder(unsigned int L);
+    unsigned int GetOrder() const {return m_LOrder;}
+    unsigned int GetNumberOfCoefficients() const {return (m_LOrder + 1) * (m_LOrder + 2) / 2;}
+
+    //! Value of the real SH of order k and degree m (|m| <= k <= L) at (theta, phi)
+    double GetValue(int k, int m, double theta, double phi) const;
+
+    //! Value at (theta, phi) of the SH series given by coefficients (T has to provide the [] operator)
+    template <class T> double GetSeriesValue(const T &coefficients, double theta, double phi) const;
+
+    /**
+     * Values of all basis functions for numDirections directions given in spherical coordinates. Outputs are
+     * row major (direction x coefficient) arrays. Theta and phi derivatives are computed only when requested
+     */
+    void Evaluate(const double *thetas, const double *phis, unsigned int numDirections, double *values,
+                  double *thetaDerivatives = 0, double *phiDerivatives = 0) const;
+
+private:
+    //! Index of normalized Legendre function of order l and degree m >= 0 in triangular tables
+    inline unsigned int GetTriangleIndex(unsigned int l, unsigned int m) const {return l * (l + 1) / 2 + m;}
+
+    unsigned int m_LOrder;
+
+    //! Factors for P_m^m from P_{m-1}^{m-1}, and P_{m+1}^m from P_m^m
+    std::vector <double> m_DiagonalFactors;
+    std::vector <double> m_SubDiagonalFactors;
+
+    //! Three term recurrence factors on l: P_l^m = a (x P_{l-1}^m - b P_{l-2}^m)
+    std::vector <double> m_AFactors;
+    std::vector <double> m_BFactors;
+
+    //! Ladder factors giving theta derivatives from P_l^{m+1} and P_l^{m-1}
+    std::vector <double> m_LadderUpFactors;
+    std::vector <double> m_LadderDownFactors;
+};
+
+} // end namespace anima
+
+#include "animaRealSphericalHarmonicKernel.hxx"
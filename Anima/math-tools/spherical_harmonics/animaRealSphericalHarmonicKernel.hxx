@@ -0,0 +1,75 @@
+#pragma once
+#include "animaRealSphericalHarmonicKernel.h"
+
+#include <cmath>
+
+namespace anima
+{
+
+template <class T>
+double
+RealSphericalHarmonicKernel::
+GetSeriesValue(const T &coefficients, double theta, double phi) const
+{
+    double x = std::cos(theta);
+    double s = std::sin(theta);
+    double cosPhi = std::cos(phi);
+    double sinPhi = std::sin(phi);
+
+    double resVal = 0;
+    double pmm = 1.0 / std::sqrt(4.0 * M_PI);
+    double cosMPhi = 1.0;
+    double sinMPhi = 0.0;
+
+    // Degree outer loop: only two Legendre values are needed at a time
+    for (unsigned int m = 0;m <= m_LOrder;++m)
+    {
+        if (m > 0)
+        {
+            pmm *= m_DiagonalFactors[m] * s;
+
+            double tmpCos = cosMPhi * cosPhi - sinMPhi * sinPhi;
+            sinMPhi = sinMPhi * cosPhi + cosMPhi * sinPhi;
+            cosMPhi = tmpCos;
+        }
+
+        double sinFactor = std::sqrt(2.0) * sinMPhi;
+        double cosFactor = std::sqrt(2.0) * cosMPhi;
+        if (m % 2 != 0)
+            cosFactor *= -1;
+
+        double previousValue = 0;
+        double currentValue = pmm;
+        for (unsigned int l = m;l <= m_LOrder;++l)
+        {
+            if (l == m + 1)
+            {
+                previousValue = currentValue;
+                currentValue = m_SubDiagonalFactors[m] * x * pmm;
+            }
+            else if (l > m + 1)
+            {
+                unsigned int triangleIndex = this->GetTriangleIndex(l,m);
+                double nextValue = m_AFactors[triangleIndex] * (x * currentValue - m_BFactors[triangleIndex] * previousValue);
+                previousValue = currentValue;
+                currentValue = nextValue;
+            }
+
+            if (l % 2 != 0)
+                continue;
+
+            unsigned int kIndexCoef = l * (l + 1) / 2;
+            if (m == 0)
+                resVal += coefficients[kIndexCoef] * currentValue;
+            else
+            {
+                resVal += coefficients[kIndexCoef + m] * sinFactor * currentValue;
+                resVal += coefficients[kIndexCoef - m] * cosFactor * currentValue;
+            }
+        }
+    }
+
+    return resVal;
+}
+
+} // end namespace anima
@@ -72,6 +72,8 @@ protected:
     CramersTestImageFilter()
         : Superclass()
     {
+        this->SetCompactedMaskExecution(true);
+
         m_NbSamples = 5000;
         m_FirstGroup.clear();
         m_SecondGroup.clear();
@@ -87,21 +89,31 @@ protected:
     void BeforeThreadedGenerateData() ITK_OVERRIDE;
     void DynamicThreadedGenerateData(const OutputImageRegionType &outputRegionForThread) ITK_OVERRIDE;
 
-    //! Bootstrap samples generator for group comparison
+    //! Bootstrap samples generator for group comparison, fills the sample indicator matrix
     void GenerateBootStrapSamples();
 
-    //! Actually bootstraps a p-value from the computed distance matrix and group samples
-    double BootStrap(vnl_matrix <double> &groupDistMatrix, std::vector <double> &inlierWeights);
+    //! Computes the inter-subject distance matrix from subject data stored one subject per row
+    void ComputeDistanceMatrix(const vnl_matrix <double> &subjectsData, vnl_matrix <double> &distMatrix);
+
+    /**
+     * Computes the Cramers' statistics of all samples (index 0 being the true groups) knowing the distance
+     * matrix, as matrix products with blocks of the sample indicator matrix. Work matrices are passed
+     * to avoid reallocations from one voxel to the next
+     */
+    void CramerStatistics(const vnl_matrix <double> &grpDistMatrix, const std::vector <double> &inlierWeights,
+                          vnl_matrix <double> &weightedIndicators, vnl_matrix <double> &distanceProducts,
+                          std::vector <double> &statistics);
 
-    //! Computes the Cramers' statistic knowing the distance matrix and the two groups
-    double CramerStatistic(vnl_matrix <double> &grpDistMatrix, std::vector <double> &inlierWeights,
-                           unsigned int index);
+    //! Actually bootstraps a p-value from the statistics of the true groups and of the bootstrap samples
+    double BootStrap(std::vector <double> &statistics);
 
 private:
     ITK_DISALLOW_COPY_AND_ASSIGN(CramersTestImageFilter);
 
     std::vector < unsigned int > m_FirstGroup, m_SecondGroup;
-    std::vector < std::vector < unsigned int > > m_SamplesFirstGroup, m_SamplesSecondGroup;
+
+    //! Sample indicator matrix: row i is 1 for subjects in the first group of sample i, 0 otherwise
+    vnl_matrix <double> m_SampleIndicators;
 
     unsigned long int m_NbSamples;
     unsigned int m_FirstGroupSize, m_SecondGroupSize;
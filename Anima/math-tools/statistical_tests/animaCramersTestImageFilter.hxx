@@ -6,9 +6,13 @@
 #include <itkTimeProbe.h>
 #include <itkProgressReporter.h>
 
+#include <vnl/vnl_fastops.h>
+
+#include <algorithm>
 #include <cmath>
 #include <ctime>
 #include <random>
+
 namespace anima
 {
 
@@ -30,9 +34,6 @@ CramersTestImageFilter<PixelScalarType>
     if ((m_FirstGroupSize + m_SecondGroupSize) != nbInputs)
         itkExceptionMacro("Groups data not clearly wrong... Exiting...");
 
-    m_SamplesFirstGroup.clear();
-    m_SamplesSecondGroup.clear();
-
     this->GenerateBootStrapSamples();
 
     m_UseOutlierMasks = (m_OutlierMasks.size() == nbInputs);
@@ -51,24 +52,30 @@ CramersTestImageFilter<PixelScalarType>
     OutRegionIteratorType outIterator(this->GetOutput(), outputRegionForThread);
     MaskRegionIteratorType maskIterator (this->GetComputationMask(), outputRegionForThread);
 
-    std::vector <InIteratorType> inIterators(this->GetNumberOfIndexedInputs());
+    unsigned int nbInputs = this->GetNumberOfIndexedInputs();
+    std::vector <InIteratorType> inIterators(nbInputs);
 
-    for (unsigned int i = 0;i < this->GetNumberOfIndexedInputs();++i)
+    for (unsigned int i = 0;i < nbInputs;++i)
         inIterators[i] = InIteratorType(this->GetInput(i), outputRegionForThread);
 
     std::vector <MaskRegionIteratorType> outlierMasksIterators(m_OutlierMasks.size());
 
     if (m_UseOutlierMasks)
     {
-        for (unsigned int i = 0;i < this->GetNumberOfIndexedInputs();++i)
+        for (unsigned int i = 0;i < nbInputs;++i)
             outlierMasksIterators[i] = MaskRegionIteratorType(m_OutlierMasks[i],outputRegionForThread);
     }
 
-    std::vector < InputPixelType > firstGroupData(m_FirstGroupSize), secondGroupData(m_SecondGroupSize);
-    vnl_matrix <double> cramerDistMatrix(this->GetNumberOfIndexedInputs(),this->GetNumberOfIndexedInputs(),0.0);
-    std::vector <double> inlierProbabilities(this->GetNumberOfIndexedInputs(),1);
     unsigned int vectorSize = this->GetInput(0)->GetNumberOfComponentsPerPixel();
 
+    // Subjects are stored in input order, as are indexes in the sample indicator matrix
+    vnl_matrix <double> subjectsData(nbInputs,vectorSize);
+    vnl_matrix <double> cramerDistMatrix(nbInputs,nbInputs,0.0);
+    std::vector <double> inlierProbabilities(nbInputs,1);
+
+    vnl_matrix <double> weightedIndicators, distanceProducts;
+    std::vector <double> statistics(m_NbSamples + 1,0);
+
     while (!outIterator.IsAtEnd())
     {
         if (maskIterator.Get() == 0)
@@ -77,12 +84,12 @@ CramersTestImageFilter<PixelScalarType>
             ++outIterator;
             ++maskIterator;
 
-            for (unsigned int i = 0;i < this->GetNumberOfIndexedInputs();++i)
+            for (unsigned int i = 0;i < nbInputs;++i)
                 ++inIterators[i];
 
             if (m_UseOutlierMasks)
             {
-                for (unsigned int i = 0;i < this->GetNumberOfIndexedInputs();++i)
+                for (unsigned int i = 0;i < nbInputs;++i)
                     ++outlierMasksIterators[i];
             }
 
@@ -90,72 +97,33 @@ CramersTestImageFilter<PixelScalarType>
         }
 
         // Voxel is in mask, so now let's go for it and compute the stats
-        for (unsigned int i = 0; i < m_FirstGroupSize;++i)
-        {
-            unsigned int indFirst = m_FirstGroup[i];
-            firstGroupData[i] = inIterators[indFirst].Get();
-        }
-
-        for (unsigned int i = 0; i < m_SecondGroupSize;++i)
-        {
-            unsigned int indSec = m_SecondGroup[i];
-            secondGroupData[i] = inIterators[indSec].Get();
-        }
-
-        // Now that data is grouped, compute the distance matrix
-        for (unsigned int i = 0; i < m_FirstGroupSize;++i)
+        for (unsigned int i = 0;i < nbInputs;++i)
         {
-            for (unsigned int l = 0;l < m_SecondGroupSize;++l)
-            {
-                double dist = 0;
-                for (unsigned int j = 0;j < vectorSize;++j)
-                    dist += (firstGroupData[i][j] - secondGroupData[l][j]) * (firstGroupData[i][j] - secondGroupData[l][j]);
-
-                cramerDistMatrix(i,m_FirstGroupSize + l) = sqrt(dist);
-                cramerDistMatrix(m_FirstGroupSize + l,i) = cramerDistMatrix(i,m_FirstGroupSize + l);
-            }
-
-            for (unsigned int l = i+1;l < m_FirstGroupSize;++l)
-            {
-                double dist = 0;
-                for (unsigned int j = 0;j < vectorSize;++j)
-                    dist += (firstGroupData[i][j] - firstGroupData[l][j]) * (firstGroupData[i][j] - firstGroupData[l][j]);
-
-                cramerDistMatrix(i,l) = sqrt(dist);
-                cramerDistMatrix(l,i) = cramerDistMatrix(i,l);
-            }
+            InputPixelType inputValue = inIterators[i].Get();
+            for (unsigned int j = 0;j < vectorSize;++j)
+                subjectsData(i,j) = inputValue[j];
         }
 
-        for (unsigned int i = 0; i < m_SecondGroupSize;++i)
-        {
-            for (unsigned int l = i+1;l < m_SecondGroupSize;++l)
-            {
-                double dist = 0;
-                for (unsigned int j = 0;j < vectorSize;++j)
-                    dist += (secondGroupData[i][j] - secondGroupData[l][j]) * (secondGroupData[i][j] - secondGroupData[l][j]);
-
-                cramerDistMatrix(m_FirstGroupSize + i,m_FirstGroupSize + l) = sqrt(dist);
-                cramerDistMatrix(m_FirstGroupSize + l,m_FirstGroupSize + i) = cramerDistMatrix(m_FirstGroupSize + i,m_FirstGroupSize + l);
-            }
-        }
+        this->ComputeDistanceMatrix(subjectsData,cramerDistMatrix);
 
         if (m_UseOutlierMasks)
         {
-            for (unsigned int i = 0;i < this->GetNumberOfIndexedInputs();++i)
+            for (unsigned int i = 0;i < nbInputs;++i)
                 inlierProbabilities[i] = (outlierMasksIterators[i].Get() == 0);
         }
 
-        outIterator.Set(this->BootStrap(cramerDistMatrix,inlierProbabilities));
+        this->CramerStatistics(cramerDistMatrix,inlierProbabilities,weightedIndicators,distanceProducts,statistics);
+        outIterator.Set(this->BootStrap(statistics));
 
         ++outIterator;
         ++maskIterator;
 
-        for (unsigned int i = 0;i < this->GetNumberOfIndexedInputs();++i)
+        for (unsigned int i = 0;i < nbInputs;++i)
             ++inIterators[i];
 
         if (m_UseOutlierMasks)
         {
-            for (unsigned int i = 0;i < this->GetNumberOfIndexedInputs();++i)
+            for (unsigned int i = 0;i < nbInputs;++i)
                 ++outlierMasksIterators[i];
         }
 
@@ -168,27 +136,27 @@ void
 CramersTestImageFilter<PixelScalarType>
 ::GenerateBootStrapSamples()
 {
-    m_SamplesFirstGroup.resize(m_NbSamples + 1);
-    m_SamplesSecondGroup.resize(m_NbSamples + 1);
-
-    m_SamplesFirstGroup[0] = m_FirstGroup;
-    m_SamplesSecondGroup[0] = m_SecondGroup;
-
     unsigned int nbFirstGroup = m_FirstGroup.size();
     unsigned int nbSecondGroup = m_SecondGroup.size();
     unsigned int nbSubjects = nbFirstGroup + nbSecondGroup;
 
+    m_SampleIndicators.set_size(m_NbSamples + 1,nbSubjects);
+    m_SampleIndicators.fill(0.0);
+
+    // First index is the true group separation
+    for (unsigned int i = 0;i < nbFirstGroup;++i)
+        m_SampleIndicators(0,m_FirstGroup[i]) = 1.0;
+
     unsigned int minNbGroup = std::min(nbFirstGroup,nbSecondGroup);
     bool isFirstGroupMin = (nbFirstGroup <= nbSecondGroup);
 
-    std::vector <unsigned int> sampleGen, sampleGenOtherGroup;
+    std::vector <bool> isAlreadyIndexed(nbSubjects);
     std::mt19937 generator(time(0));
     std::uniform_real_distribution<double> unifDistr(0.0, 1.0);
 
     for (unsigned int i = 1;i <= m_NbSamples;++i)
     {
-        sampleGen.clear();
-        sampleGenOtherGroup.clear();
+        std::fill(isAlreadyIndexed.begin(),isAlreadyIndexed.end(),false);
 
         unsigned int j = 0;
         while (j < minNbGroup)
@@ -197,49 +165,116 @@ CramersTestImageFilter<PixelScalarType>
             if (tmpVal < 0)
                 tmpVal = 0;
 
-            bool isAlreadyIndexed = false;
-            for (unsigned int k = 0; k < j;++k)
-            {
-                if (tmpVal == sampleGen[k])
-                {
-                    isAlreadyIndexed = true;
-                    break;
-                }
-            }
-
-            if (!isAlreadyIndexed)
+            if (!isAlreadyIndexed[tmpVal])
             {
-                sampleGen.push_back(tmpVal);
+                isAlreadyIndexed[tmpVal] = true;
                 j++;
             }
         }
 
-        // New sample gen that is not already here... Add it to the result vectors
+        // Drawn subjects make up the smallest group, the others the largest one
         for (unsigned int j = 0;j < nbSubjects;++j)
         {
-            bool isAlreadyIndexed = false;
-            for (unsigned int k = 0;k < minNbGroup;++k)
-            {
-                if (j == sampleGen[k])
-                {
-                    isAlreadyIndexed = true;
-                    break;
-                }
-            }
+            if (isAlreadyIndexed[j] == isFirstGroupMin)
+                m_SampleIndicators(i,j) = 1.0;
+        }
+    }
+}
 
-            if (!isAlreadyIndexed)
-                sampleGenOtherGroup.push_back(j);
+template <class PixelScalarType>
+void
+CramersTestImageFilter<PixelScalarType>
+::ComputeDistanceMatrix(const vnl_matrix <double> &subjectsData, vnl_matrix <double> &distMatrix)
+{
+    unsigned int nbSubjects = subjectsData.rows();
+    unsigned int vectorSize = subjectsData.cols();
+
+    for (unsigned int i = 0;i < nbSubjects;++i)
+    {
+        const double *firstData = subjectsData[i];
+        distMatrix(i,i) = 0.0;
+
+        for (unsigned int l = i + 1;l < nbSubjects;++l)
+        {
+            const double *secondData = subjectsData[l];
+            double dist = 0;
+            for (unsigned int j = 0;j < vectorSize;++j)
+                dist += (firstData[j] - secondData[j]) * (firstData[j] - secondData[j]);
+
+            distMatrix(i,l) = std::sqrt(dist);
+            distMatrix(l,i) = distMatrix(i,l);
         }
+    }
+}
 
-        if (isFirstGroupMin)
+template <class PixelScalarType>
+void
+CramersTestImageFilter<PixelScalarType>
+::CramerStatistics(const vnl_matrix <double> &grpDistMatrix, const std::vector <double> &inlierWeights,
+                   vnl_matrix <double> &weightedIndicators, vnl_matrix <double> &distanceProducts,
+                   std::vector <double> &statistics)
+{
+    // For a sample with weighted first group indicator u and second group indicator v = w - u,
+    // all terms are given by u'Du, u'Dv and v'Dv, computed from the rows of (U D) for blocks of samples
+    const unsigned int samplesBlockSize = 256;
+    unsigned int nbSubjects = grpDistMatrix.rows();
+    unsigned int nbTotalSamples = m_SampleIndicators.rows();
+
+    std::vector <double> weightedDistances(nbSubjects,0);
+    double sumWeights = 0;
+    double sumSquaredWeights = 0;
+    for (unsigned int i = 0;i < nbSubjects;++i)
+    {
+        sumWeights += inlierWeights[i];
+        sumSquaredWeights += inlierWeights[i] * inlierWeights[i];
+
+        const double *distRow = grpDistMatrix[i];
+        for (unsigned int j = 0;j < nbSubjects;++j)
+            weightedDistances[i] += distRow[j] * inlierWeights[j];
+    }
+
+    for (unsigned int blockStart = 0;blockStart < nbTotalSamples;blockStart += samplesBlockSize)
+    {
+        unsigned int blockLength = std::min(samplesBlockSize,nbTotalSamples - blockStart);
+        weightedIndicators.set_size(blockLength,nbSubjects);
+
+        for (unsigned int k = 0;k < blockLength;++k)
         {
-            m_SamplesFirstGroup[i] = sampleGen;
-            m_SamplesSecondGroup[i] = sampleGenOtherGroup;
+            const double *indicatorRow = m_SampleIndicators[blockStart + k];
+            double *weightedRow = weightedIndicators[k];
+            for (unsigned int i = 0;i < nbSubjects;++i)
+                weightedRow[i] = indicatorRow[i] * inlierWeights[i];
         }
-        else
+
+        // Distance matrix is symmetric: (U D)' rows are U rows times D'
+        vnl_fastops::ABt(distanceProducts,weightedIndicators,grpDistMatrix);
+
+        for (unsigned int k = 0;k < blockLength;++k)
         {
-            m_SamplesFirstGroup[i] = sampleGenOtherGroup;
-            m_SamplesSecondGroup[i] = sampleGen;
+            const double *weightedRow = weightedIndicators[k];
+            const double *productRow = distanceProducts[k];
+
+            double firstSecondProduct = 0, firstFirstProduct = 0, secondSecondProduct = 0;
+            double sumFirst = 0, sumSquaredFirst = 0;
+            for (unsigned int i = 0;i < nbSubjects;++i)
+            {
+                double secondWeight = inlierWeights[i] - weightedRow[i];
+                firstFirstProduct += weightedRow[i] * productRow[i];
+                firstSecondProduct += secondWeight * productRow[i];
+                secondSecondProduct += secondWeight * (weightedDistances[i] - productRow[i]);
+
+                sumFirst += weightedRow[i];
+                sumSquaredFirst += weightedRow[i] * weightedRow[i];
+            }
+
+            double sumSecond = sumWeights - sumFirst;
+
+            // Normalizations (including diagonal terms) as in the pairwise expression of the statistic
+            double firstTerm = firstSecondProduct / (sumFirst * sumSecond);
+            double secondTerm = firstFirstProduct / (2.0 * (sumFirst * sumFirst + sumSquaredFirst));
+            double thirdTerm = secondSecondProduct / (2.0 * sumSecond * sumSecond);
+
+            statistics[blockStart + k] = firstTerm - secondTerm - thirdTerm;
         }
     }
 }
@@ -247,26 +282,22 @@ CramersTestImageFilter<PixelScalarType>
 template <class PixelScalarType>
 double
 CramersTestImageFilter<PixelScalarType>
-::BootStrap(vnl_matrix <double> &groupDistMatrix, std::vector <double> &inlierWeights)
+::BootStrap(std::vector <double> &statistics)
 {
     // First index is the true group separation (see GenerateBootStrap)
-    double dataVal = this->CramerStatistic(groupDistMatrix,inlierWeights,0);
-
-    std::vector <double> statsValues(m_NbSamples,0);
+    double dataVal = statistics[0];
 
-    for (unsigned long int i = 0;i < m_NbSamples;++i)
-        statsValues[i] = this->CramerStatistic(groupDistMatrix,inlierWeights,i+1);
+    std::vector <double>::iterator statsBegin = statistics.begin() + 1;
+    std::sort(statsBegin,statistics.end());
 
-    std::sort(statsValues.begin(),statsValues.end());
-
-    if (dataVal >= statsValues[statsValues.size() - 1])
+    if (dataVal >= statistics[m_NbSamples])
         return 0;
 
     unsigned int position = 0;
 
-    while(position < statsValues.size())
+    while(position < m_NbSamples)
     {
-        if (dataVal <= statsValues[position])
+        if (dataVal <= statsBegin[position])
             break;
 
         ++position;
@@ -276,72 +307,17 @@ CramersTestImageFilter<PixelScalarType>
 
     if (position > 0)
     {
-        resVal = m_NbSamples - position + (statsValues[position - 1] - dataVal) / (statsValues[position] - statsValues[position - 1]);
+        resVal = m_NbSamples - position + (statsBegin[position - 1] - dataVal) / (statsBegin[position] - statsBegin[position - 1]);
         resVal /= m_NbSamples;
     }
     else
     {
         // Here statsValues[position - 1] doesn't exist, replacing with 0
-        resVal = m_NbSamples - position - dataVal / statsValues[position];
+        resVal = m_NbSamples - position - dataVal / statsBegin[position];
         resVal /= m_NbSamples;
     }
 
     return resVal;
 }
 
-template <class PixelScalarType>
-double
-CramersTestImageFilter<PixelScalarType>
-::CramerStatistic(vnl_matrix <double> &grpDistMatrix, std::vector <double> &inlierWeights,
-                  unsigned int index)
-{
-    unsigned int nbFirstGroup = m_SamplesFirstGroup[index].size();
-    unsigned int nbSecondGroup = m_SamplesSecondGroup[index].size();
-
-    double firstTerm = 0, secondTerm = 0, thirdTerm = 0;
-    double Z1 = 0, Z2 = 0, Z3 = 0;
-
-    for (unsigned int i = 0; i < nbFirstGroup;++i)
-    {
-        unsigned int indFirst = m_SamplesFirstGroup[index][i];
-        for (unsigned int j = 0;j < nbSecondGroup;++j)
-        {
-            double alpha = inlierWeights[indFirst]*inlierWeights[m_SamplesSecondGroup[index][j]];
-            firstTerm += alpha*grpDistMatrix(indFirst,m_SamplesSecondGroup[index][j]);
-            Z1 += alpha;
-        }
-
-        for (unsigned int j = i+1;j < nbFirstGroup;++j)
-        {
-            double alpha = 0.5*inlierWeights[indFirst]*inlierWeights[m_SamplesFirstGroup[index][j]];
-            secondTerm += 2*alpha*grpDistMatrix(indFirst,m_SamplesFirstGroup[index][j]);
-            Z2 += 2*alpha;
-        }
-
-        // Don't forget to add the diagonal term for Z2
-        Z2 += inlierWeights[indFirst]*inlierWeights[m_SamplesFirstGroup[index][i]];
-    }
-
-    firstTerm /= Z1;
-    secondTerm /= (2*Z2);
-
-    for (unsigned int i = 0; i < nbSecondGroup;++i)
-    {
-        int indSec = m_SamplesSecondGroup[index][i];
-        for (unsigned int j = i+1;j < nbSecondGroup;++j)
-        {
-            double alpha = inlierWeights[indSec]*inlierWeights[m_SamplesSecondGroup[index][j]];
-            thirdTerm += 2*alpha*grpDistMatrix(indSec,m_SamplesSecondGroup[index][j]);
-            Z3 += 2*alpha;
-        }
-
-        // Don't forget to add the diagonal term for Z3
-        Z3 += inlierWeights[indSec]*inlierWeights[m_SamplesSecondGroup[index][i]];
-    }
-
-    thirdTerm /= (2*Z3);
-
-    return firstTerm - secondTerm - thirdTerm;
-}
-
 } // end namespace anima
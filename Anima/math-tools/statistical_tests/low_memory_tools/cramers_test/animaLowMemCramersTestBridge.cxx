@@ -146,6 +146,16 @@ void LowMemoryCramersTestBridge::Update(int specificSplitToDo, bool genOutputDes
         }
     }
 
+    // When all blocks are processed here and no description is requested, results go directly to the final image
+    BlockWriterType outputWriter;
+    bool directOutput = (specificSplitToDo == -1) && !genOutputDescriptionData;
+    if (directOutput)
+    {
+        outputWriter.SetFileName(m_OutputPrefix + ".mha");
+        outputWriter.SetReferenceImage(m_ComputationMask);
+        outputWriter.Initialize();
+    }
+
     for (unsigned int i = 0;i < splitIndexesToProcess.size();++i)
     {
         std::cout << "Processing block : " << splitIndexesToProcess[i][0] << " "
@@ -160,6 +170,14 @@ void LowMemoryCramersTestBridge::Update(int specificSplitToDo, bool genOutputDes
             m_OutlierMaskImages->Update();
         }
 
+        // Next block is read while this one is processed
+        if (i + 1 < splitIndexesToProcess.size())
+        {
+            m_InputImages->PrefetchBlock(splitIndexesToProcess[i + 1]);
+            if (m_OutlierMaskImages)
+                m_OutlierMaskImages->PrefetchBlock(splitIndexesToProcess[i + 1]);
+        }
+
         MainFilterType::Pointer cramersFilter = MainFilterType::New();
 
         for (unsigned int j = 0;j < m_InputImages->GetNbImages();++j)
@@ -180,6 +198,13 @@ void LowMemoryCramersTestBridge::Update(int specificSplitToDo, bool genOutputDes
 
         std::cout << "Results computed... Writing reference standard, bias and covariance images..." << std::endl;
 
+        if (directOutput)
+        {
+            outputWriter.WriteBlock(cramersFilter->GetOutput(),m_InputImages->GetBlockRegionInsideMargin(),
+                                    m_InputImages->GetBlockRegion().GetIndex());
+            continue;
+        }
+
         char numSplit[2048];
         sprintf(numSplit,"_%ld_%ld_%ld.nrrd",splitIndexesToProcess[i][0],splitIndexesToProcess[i][1],splitIndexesToProcess[i][2]);
 
@@ -188,6 +213,9 @@ void LowMemoryCramersTestBridge::Update(int specificSplitToDo, bool genOutputDes
         this->BuildAndWrite(cramersFilter->GetOutput(),outputName,m_InputImages->GetBlockRegionInsideMargin());
     }
 
+    if (directOutput)
+        outputWriter.Finalize();
+
     if (genOutputDescriptionData)
     {
         std::string mainOutDescroName = m_OutputPrefix + ".txt";
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <animaImageDataSplitter.h>
+#include <animaBlockImageWriter.h>
 #include <animaCramersTestImageFilter.h>
 
 namespace anima
@@ -15,6 +16,7 @@ public:
     typedef anima::CramersTestImageFilter<double> MainFilterType;
     typedef MainFilterType::MaskImageType MaskImageType;
     typedef anima::ImageDataSplitter < MaskImageType > MaskImageSplitterType;
+    typedef anima::BlockImageWriter < OutputImageType > BlockWriterType;
 
     LowMemoryCramersTestBridge();
     ~LowMemoryCramersTestBridge();
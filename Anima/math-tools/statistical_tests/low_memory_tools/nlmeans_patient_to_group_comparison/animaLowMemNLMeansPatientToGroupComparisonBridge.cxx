@@ -123,6 +123,30 @@ void LowMemoryNLMeansPatientToGroupComparisonBridge::Update(int specificSplitToD
         }
     }
 
+    // Without a specific split or output description, outputs are directly assembled into their final files
+    BlockWriterType outputPValWriter, outputScoreWriter, outputNPatchesWriter;
+    bool directOutput = (specificSplitToDo == -1) && !genOutputDescriptionData;
+    if (directOutput)
+    {
+        outputPValWriter.SetFileName(m_OutputPValName + ".mha");
+        outputPValWriter.SetReferenceImage(m_ComputationMask);
+        outputPValWriter.Initialize();
+
+        if (m_OutputScoreName != "")
+        {
+            outputScoreWriter.SetFileName(m_OutputScoreName + ".mha");
+            outputScoreWriter.SetReferenceImage(m_ComputationMask);
+            outputScoreWriter.Initialize();
+        }
+
+        if (m_OutputNPatchesName != "")
+        {
+            outputNPatchesWriter.SetFileName(m_OutputNPatchesName + ".mha");
+            outputNPatchesWriter.SetReferenceImage(m_ComputationMask);
+            outputNPatchesWriter.Initialize();
+        }
+    }
+
     for (unsigned int i = 0;i < splitIndexesToProcess.size();++i)
     {
         std::cout << "Processing block : " << splitIndexesToProcess[i][0] << " "
@@ -146,6 +170,17 @@ void LowMemoryNLMeansPatientToGroupComparisonBridge::Update(int specificSplitToD
         m_DatabaseMeanDistanceStd->SetBlockIndex(splitIndexesToProcess[i]);
         m_DatabaseMeanDistanceStd->Update();
 
+        // Reading of the next block overlaps with the computation on this one
+        if (i + 1 < splitIndexesToProcess.size())
+        {
+            m_DatabaseImages->PrefetchBlock(splitIndexesToProcess[i + 1]);
+            m_TestImage->PrefetchBlock(splitIndexesToProcess[i + 1]);
+            m_DatabaseCovarianceDistanceAverage->PrefetchBlock(splitIndexesToProcess[i + 1]);
+            m_DatabaseCovarianceDistanceStd->PrefetchBlock(splitIndexesToProcess[i + 1]);
+            m_DatabaseMeanDistanceAverage->PrefetchBlock(splitIndexesToProcess[i + 1]);
+            m_DatabaseMeanDistanceStd->PrefetchBlock(splitIndexesToProcess[i + 1]);
+        }
+
         MainFilterType::Pointer mainFilter = MainFilterType::New();
 
         for (unsigned int j = 0;j < m_DatabaseImages->GetNbImages();++j)
@@ -173,6 +208,21 @@ void LowMemoryNLMeansPatientToGroupComparisonBridge::Update(int specificSplitToD
 
         std::cout << "Results computed... Writing output parcel..." << std::endl;
 
+        if (directOutput)
+        {
+            OutputImageType::RegionType blockRegion = m_DatabaseImages->GetBlockRegionInsideMargin();
+            OutputImageType::IndexType outputIndex = m_DatabaseImages->GetBlockRegion().GetIndex();
+            outputPValWriter.WriteBlock(mainFilter->GetOutput(0),blockRegion,outputIndex);
+
+            if (m_OutputScoreName != "")
+                outputScoreWriter.WriteBlock(mainFilter->GetOutput(1),blockRegion,outputIndex);
+
+            if (m_OutputNPatchesName != "")
+                outputNPatchesWriter.WriteBlock(mainFilter->GetOutput(2),blockRegion,outputIndex);
+
+            continue;
+        }
+
         char numSplit[2048];
         sprintf(numSplit,"_%ld_%ld_%ld.nrrd",splitIndexesToProcess[i][0],splitIndexesToProcess[i][1],splitIndexesToProcess[i][2]);
 
@@ -189,6 +239,17 @@ void LowMemoryNLMeansPatientToGroupComparisonBridge::Update(int specificSplitToD
             this->BuildAndWrite(mainFilter->GetOutput(2),outputNPatchesName,m_DatabaseImages->GetBlockRegionInsideMargin());
     }
 
+    if (directOutput)
+    {
+        outputPValWriter.Finalize();
+
+        if (m_OutputScoreName != "")
+            outputScoreWriter.Finalize();
+
+        if (m_OutputNPatchesName != "")
+            outputNPatchesWriter.Finalize();
+    }
+
     if (genOutputDescriptionData)
     {
         std::vector <std::ofstream> mainOutFiles;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <animaImageDataSplitter.h>
+#include <animaBlockImageWriter.h>
 #include <animaNLMeansPatientToGroupComparisonImageFilter.h>
 
 namespace anima
@@ -15,6 +16,7 @@ public:
 
     typedef anima::ImageDataSplitter < InputImageType > ImageSplitterType;
     typedef anima::ImageDataSplitter < OutputImageType > ScalarImageSplitterType;
+    typedef anima::BlockImageWriter < OutputImageType > BlockWriterType;
     typedef anima::NLMeansPatientToGroupComparisonImageFilter<double> MainFilterType;
     typedef itk::Image <unsigned char,3> MaskImageType;
 
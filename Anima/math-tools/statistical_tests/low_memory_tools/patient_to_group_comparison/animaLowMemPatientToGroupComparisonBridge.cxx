@@ -79,6 +79,21 @@ void LowMemoryPatientToGroupComparisonBridge::Update(int specificSplitToDo, bool
         }
     }
 
+    // All blocks processed at once: outputs are assembled into their final files, no merge step needed.
+    // Block files are kept when their description is generated, since it lists them
+    BlockWriterType outputWriter, outputPValWriter;
+    bool directOutput = (specificSplitToDo == -1) && !genOutputDescriptionData;
+    if (directOutput)
+    {
+        outputWriter.SetFileName(m_OutputName + ".mha");
+        outputWriter.SetReferenceImage(m_ComputationMask);
+        outputWriter.Initialize();
+
+        outputPValWriter.SetFileName(m_OutputPValName + ".mha");
+        outputPValWriter.SetReferenceImage(m_ComputationMask);
+        outputPValWriter.Initialize();
+    }
+
     for (unsigned int i = 0;i < splitIndexesToProcess.size();++i)
     {
         std::cout << "Processing block : " << splitIndexesToProcess[i][0] << " "
@@ -90,6 +105,12 @@ void LowMemoryPatientToGroupComparisonBridge::Update(int specificSplitToDo, bool
         m_TestLTImage->SetBlockIndex(splitIndexesToProcess[i]);
         m_TestLTImage->Update();
 
+        if (i + 1 < splitIndexesToProcess.size())
+        {
+            m_DataLTImages->PrefetchBlock(splitIndexesToProcess[i + 1]);
+            m_TestLTImage->PrefetchBlock(splitIndexesToProcess[i + 1]);
+        }
+
         MainFilterType::Pointer mainFilter = MainFilterType::New();
 
         for (unsigned int j = 0;j < m_DataLTImages->GetNbImages();++j)
@@ -108,6 +129,15 @@ void LowMemoryPatientToGroupComparisonBridge::Update(int specificSplitToDo, bool
 
         std::cout << "Results computed... Writing output parcel..." << std::endl;
 
+        if (directOutput)
+        {
+            outputWriter.WriteBlock(mainFilter->GetOutput(0),m_DataLTImages->GetBlockRegionInsideMargin(),
+                                    m_DataLTImages->GetBlockRegion().GetIndex());
+            outputPValWriter.WriteBlock(mainFilter->GetOutput(1),m_DataLTImages->GetBlockRegionInsideMargin(),
+                                        m_DataLTImages->GetBlockRegion().GetIndex());
+            continue;
+        }
+
         char numSplit[2048];
         sprintf(numSplit,"_%ld_%ld_%ld.nrrd",splitIndexesToProcess[i][0],splitIndexesToProcess[i][1],splitIndexesToProcess[i][2]);
 
@@ -118,6 +148,12 @@ void LowMemoryPatientToGroupComparisonBridge::Update(int specificSplitToDo, bool
         this->BuildAndWrite(mainFilter->GetOutput(1),outputPValName,m_DataLTImages->GetBlockRegionInsideMargin());
     }
 
+    if (directOutput)
+    {
+        outputWriter.Finalize();
+        outputPValWriter.Finalize();
+    }
+
     if (genOutputDescriptionData)
     {
         std::string tmpOutName = m_OutputName + ".txt";
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <animaImageDataSplitter.h>
+#include <animaBlockImageWriter.h>
 #include <animaPatientToGroupComparisonImageFilter.h>
 
 namespace anima
@@ -13,6 +14,7 @@ public:
     typedef PatientToGroupComparisonImageFilter<double>::OutputImageType OutputImageType;
 
     typedef anima::ImageDataSplitter < InputImageType > ImageSplitterLTType;
+    typedef anima::BlockImageWriter < OutputImageType > BlockWriterType;
     typedef anima::PatientToGroupComparisonImageFilter<double> MainFilterType;
     typedef MainFilterType::TestType TestType;
     typedef itk::Image <unsigned char,3> MaskImageType;
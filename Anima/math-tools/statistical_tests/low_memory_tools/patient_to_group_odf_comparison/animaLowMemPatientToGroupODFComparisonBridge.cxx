@@ -81,6 +81,21 @@ void LowMemoryPatientToGroupODFComparisonBridge::Update(int specificSplitToDo, b
         }
     }
 
+    // All blocks processed at once: outputs are assembled into their final files, no merge step needed.
+    // Block files are kept when their description is generated, since it lists them
+    BlockWriterType outputWriter, outputPValWriter;
+    bool directOutput = (specificSplitToDo == -1) && !genOutputDescriptionData;
+    if (directOutput)
+    {
+        outputWriter.SetFileName(m_OutputName + ".mha");
+        outputWriter.SetReferenceImage(m_ComputationMask);
+        outputWriter.Initialize();
+
+        outputPValWriter.SetFileName(m_OutputPValName + ".mha");
+        outputPValWriter.SetReferenceImage(m_ComputationMask);
+        outputPValWriter.Initialize();
+    }
+
     for (unsigned int i = 0;i < splitIndexesToProcess.size();++i)
     {
         std::cout << "Processing block : " << splitIndexesToProcess[i][0] << " "
@@ -92,6 +107,12 @@ void LowMemoryPatientToGroupODFComparisonBridge::Update(int specificSplitToDo, b
         m_TestODFImage->SetBlockIndex(splitIndexesToProcess[i]);
         m_TestODFImage->Update();
 
+        if (i + 1 < splitIndexesToProcess.size())
+        {
+            m_DataODFImages->PrefetchBlock(splitIndexesToProcess[i + 1]);
+            m_TestODFImage->PrefetchBlock(splitIndexesToProcess[i + 1]);
+        }
+
         MainFilterType::Pointer mainFilter = MainFilterType::New();
 
         for (unsigned int j = 0;j < m_DataODFImages->GetNbImages();++j)
@@ -112,6 +133,15 @@ void LowMemoryPatientToGroupODFComparisonBridge::Update(int specificSplitToDo, b
 
         std::cout << "Results computed... Writing output parcel..." << std::endl;
 
+        if (directOutput)
+        {
+            outputWriter.WriteBlock(mainFilter->GetOutput(0),m_DataODFImages->GetBlockRegionInsideMargin(),
+                                    m_DataODFImages->GetBlockRegion().GetIndex());
+            outputPValWriter.WriteBlock(mainFilter->GetOutput(1),m_DataODFImages->GetBlockRegionInsideMargin(),
+                                        m_DataODFImages->GetBlockRegion().GetIndex());
+            continue;
+        }
+
         char numSplit[2048];
         sprintf(numSplit,"_%ld_%ld_%ld.nrrd",splitIndexesToProcess[i][0],splitIndexesToProcess[i][1],splitIndexesToProcess[i][2]);
 
@@ -122,6 +152,12 @@ void LowMemoryPatientToGroupODFComparisonBridge::Update(int specificSplitToDo, b
         this->BuildAndWrite(mainFilter->GetOutput(1),outputPValName,m_DataODFImages->GetBlockRegionInsideMargin());
     }
 
+    if (directOutput)
+    {
+        outputWriter.Finalize();
+        outputPValWriter.Finalize();
+    }
+
     if (genOutputDescriptionData)
     {
         std::string tmpOutName = m_OutputName + ".txt";
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <animaImageDataSplitter.h>
+#include <animaBlockImageWriter.h>
 #include <animaPatientToGroupODFComparisonImageFilter.h>
 
 namespace anima
@@ -13,6 +14,7 @@ public:
     typedef PatientToGroupODFComparisonImageFilter<double>::OutputImageType OutputImageType;
 
     typedef anima::ImageDataSplitter < InputImageType > ImageSplitterODFType;
+    typedef anima::BlockImageWriter < OutputImageType > BlockWriterType;
     typedef anima::PatientToGroupODFComparisonImageFilter<double> MainFilterType;
     typedef MainFilterType::TestType TestType;
     typedef itk::Image <unsigned char,3> MaskImageType;
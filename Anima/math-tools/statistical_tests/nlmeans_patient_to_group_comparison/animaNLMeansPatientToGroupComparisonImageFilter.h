@@ -72,6 +72,8 @@ protected:
     NLMeansPatientToGroupComparisonImageFilter()
         : Superclass()
     {
+        this->SetCompactedMaskExecution(true);
+
         this->SetNumberOfRequiredOutputs(3);
         this->SetNthOutput(0,this->MakeOutput(0));
         this->SetNthOutput(1,this->MakeOutput(1));
@@ -71,6 +71,8 @@ protected:
     PatientToGroupComparisonImageFilter()
         : Superclass()
     {
+        this->SetCompactedMaskExecution(true);
+
         this->SetNumberOfRequiredOutputs(2);
         this->SetNthOutput(0,this->MakeOutput(0));
         this->SetNthOutput(1,this->MakeOutput(1));
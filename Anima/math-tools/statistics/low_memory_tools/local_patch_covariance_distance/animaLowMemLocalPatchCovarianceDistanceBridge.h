@@ -1,6 +1,7 @@
 #pragma once
 
 #include <animaImageDataSplitter.h>
+#include <animaBlockImageWriter.h>
 #include <animaLocalPatchCovarianceDistanceImageFilter.h>
 
 namespace anima
@@ -14,6 +15,7 @@ public:
     typedef LocalPatchCovarianceDistanceImageFilter<double>::OutputImageRegionType OutputImageRegionType;
 
     typedef anima::ImageDataSplitter < InputImageType > ImageSplitterType;
+    typedef anima::BlockImageWriter < OutputImageType > BlockWriterType;
     typedef anima::LocalPatchCovarianceDistanceImageFilter<double> MainFilterType;
     typedef itk::Image <unsigned char,3> MaskImageType;
 
@@ -81,6 +81,23 @@ void LowMemoryLocalPatchMeanDistanceBridge::Update(int specificSplitToDo, bool g
         }
     }
 
+    // Running all splits without description: blocks are written into the final images, not into block files to merge
+    BlockWriterType outputMeanWriter, outputStdWriter;
+    bool directOutput = (specificSplitToDo == -1) && !genOutputDescriptionData;
+    if (directOutput)
+    {
+        outputMeanWriter.SetFileName(m_OutputMeanName + ".mha");
+        outputMeanWriter.SetReferenceImage(m_ComputationMask);
+        outputMeanWriter.Initialize();
+
+        if (m_OutputStdName != "")
+        {
+            outputStdWriter.SetFileName(m_OutputStdName + ".mha");
+            outputStdWriter.SetReferenceImage(m_ComputationMask);
+            outputStdWriter.Initialize();
+        }
+    }
+
     for (unsigned int i = 0;i < splitIndexesToProcess.size();++i)
     {
         std::cout << "Processing block : " << splitIndexesToProcess[i][0] << " "
@@ -89,6 +106,9 @@ void LowMemoryLocalPatchMeanDistanceBridge::Update(int specificSplitToDo, bool g
         m_DatabaseImages->SetBlockIndex(splitIndexesToProcess[i]);
         m_DatabaseImages->Update();
 
+        if (i + 1 < splitIndexesToProcess.size())
+            m_DatabaseImages->PrefetchBlock(splitIndexesToProcess[i + 1]);
+
         MainFilterType::Pointer mainFilter = MainFilterType::New();
 
         for (unsigned int j = 0;j < m_DatabaseImages->GetNbImages();++j)
@@ -103,6 +123,18 @@ void LowMemoryLocalPatchMeanDistanceBridge::Update(int specificSplitToDo, bool g
 
         std::cout << "Results computed... Writing output parcel..." << std::endl;
 
+        if (directOutput)
+        {
+            outputMeanWriter.WriteBlock(mainFilter->GetOutput(0),m_DatabaseImages->GetBlockRegionInsideMargin(),
+                                        m_DatabaseImages->GetBlockRegion().GetIndex());
+
+            if (m_OutputStdName != "")
+                outputStdWriter.WriteBlock(mainFilter->GetOutput(1),m_DatabaseImages->GetBlockRegionInsideMargin(),
+                                           m_DatabaseImages->GetBlockRegion().GetIndex());
+
+            continue;
+        }
+
         char numSplit[2048];
         sprintf(numSplit,"_%ld_%ld_%ld.nrrd",splitIndexesToProcess[i][0],splitIndexesToProcess[i][1],splitIndexesToProcess[i][2]);
 
@@ -115,6 +147,14 @@ void LowMemoryLocalPatchMeanDistanceBridge::Update(int specificSplitToDo, bool g
             this->BuildAndWrite(mainFilter->GetOutput(1),outputStdName,m_DatabaseImages->GetBlockRegionInsideMargin());
     }
 
+    if (directOutput)
+    {
+        outputMeanWriter.Finalize();
+
+        if (m_OutputStdName != "")
+            outputStdWriter.Finalize();
+    }
+
     if (genOutputDescriptionData)
     {
         std::vector <std::ofstream> mainOutFiles;
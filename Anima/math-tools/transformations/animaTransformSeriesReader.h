@@ -1,6 +1,12 @@
 #pragma once
 
 #include <itkCompositeTransform.h>
+#include <itkImage.h>
+#include <itkImageIOBase.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
 
 namespace anima
 {
@@ -26,6 +32,9 @@ public:
     typedef itk::CompositeTransform <TScalarType,NDimensions> OutputTransformType;
     typedef typename OutputTransformType::Pointer OutputTransformPointer;
 
+    typedef itk::Image <itk::Vector <TScalarType,NDimensions>, NDimensions> DisplacementFieldType;
+    typedef typename DisplacementFieldType::Pointer DisplacementFieldPointer;
+
     TransformSeriesReader();
     ~TransformSeriesReader();
 
@@ -34,6 +43,15 @@ public:
     void SetNumberOfWorkUnits(unsigned int num) {m_NumberOfThreads = num;}
     void SetExponentiationOrder(unsigned int val) {m_ExponentiationOrder = val;}
 
+    /**
+     * Flattens non linear transform series into a single dense displacement field, computed once on the geometry
+     * given by SetFlatteningGeometry. If a cache directory is set, flattened fields are stored there, keyed by the
+     * transform list contents, transform files and geometry, and reused by subsequent runs.
+     */
+    void SetFlattenTransform(bool val) {m_FlattenTransform = val;}
+    void SetFlatteningGeometry(itk::ImageIOBase *geometryIO);
+    void SetFlatteningCacheDirectory(std::string const& dirName) {m_FlatteningCacheDirectory = dirName;}
+
     void Update();
 
     OutputTransformType *GetOutputTransform() {return m_OutputTransform;}
@@ -43,6 +61,22 @@ protected:
     void addSVFTransformation(std::string &fileName, bool invert);
     void addDenseTransformation(std::string &fileName, bool invert);
 
+    //! Computes the dense displacement field of the whole series on the flattening geometry
+    DisplacementFieldPointer computeFlattenedField();
+
+    /**
+     * Key identifying a flattened field from the transform list, its files (path, size and modification time) and
+     * the flattening geometry. The key is stored in the cached field and checked when loading it
+     */
+    std::string computeFlatteningCacheKey(const std::vector <TransformInformation> &transformationList);
+
+    //! Loads a cached flattened field if it matches the key and is more recent than all transform files
+    DisplacementFieldPointer readFlatteningCache(const std::string &cacheFileName, const std::string &cacheKey,
+                                                 const std::vector <TransformInformation> &transformationList);
+
+    //! 64 bits FNV-1a hash, fixed so that cache file names do not depend on the standard library
+    static uint64_t computeFNVHash(const std::string &data);
+
 private:
     OutputTransformPointer m_OutputTransform;
     bool m_InvertTransform;
@@ -51,6 +85,10 @@ private:
     unsigned int m_ExponentiationOrder;
 
     std::string m_Input;
+
+    bool m_FlattenTransform;
+    DisplacementFieldPointer m_FlatteningGeometry;
+    std::string m_FlatteningCacheDirectory;
 };
 
 } // end namespace itk
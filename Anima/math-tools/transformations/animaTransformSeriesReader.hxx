@@ -5,12 +5,21 @@
 
 #include <itkTransformFileReader.h>
 #include <itkImageFileReader.h>
+#include <itkImageFileWriter.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkMetaDataObject.h>
+#include <itksys/SystemTools.hxx>
 
 #include <itkMatrixOffsetTransformBase.h>
 #include <itkStationaryVelocityFieldTransform.h>
 #include <rpiDisplacementFieldTransform.h>
 #include <animaVelocityUtils.h>
 
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <random>
+
 namespace anima
 {
 
@@ -23,6 +32,10 @@ TransformSeriesReader<TScalarType,NDimensions>
 
     m_ExponentiationOrder = 1;
     m_NumberOfThreads = itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads();
+
+    m_FlattenTransform = false;
+    m_FlatteningGeometry = NULL;
+    m_FlatteningCacheDirectory = "";
 }
 
 template <class TScalarType, unsigned int NDimensions>
@@ -108,6 +121,44 @@ TransformSeriesReader<TScalarType,NDimensions>
         }
     }
 
+    // Flattening is only useful if the series has non linear transforms
+    bool flattenSeries = false;
+    if (m_FlattenTransform && m_FlatteningGeometry)
+    {
+        for (unsigned int i = 0;i < transformationList.size();++i)
+        {
+            if (transformationList[i].trType != LINEAR)
+            {
+                flattenSeries = true;
+                break;
+            }
+        }
+    }
+
+    typedef rpi::DisplacementFieldTransform <TScalarType,NDimensions> DenseTransformType;
+    typedef typename DenseTransformType::Pointer DenseTransformPointer;
+
+    std::string cacheFileName, cacheKey;
+    if (flattenSeries && (m_FlatteningCacheDirectory != ""))
+    {
+        cacheKey = this->computeFlatteningCacheKey(transformationList);
+
+        std::ostringstream hashStream;
+        hashStream << std::hex << std::setw(16) << std::setfill('0') << computeFNVHash(cacheKey);
+        cacheFileName = m_FlatteningCacheDirectory + "/animaFlattenedTransform_" + hashStream.str() + ".nrrd";
+
+        DisplacementFieldPointer cachedField = this->readFlatteningCache(cacheFileName,cacheKey,transformationList);
+        if (cachedField)
+        {
+            DenseTransformPointer dispTrsf = DenseTransformType::New();
+            dispTrsf->SetParametersAsVectorField(cachedField.GetPointer());
+            m_OutputTransform->AddTransform(dispTrsf);
+
+            std::cout << "Loaded flattened transformation from cache file: " << cacheFileName << std::endl;
+            return;
+        }
+    }
+
     // Now really load and handle global and local transform serie inversion
     // The fact that you have to apply transforms in the reverse order than the one in text file
     // is handled by the general transform
@@ -156,6 +207,252 @@ TransformSeriesReader<TScalarType,NDimensions>
     }
 
     std::cout << "Loaded " << m_OutputTransform->GetNumberOfTransforms() << " transformations from transform list file: " << m_Input << std::endl;
+
+    if (!flattenSeries)
+        return;
+
+    DisplacementFieldPointer flattenedField = this->computeFlattenedField();
+
+    m_OutputTransform = OutputTransformType::New();
+    DenseTransformPointer dispTrsf = DenseTransformType::New();
+    dispTrsf->SetParametersAsVectorField(flattenedField.GetPointer());
+    m_OutputTransform->AddTransform(dispTrsf);
+
+    std::cout << "Flattened transformation series into a single dense field" << std::endl;
+
+    if (cacheFileName == "")
+        return;
+
+    // Write to a temporary file first, so that concurrent runs never read a partially written field
+    std::random_device randomDevice;
+    std::ostringstream tmpFileName;
+    tmpFileName << cacheFileName << "." << std::hex << randomDevice() << ".nrrd";
+
+    itk::EncapsulateMetaData <std::string> (flattenedField->GetMetaDataDictionary(),"AnimaFlatteningKey",cacheKey);
+
+    typedef itk::ImageFileWriter <DisplacementFieldType> FieldWriterType;
+    typename FieldWriterType::Pointer fieldWriter = FieldWriterType::New();
+    fieldWriter->SetInput(flattenedField);
+    fieldWriter->SetFileName(tmpFileName.str());
+    fieldWriter->Update();
+
+    itksys::SystemTools::RenameFile(tmpFileName.str(),cacheFileName);
+}
+
+template <class TScalarType, unsigned int NDimensions>
+void
+TransformSeriesReader<TScalarType,NDimensions>
+::SetFlatteningGeometry(itk::ImageIOBase *geometryIO)
+{
+    m_FlatteningGeometry = DisplacementFieldType::New();
+
+    typename DisplacementFieldType::RegionType region;
+    typename DisplacementFieldType::PointType origin;
+    typename DisplacementFieldType::SpacingType spacing;
+    typename DisplacementFieldType::DirectionType direction;
+    direction.SetIdentity();
+
+    unsigned int imageIODimension = std::min(geometryIO->GetNumberOfDimensions(),NDimensions);
+    for (unsigned int i = 0;i < NDimensions;++i)
+    {
+        region.SetIndex(i,0);
+        region.SetSize(i,1);
+        origin[i] = 0;
+        spacing[i] = 1;
+    }
+
+    for (unsigned int i = 0;i < imageIODimension;++i)
+    {
+        region.SetSize(i,geometryIO->GetDimensions(i));
+        origin[i] = geometryIO->GetOrigin(i);
+        spacing[i] = geometryIO->GetSpacing(i);
+        for (unsigned int j = 0;j < imageIODimension;++j)
+            direction(i,j) = geometryIO->GetDirection(j)[i];
+    }
+
+    m_FlatteningGeometry->SetRegions(region);
+    m_FlatteningGeometry->SetOrigin(origin);
+    m_FlatteningGeometry->SetSpacing(spacing);
+    m_FlatteningGeometry->SetDirection(direction);
+}
+
+template <class TScalarType, unsigned int NDimensions>
+std::string
+TransformSeriesReader<TScalarType,NDimensions>
+::computeFlatteningCacheKey(const std::vector <TransformInformation> &transformationList)
+{
+    std::ostringstream keyStream;
+    keyStream << std::setprecision(17);
+
+    // The key is stored in a NRRD header field, the list file is thus only included through its hash
+    std::ifstream xmlFile(m_Input.c_str());
+    std::ostringstream xmlContent;
+    xmlContent << xmlFile.rdbuf();
+    keyStream << std::hex << computeFNVHash(xmlContent.str()) << std::dec;
+
+    keyStream << "|" << m_InvertTransform << "|" << m_ExponentiationOrder;
+
+    for (unsigned int i = 0;i < transformationList.size();++i)
+    {
+        std::string fileName = transformationList[i].fileName;
+        keyStream << "|" << itksys::SystemTools::CollapseFullPath(fileName);
+        keyStream << "|" << itksys::SystemTools::FileLength(fileName);
+        keyStream << "|" << itksys::SystemTools::ModifiedTime(fileName);
+    }
+
+    typename DisplacementFieldType::RegionType region = m_FlatteningGeometry->GetLargestPossibleRegion();
+    for (unsigned int i = 0;i < NDimensions;++i)
+    {
+        keyStream << "|" << region.GetSize(i) << "|" << m_FlatteningGeometry->GetOrigin()[i];
+        keyStream << "|" << m_FlatteningGeometry->GetSpacing()[i];
+        for (unsigned int j = 0;j < NDimensions;++j)
+            keyStream << "|" << m_FlatteningGeometry->GetDirection()(i,j);
+    }
+
+    return keyStream.str();
+}
+
+template <class TScalarType, unsigned int NDimensions>
+typename TransformSeriesReader<TScalarType,NDimensions>::DisplacementFieldPointer
+TransformSeriesReader<TScalarType,NDimensions>
+::readFlatteningCache(const std::string &cacheFileName, const std::string &cacheKey,
+                      const std::vector <TransformInformation> &transformationList)
+{
+    if (!itksys::SystemTools::FileExists(cacheFileName,true))
+        return NULL;
+
+    // Modification times have a one second resolution: a transform file rewritten in the same second as the
+    // cache could keep its size and time, the cache is then not trusted
+    long int cacheTime = itksys::SystemTools::ModifiedTime(cacheFileName);
+    for (unsigned int i = 0;i < transformationList.size();++i)
+    {
+        if (itksys::SystemTools::ModifiedTime(transformationList[i].fileName) >= cacheTime)
+            return NULL;
+    }
+
+    typedef itk::ImageFileReader <DisplacementFieldType> FieldReaderType;
+    typename FieldReaderType::Pointer fieldReader = FieldReaderType::New();
+    fieldReader->SetFileName(cacheFileName);
+    fieldReader->UpdateOutputInformation();
+
+    std::string storedKey;
+    if (!itk::ExposeMetaData <std::string> (fieldReader->GetImageIO()->GetMetaDataDictionary(),"AnimaFlatteningKey",storedKey))
+        return NULL;
+
+    if (storedKey != cacheKey)
+        return NULL;
+
+    fieldReader->Update();
+
+    DisplacementFieldPointer cachedField = fieldReader->GetOutput();
+    cachedField->DisconnectPipeline();
+
+    return cachedField;
+}
+
+template <class TScalarType, unsigned int NDimensions>
+uint64_t
+TransformSeriesReader<TScalarType,NDimensions>
+::computeFNVHash(const std::string &data)
+{
+    uint64_t hashValue = 14695981039346656037ULL;
+    for (unsigned int i = 0;i < data.size();++i)
+    {
+        hashValue ^= (unsigned char)data[i];
+        hashValue *= 1099511628211ULL;
+    }
+
+    return hashValue;
+}
+
+template <class TScalarType, unsigned int NDimensions>
+typename TransformSeriesReader<TScalarType,NDimensions>::DisplacementFieldPointer
+TransformSeriesReader<TScalarType,NDimensions>
+::computeFlattenedField()
+{
+    typedef typename OutputTransformType::TransformType BaseTransformType;
+    typedef typename BaseTransformType::ConstPointer BaseTransformConstPointer;
+    typedef itk::MatrixOffsetTransformBase <TScalarType,NDimensions> MatrixTransformType;
+    typedef typename MatrixTransformType::Pointer MatrixTransformPointer;
+
+    // Composite transforms apply their last transform first. Consecutive linear transforms are fused
+    // into a single matrix, so that each voxel only goes through the non linear stages and their linear links
+    std::vector <BaseTransformConstPointer> stages;
+    MatrixTransformPointer currentLinear;
+    for (int i = m_OutputTransform->GetNumberOfTransforms() - 1;i >= 0;--i)
+    {
+        const BaseTransformType *trsf = m_OutputTransform->GetNthTransformConstPointer(i);
+        const MatrixTransformType *linearTrsf = dynamic_cast <const MatrixTransformType *> (trsf);
+
+        if (!linearTrsf)
+        {
+            if (currentLinear)
+                stages.push_back(currentLinear.GetPointer());
+
+            currentLinear = NULL;
+            stages.push_back(trsf);
+            continue;
+        }
+
+        if (!currentLinear)
+        {
+            currentLinear = MatrixTransformType::New();
+            currentLinear->SetMatrix(linearTrsf->GetMatrix());
+            currentLinear->SetOffset(linearTrsf->GetOffset());
+        }
+        else
+        {
+            // x -> A2 (A1 x + b1) + b2
+            typename MatrixTransformType::MatrixType fusedMatrix = linearTrsf->GetMatrix() * currentLinear->GetMatrix();
+            typename MatrixTransformType::OutputVectorType fusedOffset = linearTrsf->GetMatrix() * currentLinear->GetOffset();
+            fusedOffset += linearTrsf->GetOffset();
+
+            currentLinear->SetMatrix(fusedMatrix);
+            currentLinear->SetOffset(fusedOffset);
+        }
+    }
+
+    if (currentLinear)
+        stages.push_back(currentLinear.GetPointer());
+
+    DisplacementFieldPointer flattenedField = DisplacementFieldType::New();
+    flattenedField->Initialize();
+    flattenedField->SetRegions(m_FlatteningGeometry->GetLargestPossibleRegion());
+    flattenedField->SetOrigin(m_FlatteningGeometry->GetOrigin());
+    flattenedField->SetSpacing(m_FlatteningGeometry->GetSpacing());
+    flattenedField->SetDirection(m_FlatteningGeometry->GetDirection());
+    flattenedField->Allocate();
+
+    typedef typename DisplacementFieldType::RegionType RegionType;
+    typedef typename BaseTransformType::InputPointType PointType;
+
+    itk::MultiThreaderBase::Pointer threader = itk::MultiThreaderBase::New();
+    threader->SetNumberOfWorkUnits(m_NumberOfThreads);
+    threader->template ParallelizeImageRegion<NDimensions> (
+        flattenedField->GetLargestPossibleRegion(),
+        [&flattenedField,&stages](const RegionType &regionForThread)
+        {
+            itk::ImageRegionIteratorWithIndex <DisplacementFieldType> fieldItr(flattenedField,regionForThread);
+            PointType inputPoint, transformedPoint;
+            typename DisplacementFieldType::PixelType displacement;
+
+            while (!fieldItr.IsAtEnd())
+            {
+                flattenedField->TransformIndexToPhysicalPoint(fieldItr.GetIndex(),inputPoint);
+
+                transformedPoint = inputPoint;
+                for (unsigned int i = 0;i < stages.size();++i)
+                    transformedPoint = stages[i]->TransformPoint(transformedPoint);
+
+                for (unsigned int i = 0;i < NDimensions;++i)
+                    displacement[i] = transformedPoint[i] - inputPoint[i];
+
+                fieldItr.Set(displacement);
+                ++fieldItr;
+            }
+        }, NULL);
+
+    return flattenedField;
 }
 
 template <class TScalarType, unsigned int NDimensions>
@@ -0,0 +1,149 @@
+#include "animaEPGSignalDictionary.h"
+
+#include <animaEPGSignalSimulator.h>
+#include <animaGaussLegendreQuadrature.h>
+#include <animaEPGProfileIntegrands.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace anima
+{
+
+EPGSignalDictionary::EPGSignalDictionary()
+{
+    m_NumberOfEchoes = 1;
+    m_EchoSpacing = 10;
+    m_ExcitationFlipAngle = M_PI / 2.0;
+    m_T1Value = 1000;
+
+    m_LowerFlipAngle = M_PI / 2.0;
+    m_UpperFlipAngle = M_PI;
+    m_NumberOfFlipAngles = 500;
+    m_FlipAngleStep = 0;
+
+    m_UniformPulses = true;
+    m_PixelWidth = 3.0;
+
+    m_Computed = false;
+}
+
+void EPGSignalDictionary::Compute()
+{
+    if ((m_NumberOfFlipAngles < 2) || (m_UpperFlipAngle <= m_LowerFlipAngle))
+        throw std::invalid_argument("EPG dictionary requires at least two flip angles on a non empty range");
+
+    unsigned int numT2Values = m_T2Values.size();
+    m_FlipAngleStep = (m_UpperFlipAngle - m_LowerFlipAngle) / (m_NumberOfFlipAngles - 1.0);
+
+    m_Signals.resize(numT2Values * m_NumberOfFlipAngles * m_NumberOfEchoes);
+    m_Derivatives.resize(m_Signals.size());
+
+    anima::EPGSignalSimulator t2SignalSimulator;
+    t2SignalSimulator.SetNumberOfEchoes(m_NumberOfEchoes);
+    t2SignalSimulator.SetEchoSpacing(m_EchoSpacing);
+    t2SignalSimulator.SetExcitationFlipAngle(m_ExcitationFlipAngle);
+
+    anima::EPGSignalSimulator::RealVectorType subSignalData(m_NumberOfEchoes,0);
+
+    for (unsigned int i = 0;i < numT2Values;++i)
+    {
+        for (unsigned int j = 0;j < m_NumberOfFlipAngles;++j)
+        {
+            double flipAngle = m_LowerFlipAngle + j * m_FlipAngleStep;
+            unsigned int baseIndex = (i * m_NumberOfFlipAngles + j) * m_NumberOfEchoes;
+
+            if (m_UniformPulses)
+            {
+                subSignalData = t2SignalSimulator.GetValue(m_T1Value,m_T2Values[i],flipAngle,1.0);
+                anima::EPGSignalSimulator::RealVectorType &derivativeData = t2SignalSimulator.GetFADerivative();
+
+                for (unsigned int k = 0;k < m_NumberOfEchoes;++k)
+                    m_Derivatives[baseIndex + k] = derivativeData[k];
+            }
+            else
+            {
+                double halfPixelWidth = m_PixelWidth / 2.0;
+                anima::GaussLegendreQuadrature integral;
+                integral.SetInterestZone(- halfPixelWidth, halfPixelWidth);
+                integral.SetNumberOfComponents(m_NumberOfEchoes);
+
+                anima::EPGMonoT2Integrand integrand;
+                integrand.SetFlipAngle(flipAngle);
+                integrand.SetSignalSimulator(t2SignalSimulator);
+                integrand.SetT1Value(m_T1Value);
+                integrand.SetT2Value(m_T2Values[i]);
+                integrand.SetSlicePulseProfile(m_PulseProfile);
+                integrand.SetSliceExcitationProfile(m_ExcitationProfile);
+
+                subSignalData = integral.GetVectorIntegralValue(integrand);
+                for (unsigned int k = 0;k < m_NumberOfEchoes;++k)
+                    subSignalData[k] /= m_PixelWidth;
+            }
+
+            for (unsigned int k = 0;k < m_NumberOfEchoes;++k)
+                m_Signals[baseIndex + k] = subSignalData[k];
+        }
+
+        if (m_UniformPulses)
+            continue;
+
+        // No closed form derivative of the profile integral, use finite differences on the fine grid
+        for (unsigned int j = 0;j < m_NumberOfFlipAngles;++j)
+        {
+            unsigned int previousIndex = std::max(j,(unsigned int)1) - 1;
+            unsigned int nextIndex = std::min(j + 1,m_NumberOfFlipAngles - 1);
+            double spacing = (nextIndex - previousIndex) * m_FlipAngleStep;
+
+            unsigned int baseIndex = (i * m_NumberOfFlipAngles + j) * m_NumberOfEchoes;
+            unsigned int previousBaseIndex = (i * m_NumberOfFlipAngles + previousIndex) * m_NumberOfEchoes;
+            unsigned int nextBaseIndex = (i * m_NumberOfFlipAngles + nextIndex) * m_NumberOfEchoes;
+
+            for (unsigned int k = 0;k < m_NumberOfEchoes;++k)
+                m_Derivatives[baseIndex + k] = (m_Signals[nextBaseIndex + k] - m_Signals[previousBaseIndex + k]) / spacing;
+        }
+    }
+
+    m_Computed = true;
+}
+
+bool EPGSignalDictionary::IsInRange(double flipAngle) const
+{
+    if (!m_Computed)
+        return false;
+
+    return (flipAngle >= m_LowerFlipAngle) && (flipAngle <= m_UpperFlipAngle);
+}
+
+void EPGSignalDictionary::GetSignalMatrix(double flipAngle, vnl_matrix <double> &signalMatrix) const
+{
+    unsigned int numT2Values = m_T2Values.size();
+    signalMatrix.set_size(m_NumberOfEchoes,numT2Values);
+
+    double position = (flipAngle - m_LowerFlipAngle) / m_FlipAngleStep;
+    unsigned int lowerIndex = std::min((unsigned int)std::max(0.0,std::floor(position)),m_NumberOfFlipAngles - 2);
+    double t = position - lowerIndex;
+
+    // Cubic Hermite basis
+    double t2 = t * t;
+    double t3 = t2 * t;
+    double h00 = 2.0 * t3 - 3.0 * t2 + 1.0;
+    double h10 = (t3 - 2.0 * t2 + t) * m_FlipAngleStep;
+    double h01 = - 2.0 * t3 + 3.0 * t2;
+    double h11 = (t3 - t2) * m_FlipAngleStep;
+
+    for (unsigned int i = 0;i < numT2Values;++i)
+    {
+        unsigned int lowerBaseIndex = (i * m_NumberOfFlipAngles + lowerIndex) * m_NumberOfEchoes;
+        unsigned int upperBaseIndex = lowerBaseIndex + m_NumberOfEchoes;
+
+        for (unsigned int k = 0;k < m_NumberOfEchoes;++k)
+        {
+            signalMatrix(k,i) = h00 * m_Signals[lowerBaseIndex + k] + h10 * m_Derivatives[lowerBaseIndex + k]
+                    + h01 * m_Signals[upperBaseIndex + k] + h11 * m_Derivatives[upperBaseIndex + k];
+        }
+    }
+}
+
+} // end namespace anima
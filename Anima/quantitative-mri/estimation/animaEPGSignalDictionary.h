@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <vnl/vnl_matrix.h>
+
+#include "AnimaRelaxometryExport.h"
+
+namespace anima
+{
+
+/**
+ * \class EPGSignalDictionary
+ * @brief Precomputed EPG echo trains for a fixed set of T2 values on a regular flip angle grid.
+ *
+ * Signals and their flip angle derivatives are tabulated once (possibly integrated over slice profiles
+ * for non uniform pulses), then interpolated with cubic Hermite splines. Once computed, the dictionary is
+ * only read and may be shared between threads. T1 is fixed for the whole dictionary.
+ */
+class ANIMARELAXOMETRY_EXPORT EPGSignalDictionary
+{
+public:
+    EPGSignalDictionary();
+    virtual ~EPGSignalDictionary() {}
+
+    void SetNumberOfEchoes(unsigned int val) {m_NumberOfEchoes = val;}
+    void SetEchoSpacing(double val) {m_EchoSpacing = val;}
+    void SetExcitationFlipAngle(double val) {m_ExcitationFlipAngle = val;}
+    void SetT1Value(double val) {m_T1Value = val;}
+    void SetT2Values(const std::vector <double> &values) {m_T2Values = values;}
+
+    //! Flip angle range (in radians) covered by the dictionary
+    void SetFlipAngleRange(double lowerValue, double upperValue) {m_LowerFlipAngle = lowerValue; m_UpperFlipAngle = upperValue;}
+    void SetNumberOfFlipAngles(unsigned int val) {m_NumberOfFlipAngles = val;}
+
+    void SetUniformPulses(bool val) {m_UniformPulses = val;}
+    void SetPixelWidth(double val) {m_PixelWidth = val;}
+    void SetPulseProfile(const std::vector < std::pair <double, double> > &profile) {m_PulseProfile = profile;}
+    void SetExcitationProfile(const std::vector < std::pair <double, double> > &profile) {m_ExcitationProfile = profile;}
+
+    unsigned int GetNumberOfEchoes() const {return m_NumberOfEchoes;}
+    unsigned int GetNumberOfT2Values() const {return m_T2Values.size();}
+    bool IsComputed() const {return m_Computed;}
+
+    //! Simulates all echo trains of the dictionary
+    void Compute();
+
+    //! Checks that a flip angle can be interpolated from the dictionary
+    bool IsInRange(double flipAngle) const;
+
+    //! Fills a (number of echoes x number of T2 values) matrix with the interpolated signals at a flip angle
+    void GetSignalMatrix(double flipAngle, vnl_matrix <double> &signalMatrix) const;
+
+private:
+    unsigned int m_NumberOfEchoes;
+    double m_EchoSpacing;
+    double m_ExcitationFlipAngle;
+    double m_T1Value;
+    std::vector <double> m_T2Values;
+
+    double m_LowerFlipAngle, m_UpperFlipAngle;
+    unsigned int m_NumberOfFlipAngles;
+    double m_FlipAngleStep;
+
+    bool m_UniformPulses;
+    double m_PixelWidth;
+    std::vector < std::pair <double, double> > m_PulseProfile;
+    std::vector < std::pair <double, double> > m_ExcitationProfile;
+
+    bool m_Computed;
+
+    // Signals and flip angle derivatives, stored as [(t2 * numFlipAngles + flipAngle) * numEchoes + echo]
+    std::vector <double> m_Signals;
+    std::vector <double> m_Derivatives;
+};
+
+} // end namespace anima
@@ -13,42 +13,50 @@ MultiT2EPGRelaxometryCostFunction::GetValue(const ParametersType & parameters) c
     unsigned int numT2Signals = m_T2RelaxometrySignals.size();
     unsigned int numT2Peaks = m_T2Values.size();
 
-    m_AMatrix.set_size(numT2Signals, numT2Peaks);
+    bool useDictionary = (m_EPGDictionary != nullptr) && (m_EPGDictionary->GetNumberOfEchoes() == numT2Signals)
+            && (m_EPGDictionary->GetNumberOfT2Values() == numT2Peaks) && (m_EPGDictionary->IsInRange(parameters[0]));
 
-    anima::EPGSignalSimulator t2SignalSimulator;
-    t2SignalSimulator.SetNumberOfEchoes(numT2Signals);
-    t2SignalSimulator.SetEchoSpacing(m_EchoSpacing);
-    t2SignalSimulator.SetExcitationFlipAngle(m_ExcitationFlipAngle);
+    if (useDictionary)
+        m_EPGDictionary->GetSignalMatrix(parameters[0],m_AMatrix);
+    else
+    {
+        m_AMatrix.set_size(numT2Signals, numT2Peaks);
 
-    anima::EPGSignalSimulator::RealVectorType simulatedT2Values(numT2Signals,0);
-    anima::EPGSignalSimulator::RealVectorType subSignalData(numT2Signals,0);
+        anima::EPGSignalSimulator t2SignalSimulator;
+        t2SignalSimulator.SetNumberOfEchoes(numT2Signals);
+        t2SignalSimulator.SetEchoSpacing(m_EchoSpacing);
+        t2SignalSimulator.SetExcitationFlipAngle(m_ExcitationFlipAngle);
 
-    for (unsigned int i = 0;i < numT2Peaks;++i)
-    {
-        if (m_UniformPulses)
-            subSignalData = t2SignalSimulator.GetValue(m_T1Value,m_T2Values[i],parameters[0],1.0);
-        else
+        anima::EPGSignalSimulator::RealVectorType simulatedT2Values(numT2Signals,0);
+        anima::EPGSignalSimulator::RealVectorType subSignalData(numT2Signals,0);
+
+        for (unsigned int i = 0;i < numT2Peaks;++i)
         {
-            double halfPixelWidth = m_PixelWidth / 2.0;
-            anima::GaussLegendreQuadrature integral;
-            integral.SetInterestZone(- halfPixelWidth, halfPixelWidth);
-            integral.SetNumberOfComponents(numT2Signals);
-
-            anima::EPGMonoT2Integrand integrand;
-            integrand.SetFlipAngle(parameters[0]);
-            integrand.SetSignalSimulator(t2SignalSimulator);
-            integrand.SetT1Value(m_T1Value);
-            integrand.SetT2Value(m_T2Values[i]);
-            integrand.SetSlicePulseProfile(m_PulseProfile);
-            integrand.SetSliceExcitationProfile(m_ExcitationProfile);
-
-            subSignalData = integral.GetVectorIntegralValue(integrand);
-            for (unsigned int i = 0;i < numT2Signals;++i)
-                subSignalData[i] /= m_PixelWidth;
-        }
+            if (m_UniformPulses)
+                subSignalData = t2SignalSimulator.GetValue(m_T1Value,m_T2Values[i],parameters[0],1.0);
+            else
+            {
+                double halfPixelWidth = m_PixelWidth / 2.0;
+                anima::GaussLegendreQuadrature integral;
+                integral.SetInterestZone(- halfPixelWidth, halfPixelWidth);
+                integral.SetNumberOfComponents(numT2Signals);
+
+                anima::EPGMonoT2Integrand integrand;
+                integrand.SetFlipAngle(parameters[0]);
+                integrand.SetSignalSimulator(t2SignalSimulator);
+                integrand.SetT1Value(m_T1Value);
+                integrand.SetT2Value(m_T2Values[i]);
+                integrand.SetSlicePulseProfile(m_PulseProfile);
+                integrand.SetSliceExcitationProfile(m_ExcitationProfile);
 
-        for (unsigned int j = 0;j < numT2Signals;++j)
-            m_AMatrix(j,i) = subSignalData[j];
+                subSignalData = integral.GetVectorIntegralValue(integrand);
+                for (unsigned int i = 0;i < numT2Signals;++i)
+                    subSignalData[i] /= m_PixelWidth;
+            }
+
+            for (unsigned int j = 0;j < numT2Signals;++j)
+                m_AMatrix(j,i) = subSignalData[j];
+        }
     }
 
     m_NNLSOptimizer->SetDataMatrix(m_AMatrix);
@@ -3,6 +3,7 @@
 #include <vnl/vnl_matrix.h>
 #include <itkSingleValuedCostFunction.h>
 #include <animaNNLSOptimizer.h>
+#include <animaEPGSignalDictionary.h>
 #include "AnimaRelaxometryExport.h"
 
 namespace anima
@@ -56,6 +57,9 @@ public:
     void SetPulseProfile(std::vector < std::pair <double, double> > &profile) {m_PulseProfile = profile;}
     void SetExcitationProfile(std::vector < std::pair <double, double> > &profile) {m_ExcitationProfile = profile;}
 
+    //! Optional precomputed signals (same T1, T2 values and sequence parameters), used instead of EPG simulation for flip angles in its range
+    void SetEPGDictionary(const anima::EPGSignalDictionary *dictionary) {m_EPGDictionary = dictionary;}
+
     unsigned int GetNumberOfParameters() const ITK_OVERRIDE
     {
         return 1;
@@ -72,6 +76,8 @@ protected:
 
         m_UniformPulses = true;
         m_PixelWidth = 3.0;
+
+        m_EPGDictionary = nullptr;
     }
 
     virtual ~MultiT2EPGRelaxometryCostFunction() {}
@@ -93,6 +99,8 @@ private:
 
     double m_T1Value;
 
+    const anima::EPGSignalDictionary *m_EPGDictionary;
+
     mutable NNLSOptimizerPointer m_NNLSOptimizer;
     mutable vnl_matrix <double> m_AMatrix;
     mutable ParametersType m_OptimizedT2Weights;
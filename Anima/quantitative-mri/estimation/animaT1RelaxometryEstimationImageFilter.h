@@ -46,6 +46,8 @@ protected:
     T1RelaxometryEstimationImageFilter()
     : Superclass()
     {
+        this->SetCompactedMaskExecution(true);
+
         // There are 2 outputs: T1, M0
         this->SetNumberOfRequiredOutputs(2);
 
@@ -48,6 +48,8 @@ protected:
     T1SERelaxometryEstimationImageFilter()
     : Superclass()
     {
+        this->SetCompactedMaskExecution(true);
+
         // There are 2 outputs: M0, T1
         this->SetNumberOfRequiredOutputs(2);
 
@@ -61,6 +61,8 @@ protected:
     T2EPGRelaxometryEstimationImageFilter()
     : Superclass()
     {
+        this->SetCompactedMaskExecution(true);
+
         // There are 2 outputs: T2, M0, B1
         this->SetNumberOfRequiredOutputs(3);
 
@@ -49,6 +49,8 @@ protected:
     T2RelaxometryEstimationImageFilter()
     : Superclass()
     {
+        this->SetCompactedMaskExecution(true);
+
         // There are 2 outputs: T2, M0
         this->SetNumberOfRequiredOutputs(2);
 
@@ -62,6 +62,8 @@ int main(int argc, char **argv)
     TCLAP::ValueArg<unsigned int> patchSSArg("s","patchStepSize","Patch step size for searching -> default: 1",false,1,"Patch search step size",cmd);
     TCLAP::ValueArg<unsigned int> patchNeighArg("","patchNeighborhood","Patch half neighborhood size -> default: 5",false,5,"Patch search neighborhood size",cmd);
 
+    TCLAP::SwitchArg dictionaryArg("D","dictionary","Use precomputed EPG signals interpolated along B1 (faster, ignored with a T1 map, default: no)",cmd);
+    TCLAP::SwitchArg sparseT2Arg("","sparse-t2","Store T2 weights for in-mask voxels only, expanded when written into an uncompressed output, slice by slice if its format streams writes, e.g. .mha but not .nrrd (lower memory footprint, default: no)",cmd);
     TCLAP::ValueArg<unsigned int> nbpArg("T","numberofthreads","Number of threads to run on (default : all cores)",false,itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads(),"number of threads",cmd);
 	
     try
@@ -78,7 +80,6 @@ int main(int argc, char **argv)
     typedef InputImageType OutputImageType;
     typedef anima::MultiT2RelaxometryEstimationImageFilter <double> FilterType;
     typedef FilterType::OutputImageType OutputImageType;
-    typedef FilterType::VectorOutputImageType VectorOutputImageType;
     typedef itk::ImageFileReader <InputImageType> InputImageReaderType;
 
     FilterType::Pointer mainFilter = FilterType::New();
@@ -184,6 +185,8 @@ int main(int argc, char **argv)
     }
     
     mainFilter->SetAverageSignalThreshold(backgroundSignalThresholdArg.getValue());
+    mainFilter->SetUseEPGDictionary(dictionaryArg.isSet());
+    mainFilter->SetSparseT2Output(sparseT2Arg.isSet());
     mainFilter->SetNumberOfWorkUnits(nbpArg.getValue());
 
     itk::CStyleCommand::Pointer callback = itk::CStyleCommand::New();
@@ -214,8 +217,7 @@ int main(int argc, char **argv)
     outCostImage->DisconnectPipeline();
     FilterType::OutputImagePointer outB1Image = mainFilter->GetB1OutputImage();
     outB1Image->DisconnectPipeline();
-    FilterType::VectorOutputImagePointer outT2Image = mainFilter->GetT2OutputImage();
-    outT2Image->DisconnectPipeline();
+    FilterType::Pointer lastFilter = mainFilter;
 
     if (regulEstimationArg.getValue() == 3)
     {
@@ -236,6 +238,8 @@ int main(int argc, char **argv)
         secondaryFilter->SetComputationMask(mainFilter->GetComputationMask());
 
         secondaryFilter->SetAverageSignalThreshold(backgroundSignalThresholdArg.getValue());
+        secondaryFilter->SetUseEPGDictionary(dictionaryArg.isSet());
+        secondaryFilter->SetSparseT2Output(sparseT2Arg.isSet());
         secondaryFilter->SetNumberOfWorkUnits(nbpArg.getValue());
 
         itk::CStyleCommand::Pointer secondaryCallback = itk::CStyleCommand::New();
@@ -252,7 +256,7 @@ int main(int argc, char **argv)
         secondaryFilter->SetSearchNeighborhood(patchNeighArg.getValue());
 
         secondaryFilter->SetInitialB1Map(outB1Image);
-        secondaryFilter->SetInitialT2Map(outT2Image);
+        secondaryFilter->SetInitialT2Map(mainFilter->GetT2OutputImage());
         secondaryFilter->SetInitialM0Map(outM0Image);
 
         itk::TimeProbe tmpTimeNL;
@@ -279,14 +283,13 @@ int main(int argc, char **argv)
         outCostImage->DisconnectPipeline();
         outB1Image = secondaryFilter->GetB1OutputImage();
         outB1Image->DisconnectPipeline();
-        outT2Image = secondaryFilter->GetT2OutputImage();
-        outT2Image->DisconnectPipeline();
+        lastFilter = secondaryFilter;
     }
 
     anima::writeImage<OutputImageType> (resMWFArg.getValue(),outMWFImage);
 
     if (resT2Arg.getValue() != "")
-        anima::writeImage<VectorOutputImageType> (resT2Arg.getValue(),outT2Image);
+        lastFilter->WriteT2OutputImage(resT2Arg.getValue());
 
     if (resM0Arg.getValue() != "")
         anima::writeImage<OutputImageType> (resM0Arg.getValue(),outM0Image);
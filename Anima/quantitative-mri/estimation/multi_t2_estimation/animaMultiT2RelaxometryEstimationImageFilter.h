@@ -1,11 +1,13 @@
 #pragma once
 
 #include <animaMaskedImageToImageFilter.h>
+#include <animaInMaskSparseImageSource.h>
 #include <itkVectorImage.h>
 #include <itkImage.h>
 
 #include <animaNonLocalT2DistributionPatchSearcher.h>
 #include <animaMultiT2RegularizationCostFunction.h>
+#include <animaEPGSignalDictionary.h>
 
 namespace anima
 {
@@ -47,6 +49,8 @@ public:
     typedef typename InputImageType::Pointer InputImagePointer;
     typedef typename OutputImageType::Pointer OutputImagePointer;
     typedef typename VectorOutputImageType::Pointer VectorOutputImagePointer;
+    typedef anima::InMaskSparseImageSource <VectorOutputImageType> SparseVectorOutputImageType;
+    typedef typename SparseVectorOutputImageType::Pointer SparseVectorOutputImagePointer;
 
     /** Superclass typedefs. */
     typedef typename Superclass::MaskImageType MaskImageType;
@@ -88,7 +92,13 @@ public:
     InputImageType *GetMWFOutputImage() {return this->GetOutput(1);}
     InputImageType *GetB1OutputImage() {return this->GetOutput(2);}
     InputImageType *GetCostOutputImage() {return this->GetOutput(3);}
-    VectorOutputImageType *GetT2OutputImage() {return m_T2OutputImage;}
+    //! T2 weights image, expanded from in-mask values (and kept until the next update) when the T2 output is sparse
+    VectorOutputImageType *GetT2OutputImage();
+    void WriteT2OutputImage(std::string fileName);
+
+    //! If set, T2 weights are only stored for in-mask voxels
+    itkSetMacro(SparseT2Output, bool)
+    itkGetMacro(SparseT2Output, bool)
 
     itkSetMacro(T2ExcitationFlipAngle, double)
 
@@ -103,6 +113,10 @@ public:
 
     std::vector <double> &GetT2CompartmentValues() {return m_T2CompartmentValues;}
 
+    //! Precompute EPG signals on a flip angle grid instead of simulating them at each B1 evaluation (not used with a T1 map)
+    itkSetMacro(UseEPGDictionary, bool)
+    itkSetMacro(NumberOfDictionaryFlipAngles, unsigned int)
+
 protected:
     MultiT2RelaxometryEstimationImageFilter()
     : Superclass()
@@ -139,6 +153,11 @@ protected:
         m_UniformPulses = true;
         m_ReferenceSliceThickness = 3.0;
         m_PulseWidthFactor = 1.5;
+
+        m_UseEPGDictionary = false;
+        m_NumberOfDictionaryFlipAngles = 500;
+
+        m_SparseT2Output = false;
     }
 
     virtual ~MultiT2RelaxometryEstimationImageFilter() {}
@@ -201,8 +220,14 @@ private:
     double m_ExcitationPixelWidth;
     double m_PulseWidthFactor;
 
+    bool m_UseEPGDictionary;
+    unsigned int m_NumberOfDictionaryFlipAngles;
+    anima::EPGSignalDictionary m_EPGDictionary;
+
     // Additional result image
     VectorOutputImagePointer m_T2OutputImage;
+    bool m_SparseT2Output;
+    SparseVectorOutputImagePointer m_SparseT2OutputImage;
 
     // T2 relaxometry specific values
     std::vector <double> m_T2CompartmentValues;
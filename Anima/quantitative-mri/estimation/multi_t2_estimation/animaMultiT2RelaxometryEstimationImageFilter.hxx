@@ -8,6 +8,7 @@
 #include <animaMultiT2EPGRelaxometryCostFunction.h>
 #include <animaMeanAndVarianceImagesFilter.h>
 #include <animaDekkerRootFindingAlgorithm.h>
+#include <animaReadWriteFunctions.h>
 
 namespace anima
 {
@@ -51,18 +52,28 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
 
     this->GetB1OutputImage()->FillBuffer(1.0);
 
-    m_T2OutputImage = VectorOutputImageType::New();
-    m_T2OutputImage->Initialize();
-    m_T2OutputImage->SetRegions(this->GetInput(0)->GetLargestPossibleRegion());
-    m_T2OutputImage->SetSpacing (this->GetInput(0)->GetSpacing());
-    m_T2OutputImage->SetOrigin (this->GetInput(0)->GetOrigin());
-    m_T2OutputImage->SetDirection (this->GetInput(0)->GetDirection());
-    m_T2OutputImage->SetVectorLength(m_NumberOfT2Compartments);
-    m_T2OutputImage->Allocate();
-
-    OutputVectorType zero(m_NumberOfT2Compartments);
-    zero.Fill(0.0);
-    m_T2OutputImage->FillBuffer(zero);
+    m_T2OutputImage = ITK_NULLPTR;
+    m_SparseT2OutputImage = ITK_NULLPTR;
+    if (m_SparseT2Output)
+    {
+        m_SparseT2OutputImage = SparseVectorOutputImageType::New();
+        m_SparseT2OutputImage->Initialize(this->GetComputationMask(),m_NumberOfT2Compartments);
+    }
+    else
+    {
+        m_T2OutputImage = VectorOutputImageType::New();
+        m_T2OutputImage->Initialize();
+        m_T2OutputImage->SetRegions(this->GetInput(0)->GetLargestPossibleRegion());
+        m_T2OutputImage->SetSpacing (this->GetInput(0)->GetSpacing());
+        m_T2OutputImage->SetOrigin (this->GetInput(0)->GetOrigin());
+        m_T2OutputImage->SetDirection (this->GetInput(0)->GetDirection());
+        m_T2OutputImage->SetVectorLength(m_NumberOfT2Compartments);
+        m_T2OutputImage->Allocate();
+
+        OutputVectorType zero(m_NumberOfT2Compartments);
+        zero.Fill(0.0);
+        m_T2OutputImage->FillBuffer(zero);
+    }
 
     if (m_RegularizationType == RegularizationType::NLTikhonov)
     {
@@ -125,6 +136,29 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
         for (unsigned int i = 0;i < m_PulseProfile.size();++i)
             m_PulseProfile[i].first *= pulseRatioToProfile;
     }
+
+    // Dictionary is shared by all threads, it is only valid for the default T1 value (no T1 map)
+    m_EPGDictionary = anima::EPGSignalDictionary();
+    if (m_UseEPGDictionary && !m_T1Map)
+    {
+        m_EPGDictionary.SetNumberOfEchoes(this->GetNumberOfIndexedInputs());
+        m_EPGDictionary.SetEchoSpacing(m_EchoSpacing);
+        m_EPGDictionary.SetExcitationFlipAngle(m_T2ExcitationFlipAngle);
+        m_EPGDictionary.SetT1Value(1000);
+        m_EPGDictionary.SetT2Values(m_T2CompartmentValues);
+        m_EPGDictionary.SetFlipAngleRange(0.5 * m_T2FlipAngles[0], m_T2FlipAngles[0]);
+        m_EPGDictionary.SetNumberOfFlipAngles(m_NumberOfDictionaryFlipAngles);
+
+        m_EPGDictionary.SetUniformPulses(m_UniformPulses);
+        if (!m_UniformPulses)
+        {
+            m_EPGDictionary.SetPulseProfile(m_PulseProfile);
+            m_EPGDictionary.SetExcitationProfile(m_ExcitationProfile);
+            m_EPGDictionary.SetPixelWidth(m_ExcitationPixelWidth);
+        }
+
+        m_EPGDictionary.Compute();
+    }
 }
 
 template <class TPixelScalarType>
@@ -175,6 +209,41 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
     this->SetComputationMask(maskImage);
 }
 
+template <class TPixelScalarType>
+typename MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>::VectorOutputImageType *
+MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
+::GetT2OutputImage()
+{
+    if (!m_SparseT2OutputImage)
+        return m_T2OutputImage;
+
+    if (!m_T2OutputImage)
+    {
+        m_SparseT2OutputImage->Modified();
+        m_SparseT2OutputImage->UpdateLargestPossibleRegion();
+        m_T2OutputImage = m_SparseT2OutputImage->GetOutput();
+        m_T2OutputImage->DisconnectPipeline();
+    }
+
+    return m_T2OutputImage;
+}
+
+template <class TPixelScalarType>
+void
+MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
+::WriteT2OutputImage(std::string fileName)
+{
+    if (m_T2OutputImage)
+    {
+        anima::writeImage <VectorOutputImageType> (fileName,m_T2OutputImage);
+        return;
+    }
+
+    m_SparseT2OutputImage->Modified();
+    anima::writeStreamedImage <VectorOutputImageType> (fileName,m_SparseT2OutputImage);
+    m_SparseT2OutputImage->GetOutput()->Initialize();
+}
+
 template <class TPixelScalarType>
 void
 MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
@@ -184,7 +253,10 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
     typedef itk::ImageRegionIterator <InputImageType> ImageIteratorType;
     typedef itk::ImageRegionIterator <VectorOutputImageType> VectorImageIteratorType;
 
-    VectorImageIteratorType outT2Iterator(this->GetT2OutputImage(),outputRegionForThread);
+    VectorImageIteratorType outT2Iterator;
+    if (!m_SparseT2Output)
+        outT2Iterator = VectorImageIteratorType(m_T2OutputImage,outputRegionForThread);
+
     ImageIteratorType outM0Iterator(this->GetM0OutputImage(),outputRegionForThread);
     ImageIteratorType outMWFIterator(this->GetMWFOutputImage(),outputRegionForThread);
     ImageIteratorType outB1Iterator(this->GetB1OutputImage(),outputRegionForThread);
@@ -230,6 +302,8 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
     typename B1CostFunctionType::Pointer cost = B1CostFunctionType::New();
     cost->SetEchoSpacing(m_EchoSpacing);
     cost->SetExcitationFlipAngle(m_T2ExcitationFlipAngle);
+    if (m_EPGDictionary.IsComputed())
+        cost->SetEPGDictionary(&m_EPGDictionary);
 
     unsigned int dimension = cost->GetNumberOfParameters();
     itk::Array<double> lowerBounds(dimension);
@@ -250,14 +324,18 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
 
         if (maskItr.Get() == 0)
         {
-            outT2Iterator.Set(outputT2Weights);
+            if (!m_SparseT2Output)
+            {
+                outT2Iterator.Set(outputT2Weights);
+                ++outT2Iterator;
+            }
+
             outM0Iterator.Set(0);
             outMWFIterator.Set(0.0);
             outB1Iterator.Set(1.0);
             outCostIterator.Set(0.0);
 
             ++maskItr;
-            ++outT2Iterator;
             ++outM0Iterator;
             ++outMWFIterator;
             ++outB1Iterator;
@@ -384,7 +462,14 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
             outputT2Weights[i] = t2OptimizedWeights[i];
 
         outM0Iterator.Set(m0Value);
-        outT2Iterator.Set(outputT2Weights);
+        if (m_SparseT2Output)
+            m_SparseT2OutputImage->SetPixel(maskItr.GetIndex(),outputT2Weights);
+        else
+        {
+            outT2Iterator.Set(outputT2Weights);
+            ++outT2Iterator;
+        }
+
         outCostIterator.Set(residual);
         double mwfValue = 0;
         for (unsigned int i = 0;i < m_NumberOfT2Compartments;++i)
@@ -400,7 +485,6 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
 
         this->IncrementNumberOfProcessedPoints();
         ++maskItr;
-        ++outT2Iterator;
         ++outM0Iterator;
         ++outMWFIterator;
         ++outB1Iterator;
@@ -21,6 +21,7 @@ public:
     typedef BaseAffineBlockMatcher <TInputImageType> Superclass;
     typedef typename Superclass::InputImageType InputImageType;
     typedef typename Superclass::PointType PointType;
+    typedef typename Superclass::ImageRegionType ImageRegionType;
     typedef typename Superclass::AgregatorType AgregatorType;
     typedef typename Superclass::MetricPointer MetricPointer;
     typedef typename Superclass::BaseInputTransformPointer BaseInputTransformPointer;
@@ -36,6 +37,9 @@ protected:
 
     virtual void BlockMatchingSetup(MetricPointer &metric, unsigned int block);
 
+    //! Batched exhaustive translation search from sliding window sums on a moving image lattice sampled once
+    virtual bool ExhaustiveTranslationBlockMatch(unsigned int block, double &bestValue);
+
 private:
     SimilarityDefinition m_SimilarityType;
     double m_DefaultBackgroundValue;
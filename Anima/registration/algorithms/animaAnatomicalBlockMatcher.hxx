@@ -6,7 +6,11 @@
 #include <animaFastMeanSquaresImageToImageMetric.h>
 #include <itkImageToImageMetric.h>
 
+#include <animaLinearBlockSampler.h>
+
 #include <itkLinearInterpolateImageFunction.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkTranslationTransform.h>
 
 namespace anima
 {
@@ -122,4 +126,249 @@ AnatomicalBlockMatcher<TInputImageType>
         ((anima::FastMeanSquaresImageToImageMetric<InputImageType, InputImageType> *)metric.GetPointer())->PreComputeFixedValues();
 }
 
+template <typename TInputImageType>
+bool
+AnatomicalBlockMatcher<TInputImageType>
+::ExhaustiveTranslationBlockMatch(unsigned int block, double &bestValue)
+{
+    if (this->GetBlockTransformType() != Superclass::Translation)
+        return false;
+
+    // Candidates have to lie on the reference voxel grid for the moving lattice to be shared
+    double stepSize = this->GetStepSize();
+    long stepVoxels = std::round(stepSize);
+    if ((stepVoxels <= 0) || (std::abs(stepSize - stepVoxels) > 1.0e-8))
+        return false;
+
+    const unsigned int Dimension = InputImageType::ImageDimension;
+    long numSteps = std::round(this->GetTranslateMax());
+    long latticeMargin = numSteps * stepVoxels;
+
+    InputImageType *refImage = this->GetReferenceImage();
+    ImageRegionType blockRegion = this->GetBlockRegion(block);
+    unsigned int numBlockPixels = blockRegion.GetNumberOfPixels();
+    if (numBlockPixels == 0)
+        return false;
+
+    // Fixed block values, same ordering as the metrics
+    std::vector <double> fixedValues(numBlockPixels);
+    double sumFixed = 0;
+    double sumSquaredFixed = 0;
+
+    typedef itk::ImageRegionConstIterator <InputImageType> FixedIteratorType;
+    FixedIteratorType fixedItr(refImage, blockRegion);
+    unsigned int pos = 0;
+    while (!fixedItr.IsAtEnd())
+    {
+        double fixedValue = fixedItr.Get();
+        fixedValues[pos] = fixedValue;
+        sumFixed += fixedValue;
+        sumSquaredFixed += fixedValue * fixedValue;
+
+        ++fixedItr;
+        ++pos;
+    }
+
+    double varFixed = sumSquaredFixed - sumFixed * sumFixed / numBlockPixels;
+
+    // Moving image lattice covering the block moved to all candidate positions, sampled only once
+    unsigned int latticeSize[Dimension];
+    unsigned int latticeStrides[Dimension];
+    unsigned int numLatticePixels = 1;
+    for (unsigned int i = 0;i < Dimension;++i)
+    {
+        latticeSize[i] = blockRegion.GetSize()[i] + 2 * latticeMargin;
+        latticeStrides[i] = numLatticePixels;
+        numLatticePixels *= latticeSize[i];
+    }
+
+    std::vector <PointType> latticePoints(numLatticePixels);
+    typename InputImageType::IndexType latticeIndex;
+    for (unsigned int k = 0;k < numLatticePixels;++k)
+    {
+        unsigned int remainder = k;
+        for (unsigned int i = 0;i < Dimension;++i)
+        {
+            latticeIndex[i] = blockRegion.GetIndex()[i] - latticeMargin + (remainder % latticeSize[i]);
+            remainder /= latticeSize[i];
+        }
+
+        refImage->TransformIndexToPhysicalPoint(latticeIndex,latticePoints[k]);
+    }
+
+    typedef anima::LinearBlockSampler <InputImageType> SamplerType;
+    SamplerType latticeSampler;
+    latticeSampler.SetMovingImage(this->GetMovingImage());
+    latticeSampler.SetFixedPoints(latticePoints);
+
+    typedef itk::TranslationTransform <double, Dimension> TranslationTransformType;
+    typename TranslationTransformType::Pointer identityTrsf = TranslationTransformType::New();
+    identityTrsf->SetIdentity();
+
+    std::vector <double> latticeValues;
+    latticeSampler.SampleMovingValues(identityTrsf,1.0,m_DefaultBackgroundValue,latticeValues);
+
+    // Summed area tables of moving values and squared values, with a leading zero row along each dimension
+    unsigned int tableSize[Dimension];
+    unsigned int tableStrides[Dimension];
+    unsigned int numTableValues = 1;
+    for (unsigned int i = 0;i < Dimension;++i)
+    {
+        tableSize[i] = latticeSize[i] + 1;
+        tableStrides[i] = numTableValues;
+        numTableValues *= tableSize[i];
+    }
+
+    std::vector <double> sumTable(numTableValues,0.0);
+    std::vector <double> squaredSumTable(numTableValues,0.0);
+    for (unsigned int k = 0;k < numLatticePixels;++k)
+    {
+        unsigned int remainder = k;
+        unsigned int tablePos = 0;
+        for (unsigned int i = 0;i < Dimension;++i)
+        {
+            tablePos += (remainder % latticeSize[i] + 1) * tableStrides[i];
+            remainder /= latticeSize[i];
+        }
+
+        sumTable[tablePos] = latticeValues[k];
+        squaredSumTable[tablePos] = latticeValues[k] * latticeValues[k];
+    }
+
+    for (unsigned int i = 0;i < Dimension;++i)
+    {
+        for (unsigned int k = 0;k < numTableValues;++k)
+        {
+            if ((k / tableStrides[i]) % tableSize[i] == 0)
+                continue;
+
+            sumTable[k] += sumTable[k - tableStrides[i]];
+            squaredSumTable[k] += squaredSumTable[k - tableStrides[i]];
+        }
+    }
+
+    // Block pixel offsets inside the lattice
+    std::vector <unsigned int> blockOffsets(numBlockPixels);
+    for (unsigned int k = 0;k < numBlockPixels;++k)
+    {
+        unsigned int remainder = k;
+        blockOffsets[k] = 0;
+        for (unsigned int i = 0;i < Dimension;++i)
+        {
+            blockOffsets[k] += (remainder % blockRegion.GetSize()[i]) * latticeStrides[i];
+            remainder /= blockRegion.GetSize()[i];
+        }
+    }
+
+    const unsigned int numCorners = 1 << Dimension;
+    unsigned int numCandidatesPerDim = 2 * numSteps + 1;
+    unsigned int numCandidates = 1;
+    for (unsigned int i = 0;i < Dimension;++i)
+        numCandidates *= numCandidatesPerDim;
+
+    bool maximize = this->GetMaximizedMetric();
+    bool initialized = false;
+    unsigned int bestCandidate = 0;
+
+    // Evaluates candidates in the order of the exhaustive optimizer, starting from the null displacement
+    for (unsigned int c = 0;c <= numCandidates;++c)
+    {
+        unsigned int candidate = c - 1;
+        if (c == 0)
+        {
+            candidate = 0;
+            for (unsigned int i = 0;i < Dimension;++i)
+                candidate = candidate * numCandidatesPerDim + numSteps;
+        }
+
+        unsigned int latticeBase = 0;
+        unsigned int tableBase = 0;
+        unsigned int remainder = candidate;
+        for (unsigned int i = 0;i < Dimension;++i)
+        {
+            unsigned int latticeStart = (remainder % numCandidatesPerDim) * stepVoxels;
+            remainder /= numCandidatesPerDim;
+
+            latticeBase += latticeStart * latticeStrides[i];
+            tableBase += latticeStart * tableStrides[i];
+        }
+
+        double sm = 0;
+        double smm = 0;
+        for (unsigned int corner = 0;corner < numCorners;++corner)
+        {
+            unsigned int tablePos = tableBase;
+            unsigned int numLowerCorners = 0;
+            for (unsigned int i = 0;i < Dimension;++i)
+            {
+                if (corner & (1 << i))
+                    tablePos += blockRegion.GetSize()[i] * tableStrides[i];
+                else
+                    ++numLowerCorners;
+            }
+
+            double sign = (numLowerCorners % 2 == 0) ? 1.0 : -1.0;
+            sm += sign * sumTable[tablePos];
+            smm += sign * squaredSumTable[tablePos];
+        }
+
+        const double *movingPtr = latticeValues.data() + latticeBase;
+        double sfm = 0;
+        for (unsigned int k = 0;k < numBlockPixels;++k)
+            sfm += fixedValues[k] * movingPtr[blockOffsets[k]];
+
+        double value = 0;
+        if (m_SimilarityType == MeanSquares)
+            value = std::max(0.0,smm - 2.0 * sfm + sumSquaredFixed) / numBlockPixels;
+        else
+        {
+            double movingVariance = smm - sm * sm / numBlockPixels;
+            double covData = sfm - sumFixed * sm / numBlockPixels;
+            double multVars = varFixed * movingVariance;
+
+            if (numBlockPixels > 1 && multVars > 1.0e-16)
+            {
+                if (m_SimilarityType == SquaredCorrelation)
+                    value = covData * covData / multVars;
+                else
+                    value = std::max(-1.0,covData / std::sqrt(multVars));
+            }
+            else if (m_SimilarityType == Correlation)
+                value = -1.0;
+        }
+
+        if ((!initialized) || (maximize && (value > bestValue)) || ((!maximize) && (value < bestValue)))
+        {
+            bestValue = value;
+            bestCandidate = candidate;
+            initialized = true;
+        }
+    }
+
+    // Physical translation of the best candidate
+    typename InputImageType::SpacingType refSpacing = refImage->GetSpacing();
+    typename InputImageType::DirectionType refDirection = refImage->GetDirection();
+
+    double voxelDisplacement[Dimension];
+    unsigned int remainder = bestCandidate;
+    for (unsigned int i = 0;i < Dimension;++i)
+    {
+        long candidateStep = remainder % numCandidatesPerDim;
+        remainder /= numCandidatesPerDim;
+        voxelDisplacement[i] = (candidateStep - numSteps) * stepSize;
+    }
+
+    typename TranslationTransformType::ParametersType bestParameters(Dimension);
+    for (unsigned int i = 0;i < Dimension;++i)
+    {
+        bestParameters[i] = 0;
+        for (unsigned int j = 0;j < Dimension;++j)
+            bestParameters[i] += refDirection(i,j) * refSpacing[j] * voxelDisplacement[j];
+    }
+
+    this->GetBlockTransformPointer(block)->SetParameters(bestParameters);
+
+    return true;
+}
+
 } // end namespace anima
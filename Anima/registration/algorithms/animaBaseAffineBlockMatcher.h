@@ -33,6 +33,7 @@ public:
 
     void SetAngleMax(double val) {m_AngleMax = val;}
     void SetTranslateMax(double val) {m_TranslateMax = val;}
+    double GetTranslateMax() {return m_TranslateMax;}
     void SetScaleMax(double val) {m_ScaleMax = val;}
 
     void SetAffineDirection(unsigned int val) {m_AffineDirection = val;}
@@ -3,7 +3,7 @@
 
 #include <itkSingleValuedNonLinearOptimizer.h>
 #include <itkSingleValuedCostFunction.h>
-#include <mutex>
+#include <animaWorkStealingScheduler.h>
 
 namespace anima
 {
@@ -66,6 +66,7 @@ public:
     unsigned int GetBlockSpacing() {return m_BlockSpacing;}
 
     void SetStepSize (double val) {m_StepSize = val;}
+    double GetStepSize() {return m_StepSize;}
     void SetOptimizerMaximumIterations (unsigned int val) {m_OptimizerMaximumIterations = val;}
 
     void Update();
@@ -100,7 +101,7 @@ protected:
     /** Do the matching for a batch of regions (split according to the thread id + nb threads) */
     static ITK_THREAD_RETURN_FUNCTION_CALL_CONVENTION ThreadedMatching(void *arg);
 
-    void ProcessBlockMatch();
+    void ProcessBlockMatch(unsigned int workerId);
     void BlockMatch(unsigned int startIndex, unsigned int endIndex);
 
     virtual void InitializeBlocks();
@@ -115,6 +116,13 @@ protected:
     virtual void BlockMatchingSetup(MetricPointer &metric, unsigned int block) = 0;
     virtual void TransformDependantOptimizerSetup(OptimizerPointer &optimizer) = 0;
 
+    /**
+     * Batched exhaustive search: evaluates the whole translation search window of a block in one pass,
+     * sets the block transform to the best candidate and returns its metric value in bestValue.
+     * Returns false if not handled, in which case the exhaustive optimizer is used for that block.
+     */
+    virtual bool ExhaustiveTranslationBlockMatch(unsigned int block, double &bestValue) {return false;}
+
     // Internal setters for re-implementations of block initialization
     void SetBlockWeights(std::vector <double> &val) {m_BlockWeights = val;}
     void SetBlockRegions(std::vector <ImageRegionType> &val) {m_BlockRegions = val;}
@@ -151,8 +159,8 @@ private:
     unsigned int m_OptimizerMaximumIterations;
     double m_StepSize;
 
-    std::mutex m_LockHighestProcessedBlock;
-    int m_HighestProcessedBlock;
+    // Dynamic scheduling of blocks over threads
+    anima::WorkStealingScheduler m_BlockScheduler;
 };
 
 } // end namespace anima
@@ -28,7 +28,7 @@ BaseBlockMatcher <TInputImageType>
     m_OptimizerType = Bobyqa;
     m_Verbose = true;
 
-    m_HighestProcessedBlock = 0;
+    m_BlockScheduler.SetMinimumChunkSize(10);
 }
 
 template <typename TInputImageType>
@@ -143,12 +143,12 @@ BaseBlockMatcher <TInputImageType>
     if ((m_ForceComputeBlocks) || (m_BlockTransformPointers.size() == 0))
         this->InitializeBlocks();
 
-    m_HighestProcessedBlock = 0;
     itk::PoolMultiThreader::Pointer threadWorker = itk::PoolMultiThreader::New();
     ThreadedMatchData *tmpStr = new ThreadedMatchData;
     tmpStr->BlockMatch = this;
 
     threadWorker->SetNumberOfWorkUnits(m_NumberOfThreads);
+    m_BlockScheduler.Initialize(m_BlockRegions.size(),threadWorker->GetNumberOfWorkUnits());
     threadWorker->SetSingleMethod(this->ThreadedMatching,tmpStr);
     threadWorker->SingleMethodExecute();
 
@@ -163,44 +163,18 @@ BaseBlockMatcher <TInputImageType>
     itk::MultiThreaderBase::WorkUnitInfo *threadArgs = (itk::MultiThreaderBase::WorkUnitInfo *)arg;
     ThreadedMatchData* data = (ThreadedMatchData *)threadArgs->UserData;
 
-    data->BlockMatch->ProcessBlockMatch();
+    data->BlockMatch->ProcessBlockMatch(threadArgs->WorkUnitID);
     return ITK_THREAD_RETURN_DEFAULT_VALUE;
 }
 
 template <typename TInputImageType>
 void
 BaseBlockMatcher <TInputImageType>
-::ProcessBlockMatch()
+::ProcessBlockMatch(unsigned int workerId)
 {
-    bool continueLoop = true;
-    unsigned int highestToleratedBlockIndex = m_BlockRegions.size();
-
-    unsigned int stepData = std::ceil(m_BlockRegions.size() / (10 * this->GetNumberOfWorkUnits()));
-    unsigned int minNumBlocks = std::min(highestToleratedBlockIndex,static_cast <unsigned int> (10));
-    stepData = std::max(minNumBlocks,stepData);
-
-    while (continueLoop)
-    {
-        m_LockHighestProcessedBlock.lock();
-
-        if (m_HighestProcessedBlock >= highestToleratedBlockIndex)
-        {
-            m_LockHighestProcessedBlock.unlock();
-            continueLoop = false;
-            continue;
-        }
-
-        unsigned int startPoint = m_HighestProcessedBlock;
-        unsigned int endPoint = m_HighestProcessedBlock + stepData;
-        if (endPoint > highestToleratedBlockIndex)
-            endPoint = highestToleratedBlockIndex;
-
-        m_HighestProcessedBlock = endPoint;
-
-        m_LockHighestProcessedBlock.unlock();
-
+    unsigned int startPoint, endPoint;
+    while (m_BlockScheduler.GetNextChunk(workerId,startPoint,endPoint))
         this->BlockMatch(startPoint,endPoint);
-    }
 }
 
 template <typename TInputImageType>
@@ -214,6 +188,16 @@ BaseBlockMatcher <TInputImageType>
     // Loop over the desired blocks
     for (unsigned int block = startIndex;block < endIndex;++block)
     {
+        if (m_OptimizerType == Exhaustive)
+        {
+            double bestValue = 0;
+            if (this->ExhaustiveTranslationBlockMatch(block,bestValue))
+            {
+                m_BlockWeights[block] = this->ComputeBlockWeight(bestValue,block);
+                continue;
+            }
+        }
+
         this->BlockMatchingSetup(metric, block);
         optimizer->SetCostFunction(metric);
         optimizer->SetInitialPosition(m_BlockTransformPointers[block]->GetParameters());
@@ -13,6 +13,10 @@
 #include <animaResampleImageFilter.h>
 #include <animaGradientFileReader.h>
 
+#include <thread>
+#include <mutex>
+#include <algorithm>
+
 int main(int argc, const char** argv)
 {
     const unsigned int Dimension = 3;
@@ -67,6 +71,7 @@ int main(int argc, const char** argv)
     TCLAP::ValueArg<unsigned int> numPyramidLevelsArg("p","pyr","Number of pyramid levels (default: 3)",false,3,"number of pyramid levels",cmd);
     TCLAP::ValueArg<unsigned int> lastPyramidLevelArg("l","last-level","Index of the last pyramid level explored (default: 0)",false,0,"last pyramid level",cmd);
     TCLAP::ValueArg<unsigned int> numThreadsArg("T","threads","Number of execution threads (default: 0 = all cores)",false,0,"number of threads",cmd);
+    TCLAP::ValueArg<unsigned int> numConcurrentVolumesArg("","cv","Number of volumes registered concurrently, threads being shared among them (default: 0 = number of threads)",false,0,"number of concurrent volumes",cmd);
 
     try
     {
@@ -99,21 +104,50 @@ int main(int argc, const char** argv)
 
     GFReaderType::GradientVectorType directions = gfReader.GetGradients();
 
-    for (unsigned int i = 0;i < numberOfImages;++i)
-    {
-        if (i == b0Arg.getValue())
-            continue;
+    // Volumes are registered concurrently, each registration gets its share of the threads
+    unsigned int numThreads = numThreadsArg.getValue();
+    if (numThreads == 0)
+        numThreads = itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads();
+
+    unsigned int numConcurrentVolumes = numConcurrentVolumesArg.getValue();
+    if (numConcurrentVolumes == 0)
+        numConcurrentVolumes = numThreads;
+
+    unsigned int numVolumesToProcess = (b0Arg.getValue() < numberOfImages) ? numberOfImages - 1 : numberOfImages;
+    numConcurrentVolumes = std::max(1u, std::min(numConcurrentVolumes, numVolumesToProcess));
+    unsigned int numVolumeThreads = std::max(1u, numThreads / numConcurrentVolumes);
+
+    InputSubImageType::Pointer referenceImage = referenceExtractFilter->GetOutput();
+    referenceImage->DisconnectPipeline();
 
-        std::cout << "\033[K\rProcessing image " << i+1 << " out of " << numberOfImages << std::flush;
+    // Pipeline updates on the 4D image and console outputs are serialized
+    std::mutex inputImageMutex;
+    unsigned int nextImageIndex = 0;
+    unsigned int numProcessedImages = 0;
+    bool registrationFailed = false;
+
+    auto correctVolume = [&](unsigned int i)
+    {
+        InputSubImageType::Pointer movingImage;
+        {
+            std::lock_guard <std::mutex> lock(inputImageMutex);
+
+            ExtractFilterType::Pointer extractFilter = ExtractFilterType::New();
+            extractFilter->SetInput(inputImage);
+            InputImageType::RegionType extractRegion = inputImage->GetLargestPossibleRegion();
+            extractRegion.SetIndex(Dimension,i);
+            extractRegion.SetSize(Dimension,0);
+            extractFilter->SetExtractionRegion(extractRegion);
+            extractFilter->SetDirectionCollapseToGuess();
+            extractFilter->Update();
+
+            movingImage = extractFilter->GetOutput();
+            movingImage->DisconnectPipeline();
+        }
 
-        ExtractFilterType::Pointer extractFilter = ExtractFilterType::New();
-        extractFilter->SetInput(inputImage);
-        InputImageType::RegionType extractRegion = inputImage->GetLargestPossibleRegion();
-        extractRegion.SetIndex(Dimension,i);
-        extractRegion.SetSize(Dimension,0);
-        extractFilter->SetExtractionRegion(extractRegion);
-        extractFilter->SetDirectionCollapseToGuess();
-        extractFilter->Update();
+        // Each registration works on its own image object sharing the read-only B0 buffer
+        InputSubImageType::Pointer volumeReferenceImage = InputSubImageType::New();
+        volumeReferenceImage->Graft(referenceImage);
 
         // First perform rigid registration to correct for movement
         PyramidBMType::Pointer matcher = PyramidBMType::New();
@@ -136,29 +170,19 @@ int main(int argc, const char** argv)
         matcher->SetNumberOfPyramidLevels(numPyramidLevelsArg.getValue());
         matcher->SetLastPyramidLevel(lastPyramidLevelArg.getValue());
         matcher->SetVerbose(false);
-
-        if (numThreadsArg.getValue() != 0)
-            matcher->SetNumberOfWorkUnits( numThreadsArg.getValue() );
+        matcher->SetNumberOfWorkUnits(numVolumeThreads);
 
         matcher->SetPercentageKept( percentageKeptArg.getValue() );
         matcher->SetTransformInitializationType(PyramidBMType::GravityCenters);
 
-        matcher->SetFloatingImage(referenceExtractFilter->GetOutput());
-        matcher->SetReferenceImage(extractFilter->GetOutput());
+        matcher->SetFloatingImage(volumeReferenceImage);
+        matcher->SetReferenceImage(movingImage);
 
         AffineTransformPointer rigidTrsf = AffineTransformType::New();
         rigidTrsf->SetIdentity();
         matcher->SetOutputTransform(rigidTrsf.GetPointer());
 
-        try
-        {
-            matcher->Update();
-        }
-        catch (itk::ExceptionObject &e)
-        {
-            std::cerr << e << std::endl;
-            return EXIT_FAILURE;
-        }
+        matcher->Update();
 
         rigidTrsf = dynamic_cast <AffineTransformType *> (matcher->GetOutputTransform().GetPointer());
 
@@ -166,7 +190,7 @@ int main(int argc, const char** argv)
 
         // Then perform directional affine registration
         matcher->SetReferenceImage(rigidReference);
-        matcher->SetFloatingImage(extractFilter->GetOutput());
+        matcher->SetFloatingImage(movingImage);
         matcher->SetTransform(PyramidBMType::Directional_Affine);
         matcher->SetOutputTransformType(PyramidBMType::outAffine);
         matcher->SetAffineDirection(directionArg.getValue());
@@ -180,15 +204,7 @@ int main(int argc, const char** argv)
         tmpTrsfDirectional->SetIdentity();
         matcher->SetOutputTransform(tmpTrsfDirectional.GetPointer());
 
-        try
-        {
-            matcher->Update();
-        }
-        catch (itk::ExceptionObject &e)
-        {
-            std::cerr << e << std::endl;
-            return EXIT_FAILURE;
-        }
+        matcher->Update();
 
         // Finally, perform non linear registration to get rid of non linear distortions
         typedef anima::PyramidalDenseSVFMatchingBridge <Dimension> NonLinearPyramidBMType;
@@ -220,21 +236,11 @@ int main(int argc, const char** argv)
         nonLinearMatcher->SetNumberOfPyramidLevels(numPyramidLevelsArg.getValue());
         nonLinearMatcher->SetLastPyramidLevel(lastPyramidLevelArg.getValue());
         nonLinearMatcher->SetVerbose(false);
-
-        if (numThreadsArg.getValue() != 0)
-            nonLinearMatcher->SetNumberOfWorkUnits(numThreadsArg.getValue());
+        nonLinearMatcher->SetNumberOfWorkUnits(numVolumeThreads);
 
         nonLinearMatcher->SetPercentageKept(percentageKeptArg.getValue());
 
-        try
-        {
-            nonLinearMatcher->Update();
-        }
-        catch (itk::ExceptionObject &e)
-        {
-            std::cerr << e << std::endl;
-            return EXIT_FAILURE;
-        }
+        nonLinearMatcher->Update();
 
         // Finally, apply transform serie to image
         typedef itk::CompositeTransform <AgregatorType::ScalarType,Dimension> GeneralTransformType;
@@ -250,7 +256,7 @@ int main(int argc, const char** argv)
         SVFTransformPointer svfPointer = nonLinearMatcher->GetOutputTransform();
 
         DenseTransformPointer dispTrsf = DenseTransformType::New();
-        anima::GetSVFExponential(svfPointer.GetPointer(),dispTrsf.GetPointer(),0,numThreadsArg.getValue(),1.0);
+        anima::GetSVFExponential(svfPointer.GetPointer(),dispTrsf.GetPointer(),0,numVolumeThreads,1.0);
 
         transformSerie->AddTransform(dispTrsf.GetPointer());
 
@@ -272,10 +278,10 @@ int main(int argc, const char** argv)
         typedef anima::ResampleImageFilter<InputSubImageType, InputSubImageType> ResampleFilterType;
         ResampleFilterType::Pointer scalarResampler = ResampleFilterType::New();
 
-        InputSubImageType::SizeType size = referenceExtractFilter->GetOutput()->GetLargestPossibleRegion().GetSize();
-        InputSubImageType::PointType origin = referenceExtractFilter->GetOutput()->GetOrigin();
-        InputSubImageType::SpacingType spacing = referenceExtractFilter->GetOutput()->GetSpacing();
-        InputSubImageType::DirectionType direction = referenceExtractFilter->GetOutput()->GetDirection();
+        InputSubImageType::SizeType size = referenceImage->GetLargestPossibleRegion().GetSize();
+        InputSubImageType::PointType origin = referenceImage->GetOrigin();
+        InputSubImageType::SpacingType spacing = referenceImage->GetSpacing();
+        InputSubImageType::DirectionType direction = referenceImage->GetDirection();
 
         scalarResampler->SetTransform(transformSerie);
         scalarResampler->SetSize(size);
@@ -283,11 +289,12 @@ int main(int argc, const char** argv)
         scalarResampler->SetOutputSpacing(spacing);
         scalarResampler->SetOutputDirection(direction);
 
-        scalarResampler->SetInput(extractFilter->GetOutput());
-        if (numThreadsArg.getValue() != 0)
-            scalarResampler->SetNumberOfWorkUnits(numThreadsArg.getValue());
+        scalarResampler->SetInput(movingImage);
+        scalarResampler->SetNumberOfWorkUnits(numVolumeThreads);
         scalarResampler->Update();
 
+        std::lock_guard <std::mutex> lock(inputImageMutex);
+
         InputSubImageType::RegionType regionSubImage = scalarResampler->GetOutput()->GetLargestPossibleRegion();
         InputImageType::RegionType regionImage = inputImage->GetLargestPossibleRegion();
         regionImage.SetIndex(Dimension,i);
@@ -303,7 +310,53 @@ int main(int argc, const char** argv)
             ++inIterator;
             ++outIterator;
         }
-    }
+
+        ++numProcessedImages;
+        std::cout << "\033[K\rProcessed image " << numProcessedImages << " out of " << numVolumesToProcess << std::flush;
+    };
+
+    auto volumesWorker = [&]()
+    {
+        while (true)
+        {
+            unsigned int i = 0;
+            {
+                std::lock_guard <std::mutex> lock(inputImageMutex);
+                while ((nextImageIndex < numberOfImages) && (nextImageIndex == b0Arg.getValue()))
+                    ++nextImageIndex;
+
+                if ((nextImageIndex >= numberOfImages) || registrationFailed)
+                    return;
+
+                i = nextImageIndex;
+                ++nextImageIndex;
+            }
+
+            try
+            {
+                correctVolume(i);
+            }
+            catch (itk::ExceptionObject &e)
+            {
+                std::lock_guard <std::mutex> lock(inputImageMutex);
+                std::cerr << e << std::endl;
+                registrationFailed = true;
+                return;
+            }
+        }
+    };
+
+    std::vector <std::thread> volumeThreads;
+    for (unsigned int i = 1;i < numConcurrentVolumes;++i)
+        volumeThreads.push_back(std::thread(volumesWorker));
+
+    volumesWorker();
+
+    for (unsigned int i = 0;i < volumeThreads.size();++i)
+        volumeThreads[i].join();
+
+    if (registrationFailed)
+        return EXIT_FAILURE;
 
     std::cout << std::endl;
 
@@ -21,10 +21,10 @@
 
 struct arguments
 {
-    bool invert;
+    bool invert, flatten;
     unsigned int exponentiationOrder;
     unsigned int pthread;
-    std::string input, output, geometry, transfo, interpolation;
+    std::string input, output, geometry, transfo, interpolation, flattenCache;
 };
 
 void applyTransformationToGradients(std::string &inputGradientsFileName, std::string &outputGradientsFileName, const arguments &args)
@@ -107,6 +107,9 @@ applyVectorTransfo(itk::ImageIOBase::Pointer geometryImageIO, const arguments &a
     trReader->SetInvertTransform(args.invert);
     trReader->SetExponentiationOrder(args.exponentiationOrder);
     trReader->SetNumberOfWorkUnits(args.pthread);
+    trReader->SetFlattenTransform(args.flatten);
+    trReader->SetFlatteningGeometry(geometryImageIO);
+    trReader->SetFlatteningCacheDirectory(args.flattenCache);
     trReader->Update();
     typename TransformType::Pointer transfo = trReader->GetOutputTransform();
 
@@ -183,6 +186,9 @@ applyScalarTransfo4D(itk::ImageIOBase::Pointer geometryImageIO, const arguments
     trReader->SetInvertTransform(args.invert);
     trReader->SetExponentiationOrder(args.exponentiationOrder);
     trReader->SetNumberOfWorkUnits(args.pthread);
+    trReader->SetFlattenTransform(args.flatten);
+    trReader->SetFlatteningGeometry(geometryImageIO);
+    trReader->SetFlatteningCacheDirectory(args.flattenCache);
     trReader->Update();
     typename TransformType::Pointer transfo = trReader->GetOutputTransform();
 
@@ -348,6 +354,9 @@ applyScalarTransfo(itk::ImageIOBase::Pointer geometryImageIO, const arguments &a
     trReader->SetInvertTransform(args.invert);
     trReader->SetExponentiationOrder(args.exponentiationOrder);
     trReader->SetNumberOfWorkUnits(args.pthread);
+    trReader->SetFlattenTransform(args.flatten);
+    trReader->SetFlatteningGeometry(geometryImageIO);
+    trReader->SetFlatteningCacheDirectory(args.flattenCache);
     trReader->Update();
     typename TransformType::Pointer transfo = trReader->GetOutputTransform();
 
@@ -495,6 +504,8 @@ int main(int ac, const char** av)
 
     TCLAP::ValueArg<unsigned int> expOrderArg("e","exp-order","Order of field exponentiation approximation (in between 0 and 1, default: 0)",false,0,"exponentiation order",cmd);
     TCLAP::SwitchArg invertArg("I","invert","Invert the transformation series",cmd,false);
+    TCLAP::SwitchArg flattenArg("F","flatten","Flatten non linear transformation series into a single dense field before resampling",cmd,false);
+    TCLAP::ValueArg<std::string> flattenCacheArg("","flatten-cache","Directory where flattened transformation fields are cached (implies flatten)",false,"","flattening cache directory",cmd);
     TCLAP::ValueArg<std::string> interpolationArg("n",
                                                   "interpolation",
                                                   "interpolation method to use [nearest, linear, bspline, sinc]",
@@ -552,6 +563,8 @@ int main(int ac, const char** av)
     args.pthread = nbpArg.getValue();
     args.exponentiationOrder = expOrderArg.getValue();
     args.interpolation = interpolationArg.getValue();
+    args.flattenCache = flattenCacheArg.getValue();
+    args.flatten = flattenArg.isSet() || (args.flattenCache != "");
 
     bool badInterpolation = true;
     std::string interpolations[4] = {"nearest", "linear", "bspline", "sinc"};
@@ -39,6 +39,8 @@ int main(int ac, const char** av)
 
     TCLAP::SwitchArg ppdArg("P","ppd","Use PPD re-orientation scheme (default: no)",cmd,false);
     TCLAP::SwitchArg invertArg("I","invert","Invert the transformation series",cmd,false);
+    TCLAP::SwitchArg flattenArg("F","flatten","Flatten non linear transformation series into a single dense field before resampling",cmd,false);
+    TCLAP::ValueArg<std::string> flattenCacheArg("","flatten-cache","Directory where flattened transformation fields are cached (implies flatten)",false,"","flattening cache directory",cmd);
     TCLAP::SwitchArg nearestArg("N","nearest","Use nearest neighbor interpolation",cmd,false);
     
     TCLAP::ValueArg<unsigned int> nbpArg("p","numberofthreads","Number of threads to run on (default: all cores)",false,itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads(),"number of threads",cmd);
@@ -86,6 +88,9 @@ int main(int ac, const char** av)
     trReader->SetExponentiationOrder(expOrderArg.getValue());
     trReader->SetNumberOfWorkUnits(nbpArg.getValue());
     trReader->SetInvertTransform(invertArg.isSet());
+    trReader->SetFlattenTransform(flattenArg.isSet() || flattenCacheArg.isSet());
+    trReader->SetFlatteningGeometry(imageIO);
+    trReader->SetFlatteningCacheDirectory(flattenCacheArg.getValue());
     
     try
     {
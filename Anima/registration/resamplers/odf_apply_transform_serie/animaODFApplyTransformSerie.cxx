@@ -33,6 +33,8 @@ int main(int ac, const char** av)
     
     TCLAP::ValueArg<unsigned int> expOrderArg("e","exp-order","Order of field exponentiation approximation (in between 0 and 1, default: 0)",false,0,"exponentiation order",cmd);
     TCLAP::SwitchArg invertArg("I","invert","Invert the transformation series",cmd,false);
+    TCLAP::SwitchArg flattenArg("F","flatten","Flatten non linear transformation series into a single dense field before resampling",cmd,false);
+    TCLAP::ValueArg<std::string> flattenCacheArg("","flatten-cache","Directory where flattened transformation fields are cached (implies flatten)",false,"","flattening cache directory",cmd);
     TCLAP::SwitchArg nearestArg("N","nearest","Use nearest neighbor interpolation",cmd,false);
     
     TCLAP::ValueArg<unsigned int> nbpArg("p","numberofthreads","Number of threads to run on (default: all cores)",false,itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads(),"number of threads",cmd);
@@ -79,6 +81,9 @@ int main(int ac, const char** av)
     trReader->SetInvertTransform(invertArg.isSet());
     trReader->SetExponentiationOrder(expOrderArg.getValue());
     trReader->SetNumberOfWorkUnits(nbpArg.getValue());
+    trReader->SetFlattenTransform(flattenArg.isSet() || flattenCacheArg.isSet());
+    trReader->SetFlatteningGeometry(imageIO);
+    trReader->SetFlatteningCacheDirectory(flattenCacheArg.getValue());
 
     try
     {
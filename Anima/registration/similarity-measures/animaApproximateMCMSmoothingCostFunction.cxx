@@ -11,18 +11,16 @@ ApproximateMCMSmoothingCostFunction
     unsigned int numRefModels = refModels.size();
     m_ReferenceModelSignalValues.resize(numRefModels);
     unsigned int numSamples = gradients.size();
-    std::vector <double> modelSignalValues(numSamples,0);
 
     for (unsigned int i = 0;i < numRefModels;++i)
     {
+        m_ReferenceModelSignalValues[i].resize(numSamples);
         for (unsigned int j = 0;j < numSamples;++j)
-            modelSignalValues[j] = refModels[i]->GetPredictedSignal(smallDelta, bigDelta,
-                                                                    gradientStrengths[j], gradients[j]);
-
-        m_ReferenceModelSignalValues[i] = modelSignalValues;
+            m_ReferenceModelSignalValues[i][j] = refModels[i]->GetPredictedSignal(smallDelta, bigDelta,
+                                                                                  gradientStrengths[j], gradients[j]);
     }
 
-    m_UpdatedData = true;
+    m_UpdatedReferenceData = true;
 }
 
 void
@@ -33,83 +31,116 @@ ApproximateMCMSmoothingCostFunction
     unsigned int numMovingModels = movingModels.size();
     m_MovingModelSignalValues.resize(numMovingModels);
     unsigned int numSamples = gradients.size();
-    std::vector <double> modelSignalValues(numSamples,0);
 
     for (unsigned int i = 0;i < numMovingModels;++i)
     {
+        m_MovingModelSignalValues[i].resize(numSamples);
         for (unsigned int j = 0;j < numSamples;++j)
-            modelSignalValues[j] = movingModels[i]->GetPredictedSignal(smallDelta, bigDelta,
-                                                                       gradientStrengths[j], gradients[j]);
-
-        m_MovingModelSignalValues[i] = modelSignalValues;
+            m_MovingModelSignalValues[i][j] = movingModels[i]->GetPredictedSignal(smallDelta, bigDelta,
+                                                                                  gradientStrengths[j], gradients[j]);
     }
 
-    m_UpdatedData = true;
+    m_UpdatedMovingData = true;
 }
 
 void
 ApproximateMCMSmoothingCostFunction
 ::SetSmallDelta(double val)
 {
+    if (m_SmallDelta != val)
+        m_UpdatedGradientData = true;
+
     m_SmallDelta = val;
-    m_UpdatedData = true;
 }
 
 void
 ApproximateMCMSmoothingCostFunction
 ::SetBigDelta(double val)
 {
+    if (m_BigDelta != val)
+        m_UpdatedGradientData = true;
+
     m_BigDelta = val;
-    m_UpdatedData = true;
 }
 
 void
 ApproximateMCMSmoothingCostFunction
 ::SetGradientStrengths(const std::vector <double> &val)
 {
+    if (m_GradientStrengths != val)
+        m_UpdatedGradientData = true;
+
     m_GradientStrengths = val;
-    m_UpdatedData = true;
 }
 
 void
 ApproximateMCMSmoothingCostFunction
 ::SetGradientDirections(const std::vector <GradientType> &val)
 {
+    if (m_GradientDirections != val)
+        m_UpdatedGradientData = true;
+
     m_GradientDirections = val;
-    m_UpdatedData = true;
 }
 
 void
 ApproximateMCMSmoothingCostFunction
 ::SetBValueWeightIndexes(const std::vector <unsigned int> &val)
 {
+    if (m_BValueWeightIndexes != val)
+        m_UpdatedGradientData = true;
+
     m_BValueWeightIndexes = val;
-    m_UpdatedData = true;
 }
 
 void
 ApproximateMCMSmoothingCostFunction
 ::SetSphereWeights(const std::vector <double> &val)
 {
+    if (m_SphereWeights != val)
+        m_UpdatedGradientData = true;
+
     m_SphereWeights = val;
-    m_UpdatedData = true;
 }
 
-ApproximateMCMSmoothingCostFunction::MeasureType
+void
 ApproximateMCMSmoothingCostFunction
-::GetValue(const ParametersType &parameters) const
+::UpdateSignalSums() const
 {
     unsigned int numDataPoints = m_ReferenceModelSignalValues.size();
-    if (numDataPoints == 0)
-        return 0.0;
+    unsigned int numGradients = m_GradientDirections.size();
 
-    double gaussianSigma = parameters[0] * m_ParameterScale;
-    MeasureType outputValue = 0;
+    if (m_UpdatedGradientData)
+    {
+        m_GradientBValueNorms.resize(numGradients);
+        for (unsigned int j = 0;j < numGradients;++j)
+        {
+            double bValue = anima::GetBValueFromAcquisitionParameters(m_SmallDelta, m_BigDelta, m_GradientStrengths[j]);
+            double gradientNorm = 0;
+            for (unsigned int i = 0;i < m_GradientDirections[j].size();++i)
+                gradientNorm += m_GradientDirections[j][i] * m_GradientDirections[j][i];
 
-    if (m_UpdatedData)
+            m_GradientBValueNorms[j] = bValue * gradientNorm;
+        }
+    }
+
+    if (m_UpdatedReferenceData || m_UpdatedGradientData)
+    {
+        m_ReferenceSquaredSums.resize(numGradients);
+        for (unsigned int j = 0;j < numGradients;++j)
+        {
+            double squaredSum = 0;
+            for (unsigned int l = 0;l < numDataPoints;++l)
+                squaredSum += m_ReferenceModelSignalValues[l][j] * m_ReferenceModelSignalValues[l][j];
+
+            m_ReferenceSquaredSums[j] = squaredSum;
+        }
+    }
+
+    if (m_UpdatedMovingData || m_UpdatedGradientData)
     {
         m_ConstantTerm = 0;
-        for (unsigned int j = 0;j < m_GradientDirections.size();++j)
+        for (unsigned int j = 0;j < numGradients;++j)
         {
             double constantAddonValue = 0;
             for (unsigned int l = 0;l < numDataPoints;++l)
@@ -119,23 +150,42 @@ ApproximateMCMSmoothingCostFunction
         }
     }
 
-    outputValue = m_ConstantTerm;
-
-    for (unsigned int j = 0;j < m_GradientDirections.size();++j)
+    if (m_UpdatedReferenceData || m_UpdatedMovingData || m_UpdatedGradientData)
     {
-        double bValue = anima::GetBValueFromAcquisitionParameters(m_SmallDelta, m_BigDelta, m_GradientStrengths[j]);
-        double gaussianValue = 0;
-        for (unsigned int i = 0;i < m_GradientDirections[j].size();++i)
-            gaussianValue += m_GradientDirections[j][i] * m_GradientDirections[j][i];
-
-        gaussianValue = std::exp (- bValue * gaussianSigma * gaussianValue);
-
-        double addonValue = 0;
-        for (unsigned int l = 0;l < numDataPoints;++l)
+        m_ReferenceMovingSums.resize(numGradients);
+        for (unsigned int j = 0;j < numGradients;++j)
         {
-            addonValue -= 2.0 * m_MovingModelSignalValues[l][j] * m_ReferenceModelSignalValues[l][j];
-            addonValue += gaussianValue * m_ReferenceModelSignalValues[l][j] * m_ReferenceModelSignalValues[l][j];
+            double crossSum = 0;
+            for (unsigned int l = 0;l < numDataPoints;++l)
+                crossSum += m_MovingModelSignalValues[l][j] * m_ReferenceModelSignalValues[l][j];
+
+            m_ReferenceMovingSums[j] = crossSum;
         }
+    }
+
+    m_UpdatedReferenceData = false;
+    m_UpdatedMovingData = false;
+    m_UpdatedGradientData = false;
+}
+
+ApproximateMCMSmoothingCostFunction::MeasureType
+ApproximateMCMSmoothingCostFunction
+::GetValue(const ParametersType &parameters) const
+{
+    unsigned int numDataPoints = m_ReferenceModelSignalValues.size();
+    if (numDataPoints == 0)
+        return 0.0;
+
+    this->UpdateSignalSums();
+
+    double gaussianSigma = parameters[0] * m_ParameterScale;
+    MeasureType outputValue = m_ConstantTerm;
+
+    // Data points only enter through sigma independent sums, a value is linear in the number of gradients
+    for (unsigned int j = 0;j < m_GradientDirections.size();++j)
+    {
+        double gaussianValue = std::exp (- gaussianSigma * m_GradientBValueNorms[j]);
+        double addonValue = gaussianValue * m_ReferenceSquaredSums[j] - 2.0 * m_ReferenceMovingSums[j];
 
         outputValue += m_SphereWeights[m_BValueWeightIndexes[j]] * gaussianValue * addonValue;
     }
@@ -157,28 +207,18 @@ ApproximateMCMSmoothingCostFunction
     if (numDataPoints == 0)
         return;
 
+    this->UpdateSignalSums();
+
     double gaussianSigma = parameters[0] * m_ParameterScale;
 
     for (unsigned int j = 0;j < m_GradientDirections.size();++j)
     {
-        double bValue = anima::GetBValueFromAcquisitionParameters(m_SmallDelta, m_BigDelta, m_GradientStrengths[j]);
-        double addonValue = 0;
-        double gaussianDotProduct = 0;
-        for (unsigned int i = 0;i < m_GradientDirections[j].size();++i)
-            gaussianDotProduct += m_GradientDirections[j][i] * m_GradientDirections[j][i];
-        gaussianDotProduct *= bValue;
+        double gaussianDotProduct = m_GradientBValueNorms[j];
 
         double gaussianDerivativeValue = - gaussianDotProduct * std::exp (- gaussianSigma * gaussianDotProduct);
         double gaussianSqDerivativeValue = - 2.0 * gaussianDotProduct * std::exp (- 2.0 * gaussianSigma * gaussianDotProduct);
 
-        for (unsigned int l = 0;l < numDataPoints;++l)
-        {
-            double firstTerm = gaussianSqDerivativeValue * m_ReferenceModelSignalValues[l][j] * m_ReferenceModelSignalValues[l][j];
-            double secondTerm = - 2.0 * gaussianDerivativeValue * m_MovingModelSignalValues[l][j] - m_ReferenceModelSignalValues[l][j];
-
-            addonValue += firstTerm + secondTerm;
-        }
-
+        double addonValue = gaussianSqDerivativeValue * m_ReferenceSquaredSums[j] - 2.0 * gaussianDerivativeValue * m_ReferenceMovingSums[j];
         derivative[0] += m_SphereWeights[m_BValueWeightIndexes[j]] * addonValue;
     }
 
@@ -55,7 +55,9 @@ public:
 protected:
     ApproximateMCMSmoothingCostFunction()
     {
-        m_UpdatedData = false;
+        m_UpdatedReferenceData = false;
+        m_UpdatedMovingData = false;
+        m_UpdatedGradientData = false;
         m_ConstantTerm = 0;
         m_ParameterScale = 1.0e-3;
         m_SmallDelta = anima::DiffusionSmallDelta;
@@ -64,6 +66,9 @@ protected:
 
     virtual ~ApproximateMCMSmoothingCostFunction() {}
 
+    //! Computes sigma independent per gradient sums over the block data points, only for updated data
+    void UpdateSignalSums() const;
+
 private:
     ApproximateMCMSmoothingCostFunction(const Self&); //purposely not implemented
     void operator=(const Self&); //purposely not implemented
@@ -75,7 +80,11 @@ private:
     std::vector <double> m_GradientStrengths, m_SphereWeights;
     std::vector <GradientType> m_GradientDirections;
 
-    mutable bool m_UpdatedData;
+    //! Per gradient b-value times squared gradient norm, and sums of reference squared and reference times moving signals
+    mutable std::vector <double> m_GradientBValueNorms;
+    mutable std::vector <double> m_ReferenceSquaredSums, m_ReferenceMovingSums;
+
+    mutable bool m_UpdatedReferenceData, m_UpdatedMovingData, m_UpdatedGradientData;
     mutable double m_ConstantTerm;
     double m_ParameterScale;
     double m_SmallDelta, m_BigDelta;
@@ -4,6 +4,8 @@
 #include <itkCovariantVector.h>
 #include <itkPoint.h>
 
+#include <animaLinearBlockSampler.h>
+
 
 namespace anima
 {
@@ -78,6 +80,10 @@ private:
 
     std::vector <InputPointType> m_FixedImagePoints;
     std::vector <RealType> m_FixedImageValues;
+
+    // Fast path for linear block transforms, work buffer for moving values
+    LinearBlockSampler <TMovingImage> m_BlockSampler;
+    mutable std::vector <double> m_MovingValues;
 };
 
 } // end of namespace anima
@@ -2,6 +2,7 @@
 #include "animaFastCorrelationImageToImageMetric.h"
 
 #include <itkImageRegionConstIteratorWithIndex.h>
+#include <vnl/algo/vnl_determinant.h>
 
 namespace anima
 {
@@ -41,37 +42,78 @@ FastCorrelationImageToImageMetric<TFixedImage,TMovingImage>
     AccumulateType sfm = itk::NumericTraits< AccumulateType >::Zero;
     AccumulateType sm  = itk::NumericTraits< AccumulateType >::Zero;
 
-    OutputPointType transformedPoint;
-    ContinuousIndexType transformedIndex;
-    RealType movingValue;
+    double scaleFactor = 1.0;
+    if (m_ScaleIntensities)
+    {
+        typename LinearBlockSampler <TMovingImage>::MatrixType linearMatrix;
+        typename LinearBlockSampler <TMovingImage>::VectorType linearOffset;
+        if (LinearBlockSampler <TMovingImage>::GetLinearTransformParameters(this->m_Transform,linearMatrix,linearOffset))
+            scaleFactor = vnl_determinant(linearMatrix);
+    }
+
+    bool fastSampling = m_BlockSampler.SampleMovingValues(this->m_Transform,scaleFactor,
+                                                          m_DefaultBackgroundValue * scaleFactor,m_MovingValues);
+
+    if (!fastSampling)
+    {
+        // Generic transform, sample points one by one
+        OutputPointType transformedPoint;
+        ContinuousIndexType transformedIndex;
+        m_MovingValues.resize(this->m_NumberOfPixelsCounted);
+
+        for (unsigned int i = 0;i < this->m_NumberOfPixelsCounted;++i)
+        {
+            transformedPoint = this->m_Transform->TransformPoint(m_FixedImagePoints[i]);
+            this->m_Interpolator->GetInputImage()->TransformPhysicalPointToContinuousIndex(transformedPoint,transformedIndex);
+
+            RealType movingValue = m_DefaultBackgroundValue;
+            if (this->m_Interpolator->IsInsideBuffer(transformedIndex))
+                movingValue = this->m_Interpolator->EvaluateAtContinuousIndex(transformedIndex);
+
+            m_MovingValues[i] = movingValue * scaleFactor;
+        }
+    }
 
-    for (unsigned int i = 0;i < this->m_NumberOfPixelsCounted;++i)
+    // Null moving values do not contribute, accumulate on independent partial sums to allow vectorization
+    const unsigned int numPartialSums = 4;
+    AccumulateType partialSmm[numPartialSums], partialSfm[numPartialSums], partialSm[numPartialSums];
+    for (unsigned int j = 0;j < numPartialSums;++j)
     {
-        transformedPoint = this->m_Transform->TransformPoint(m_FixedImagePoints[i]);
-        this->m_Interpolator->GetInputImage()->TransformPhysicalPointToContinuousIndex(transformedPoint,transformedIndex);
+        partialSmm[j] = itk::NumericTraits< AccumulateType >::Zero;
+        partialSfm[j] = itk::NumericTraits< AccumulateType >::Zero;
+        partialSm[j] = itk::NumericTraits< AccumulateType >::Zero;
+    }
 
-        movingValue = m_DefaultBackgroundValue;
-        if (this->m_Interpolator->IsInsideBuffer(transformedIndex))
-            movingValue = this->m_Interpolator->EvaluateAtContinuousIndex(transformedIndex);
+    const double *movingPtr = m_MovingValues.data();
+    const RealType *fixedPtr = m_FixedImageValues.data();
+    unsigned int numVectorizedPixels = this->m_NumberOfPixelsCounted - (this->m_NumberOfPixelsCounted % numPartialSums);
 
-        if (movingValue != 0.0)
+    for (unsigned int i = 0;i < numVectorizedPixels;i += numPartialSums)
+    {
+        for (unsigned int j = 0;j < numPartialSums;++j)
         {
-            if (m_ScaleIntensities)
-            {
-                typedef itk::MatrixOffsetTransformBase <typename TransformType::ScalarType,
-                        TFixedImage::ImageDimension, TFixedImage::ImageDimension> BaseTransformType;
-                BaseTransformType *currentTrsf = dynamic_cast<BaseTransformType *> (this->m_Transform.GetPointer());
-
-                double factor = vnl_determinant(currentTrsf->GetMatrix().GetVnlMatrix());
-                movingValue *= factor;
-            }
-
-            smm += movingValue * movingValue;
-            sfm += m_FixedImageValues[i] * movingValue;
-            sm += movingValue;
+            double movingValue = movingPtr[i + j];
+            partialSmm[j] += movingValue * movingValue;
+            partialSfm[j] += fixedPtr[i + j] * movingValue;
+            partialSm[j] += movingValue;
         }
     }
 
+    for (unsigned int i = numVectorizedPixels;i < this->m_NumberOfPixelsCounted;++i)
+    {
+        double movingValue = movingPtr[i];
+        smm += movingValue * movingValue;
+        sfm += fixedPtr[i] * movingValue;
+        sm += movingValue;
+    }
+
+    for (unsigned int j = 0;j < numPartialSums;++j)
+    {
+        smm += partialSmm[j];
+        sfm += partialSfm[j];
+        sm += partialSm[j];
+    }
+
     RealType movingVariance = smm - sm * sm / this->m_NumberOfPixelsCounted;
     RealType covData = sfm - m_SumFixed * sm / this->m_NumberOfPixelsCounted;
     RealType multVars = m_VarFixed * movingVariance;
@@ -141,6 +183,9 @@ FastCorrelationImageToImageMetric<TFixedImage,TMovingImage>
     }
 
     m_VarFixed = sumSquared - m_SumFixed * m_SumFixed / this->m_NumberOfPixelsCounted;
+
+    m_BlockSampler.SetMovingImage(this->m_MovingImage);
+    m_BlockSampler.SetFixedPoints(m_FixedImagePoints);
 }
 
 template < class TFixedImage, class TMovingImage>
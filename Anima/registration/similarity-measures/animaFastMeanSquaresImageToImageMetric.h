@@ -4,6 +4,8 @@
 #include "itkCovariantVector.h"
 #include "itkPoint.h"
 
+#include <animaLinearBlockSampler.h>
+
 namespace anima
 {
 template < class TFixedImage, class TMovingImage >
@@ -73,6 +75,10 @@ private:
 
     std::vector <InputPointType> m_FixedImagePoints;
     std::vector <RealType> m_FixedImageValues;
+
+    // Fast path for linear block transforms, work buffer for moving values
+    LinearBlockSampler <TMovingImage> m_BlockSampler;
+    mutable std::vector <double> m_MovingValues;
 };
 
 } // end namespace anima
@@ -2,6 +2,7 @@
 #include "animaFastMeanSquaresImageToImageMetric.h"
 
 #include <itkImageRegionConstIteratorWithIndex.h>
+#include <vnl/algo/vnl_determinant.h>
 
 namespace anima
 {
@@ -32,35 +33,67 @@ FastMeanSquaresImageToImageMetric<TFixedImage,TMovingImage>
     MeasureType measure = 0;
     this->SetTransformParameters( parameters );
 
-    OutputPointType transformedPoint;
-    ContinuousIndexType transformedIndex;
-    RealType movingValue;
-
-    for (unsigned int i = 0;i < this->m_NumberOfPixelsCounted;++i)
+    double scaleFactor = 1.0;
+    if (m_ScaleIntensities)
     {
-        transformedPoint = this->m_Transform->TransformPoint( m_FixedImagePoints[i] );
-        this->m_Interpolator->GetInputImage()->TransformPhysicalPointToContinuousIndex(transformedPoint,transformedIndex);
+        typename LinearBlockSampler <TMovingImage>::MatrixType linearMatrix;
+        typename LinearBlockSampler <TMovingImage>::VectorType linearOffset;
+        if (LinearBlockSampler <TMovingImage>::GetLinearTransformParameters(this->m_Transform,linearMatrix,linearOffset))
+            scaleFactor = vnl_determinant(linearMatrix);
+    }
 
-        movingValue = m_DefaultBackgroundValue;
+    bool fastSampling = m_BlockSampler.SampleMovingValues(this->m_Transform,scaleFactor,
+                                                          m_DefaultBackgroundValue,m_MovingValues);
+
+    if (!fastSampling)
+    {
+        // Generic transform, sample points one by one
+        OutputPointType transformedPoint;
+        ContinuousIndexType transformedIndex;
+        m_MovingValues.resize(this->m_NumberOfPixelsCounted);
 
-        if( this->m_Interpolator->IsInsideBuffer( transformedIndex ) )
+        for (unsigned int i = 0;i < this->m_NumberOfPixelsCounted;++i)
         {
-            movingValue = this->m_Interpolator->EvaluateAtContinuousIndex( transformedIndex );
+            transformedPoint = this->m_Transform->TransformPoint( m_FixedImagePoints[i] );
+            this->m_Interpolator->GetInputImage()->TransformPhysicalPointToContinuousIndex(transformedPoint,transformedIndex);
+
+            RealType movingValue = m_DefaultBackgroundValue;
+
+            if( this->m_Interpolator->IsInsideBuffer( transformedIndex ) )
+                movingValue = this->m_Interpolator->EvaluateAtContinuousIndex( transformedIndex ) * scaleFactor;
+
+            m_MovingValues[i] = movingValue;
+        }
+    }
+
+    // Accumulate on independent partial sums to allow vectorization
+    const unsigned int numPartialSums = 4;
+    double partialMeasures[numPartialSums];
+    for (unsigned int j = 0;j < numPartialSums;++j)
+        partialMeasures[j] = 0;
 
-            if (m_ScaleIntensities)
-            {
-                typedef itk::MatrixOffsetTransformBase <typename TransformType::ScalarType,
-                        TFixedImage::ImageDimension, TFixedImage::ImageDimension> BaseTransformType;
-                BaseTransformType *currentTrsf = dynamic_cast<BaseTransformType *> (this->m_Transform.GetPointer());
+    const double *movingPtr = m_MovingValues.data();
+    const RealType *fixedPtr = m_FixedImageValues.data();
+    unsigned int numVectorizedPixels = this->m_NumberOfPixelsCounted - (this->m_NumberOfPixelsCounted % numPartialSums);
 
-                double factor = vnl_determinant(currentTrsf->GetMatrix().GetVnlMatrix());
-                movingValue *= factor;
-            }
+    for (unsigned int i = 0;i < numVectorizedPixels;i += numPartialSums)
+    {
+        for (unsigned int j = 0;j < numPartialSums;++j)
+        {
+            double diffValue = movingPtr[i + j] - fixedPtr[i + j];
+            partialMeasures[j] += diffValue * diffValue;
         }
+    }
 
-        measure += (movingValue - m_FixedImageValues[i]) * (movingValue - m_FixedImageValues[i]);
+    for (unsigned int i = numVectorizedPixels;i < this->m_NumberOfPixelsCounted;++i)
+    {
+        double diffValue = movingPtr[i] - fixedPtr[i];
+        measure += diffValue * diffValue;
     }
 
+    for (unsigned int j = 0;j < numPartialSums;++j)
+        measure += partialMeasures[j];
+
     measure /= this->m_NumberOfPixelsCounted;
 
     return measure;
@@ -125,6 +158,9 @@ FastMeanSquaresImageToImageMetric<TFixedImage,TMovingImage>
         ++ti;
         ++pos;
     }
+
+    m_BlockSampler.SetMovingImage(this->m_MovingImage);
+    m_BlockSampler.SetFixedPoints(m_FixedImagePoints);
 }
 
 } // end namespace anima
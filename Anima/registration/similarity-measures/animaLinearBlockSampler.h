@@ -0,0 +1,75 @@
+#pragma once
+
+#include <itkTransform.h>
+#include <itkPoint.h>
+#include <vnl/vnl_matrix_fixed.h>
+#include <vnl/vnl_vector_fixed.h>
+
+#include <vector>
+
+namespace anima
+{
+
+/**
+ * @brief Fast sampler of a scalar moving image on a fixed set of block points, for linear transforms.
+ * Fixed block points are stored coordinate-wise (structure of arrays). For translation and matrix-offset
+ * transforms, the whole block is mapped to moving image continuous indexes with a single matrix product
+ * and linearly interpolated directly from the moving image buffer, bypassing the per-point virtual
+ * calls of the transform and interpolator. Interpolation mimics itk::LinearInterpolateImageFunction
+ * (values are clamped to the buffer border, points outside the buffer get a default value).
+ */
+template <class TMovingImage>
+class LinearBlockSampler
+{
+public:
+    typedef TMovingImage MovingImageType;
+    itkStaticConstMacro(ImageDimension, unsigned int, TMovingImage::ImageDimension);
+
+    typedef itk::Transform <double, ImageDimension, ImageDimension> TransformType;
+    typedef itk::Point <double, ImageDimension> PointType;
+    typedef vnl_matrix_fixed <double, ImageDimension, ImageDimension> MatrixType;
+    typedef vnl_vector_fixed <double, ImageDimension> VectorType;
+
+    LinearBlockSampler();
+    virtual ~LinearBlockSampler() {}
+
+    void SetMovingImage(const MovingImageType *image);
+    void SetFixedPoints(const std::vector <PointType> &points);
+
+    unsigned int GetNumberOfPoints() const {return m_NumberOfPoints;}
+
+    /**
+     * Extracts the linear part and offset of a transform if it is a translation or a matrix-offset transform.
+     * Returns false for any other transform, in which case the generic metric path should be used.
+     */
+    static bool GetLinearTransformParameters(const TransformType *transform, MatrixType &matrix, VectorType &offset);
+
+    /**
+     * Samples the moving image at the transformed block points. Inside values are multiplied by insideScale,
+     * outside values are set to outsideValue. Returns false if the transform is not linear.
+     */
+    bool SampleMovingValues(const TransformType *transform, double insideScale, double outsideValue,
+                            std::vector <double> &movingValues) const;
+
+private:
+    const MovingImageType *m_MovingImage;
+
+    unsigned int m_NumberOfPoints;
+
+    // Fixed points coordinates, stored as [dim * m_NumberOfPoints + point]
+    std::vector <double> m_FixedCoordinates;
+
+    // Work buffer for moving continuous indexes, same layout as fixed coordinates
+    mutable std::vector <double> m_ContinuousIndexes;
+
+    // Moving image geometry, cached at SetMovingImage
+    MatrixType m_PhysicalToIndexMatrix;
+    VectorType m_MovingOrigin;
+    long m_BufferStartIndex[ImageDimension];
+    long m_BufferEndIndex[ImageDimension];
+    long m_BufferOffsets[ImageDimension];
+};
+
+} // end namespace anima
+
+#include "animaLinearBlockSampler.hxx"
@@ -0,0 +1,204 @@
+#pragma once
+#include "animaLinearBlockSampler.h"
+
+#include <itkTranslationTransform.h>
+#include <itkMatrixOffsetTransformBase.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace anima
+{
+
+template <class TMovingImage>
+LinearBlockSampler <TMovingImage>
+::LinearBlockSampler()
+{
+    m_MovingImage = 0;
+    m_NumberOfPoints = 0;
+
+    m_PhysicalToIndexMatrix.set_identity();
+    m_MovingOrigin.fill(0.0);
+    for (unsigned int i = 0;i < ImageDimension;++i)
+    {
+        m_BufferStartIndex[i] = 0;
+        m_BufferEndIndex[i] = 0;
+        m_BufferOffsets[i] = 0;
+    }
+}
+
+template <class TMovingImage>
+void
+LinearBlockSampler <TMovingImage>
+::SetMovingImage(const MovingImageType *image)
+{
+    m_MovingImage = image;
+    if (!image)
+        return;
+
+    typename MovingImageType::RegionType bufferedRegion = image->GetBufferedRegion();
+    const typename MovingImageType::OffsetValueType *offsetTable = image->GetOffsetTable();
+
+    for (unsigned int i = 0;i < ImageDimension;++i)
+    {
+        m_BufferStartIndex[i] = bufferedRegion.GetIndex()[i];
+        m_BufferEndIndex[i] = m_BufferStartIndex[i] + bufferedRegion.GetSize()[i] - 1;
+        m_BufferOffsets[i] = offsetTable[i];
+        m_MovingOrigin[i] = image->GetOrigin()[i];
+
+        for (unsigned int j = 0;j < ImageDimension;++j)
+            m_PhysicalToIndexMatrix(i,j) = image->GetPhysicalPointToIndexMatrix()(i,j);
+    }
+}
+
+template <class TMovingImage>
+void
+LinearBlockSampler <TMovingImage>
+::SetFixedPoints(const std::vector <PointType> &points)
+{
+    m_NumberOfPoints = points.size();
+    m_FixedCoordinates.resize(ImageDimension * m_NumberOfPoints);
+    m_ContinuousIndexes.resize(ImageDimension * m_NumberOfPoints);
+
+    for (unsigned int i = 0;i < ImageDimension;++i)
+    {
+        double *coordinatesPtr = m_FixedCoordinates.data() + i * m_NumberOfPoints;
+        for (unsigned int j = 0;j < m_NumberOfPoints;++j)
+            coordinatesPtr[j] = points[j][i];
+    }
+}
+
+template <class TMovingImage>
+bool
+LinearBlockSampler <TMovingImage>
+::GetLinearTransformParameters(const TransformType *transform, MatrixType &matrix, VectorType &offset)
+{
+    typedef itk::MatrixOffsetTransformBase <double, ImageDimension, ImageDimension> MatrixTransformType;
+    const MatrixTransformType *matrixTrsf = dynamic_cast <const MatrixTransformType *> (transform);
+
+    if (matrixTrsf)
+    {
+        for (unsigned int i = 0;i < ImageDimension;++i)
+        {
+            offset[i] = matrixTrsf->GetOffset()[i];
+            for (unsigned int j = 0;j < ImageDimension;++j)
+                matrix(i,j) = matrixTrsf->GetMatrix()(i,j);
+        }
+
+        return true;
+    }
+
+    typedef itk::TranslationTransform <double, ImageDimension> TranslationTransformType;
+    const TranslationTransformType *translationTrsf = dynamic_cast <const TranslationTransformType *> (transform);
+
+    if (translationTrsf)
+    {
+        matrix.set_identity();
+        for (unsigned int i = 0;i < ImageDimension;++i)
+            offset[i] = translationTrsf->GetOffset()[i];
+
+        return true;
+    }
+
+    return false;
+}
+
+template <class TMovingImage>
+bool
+LinearBlockSampler <TMovingImage>
+::SampleMovingValues(const TransformType *transform, double insideScale, double outsideValue,
+                     std::vector <double> &movingValues) const
+{
+    if (!m_MovingImage)
+        return false;
+
+    MatrixType transformMatrix;
+    VectorType transformOffset;
+    if (!GetLinearTransformParameters(transform, transformMatrix, transformOffset))
+        return false;
+
+    // Physical to continuous index mapping of the whole block: c = P * (A * x + t - O)
+    MatrixType indexMatrix = m_PhysicalToIndexMatrix * transformMatrix;
+    VectorType indexOffset = m_PhysicalToIndexMatrix * (transformOffset - m_MovingOrigin);
+
+    for (unsigned int i = 0;i < ImageDimension;++i)
+    {
+        double *indexPtr = m_ContinuousIndexes.data() + i * m_NumberOfPoints;
+        double offsetValue = indexOffset[i];
+        for (unsigned int k = 0;k < m_NumberOfPoints;++k)
+            indexPtr[k] = offsetValue;
+
+        for (unsigned int j = 0;j < ImageDimension;++j)
+        {
+            double coefValue = indexMatrix(i,j);
+            const double *coordinatesPtr = m_FixedCoordinates.data() + j * m_NumberOfPoints;
+            for (unsigned int k = 0;k < m_NumberOfPoints;++k)
+                indexPtr[k] += coefValue * coordinatesPtr[k];
+        }
+    }
+
+    movingValues.resize(m_NumberOfPoints);
+
+    typedef typename MovingImageType::PixelType MovingPixelType;
+    const MovingPixelType *bufferPtr = m_MovingImage->GetBufferPointer();
+    const unsigned int numCorners = 1 << ImageDimension;
+
+    long cornerSteps[ImageDimension];
+    double distances[ImageDimension];
+
+    for (unsigned int k = 0;k < m_NumberOfPoints;++k)
+    {
+        bool isInside = true;
+        long baseOffset = 0;
+        for (unsigned int i = 0;i < ImageDimension;++i)
+        {
+            double indexValue = m_ContinuousIndexes[i * m_NumberOfPoints + k];
+            if ((indexValue < m_BufferStartIndex[i] - 0.5) || (indexValue >= m_BufferEndIndex[i] + 0.5))
+            {
+                isInside = false;
+                break;
+            }
+
+            long baseIndex = std::floor(indexValue);
+            if (baseIndex < m_BufferStartIndex[i])
+                baseIndex = m_BufferStartIndex[i];
+
+            distances[i] = std::max(0.0, indexValue - baseIndex);
+            cornerSteps[i] = (baseIndex < m_BufferEndIndex[i]) ? m_BufferOffsets[i] : 0;
+
+            baseOffset += (baseIndex - m_BufferStartIndex[i]) * m_BufferOffsets[i];
+        }
+
+        if (!isInside)
+        {
+            movingValues[k] = outsideValue;
+            continue;
+        }
+
+        double value = 0.0;
+        for (unsigned int c = 0;c < numCorners;++c)
+        {
+            double weight = 1.0;
+            long cornerOffset = baseOffset;
+            for (unsigned int i = 0;i < ImageDimension;++i)
+            {
+                if (c & (1 << i))
+                {
+                    weight *= distances[i];
+                    cornerOffset += cornerSteps[i];
+                }
+                else
+                    weight *= 1.0 - distances[i];
+            }
+
+            if (weight != 0.0)
+                value += weight * bufferPtr[cornerOffset];
+        }
+
+        movingValues[k] = insideScale * value;
+    }
+
+    return true;
+}
+
+} // end namespace anima
@@ -4,6 +4,10 @@
 #include <animaMultiCompartmentModel.h>
 #include <animaMCMImage.h>
 
+#include <animaMultiTensorSmoothingCostFunction.h>
+#include <animaApproximateMCMSmoothingCostFunction.h>
+#include <animaNLOPTOptimizers.h>
+
 namespace anima
 {
 
@@ -25,6 +29,10 @@ public:
     typedef typename MCModelType::Pointer MCModelPointer;
     typedef typename MCModelType::Vector3DType GradientType;
 
+    typedef anima::MultiTensorSmoothingCostFunction TensorSmoothingCostFunctionType;
+    typedef anima::ApproximateMCMSmoothingCostFunction ApproximateSmoothingCostFunctionType;
+    typedef anima::NLOPTOptimizers SmoothingOptimizerType;
+
     /** Method for creation through the object factory. */
     itkNewMacro(Self)
 
@@ -74,6 +82,9 @@ protected:
     double ComputeTensorBasedMetric(const std::vector <MCModelPointer> &movingValues) const;
     double ComputeNonTensorBasedMetric(const std::vector <MCModelPointer> &movingValues) const;
 
+    //! Optimizes the smoothing sigma from the previous optimal value, returns the optimal cost
+    double OptimizeSmoothingSigma(itk::SingleValuedCostFunction *costFunction) const;
+
     bool isZero(PixelType &vector) const;
 
 private:
@@ -83,6 +94,21 @@ private:
     std::vector <InputPointType> m_FixedImagePoints;
     std::vector <MCModelPointer> m_FixedImageValues;
 
+    // Model pools reused over blocks and evaluations, the metric being used by a single thread
+    std::vector <MCModelPointer> m_FixedModelsPool;
+    const FixedImageType *m_PooledFixedImage;
+    mutable std::vector <MCModelPointer> m_MovingModelsPool;
+    mutable std::vector <MCModelPointer> m_MovingValues;
+    mutable const MovingImageType *m_PooledMovingImage;
+
+    // Smoothing cost functions and optimizer, reference data is set once per block
+    TensorSmoothingCostFunctionType::Pointer m_TensorSmoothingCostFunction;
+    ApproximateSmoothingCostFunctionType::Pointer m_ApproximateSmoothingCostFunction;
+    SmoothingOptimizerType::Pointer m_SmoothingOptimizer;
+    mutable bool m_ModifiedTensorReferenceModels;
+    mutable bool m_ModifiedApproximateReferenceModels;
+    mutable double m_LastOptimalGaussianSigma;
+
     // Optional parameters for the case when compartments are not tensor compatible
     std::vector <double> m_GradientStrengths;
     double m_SmallDelta, m_BigDelta;
@@ -1,14 +1,12 @@
 #pragma once
 #include "animaMCMCorrelationImageToImageMetric.h"
 
+#include <algorithm>
 #include <vnl/vnl_matrix_fixed.h>
 #include <animaBaseTensorTools.h>
 #include <animaMultiCompartmentModelCreator.h>
 #include <itkImageRegionConstIteratorWithIndex.h>
 
-#include <animaMultiTensorSmoothingCostFunction.h>
-#include <animaApproximateMCMSmoothingCostFunction.h>
-#include <animaNLOPTOptimizers.h>
 #include <animaMCMConstants.h>
 
 namespace anima
@@ -38,6 +36,25 @@ MCMCorrelationImageToImageMetric<TFixedImagePixelType,TMovingImagePixelType,Imag
 
     m_LowerBoundGaussianSigma = 0;
     m_UpperBoundGaussianSigma = 25;
+    m_LastOptimalGaussianSigma = m_LowerBoundGaussianSigma + (m_UpperBoundGaussianSigma - m_LowerBoundGaussianSigma) / 10.0;
+
+    m_PooledFixedImage = NULL;
+    m_PooledMovingImage = NULL;
+
+    m_TensorSmoothingCostFunction = TensorSmoothingCostFunctionType::New();
+    m_TensorSmoothingCostFunction->SetTensorsScale(1000.0);
+
+    m_ApproximateSmoothingCostFunction = ApproximateSmoothingCostFunctionType::New();
+    m_ApproximateSmoothingCostFunction->SetParameterScale(1.0e-3);
+
+    m_ModifiedTensorReferenceModels = true;
+    m_ModifiedApproximateReferenceModels = true;
+
+    m_SmoothingOptimizer = SmoothingOptimizerType::New();
+    m_SmoothingOptimizer->SetAlgorithm(NLOPT_LN_BOBYQA);
+    m_SmoothingOptimizer->SetMaximize(false);
+    m_SmoothingOptimizer->SetXTolRel(1.0e-8);
+    m_SmoothingOptimizer->SetMaxEval(2000);
 }
 
 template < class TFixedImagePixelType, class TMovingImagePixelType, unsigned int ImageDimension >
@@ -90,7 +107,14 @@ MCMCorrelationImageToImageMetric<TFixedImagePixelType,TMovingImagePixelType,Imag
     MovingImageType *movingImage = const_cast <MovingImageType *> (this->GetMovingImage());
     bool tensorCompatibilityCondition = this->CheckTensorCompatibility();
 
-    std::vector <MCModelPointer> movingValues(this->m_NumberOfPixelsCounted);
+    if (m_PooledMovingImage != movingImage)
+    {
+        m_MovingModelsPool.clear();
+        m_PooledMovingImage = movingImage;
+    }
+
+    m_MovingModelsPool.resize(this->m_NumberOfPixelsCounted);
+    m_MovingValues.resize(this->m_NumberOfPixelsCounted);
 
     for (unsigned int i = 0;i < this->m_NumberOfPixelsCounted;++i)
     {
@@ -103,25 +127,28 @@ MCMCorrelationImageToImageMetric<TFixedImagePixelType,TMovingImagePixelType,Imag
 
             if (!isZero(movingValue))
             {
-                MCModelPointer currentMovingValue = movingImage->GetDescriptionModel()->Clone();
+                if (!m_MovingModelsPool[i])
+                    m_MovingModelsPool[i] = movingImage->GetDescriptionModel()->Clone();
+
+                MCModelPointer &currentMovingValue = m_MovingModelsPool[i];
                 currentMovingValue->SetModelVector(movingValue);
 
                 if (this->GetModelRotation() != Superclass::NONE)
                     currentMovingValue->Reorient(this->m_OrientationMatrix, (this->GetModelRotation() == Superclass::PPD));
 
-                movingValues[i] = currentMovingValue;
+                m_MovingValues[i] = currentMovingValue;
             }
             else
-                movingValues[i] = m_ZeroDiffusionModel;
+                m_MovingValues[i] = m_ZeroDiffusionModel;
         }
         else
-            movingValues[i] = m_ZeroDiffusionModel;
+            m_MovingValues[i] = m_ZeroDiffusionModel;
     }
 
     if (tensorCompatibilityCondition)
-        return this->ComputeTensorBasedMetric(movingValues);
+        return this->ComputeTensorBasedMetric(m_MovingValues);
 
-    return this->ComputeNonTensorBasedMetric(movingValues);
+    return this->ComputeNonTensorBasedMetric(m_MovingValues);
 }
 
 template < class TFixedImagePixelType, class TMovingImagePixelType, unsigned int ImageDimension >
@@ -129,85 +156,68 @@ double
 MCMCorrelationImageToImageMetric<TFixedImagePixelType,TMovingImagePixelType,ImageDimension>
 ::ComputeTensorBasedMetric(const std::vector <MCModelPointer> &movingValues) const
 {
-    typedef anima::MultiTensorSmoothingCostFunction CostFunctionType;
-    typename CostFunctionType::Pointer smootherCostFunction = CostFunctionType::New();
-
-    smootherCostFunction->SetReferenceModels(m_FixedImageValues);
-    smootherCostFunction->SetMovingModels(movingValues);
-    smootherCostFunction->SetTensorsScale(1000.0);
-
-    typedef anima::NLOPTOptimizers OptimizerType;
-    OptimizerType::ParametersType p(smootherCostFunction->GetNumberOfParameters());
-    OptimizerType::ParametersType lowerBounds(smootherCostFunction->GetNumberOfParameters());
-    OptimizerType::ParametersType upperBounds(smootherCostFunction->GetNumberOfParameters());
-
-    lowerBounds[0] = m_LowerBoundGaussianSigma;
-    upperBounds[0] = m_UpperBoundGaussianSigma;
+    if (m_ModifiedTensorReferenceModels)
+    {
+        m_TensorSmoothingCostFunction->SetReferenceModels(m_FixedImageValues);
+        m_ModifiedTensorReferenceModels = false;
+    }
 
-    p[0] = m_LowerBoundGaussianSigma + (m_UpperBoundGaussianSigma - m_LowerBoundGaussianSigma) / 10.0;
+    m_TensorSmoothingCostFunction->SetMovingModels(movingValues);
 
-    typename OptimizerType::Pointer smoothingOptimizer = OptimizerType::New();
-    smoothingOptimizer->SetAlgorithm(NLOPT_LN_BOBYQA);
-    smoothingOptimizer->SetMaximize(false);
-    smoothingOptimizer->SetXTolRel(1.0e-8);
-    smoothingOptimizer->SetMaxEval(2000);
-    smoothingOptimizer->SetCostFunction(smootherCostFunction);
+    return this->OptimizeSmoothingSigma(m_TensorSmoothingCostFunction);
+}
 
-    smoothingOptimizer->SetLowerBoundParameters(lowerBounds);
-    smoothingOptimizer->SetUpperBoundParameters(upperBounds);
+template < class TFixedImagePixelType, class TMovingImagePixelType, unsigned int ImageDimension >
+double
+MCMCorrelationImageToImageMetric<TFixedImagePixelType,TMovingImagePixelType,ImageDimension>
+::ComputeNonTensorBasedMetric(const std::vector <MCModelPointer> &movingValues) const
+{
+    if (m_ModifiedApproximateReferenceModels)
+    {
+        m_ApproximateSmoothingCostFunction->SetGradientDirections(m_GradientDirections);
+        m_ApproximateSmoothingCostFunction->SetSmallDelta(m_SmallDelta);
+        m_ApproximateSmoothingCostFunction->SetBigDelta(m_BigDelta);
+        m_ApproximateSmoothingCostFunction->SetGradientStrengths(m_GradientStrengths);
+        m_ApproximateSmoothingCostFunction->SetBValueWeightIndexes(m_BValWeightsIndexes);
+        m_ApproximateSmoothingCostFunction->SetSphereWeights(m_SphereWeights);
+
+        m_ApproximateSmoothingCostFunction->SetReferenceModels(m_FixedImageValues,m_GradientDirections,
+                                                               m_SmallDelta,m_BigDelta,m_GradientStrengths);
+        m_ModifiedApproximateReferenceModels = false;
+    }
 
-    smoothingOptimizer->SetInitialPosition(p);
-    smoothingOptimizer->StartOptimization();
+    m_ApproximateSmoothingCostFunction->SetMovingModels(movingValues,m_GradientDirections,
+                                                        m_SmallDelta,m_BigDelta,m_GradientStrengths);
 
-    p = smoothingOptimizer->GetCurrentPosition();
-    return smootherCostFunction->GetValue(p);
+    return this->OptimizeSmoothingSigma(m_ApproximateSmoothingCostFunction);
 }
 
 template < class TFixedImagePixelType, class TMovingImagePixelType, unsigned int ImageDimension >
 double
 MCMCorrelationImageToImageMetric<TFixedImagePixelType,TMovingImagePixelType,ImageDimension>
-::ComputeNonTensorBasedMetric(const std::vector <MCModelPointer> &movingValues) const
+::OptimizeSmoothingSigma(itk::SingleValuedCostFunction *costFunction) const
 {
-    typedef anima::ApproximateMCMSmoothingCostFunction CostFunctionType;
-    typename CostFunctionType::Pointer smootherCostFunction = CostFunctionType::New();
-
-    smootherCostFunction->SetReferenceModels(m_FixedImageValues,m_GradientDirections,
-                                             m_SmallDelta,m_BigDelta,m_GradientStrengths);
-    smootherCostFunction->SetMovingModels(movingValues,m_GradientDirections,
-                                          m_SmallDelta,m_BigDelta,m_GradientStrengths);
-    smootherCostFunction->SetGradientDirections(m_GradientDirections);
-    smootherCostFunction->SetSmallDelta(m_SmallDelta);
-    smootherCostFunction->SetBigDelta(m_SmallDelta);
-    smootherCostFunction->SetGradientStrengths(m_GradientStrengths);
-    smootherCostFunction->SetBValueWeightIndexes(m_BValWeightsIndexes);
-    smootherCostFunction->SetSphereWeights(m_SphereWeights);
-    smootherCostFunction->SetParameterScale(1.0e-3);
-
-    typedef anima::NLOPTOptimizers OptimizerType;
-    OptimizerType::ParametersType p(smootherCostFunction->GetNumberOfParameters());
-    OptimizerType::ParametersType lowerBounds(smootherCostFunction->GetNumberOfParameters());
-    OptimizerType::ParametersType upperBounds(smootherCostFunction->GetNumberOfParameters());
+    SmoothingOptimizerType::ParametersType p(1);
+    SmoothingOptimizerType::ParametersType lowerBounds(1);
+    SmoothingOptimizerType::ParametersType upperBounds(1);
 
     lowerBounds[0] = m_LowerBoundGaussianSigma;
     upperBounds[0] = m_UpperBoundGaussianSigma;
 
-    p[0] = m_LowerBoundGaussianSigma + (m_UpperBoundGaussianSigma - m_LowerBoundGaussianSigma) / 10.0;
+    // Warm start: successive evaluations on a block have close optimal sigmas
+    p[0] = std::min(std::max(m_LastOptimalGaussianSigma,m_LowerBoundGaussianSigma),m_UpperBoundGaussianSigma);
 
-    typename OptimizerType::Pointer smoothingOptimizer = OptimizerType::New();
-    smoothingOptimizer->SetAlgorithm(NLOPT_LN_BOBYQA);
-    smoothingOptimizer->SetMaximize(false);
-    smoothingOptimizer->SetXTolRel(1.0e-8);
-    smoothingOptimizer->SetMaxEval(2000);
-    smoothingOptimizer->SetCostFunction(smootherCostFunction);
+    m_SmoothingOptimizer->SetCostFunction(costFunction);
+    m_SmoothingOptimizer->SetLowerBoundParameters(lowerBounds);
+    m_SmoothingOptimizer->SetUpperBoundParameters(upperBounds);
 
-    smoothingOptimizer->SetLowerBoundParameters(lowerBounds);
-    smoothingOptimizer->SetUpperBoundParameters(upperBounds);
+    m_SmoothingOptimizer->SetInitialPosition(p);
+    m_SmoothingOptimizer->StartOptimization();
 
-    smoothingOptimizer->SetInitialPosition(p);
-    smoothingOptimizer->StartOptimization();
+    p = m_SmoothingOptimizer->GetCurrentPosition();
+    m_LastOptimalGaussianSigma = p[0];
 
-    p = smoothingOptimizer->GetCurrentPosition();
-    return smootherCostFunction->GetValue(p);
+    return costFunction->GetValue(p);
 }
 
 template < class TFixedImagePixelType, class TMovingImagePixelType, unsigned int ImageDimension >
@@ -217,6 +227,7 @@ MCMCorrelationImageToImageMetric<TFixedImagePixelType,TMovingImagePixelType,Imag
 {
     double oldVal = m_SmallDelta;
     m_SmallDelta = val;
+    m_ModifiedApproximateReferenceModels = true;
 
     if (oldVal != val)
         this->UpdateSphereWeights();
@@ -229,6 +240,7 @@ MCMCorrelationImageToImageMetric<TFixedImagePixelType,TMovingImagePixelType,Imag
 {
     double oldVal = m_BigDelta;
     m_BigDelta = val;
+    m_ModifiedApproximateReferenceModels = true;
 
     if (oldVal != val)
         this->UpdateSphereWeights();
@@ -240,6 +252,7 @@ MCMCorrelationImageToImageMetric<TFixedImagePixelType,TMovingImagePixelType,Imag
 ::SetGradientStrengths(std::vector <double> &val)
 {
     m_GradientStrengths = val;
+    m_ModifiedApproximateReferenceModels = true;
 
     if ((m_GradientDirections.size() == m_GradientStrengths.size())&&(m_GradientStrengths.size() != 0)&&(m_GradientDirections.size() != 0))
         this->UpdateSphereWeights();
@@ -251,6 +264,7 @@ MCMCorrelationImageToImageMetric<TFixedImagePixelType,TMovingImagePixelType,Imag
 ::SetGradientDirections(std::vector <GradientType> &val)
 {
     m_GradientDirections = val;
+    m_ModifiedApproximateReferenceModels = true;
 
     if ((m_GradientDirections.size() == m_GradientStrengths.size())&&(m_GradientStrengths.size() != 0)&&(m_GradientDirections.size() != 0))
         this->UpdateSphereWeights();
@@ -363,6 +377,14 @@ MCMCorrelationImageToImageMetric<TFixedImagePixelType,TMovingImagePixelType,Imag
     m_FixedImagePoints.resize(this->m_NumberOfPixelsCounted);
     m_FixedImageValues.resize(this->m_NumberOfPixelsCounted);
 
+    if (m_PooledFixedImage != fixedImage)
+    {
+        m_FixedModelsPool.clear();
+        m_PooledFixedImage = fixedImage;
+    }
+
+    m_FixedModelsPool.resize(this->m_NumberOfPixelsCounted);
+
     InputPointType inputPoint;
 
     unsigned int pos = 0;
@@ -377,18 +399,23 @@ MCMCorrelationImageToImageMetric<TFixedImagePixelType,TMovingImagePixelType,Imag
 
         if (!isZero(fixedValue))
         {
-            m_FixedImageValues[pos] = fixedImage->GetDescriptionModel()->Clone();
-            m_FixedImageValues[pos]->SetModelVector(fixedValue);
+            if (!m_FixedModelsPool[pos])
+                m_FixedModelsPool[pos] = fixedImage->GetDescriptionModel()->Clone();
+
+            m_FixedModelsPool[pos]->SetModelVector(fixedValue);
+            m_FixedImageValues[pos] = m_FixedModelsPool[pos];
         }
         else
-        {
-            m_FixedImageValues[pos] = m_ZeroDiffusionModel->Clone();
-            m_FixedImageValues[pos]->SetModelVector(m_ZeroDiffusionVector);
-        }
+            m_FixedImageValues[pos] = m_ZeroDiffusionModel;
 
         ++ti;
         ++pos;
     }
+
+    // New block: reference data of the smoothing cost functions is updated at the next evaluation
+    m_ModifiedTensorReferenceModels = true;
+    m_ModifiedApproximateReferenceModels = true;
+    m_LastOptimalGaussianSigma = m_LowerBoundGaussianSigma + (m_UpperBoundGaussianSigma - m_LowerBoundGaussianSigma) / 10.0;
 }
 
 } // end namespace anima
@@ -16,8 +16,11 @@ MultiTensorSmoothingCostFunction
     for (unsigned int i = 0;i < numRefModels;++i)
     {
         unsigned int numCompartments = refModels[i]->GetNumberOfCompartments();
-        std::vector <TensorType> compartmentTensors(numCompartments);
-        std::vector <double> compartmentWeights(numCompartments);
+        std::vector <TensorType> &compartmentTensors = m_ReferenceModels[i];
+        std::vector <double> &compartmentWeights = m_ReferenceModelWeights[i];
+        compartmentTensors.resize(numCompartments);
+        compartmentWeights.resize(numCompartments);
+
         unsigned int pos = 0;
         unsigned int numIsoCompartments = refModels[i]->GetNumberOfIsotropicCompartments();
         for (unsigned int j = 0;j < numCompartments;++j)
@@ -36,8 +39,6 @@ MultiTensorSmoothingCostFunction
         compartmentTensors.resize(pos);
         compartmentWeights.resize(pos);
 
-        m_ReferenceModels[i] = compartmentTensors;
-        m_ReferenceModelWeights[i] = compartmentWeights;
         m_ReferenceNumberOfIsotropicCompartments[i] = 0;
     }
 
@@ -55,9 +56,13 @@ MultiTensorSmoothingCostFunction
 
     for (unsigned int i = 0;i < numMovingModels;++i)
     {
+        // Filled in place, called at each metric evaluation
         unsigned int numCompartments = movingModels[i]->GetNumberOfCompartments();
-        std::vector <TensorType> compartmentTensors(numCompartments);
-        std::vector <double> compartmentWeights(numCompartments);
+        std::vector <TensorType> &compartmentTensors = m_MovingModels[i];
+        std::vector <double> &compartmentWeights = m_MovingModelWeights[i];
+        compartmentTensors.resize(numCompartments);
+        compartmentWeights.resize(numCompartments);
+
         unsigned int pos = 0;
         for (unsigned int j = 0;j < numCompartments;++j)
         {
@@ -72,9 +77,6 @@ MultiTensorSmoothingCostFunction
 
         compartmentTensors.resize(pos);
         compartmentWeights.resize(pos);
-
-        m_MovingModels[i] = compartmentTensors;
-        m_MovingModelWeights[i] = compartmentWeights;
     }
 
     m_UpdatedMovingData = true;
@@ -12,6 +12,10 @@ namespace anima
  * Depending on the order set (0 or 1), the approximated exponentiation for a small enough field
  * is performed using Ferraris et al. ss_aei or Arsigny et al. original approach
  *
+ * Squarings are performed in place between two preallocated fields, composing the field with itself through
+ * a linear interpolation (clamped at the field borders) directly on the pixel buffers. The Jacobian determinant
+ * of the exponential may be computed along the way by the chain rule.
+ *
  * S. Ferraris et al. Accurate small deformation exponential approximant to integrate large velocity fields: Application to image registration. WBIR 2016
  * V. Arsigny et al. A Log-Euclidean Framework for Statistics on Diffeomorphisms. MICCAI 2006.
  */
@@ -25,6 +29,7 @@ public:
     typedef typename itk::Image <itk::Vector <TPixelType, Dimension>, Dimension> InputImageType;
     typedef typename itk::Image <itk::Vector <TPixelType, Dimension * Dimension>, Dimension> JacobianImageType;
     typedef typename itk::Image <itk::Vector <TPixelType, Dimension>, Dimension> OutputImageType;
+    typedef typename itk::Image <TPixelType, Dimension> DeterminantImageType;
     typedef itk::ImageToImageFilter <InputImageType, OutputImageType> Superclass;
     typedef itk::SmartPointer<Self> Pointer;
     typedef itk::SmartPointer<const Self> ConstPointer;
@@ -37,18 +42,26 @@ public:
     typedef typename OutputImageType::PixelType OutputPixelType;
     typedef typename JacobianImageType::Pointer JacobianImagePointer;
     typedef typename JacobianImageType::PixelType JacobianPixelType;
+    typedef typename OutputImageType::Pointer OutputImagePointer;
+    typedef typename DeterminantImageType::Pointer DeterminantImagePointer;
 
     typedef typename Superclass::OutputImageRegionType OutputImageRegionType;
 
     itkSetMacro(ExponentiationOrder, unsigned int)
     itkSetMacro(MaximalDisplacementAmplitude, double)
 
+    //! Computes the Jacobian determinant of the exponential during squarings
+    itkSetMacro(ComputeJacobianDeterminant, bool)
+    itkGetObjectMacro(JacobianDeterminantImage, DeterminantImageType)
+
 protected:
     SVFExponentialImageFilter()
     {
         m_ExponentiationOrder = 0;
         m_MaximalDisplacementAmplitude = 0.25;
         m_FieldJacobian = 0;
+        m_ComputeJacobianDeterminant = false;
+        m_JacobianDeterminantImage = 0;
     }
 
     virtual ~SVFExponentialImageFilter() {}
@@ -57,6 +70,9 @@ protected:
     void DynamicThreadedGenerateData(const OutputImageRegionType &outputRegionForThread) ITK_OVERRIDE;
     void AfterThreadedGenerateData() ITK_OVERRIDE;
 
+    //! One squaring step on a region: output(x) = input(x) + input(x + input(x)), read from and written to internal buffers
+    void ComposeSquaringStep(const OutputImageRegionType &region);
+
 private:
     ITK_DISALLOW_COPY_AND_ASSIGN(SVFExponentialImageFilter);
 
@@ -66,9 +82,16 @@ private:
     //! Exponentiation order (0: Arsigny et al., 1: ss_aei from Ferraris et al.)
     double m_ExponentiationOrder;
 
-    //! Jacobian field (computed only if order 1)
+    //! Jacobian field (computed only if order 1 or if the determinant is required)
     JacobianImagePointer m_FieldJacobian;
 
+    bool m_ComputeJacobianDeterminant;
+    DeterminantImagePointer m_JacobianDeterminantImage;
+
+    //! Ping-pong buffers used during squarings
+    OutputImagePointer m_SquaringInputField, m_SquaringOutputField;
+    DeterminantImagePointer m_SquaringInputDeterminant, m_SquaringOutputDeterminant;
+
     //! Internal variable that holds the automatically computed number of recursive squarings
     unsigned int m_NumberOfSquarings;
 };
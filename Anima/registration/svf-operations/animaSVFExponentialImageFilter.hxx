@@ -4,9 +4,11 @@
 #include <animaJacobianMatrixImageFilter.h>
 #include <itkImageRegionConstIterator.h>
 #include <itkImageRegionIterator.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
 
-#include <itkComposeDisplacementFieldsImageFilter.h>
-#include <itkVectorLinearInterpolateNearestNeighborExtrapolateImageFunction.h>
+#include <vnl/algo/vnl_determinant.h>
+
+#include <algorithm>
 
 namespace anima
 {
@@ -22,7 +24,7 @@ SVFExponentialImageFilter <TPixelType, Dimension>
         itkExceptionMacro("Exponentiation order not supported");
 
     // Precomputes jacobian if needed
-    if (m_ExponentiationOrder > 0)
+    if ((m_ExponentiationOrder > 0)||(m_ComputeJacobianDeterminant))
     {
         typedef anima::JacobianMatrixImageFilter <TPixelType, TPixelType, Dimension> JacobianFilterType;
 
@@ -73,6 +75,19 @@ SVFExponentialImageFilter <TPixelType, Dimension>
     m_NumberOfSquarings = 0;
     if (numIter + 1 > 0)
         m_NumberOfSquarings = static_cast<unsigned int>(numIter + 1.0);
+
+    m_JacobianDeterminantImage = 0;
+    if (m_ComputeJacobianDeterminant)
+    {
+        m_JacobianDeterminantImage = DeterminantImageType::New();
+        m_JacobianDeterminantImage->Initialize();
+        m_JacobianDeterminantImage->SetOrigin(this->GetOutput()->GetOrigin());
+        m_JacobianDeterminantImage->SetSpacing(this->GetOutput()->GetSpacing());
+        m_JacobianDeterminantImage->SetDirection(this->GetOutput()->GetDirection());
+        m_JacobianDeterminantImage->SetRegions(this->GetOutput()->GetRequestedRegion());
+
+        m_JacobianDeterminantImage->Allocate();
+    }
 }
 
 template <typename TPixelType, unsigned int Dimension>
@@ -87,13 +102,20 @@ SVFExponentialImageFilter <TPixelType, Dimension>
     InputIteratorType inputItr(this->GetInput(),outputRegionForThread);
     OutIteratorType outItr(this->GetOutput(),outputRegionForThread);
 
+    typedef itk::ImageRegionIterator <DeterminantImageType> DeterminantIteratorType;
+
     JacobianIteratorType jacItr;
-    if (m_ExponentiationOrder > 0)
+    if ((m_ExponentiationOrder > 0)||(m_ComputeJacobianDeterminant))
         jacItr = JacobianIteratorType(m_FieldJacobian,outputRegionForThread);
 
+    DeterminantIteratorType detItr;
+    if (m_ComputeJacobianDeterminant)
+        detItr = DeterminantIteratorType(m_JacobianDeterminantImage,outputRegionForThread);
+
     InputPixelType inputValue;
     OutputPixelType outputValue;
     JacobianPixelType jacValue;
+    vnl_matrix <double> jacMatrix(Dimension,Dimension);
 
     double scalingFactor = 1.0 / std::pow(2.0, m_NumberOfSquarings);
     while (!outItr.IsAtEnd())
@@ -102,9 +124,11 @@ SVFExponentialImageFilter <TPixelType, Dimension>
         for (unsigned int i = 0;i < Dimension;++i)
             outputValue[i] = scalingFactor * inputValue[i];
 
+        if ((m_ExponentiationOrder > 0)||(m_ComputeJacobianDeterminant))
+            jacValue = jacItr.Get();
+
         if (m_ExponentiationOrder > 0)
         {
-            jacValue = jacItr.Get();
             for (unsigned int i = 0;i < Dimension;++i)
             {
                 for (unsigned int j = 0;j < Dimension;++j)
@@ -114,9 +138,22 @@ SVFExponentialImageFilter <TPixelType, Dimension>
 
         outItr.Set(outputValue);
 
+        // Determinant of the scaled field, to first order in the scaling factor
+        if (m_ComputeJacobianDeterminant)
+        {
+            for (unsigned int i = 0;i < Dimension;++i)
+            {
+                for (unsigned int j = 0;j < Dimension;++j)
+                    jacMatrix(i,j) = (i == j) + scalingFactor * jacValue[i * Dimension + j];
+            }
+
+            detItr.Set(vnl_determinant(jacMatrix));
+            ++detItr;
+        }
+
         ++inputItr;
         ++outItr;
-        if (m_ExponentiationOrder > 0)
+        if ((m_ExponentiationOrder > 0)||(m_ComputeJacobianDeterminant))
             ++jacItr;
     }
 }
@@ -128,30 +165,162 @@ SVFExponentialImageFilter <TPixelType, Dimension>
 {
     this->Superclass::AfterThreadedGenerateData();
 
-    // Compute recursive squaring of the output
-    typedef itk::ComposeDisplacementFieldsImageFilter <OutputImageType,OutputImageType> ComposeFilterType;
-    typedef itk::VectorLinearInterpolateNearestNeighborExtrapolateImageFunction <OutputImageType,
-            typename OutputImageType::PixelType::ValueType> VectorInterpolateFunctionType;
+    // Field jacobian is only needed for the initial scaled field
+    m_FieldJacobian = 0;
+
+    if (m_NumberOfSquarings == 0)
+        return;
+
+    // Compute recursive squaring of the output, ping-ponging between the output and one scratch buffer
+    OutputImagePointer outputPtr = this->GetOutput();
+    OutputImageRegionType squaringRegion = outputPtr->GetBufferedRegion();
 
-    typename OutputImageType::Pointer outputPtr = this->GetOutput();
+    m_SquaringInputField = outputPtr;
+    m_SquaringOutputField = OutputImageType::New();
+    m_SquaringOutputField->Initialize();
+    m_SquaringOutputField->SetOrigin(outputPtr->GetOrigin());
+    m_SquaringOutputField->SetSpacing(outputPtr->GetSpacing());
+    m_SquaringOutputField->SetDirection(outputPtr->GetDirection());
+    m_SquaringOutputField->SetRegions(squaringRegion);
+    m_SquaringOutputField->Allocate();
+
+    m_SquaringInputDeterminant = 0;
+    m_SquaringOutputDeterminant = 0;
+    if (m_ComputeJacobianDeterminant)
+    {
+        m_SquaringInputDeterminant = m_JacobianDeterminantImage;
+        m_SquaringOutputDeterminant = DeterminantImageType::New();
+        m_SquaringOutputDeterminant->Initialize();
+        m_SquaringOutputDeterminant->SetOrigin(outputPtr->GetOrigin());
+        m_SquaringOutputDeterminant->SetSpacing(outputPtr->GetSpacing());
+        m_SquaringOutputDeterminant->SetDirection(outputPtr->GetDirection());
+        m_SquaringOutputDeterminant->SetRegions(squaringRegion);
+        m_SquaringOutputDeterminant->Allocate();
+    }
 
     for (unsigned int i = 0;i < m_NumberOfSquarings;++i)
     {
-        typename ComposeFilterType::Pointer composer = ComposeFilterType::New();
-        composer->SetWarpingField(outputPtr);
-        composer->SetDisplacementField(outputPtr);
-        composer->SetNumberOfWorkUnits(this->GetNumberOfWorkUnits());
+        this->GetMultiThreader()->template ParallelizeImageRegion<Dimension> (
+            squaringRegion,
+            [this](const OutputImageRegionType & regionForThread)
+              { this->ComposeSquaringStep(regionForThread); }, this);
+
+        std::swap(m_SquaringInputField,m_SquaringOutputField);
+        std::swap(m_SquaringInputDeterminant,m_SquaringOutputDeterminant);
+    }
+
+    // Result of the last squaring is now the input buffer
+    if (m_SquaringInputField.GetPointer() != outputPtr.GetPointer())
+        this->GraftOutput(m_SquaringInputField);
 
-        typename VectorInterpolateFunctionType::Pointer interpolator = VectorInterpolateFunctionType::New();
+    if (m_ComputeJacobianDeterminant)
+        m_JacobianDeterminantImage = m_SquaringInputDeterminant;
+
+    m_SquaringInputField = 0;
+    m_SquaringOutputField = 0;
+    m_SquaringInputDeterminant = 0;
+    m_SquaringOutputDeterminant = 0;
+}
 
-        composer->SetInterpolator(interpolator);
-        composer->Update();
-        outputPtr = composer->GetOutput();
-        outputPtr->DisconnectPipeline();
+template <typename TPixelType, unsigned int Dimension>
+void
+SVFExponentialImageFilter <TPixelType, Dimension>
+::ComposeSquaringStep(const OutputImageRegionType &region)
+{
+    typedef itk::ImageRegionConstIteratorWithIndex <OutputImageType> IteratorType;
+    typedef typename OutputImageType::OffsetValueType OffsetValueType;
+    typedef typename OutputImageType::IndexType IndexType;
+
+    const OutputPixelType *inputBuffer = m_SquaringInputField->GetBufferPointer();
+    OutputPixelType *outputBuffer = m_SquaringOutputField->GetBufferPointer();
+
+    const TPixelType *inputDeterminant = 0;
+    TPixelType *outputDeterminant = 0;
+    if (m_ComputeJacobianDeterminant)
+    {
+        inputDeterminant = m_SquaringInputDeterminant->GetBufferPointer();
+        outputDeterminant = m_SquaringOutputDeterminant->GetBufferPointer();
+    }
+
+    OutputImageRegionType bufferedRegion = m_SquaringInputField->GetBufferedRegion();
+    const OffsetValueType *offsetTable = m_SquaringInputField->GetOffsetTable();
+
+    // Displacements are in physical space, index displacement is obtained through the physical to index matrix
+    vnl_matrix_fixed <double, Dimension, Dimension> indexMatrix = m_SquaringInputField->GetPhysicalPointToIndexMatrix().GetVnlMatrix();
+
+    double lowerBound[Dimension], upperBound[Dimension];
+    for (unsigned int i = 0;i < Dimension;++i)
+    {
+        lowerBound[i] = bufferedRegion.GetIndex()[i];
+        upperBound[i] = bufferedRegion.GetIndex()[i] + bufferedRegion.GetSize()[i] - 1.0;
     }
 
-    if (m_NumberOfSquarings > 0)
-        this->GraftOutput(outputPtr);
+    const unsigned int numCorners = 1 << Dimension;
+    double distances[Dimension];
+    OffsetValueType cornerSteps[Dimension];
+    OutputPixelType interpolatedValue;
+
+    IteratorType itr(m_SquaringInputField,region);
+    while (!itr.IsAtEnd())
+    {
+        IndexType index = itr.GetIndex();
+        OffsetValueType pixelOffset = m_SquaringInputField->ComputeOffset(index);
+        const OutputPixelType &displacement = inputBuffer[pixelOffset];
+
+        // Linear interpolation at x + u(x), clamped to the buffer (nearest neighbor extrapolation)
+        OffsetValueType baseOffset = 0;
+        for (unsigned int i = 0;i < Dimension;++i)
+        {
+            double indexValue = index[i];
+            for (unsigned int j = 0;j < Dimension;++j)
+                indexValue += indexMatrix(i,j) * displacement[j];
+
+            indexValue = std::min(std::max(indexValue,lowerBound[i]),upperBound[i]);
+
+            OffsetValueType baseIndex = std::floor(indexValue);
+            distances[i] = indexValue - baseIndex;
+            cornerSteps[i] = (baseIndex < upperBound[i]) ? offsetTable[i] : 0;
+            baseOffset += (baseIndex - bufferedRegion.GetIndex()[i]) * offsetTable[i];
+        }
+
+        interpolatedValue.Fill(0.0);
+        double interpolatedDeterminant = 0;
+        for (unsigned int c = 0;c < numCorners;++c)
+        {
+            double weight = 1.0;
+            OffsetValueType cornerOffset = baseOffset;
+            for (unsigned int i = 0;i < Dimension;++i)
+            {
+                if (c & (1 << i))
+                {
+                    weight *= distances[i];
+                    cornerOffset += cornerSteps[i];
+                }
+                else
+                    weight *= 1.0 - distances[i];
+            }
+
+            if (weight == 0.0)
+                continue;
+
+            const OutputPixelType &cornerValue = inputBuffer[cornerOffset];
+            for (unsigned int i = 0;i < Dimension;++i)
+                interpolatedValue[i] += weight * cornerValue[i];
+
+            if (m_ComputeJacobianDeterminant)
+                interpolatedDeterminant += weight * inputDeterminant[cornerOffset];
+        }
+
+        OutputPixelType &outputValue = outputBuffer[pixelOffset];
+        for (unsigned int i = 0;i < Dimension;++i)
+            outputValue[i] = displacement[i] + interpolatedValue[i];
+
+        // Chain rule: det(J_phi o phi)(x) = det(J_phi)(phi(x)) * det(J_phi)(x)
+        if (m_ComputeJacobianDeterminant)
+            outputDeterminant[pixelOffset] = interpolatedDeterminant * inputDeterminant[pixelOffset];
+
+        ++itr;
+    }
 }
 
 } // end namespace anima
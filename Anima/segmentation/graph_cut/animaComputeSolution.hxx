@@ -455,6 +455,7 @@ ComputeSolution <TInputImage, TMaskImage, TAtlasImage>
             exit(-1);
         }
         }//switch InitMethod
+        initializer->SetNumberOfWorkUnits(this->GetNumberOfWorkUnits());
 
         std::cout << "Computing initialization for EM..." << std::endl;
         initializer->Update();
@@ -473,6 +474,7 @@ ComputeSolution <TInputImage, TMaskImage, TAtlasImage>
         estimator ->SetInputImage2( m_InputImage_T2_DP_UC );
         estimator ->SetInputImage3( m_InputImage_DP_FLAIR_UC );
         estimator ->SetVerbose( m_Verbose );
+        estimator ->SetNumberOfWorkUnits( this->GetNumberOfWorkUnits() );
 
         itk::CStyleCommand::Pointer callback = itk::CStyleCommand::New();
         callback ->SetCallback(eventCallback);
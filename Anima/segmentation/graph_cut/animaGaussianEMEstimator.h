@@ -2,6 +2,10 @@
 
 #include "itkProcessObject.h"
 #include "itkGaussianMembershipFunction.h"
+#include <itkPoolMultiThreader.h>
+
+#include <map>
+#include <vector>
 
 namespace anima
 {
@@ -56,18 +60,16 @@ public:
 
     /** @brief return joint histogram
        */
-    Histogram GetJointHistogram(){return m_JointHistogramInitial;}
+    Histogram GetJointHistogram(){return this->ConvertToHistogram(m_JointHistogramInitial);}
 
     virtual void Update() ITK_OVERRIDE;
 
     virtual bool maximization(std::vector<GaussianFunctionType::Pointer> &newModel, std::vector<double> &newAlphas);
     virtual double expectation();
 
-    double likelihood(GaussianFunctionType::CovarianceMatrixType *invCovariance=NULL, double *detCovariance=NULL);
-
     double computeDistance(std::vector<GaussianFunctionType::Pointer> &newModel);
 
-    GenericContainer GetAPosterioriProbability(){return m_APosterioriProbability;}
+    GenericContainer GetAPosterioriProbability();
 
     void createJointHistogram();
 
@@ -108,6 +110,7 @@ protected:
 
     GaussianEMEstimator ()
     {
+        m_HistogramDimension=0;
         m_ModelMinDistance=1e-9;
         m_MaxIterations=1000;
         m_Verbose=false;
@@ -122,7 +125,37 @@ protected:
     }
     virtual ~GaussianEMEstimator(){}
 
-    GenericContainer m_APosterioriProbability;
+    //! Steps run over histogram entries by RunThreadedStep
+    enum ThreadedStepType
+    {
+        ExpectationStep = 0,
+        MaximizationMeansStep,
+        MaximizationCovariancesStep,
+        ConcentrationStep
+    };
+
+    struct EMThreadStruct
+    {
+        Pointer Filter;
+        ThreadedStepType Step;
+    };
+
+    static ITK_THREAD_RETURN_FUNCTION_CALL_CONVENTION ThreadedStep(void *arg);
+
+    //! Splits histogram entries between threads, results are stored per thread in m_ThreadLikelihoods and m_ThreadStatistics
+    void RunThreadedStep(ThreadedStepType step);
+    virtual void ProcessHistogramEntries(ThreadedStepType step, unsigned int startEntry, unsigned int endEntry, unsigned int threadId);
+
+    unsigned int GetNumberOfHistogramEntries() {return m_JointHistogramInitial.size();}
+
+    //! Caches means, inverse covariances and normalization factors of the current model, false if a covariance is singular
+    bool PrepareModelParameters(double determinantThreshold);
+    double ComputeMahalanobisTerm(const double *intensities, unsigned int classIndex) const;
+
+    Histogram ConvertToHistogram(const std::vector<Ocurrences> &occurrences);
+
+    //! A posteriori probabilities, one value per class for each histogram entry
+    std::vector<double> m_APosterioriProbability;
 
     double m_ModelMinDistance;
 
@@ -134,10 +167,25 @@ protected:
     std::vector<GaussianFunctionType::Pointer> m_GaussianModel;
 
     /** @brief joint histogram
-       * The points stored here will be used for estimate de model
+       * Distinct intensity tuples of the mask are stored contiguously (m_HistogramDimension values per entry),
+       * in the same increasing order as a map. m_JointHistogramInitial holds their occurrences, m_JointHistogram
+       * the occurrences used to estimate the model (entries with no occurrence are ignored)
+       */
+    std::vector<double> m_HistogramIntensities;
+    std::vector<Ocurrences> m_JointHistogram;
+    std::vector<Ocurrences> m_JointHistogramInitial;
+    unsigned int m_HistogramDimension;
+
+    /** @brief current model cached for histogram processing
        */
-    Histogram m_JointHistogram;
-    Histogram m_JointHistogramInitial;
+    std::vector<double> m_ModelMeans;
+    std::vector<double> m_ModelInverseCovariances;
+    std::vector<double> m_ModelFactors;
+    std::vector<double> m_ModelLogNormalizations;
+    std::vector<double> m_EstimatedMeans;
+
+    std::vector<double> m_ThreadLikelihoods;
+    std::vector< std::vector<double> > m_ThreadStatistics;
 
     std::vector<InputImageConstPointer > m_ImagesVector;
 
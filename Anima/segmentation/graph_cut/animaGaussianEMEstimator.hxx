@@ -1,5 +1,7 @@
 #include "animaGaussianEMEstimator.h"
 
+#include <algorithm>
+
 namespace anima
 {
 
@@ -95,6 +97,7 @@ template <typename TInputImage, typename TMaskImage>
 void GaussianEMEstimator<TInputImage,TMaskImage>::createJointHistogram()
 {
     m_ImagesVector.clear();
+    m_HistogramIntensities.clear();
     m_JointHistogramInitial.clear();
 
     if(m_IndexImage1 < m_nbMaxImages){m_ImagesVector.push_back(this->GetInputImage1());}
@@ -104,36 +107,31 @@ void GaussianEMEstimator<TInputImage,TMaskImage>::createJointHistogram()
     if(m_IndexImage5 < m_nbMaxImages){m_ImagesVector.push_back(this->GetInputImage5());}
 
     unsigned int histoDimension = m_ImagesVector.size();
+    m_HistogramDimension = histoDimension;
+
     std::vector<InputConstIteratorType> ImagesVectorIt;
     for ( unsigned int i = 0; i < m_ImagesVector.size(); i++ )
     {
         InputConstIteratorType It(m_ImagesVector[i],m_ImagesVector[i]->GetLargestPossibleRegion() );
         ImagesVectorIt.push_back(It);
     }
+
+    // Gather intensity tuples of the mask, negative intensities are clamped to 0
+    std::vector<MeasureType> maskIntensities;
     MaskConstIteratorType MaskIt (this->GetMask(), this->GetMask()->GetLargestPossibleRegion() );
-    Histogram::iterator it;
     while (!MaskIt.IsAtEnd())
     {
         if(MaskIt.Get()!=0)
         {
-            Intensities value(histoDimension);
             for(unsigned int m = 0; m < histoDimension; m++ )
             {
-                if(static_cast<MeasureType>(ImagesVectorIt[m].Get()) < 0 )
-                    value[m] = 0;
-                if(static_cast<MeasureType>(ImagesVectorIt[m].Get()) > static_cast<double>(std::numeric_limits<MeasureType>::max()))
-                    value[m]= std::numeric_limits<MeasureType>::max();
+                double value = static_cast<double>(ImagesVectorIt[m].Get());
+                if(value < 0)
+                    maskIntensities.push_back(0);
+                else if(value > static_cast<double>(std::numeric_limits<MeasureType>::max()))
+                    maskIntensities.push_back(std::numeric_limits<MeasureType>::max());
                 else
-                    value[m] = static_cast<MeasureType>(ImagesVectorIt[m].Get());
-            }
-            it = m_JointHistogramInitial.find(value);
-            if(it == m_JointHistogramInitial.end())
-            {
-                m_JointHistogramInitial.insert(Histogram::value_type(value,1));
-            }
-            else
-            {
-                (it->second)++;
+                    maskIntensities.push_back(static_cast<MeasureType>(value));
             }
         }
         for ( unsigned int i = 0; i < histoDimension; i++ )
@@ -142,129 +140,313 @@ void GaussianEMEstimator<TInputImage,TMaskImage>::createJointHistogram()
         }
         ++MaskIt;
     }
+
+    if (histoDimension == 0)
+        return;
+
+    // Sort tuples in lexicographic order and count identical ones (single threaded)
+    unsigned int numberOfVoxels = maskIntensities.size() / histoDimension;
+    std::vector<unsigned int> voxelOrder(numberOfVoxels);
+    for (unsigned int i = 0;i < numberOfVoxels;++i)
+        voxelOrder[i] = i;
+
+    const MeasureType *intensitiesPtr = maskIntensities.data();
+    std::sort(voxelOrder.begin(),voxelOrder.end(),[intensitiesPtr,histoDimension](unsigned int a, unsigned int b) {
+        return std::lexicographical_compare(intensitiesPtr + a * histoDimension, intensitiesPtr + (a + 1) * histoDimension,
+                                            intensitiesPtr + b * histoDimension, intensitiesPtr + (b + 1) * histoDimension);
+    });
+
+    for (unsigned int i = 0;i < numberOfVoxels;++i)
+    {
+        const MeasureType *voxelIntensities = intensitiesPtr + voxelOrder[i] * histoDimension;
+        if ((i > 0) && std::equal(voxelIntensities, voxelIntensities + histoDimension, intensitiesPtr + voxelOrder[i - 1] * histoDimension))
+        {
+            m_JointHistogramInitial.back()++;
+            continue;
+        }
+
+        for (unsigned int m = 0;m < histoDimension;++m)
+            m_HistogramIntensities.push_back(static_cast<double>(voxelIntensities[m]));
+        m_JointHistogramInitial.push_back(1);
+    }
 }
 
 template <typename TInputImage, typename TMaskImage>
-double GaussianEMEstimator<TInputImage,TMaskImage>::expectation()
+typename GaussianEMEstimator<TInputImage,TMaskImage>::Histogram
+GaussianEMEstimator<TInputImage,TMaskImage>::ConvertToHistogram(const std::vector<Ocurrences> &occurrences)
+{
+    Histogram histogram;
+    Intensities value(m_HistogramDimension);
+    for (unsigned int i = 0;i < occurrences.size();++i)
+    {
+        if (occurrences[i] <= 0)
+            continue;
+
+        for (unsigned int m = 0;m < m_HistogramDimension;++m)
+            value[m] = static_cast<MeasureType>(m_HistogramIntensities[i * m_HistogramDimension + m]);
+
+        histogram.insert(Histogram::value_type(value,occurrences[i]));
+    }
+
+    return histogram;
+}
+
+template <typename TInputImage, typename TMaskImage>
+typename GaussianEMEstimator<TInputImage,TMaskImage>::GenericContainer
+GaussianEMEstimator<TInputImage,TMaskImage>::GetAPosterioriProbability()
 {
+    GenericContainer probabilities;
     unsigned int nbClasses = m_GaussianModel.size();
-    this->m_APosterioriProbability.clear();
+    if (m_APosterioriProbability.size() != m_JointHistogram.size() * nbClasses)
+        return probabilities;
 
-    //1. We calculate the inverse of the covariance and the determinant;
-    GaussianFunctionType::CovarianceMatrixType *inverseCovariance = new GaussianFunctionType::CovarianceMatrixType[nbClasses];
-    double *determinantCovariance = new double[nbClasses];
-    for(unsigned int i = 0 ; i < nbClasses; i++)
+    Intensities value(m_HistogramDimension);
+    std::vector<Ocurrences> probas(nbClasses);
+    for (unsigned int i = 0;i < m_JointHistogram.size();++i)
     {
-        GaussianFunctionType::CovarianceMatrixType covar = (m_GaussianModel[i])->GetCovariance();
+        if (m_JointHistogram[i] <= 0)
+            continue;
 
-        determinantCovariance[i] = vnl_determinant(covar.GetVnlMatrix());
-        if(std::abs(determinantCovariance[i]) < 1e-12)
-        {
-            if(inverseCovariance != NULL)
-            {
-                delete[] inverseCovariance;
-                inverseCovariance=NULL;
-            }
-            if(determinantCovariance != NULL)
-            {
-                delete[] determinantCovariance;
-                determinantCovariance= NULL;
-            }
-            return 1.0;
-        }
-        inverseCovariance[i] = covar.GetInverse();
+        for (unsigned int m = 0;m < m_HistogramDimension;++m)
+            value[m] = static_cast<MeasureType>(m_HistogramIntensities[i * m_HistogramDimension + m]);
+
+        std::copy(m_APosterioriProbability.begin() + i * nbClasses,m_APosterioriProbability.begin() + (i + 1) * nbClasses,probas.begin());
+        probabilities.insert(GenericContainer::value_type(value,probas));
     }
 
-    //2. We calculate the a posterirori probability
-    Histogram::iterator histoIt;
-    GaussianFunctionType::CovarianceMatrixType intensities(this->m_JointHistogram.begin()->first.size(),1);
-    std::vector<double> probas(nbClasses);
+    return probabilities;
+}
 
-    GaussianFunctionType::CovarianceMatrixType *xi = new GaussianFunctionType::CovarianceMatrixType[nbClasses];
-    unsigned int matrixSize = 0;
-    for(unsigned int i = 0; i < nbClasses; i++)
+template <typename TInputImage, typename TMaskImage>
+bool GaussianEMEstimator<TInputImage,TMaskImage>::PrepareModelParameters(double determinantThreshold)
+{
+    unsigned int nbClasses = m_GaussianModel.size();
+    unsigned int dimension = m_HistogramDimension;
+
+    m_ModelMeans.resize(nbClasses * dimension);
+    m_ModelInverseCovariances.resize(nbClasses * dimension * dimension);
+    m_ModelFactors.resize(nbClasses);
+    m_ModelLogNormalizations.resize(nbClasses);
+
+    for(unsigned int i = 0 ; i < nbClasses; i++)
     {
+        GaussianFunctionType::CovarianceMatrixType covar = (m_GaussianModel[i])->GetCovariance();
+        double determinantCovariance = vnl_determinant(covar.GetVnlMatrix());
+        if(std::abs(determinantCovariance) < determinantThreshold)
+            return false;
+
+        GaussianFunctionType::CovarianceMatrixType inverseCovariance = covar.GetInverse();
         GaussianFunctionType::MeanVectorType mu = (m_GaussianModel[i])->GetMean();
-        matrixSize = mu.Size();
-        for(unsigned int j = 0; j < mu.Size(); j++)
+        for (unsigned int j = 0;j < dimension;++j)
         {
-            (xi[i]).SetSize(mu.Size(),1);
-            (xi[i])(j,0) = mu[j];
+            m_ModelMeans[i * dimension + j] = mu[j];
+            for (unsigned int k = 0;k < dimension;++k)
+                m_ModelInverseCovariances[(i * dimension + j) * dimension + k] = inverseCovariance(j,k);
         }
+
+        m_ModelFactors[i] = m_Alphas[i] / std::sqrt(std::fabs(determinantCovariance));
+        m_ModelLogNormalizations[i] = std::log(std::sqrt(std::pow(2*M_PI,static_cast<int>(dimension)) * std::fabs(determinantCovariance)));
     }
 
-    GaussianFunctionType::CovarianceMatrixType x;
+    return true;
+}
 
-    for(histoIt = this->m_JointHistogram.begin(); histoIt != this->m_JointHistogram.end(); ++histoIt)
+template <typename TInputImage, typename TMaskImage>
+double GaussianEMEstimator<TInputImage,TMaskImage>::ComputeMahalanobisTerm(const double *intensities, unsigned int classIndex) const
+{
+    unsigned int dimension = m_HistogramDimension;
+    const double *mu = &m_ModelMeans[classIndex * dimension];
+    const double *inverseCovariance = &m_ModelInverseCovariances[classIndex * dimension * dimension];
+
+    double result = 0;
+    for (unsigned int j = 0; j < dimension; ++j)
     {
-        //We set the intensities of the histogram in a vector
-        for(unsigned int i = 0; i < histoIt->first.size(); i++)
-        {
-            intensities(i,0) = static_cast<double>(histoIt->first[i]);
-        }
+        double xj = intensities[j] - mu[j];
+        result += inverseCovariance[j * dimension + j] * xj * xj;
+        for (unsigned int k = j+1; k < dimension; ++k)
+            result += 2 * inverseCovariance[j * dimension + k] * xj * (intensities[k] - mu[k]);
+    }
+
+    return result;
+}
+
+template <typename TInputImage, typename TMaskImage>
+void GaussianEMEstimator<TInputImage,TMaskImage>::RunThreadedStep(ThreadedStepType step)
+{
+    unsigned int numEntries = this->GetNumberOfHistogramEntries();
+    unsigned int actualNumberOfThreads = std::max(1u,std::min((unsigned int)this->GetNumberOfWorkUnits(),numEntries));
+
+    itk::PoolMultiThreader::Pointer threaderStep = itk::PoolMultiThreader::New();
+    threaderStep->SetNumberOfWorkUnits(actualNumberOfThreads);
+
+    m_ThreadLikelihoods.assign(threaderStep->GetNumberOfWorkUnits(),0.0);
+    m_ThreadStatistics.resize(threaderStep->GetNumberOfWorkUnits());
+
+    EMThreadStruct *tmpStr = new EMThreadStruct;
+    tmpStr->Filter = this;
+    tmpStr->Step = step;
+
+    threaderStep->SetSingleMethod(this->ThreadedStep,tmpStr);
+    threaderStep->SingleMethodExecute();
+
+    delete tmpStr;
+}
+
+template <typename TInputImage, typename TMaskImage>
+ITK_THREAD_RETURN_FUNCTION_CALL_CONVENTION
+GaussianEMEstimator<TInputImage,TMaskImage>::ThreadedStep(void *arg)
+{
+    itk::MultiThreaderBase::WorkUnitInfo *threadArgs = (itk::MultiThreaderBase::WorkUnitInfo *)arg;
+
+    unsigned int nbThread = threadArgs->WorkUnitID;
+    unsigned int nbProcs = threadArgs->NumberOfWorkUnits;
+
+    EMThreadStruct *tmpStr = (EMThreadStruct *)threadArgs->UserData;
+    unsigned int numEntries = tmpStr->Filter->GetNumberOfHistogramEntries();
+
+    unsigned int startEntry = (unsigned int)std::floor((double)nbThread*numEntries/nbProcs);
+    unsigned int endEntry = (unsigned int)std::floor((double)(nbThread + 1.0)*numEntries/nbProcs);
+    endEntry = std::min(numEntries,endEntry);
+
+    tmpStr->Filter->ProcessHistogramEntries(tmpStr->Step,startEntry,endEntry,nbThread);
 
-        // Calculate probability a posteriori for each pixel
-        // To eliminate problems with too small numbers we are going to substract in the exponetial
-        // the minimum found to at least have one "significant" value (equivalent to multiply the whole for a constant)
-        // Afterwards the a posteriory probability is normalize so this constant is eliminated
-        double minExpoTerm = 1e10;
-        double sumProba = 0.0;
+    return ITK_THREAD_RETURN_DEFAULT_VALUE;
+}
+
+template <typename TInputImage, typename TMaskImage>
+void GaussianEMEstimator<TInputImage,TMaskImage>::ProcessHistogramEntries(ThreadedStepType step, unsigned int startEntry,
+                                                                          unsigned int endEntry, unsigned int threadId)
+{
+    unsigned int nbClasses = m_GaussianModel.size();
+    unsigned int dimension = m_HistogramDimension;
+    std::vector<double> &threadStatistics = m_ThreadStatistics[threadId];
 
-        //Calculate the exponential term and the minimum of them
-        for(unsigned int i = 0; i < nbClasses; i++)
+    switch (step)
+    {
+        case ExpectationStep:
         {
-            x = intensities - xi[i];
+            std::vector<double> mahalanobisTerms(nbClasses);
+            double likelihoodValue = 0.0;
 
-            double result = 0;
-            for (unsigned int j = 0; j < matrixSize; ++j)
+            for (unsigned int entry = startEntry;entry < endEntry;++entry)
             {
-                result += inverseCovariance[i](j,j) * x(j,0) * x(j,0);
-                for (unsigned int k = j+1; k < matrixSize; ++k)
-                    result += 2 * inverseCovariance[i](j,k) * x(j,0) * x(k,0);
-            }
-            probas[i] = result;
+                if (m_JointHistogram[entry] <= 0)
+                    continue;
 
-            if( minExpoTerm > probas[i])
-            {
-                minExpoTerm = probas[i];
+                const double *intensities = &m_HistogramIntensities[entry * dimension];
+                double *probas = &m_APosterioriProbability[entry * nbClasses];
+
+                // To eliminate problems with too small numbers we substract in the exponential the minimum found,
+                // the constant is then eliminated by normalizing the a posteriori probability
+                double minExpoTerm = 1e10;
+                for(unsigned int i = 0; i < nbClasses; i++)
+                {
+                    mahalanobisTerms[i] = this->ComputeMahalanobisTerm(intensities,i);
+                    if (minExpoTerm > mahalanobisTerms[i])
+                        minExpoTerm = mahalanobisTerms[i];
+                }
+
+                double sumProba = 0.0;
+                for(unsigned int i = 0; i < nbClasses; i++)
+                {
+                    probas[i] = m_ModelFactors[i] * std::exp(0.5 * (minExpoTerm - mahalanobisTerms[i]));
+                    sumProba += probas[i];
+                }
+
+                unsigned int maxIndex = 0;
+                double maxPostProba = 0.0;
+                for(unsigned int i = 0; i < nbClasses; i++)
+                {
+                    probas[i] /= sumProba;
+                    if (probas[i] > maxPostProba)
+                    {
+                        maxPostProba = probas[i];
+                        maxIndex = i;
+                    }
+                }
+
+                // Likelihood term of the most probable class
+                likelihoodValue += m_JointHistogram[entry] * ( -mahalanobisTerms[maxIndex]/2.0 - m_ModelLogNormalizations[maxIndex]
+                                                              + std::log(m_Alphas[maxIndex]/maxPostProba));
             }
+
+            m_ThreadLikelihoods[threadId] = likelihoodValue;
+            break;
         }
 
-        //Calculate numerator and denominator of a posteriori probability
-        for(unsigned int i = 0; i < probas.size(); i++)
+        case MaximizationMeansStep:
         {
-            // Constant * conditional probability of pixel knwoing gaussian i, last value multiply by the gaussian proportion
-            probas[i] = m_Alphas[i] * ((std::exp(0.5* (minExpoTerm - probas[i])) / std::sqrt(std::fabs(determinantCovariance[i]))));
-            // adding all classes to have the denominator
-            sumProba += probas[i];
+            // Number of pixels, then for each class its mixed proportion and weighted intensity sums
+            threadStatistics.assign(1 + nbClasses * (dimension + 1),0.0);
+            for (unsigned int entry = startEntry;entry < endEntry;++entry)
+            {
+                double occurrences = m_JointHistogram[entry];
+                if (occurrences <= 0)
+                    continue;
+
+                const double *intensities = &m_HistogramIntensities[entry * dimension];
+                const double *probas = &m_APosterioriProbability[entry * nbClasses];
+
+                threadStatistics[0] += occurrences;
+                for(unsigned int i = 0; i < nbClasses; i++)
+                {
+                    double weight = probas[i] * occurrences;
+                    double *classStatistics = &threadStatistics[1 + i * (dimension + 1)];
+                    classStatistics[0] += weight;
+                    for(unsigned int j = 0; j < dimension; j++)
+                        classStatistics[j + 1] += weight * intensities[j];
+                }
+            }
+            break;
         }
 
-        // This division eliminate the constant ment before
-        for(unsigned int i = 0; i < probas.size(); i++)
+        case MaximizationCovariancesStep:
         {
-            probas[i] /= sumProba;
+            threadStatistics.assign(nbClasses * dimension * dimension,0.0);
+            for (unsigned int entry = startEntry;entry < endEntry;++entry)
+            {
+                double occurrences = m_JointHistogram[entry];
+                if (occurrences <= 0)
+                    continue;
+
+                const double *intensities = &m_HistogramIntensities[entry * dimension];
+                const double *probas = &m_APosterioriProbability[entry * nbClasses];
+
+                for(unsigned int i = 0; i < nbClasses; i++)
+                {
+                    double weight = probas[i] * occurrences;
+                    const double *means = &m_EstimatedMeans[i * dimension];
+                    double *classCovariance = &threadStatistics[i * dimension * dimension];
+                    for(unsigned int j = 0; j < dimension; j++)
+                    {
+                        double weightedResidual = weight * (intensities[j] - means[j]);
+                        for(unsigned int k = j; k < dimension; k++)
+                            classCovariance[j * dimension + k] += weightedResidual * (intensities[k] - means[k]);
+                    }
+                }
+            }
+            break;
         }
 
-        //Add probability to the GenericContainer
-        this->m_APosterioriProbability.insert(GenericContainer::value_type(histoIt->first, probas));
+        default:
+            break;
     }
+}
 
-    double likelihoodValue = this->likelihood(inverseCovariance, determinantCovariance);
+template <typename TInputImage, typename TMaskImage>
+double GaussianEMEstimator<TInputImage,TMaskImage>::expectation()
+{
+    //1. We calculate the inverse of the covariance and the determinant
+    if (!this->PrepareModelParameters(1e-12))
+        return 1.0;
 
-    // memory free
-    if(inverseCovariance != NULL)
-    {
-        delete[] inverseCovariance;
-        inverseCovariance = NULL;
-    }
-    if(determinantCovariance != NULL)
-    {
-        delete[] determinantCovariance;
-        determinantCovariance = NULL;
-    }
+    //2. We calculate the a posteriori probability and the likelihood
+    m_APosterioriProbability.resize(m_JointHistogram.size() * m_GaussianModel.size());
+    this->RunThreadedStep(ExpectationStep);
 
-    delete[] xi;
-    xi = NULL;
+    double likelihoodValue = 0.0;
+    for (unsigned int i = 0;i < m_ThreadLikelihoods.size();++i)
+        likelihoodValue += m_ThreadLikelihoods[i];
 
     return likelihoodValue;
 }
@@ -272,44 +454,24 @@ double GaussianEMEstimator<TInputImage,TMaskImage>::expectation()
 template <typename TInputImage, typename TMaskImage>
 bool GaussianEMEstimator<TInputImage,TMaskImage>::maximization(std::vector<GaussianFunctionType::Pointer>  &newModel, std::vector<double> &newAlphas)
 {
-    GenericContainer::iterator it;
-    Histogram::iterator histoIt;
-
     unsigned int numberOfClasses = m_GaussianModel.size();
-    unsigned int dimensions = this->m_JointHistogram.begin()->first.size();
-    double numberOfPixels = 0;
-
-    // initializations for estimations
-    double *mixedProportions = new double[numberOfClasses];
-    double **means = new double*[numberOfClasses];
-    for (unsigned int i = 0; i < numberOfClasses; ++i)
-    {
-        means[i] = new double [dimensions];
-    }
-
-    std::vector<GaussianFunctionType::CovarianceMatrixType> covariances(numberOfClasses, GaussianFunctionType::CovarianceMatrixType(dimensions,dimensions));
-
-    for(unsigned int i = 0; i < numberOfClasses;i++)
-    {
-        mixedProportions[i] = 0.0;
-        for(unsigned int j = 0; j < dimensions; j++)
-        {
-            means[i][j] = 0.0;
-            for(unsigned int k = 0; k < dimensions; k++)
-                covariances[i](j,k)=0.0;
-        }
-    }
+    unsigned int dimensions = m_HistogramDimension;
 
     //Mixing proportions and gaussian means
-    for(it = this->m_APosterioriProbability.begin(),histoIt = this->m_JointHistogram.begin(); it != this->m_APosterioriProbability.end(); ++it, ++histoIt) //for all histogram
+    this->RunThreadedStep(MaximizationMeansStep);
+
+    double numberOfPixels = 0;
+    std::vector<double> mixedProportions(numberOfClasses,0.0);
+    m_EstimatedMeans.assign(numberOfClasses * dimensions,0.0);
+    for (unsigned int t = 0;t < m_ThreadStatistics.size();++t)
     {
-        numberOfPixels += static_cast<double>(histoIt->second);//counting all pixels
+        numberOfPixels += m_ThreadStatistics[t][0];
         for(unsigned int i = 0; i < numberOfClasses; i++)
         {
-            mixedProportions[i] += it->second[i] * histoIt->second; //mixedProportions [A posteriori probability] * [occurrences]
-
+            const double *classStatistics = &m_ThreadStatistics[t][1 + i * (dimensions + 1)];
+            mixedProportions[i] += classStatistics[0];
             for(unsigned int j = 0; j < dimensions; j++)
-                means[i][j] += it->second[i] * histoIt->second * histoIt->first[j]; // means: [A posteriori probability] * [occurrences]*[intensity]
+                m_EstimatedMeans[i * dimensions + j] += classStatistics[j + 1];
         }
     }
 
@@ -317,38 +479,33 @@ bool GaussianEMEstimator<TInputImage,TMaskImage>::maximization(std::vector<Gauss
     {
         // normalization of means by sum( [A posteriori probability] * [occurrences])
         for(unsigned int j = 0; j < dimensions; j++)
-            means[i][j] /= mixedProportions[i];
+            m_EstimatedMeans[i * dimensions + j] /= mixedProportions[i];
     }
 
     // Covariance matrix for gaussians
-    for(it = this->m_APosterioriProbability.begin(), histoIt = this->m_JointHistogram.begin() ; it != this->m_APosterioriProbability.end(); ++it, ++histoIt) //for all histogram
-    {
-        for(unsigned int i = 0; i < numberOfClasses; i++)
-            for(unsigned int j = 0; j < dimensions; j++)
-                for(unsigned int k = j; k < dimensions; k++)
-                    covariances[i](j,k) += it->second[i] * histoIt->second * ( histoIt->first[j] - means[i][j] ) * ( histoIt->first[k] - means[i][k] ); //[post proba] [occurrences] ([intensity]-[mean])^2
-    }
+    this->RunThreadedStep(MaximizationCovariancesStep);
 
-    double mix_pro;
+    std::vector<GaussianFunctionType::CovarianceMatrixType> covariances(numberOfClasses, GaussianFunctionType::CovarianceMatrixType(dimensions,dimensions));
     for(unsigned int i = 0; i < numberOfClasses; i++)
     {
         for(unsigned int j = 0; j < dimensions; j++)
         {
-            mix_pro = mixedProportions[i];
-            covariances[i](j,j) /= mixedProportions[i];
-            for(unsigned int k = j+1; k < dimensions; k++)
+            for(unsigned int k = j; k < dimensions; k++)
             {
-                covariances[i](j,k) /= mixedProportions[i];
+                double covarianceValue = 0.0;
+                for (unsigned int t = 0;t < m_ThreadStatistics.size();++t)
+                    covarianceValue += m_ThreadStatistics[t][(i * dimensions + j) * dimensions + k];
+
+                covariances[i](j,k) = covarianceValue / mixedProportions[i];
                 covariances[i](k,j) = covariances[i](j,k);
             }
         }
         mixedProportions[i] /= static_cast<double>(numberOfPixels); // normalization of proportions by [numberOfPixels]
     }
 
-
     //storing values in an appropiate class
     newModel.clear();
-    int *sort = new int[numberOfClasses]; //sorting in increasing order the means[0]
+    std::vector<int> sort(numberOfClasses); //sorting in increasing order the means[0]
     for (unsigned int i = 0; i < numberOfClasses;i++)
     {
         sort[i] =-1;
@@ -366,9 +523,9 @@ bool GaussianEMEstimator<TInputImage,TMaskImage>::maximization(std::vector<Gauss
                 }
             }
             // if not used we get the min
-            if(!used && means[j][0] < minValue)
+            if(!used && m_EstimatedMeans[j * dimensions] < minValue)
             {
-                minValue = means[j][0];
+                minValue = m_EstimatedMeans[j * dimensions];
                 sort[i] = j;
             }
         }
@@ -385,7 +542,7 @@ bool GaussianEMEstimator<TInputImage,TMaskImage>::maximization(std::vector<Gauss
         GaussianFunctionType::MeanVectorType mu(dimensions);
         for(unsigned int j = 0; j < dimensions; j++)
         {
-            mu[j] = means[sort[i]][j];
+            mu[j] = m_EstimatedMeans[sort[i] * dimensions + j];
         }
 
         GaussianFunctionType::Pointer tmp = GaussianFunctionType::New();
@@ -395,13 +552,6 @@ bool GaussianEMEstimator<TInputImage,TMaskImage>::maximization(std::vector<Gauss
         newModel.push_back(tmp);
     }
 
-    delete[] sort;
-    for (unsigned int i = 0; i < numberOfClasses; ++i)
-    {
-        delete[] (means[i]);
-    }
-    delete[] mixedProportions;
-
     return true;
 }
 
@@ -440,95 +590,6 @@ void GaussianEMEstimator<TInputImage,TMaskImage>::Update()
     m_Likelihood = this->expectation();
 }
 
-template <typename TInputImage, typename TMaskImage>
-double GaussianEMEstimator<TInputImage,TMaskImage>::likelihood(GaussianFunctionType::CovarianceMatrixType *invCovariance, double *detCovariance)
-{
-    double likelihoodValue = 0.0;
-    unsigned int nbClasses = m_GaussianModel.size();
-    GaussianFunctionType::CovarianceMatrixType *inverseCovariance = NULL;
-    double *determinantCovariance = NULL;
-    if(invCovariance != NULL && detCovariance !=NULL)
-    {
-        inverseCovariance = invCovariance;
-        determinantCovariance = detCovariance;
-    }
-    else
-    {
-        inverseCovariance = new GaussianFunctionType::CovarianceMatrixType[nbClasses];
-        determinantCovariance = new double[nbClasses];
-
-        //1. We calculate covariance inverse and determinant
-        for(unsigned int i = 0 ; i < nbClasses; i++)
-        {
-            GaussianFunctionType::CovarianceMatrixType covar = (m_GaussianModel[i])->GetCovariance();
-            determinantCovariance[i] = vnl_determinant(covar.GetVnlMatrix());
-            if(std::fabs(determinantCovariance[i]) < 1e-9)
-            {
-                return likelihoodValue;
-            }
-            inverseCovariance[i] = covar.GetInverse();
-        }
-    }
-
-    //2. We calculate the a posteriori probability
-    Histogram::iterator histoIt;
-    GenericContainer::iterator it = this->m_APosterioriProbability.begin();
-
-    GaussianFunctionType::CovarianceMatrixType intensities(this->m_JointHistogram.begin()->first.size(),1);
-
-    for(histoIt = this->m_JointHistogram.begin(); histoIt != this->m_JointHistogram.end(); ++histoIt, ++it)
-    {
-        //We set the intensities of the histogram in a vector
-        for(unsigned int i = 0; i < histoIt->first.size(); i++)
-        {
-            intensities(i,0) = static_cast<double> (histoIt->first[i]);
-        }
-
-        unsigned int maxIndex = 0;
-        double maxPostProba = 0.0;
-        //we look for the max post proba to resolve de ecuation
-        for(unsigned int i = 0; i < nbClasses; i++)
-        {
-            if(it->second[i] > maxPostProba)
-            {
-                maxPostProba = it->second[i];
-                maxIndex = i;
-            }
-        }
-
-        GaussianFunctionType::CovarianceMatrixType x,xT,result;
-        GaussianFunctionType::MeanVectorType mu = (m_GaussianModel[maxIndex])->GetMean();
-        for(unsigned int i = 0; i < mu.Size(); i++)
-        {
-            x.SetSize(mu.Size(),1);
-            x(i,0) = mu[i];
-        }
-        x = intensities - x;
-        xT = (x.GetTranspose());
-        result = xT * inverseCovariance[maxIndex] * x;
-        double proba = result(0,0);
-
-        likelihoodValue += histoIt->second * ( -proba/2.0 - std::log(std::sqrt(pow(2*M_PI,static_cast<int>(this->m_JointHistogram.begin()->first.size())) *
-                                                                              std::fabs(determinantCovariance[maxIndex])))
-                                              + std::log(m_Alphas[maxIndex]/maxPostProba));
-    }
-
-    //Cleaning pointers if created in this function
-    if((invCovariance == NULL)&&(inverseCovariance!=NULL))
-    {
-        delete[] inverseCovariance;
-        inverseCovariance=NULL;
-    }
-    if((detCovariance ==NULL)&&(determinantCovariance!=NULL))
-    {
-        delete[] determinantCovariance;
-        determinantCovariance=NULL;
-    }
-
-    return likelihoodValue;
-}
-
-
 template <typename TInputImage, typename TMaskImage>
 double GaussianEMEstimator<TInputImage,TMaskImage>::computeDistance(std::vector<GaussianFunctionType::Pointer> &newModel)
 {
@@ -23,6 +23,7 @@ public:
     /** Standard class typedefs. */
     typedef GaussianREMEstimator  Self;
     typedef itk::ProcessObject Superclass;
+    typedef GaussianEMEstimator<TInputImage,TMaskImage> EMEstimatorType;
     typedef itk::SmartPointer <Self> Pointer;
     typedef itk::SmartPointer <const Self> ConstPointer;
 
@@ -40,7 +41,6 @@ public:
     typedef std::vector<MeasureType> Intensities;
     typedef std::map< Intensities, std::vector<Ocurrences> > GenericContainer;
     typedef std::map<Intensities,Ocurrences> Histogram;
-    typedef std::map<double,std::vector<unsigned short> > ResidualMap;
 
     typedef itk::VariableLengthVector<double> MeasurementVectorType;
     typedef itk::Statistics::GaussianMembershipFunction< MeasurementVectorType > GaussianFunctionType;
@@ -55,7 +55,7 @@ public:
     /** @brief Get the "concentrated" joint histogram
        * This joint histogram is the original without the samples considered outliersm
        */
-    Histogram GetConcentrationJointHistogram(){return this->m_JointHistogram;}
+    Histogram GetConcentrationJointHistogram(){return this->ConvertToHistogram(this->m_JointHistogram);}
 
     itkSetMacro(RejectionRatio, double);
     itkGetMacro(RejectionRatio, double);
@@ -83,6 +83,10 @@ protected:
 
     virtual ~GaussianREMEstimator(){}
 
+    //! Adds the computation of the mixture log-density of histogram entries, used to trim outliers
+    virtual void ProcessHistogramEntries(typename EMEstimatorType::ThreadedStepType step, unsigned int startEntry,
+                                         unsigned int endEntry, unsigned int threadId) ITK_OVERRIDE;
+
     /** @brief ratio of rejection
        * This is the ratio of samples that will be trimmed to calculate the estimation
        * Value between 0.0 and 1.0 (normally < 0.5)
@@ -100,7 +104,11 @@ protected:
     /** @brief input joint histogram, it will never be modified
        * @warning the attribute jointHistogram will be the "concentrated" histogram and will change in each iteration
        */
-    Histogram m_OriginalJointHistogram;
+    std::vector<Ocurrences> m_OriginalJointHistogram;
+
+    /** @brief log of the mixture density of each histogram entry, computed by concentration
+       */
+    std::vector<double> m_ConcentrationValues;
 
 };
 
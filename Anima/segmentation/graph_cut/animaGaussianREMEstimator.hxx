@@ -1,121 +1,84 @@
 #include "animaGaussianREMEstimator.h"
 
+#include <algorithm>
+
 namespace anima
 {
 
 template <typename TInputImage, typename TMaskImage>
-bool GaussianREMEstimator<TInputImage,TMaskImage>::concentration()
+void GaussianREMEstimator<TInputImage,TMaskImage>::ProcessHistogramEntries(typename EMEstimatorType::ThreadedStepType step, unsigned int startEntry,
+                                                                           unsigned int endEntry, unsigned int threadId)
 {
-    std::vector<vnl_matrix<GaussianREMEstimator::NumericType> > inverseCovariance;
-    inverseCovariance.reserve(this->m_GaussianModel.size());
-    double *determinantCovariance = new double[this->m_GaussianModel.size()];
-
-    if(!this->m_APosterioriProbability.empty())
-        this->m_APosterioriProbability.clear();
-    if(!this->m_JointHistogram.empty())
-        this->m_JointHistogram.clear();
-
-    GaussianFunctionType::CovarianceMatrixType *covari = new GaussianFunctionType::CovarianceMatrixType[this->m_GaussianModel.size()];
-    for(unsigned int i = 0; i < this->m_GaussianModel.size(); i++)
+    if (step != EMEstimatorType::ConcentrationStep)
     {
-        covari[i] = (this->m_GaussianModel[i])->GetCovariance();
+        EMEstimatorType::ProcessHistogramEntries(step,startEntry,endEntry,threadId);
+        return;
     }
 
-    //1. We calculate covariance inverse and determinant
-    for(unsigned int i = 0; i < this->m_GaussianModel.size(); i++)
+    unsigned int nbClasses = this->m_GaussianModel.size();
+    for (unsigned int entry = startEntry;entry < endEntry;++entry)
     {
-        determinantCovariance[i] = vnl_determinant(covari[i].GetVnlMatrix());
-        if(std::fabs(determinantCovariance[i]) < 1e-12)
-        {
-            return false;
-        }
-        inverseCovariance.push_back(covari[i].GetInverse());
-    }
+        const double *intensities = &this->m_HistogramIntensities[entry * this->m_HistogramDimension];
 
-    Histogram::iterator histoIt;
-    GaussianFunctionType::CovarianceMatrixType intensities(this->m_OriginalJointHistogram.begin()->first.size(),1);
-    std::vector<double> probas(this->m_GaussianModel.size());
-
-    ResidualMap residualMap;
-    double numberOfPixels=0;
+        double concentrationValue = 0.0;
+        for(unsigned int i = 0; i < nbClasses; i++)
+            concentrationValue += this->m_ModelFactors[i] * std::exp(- this->ComputeMahalanobisTerm(intensities,i) / 2.0);
 
-    GaussianFunctionType::CovarianceMatrixType *xi = new GaussianFunctionType::CovarianceMatrixType[probas.size()];
-    for(unsigned int i = 0; i < probas.size(); i++)
-    {
-        GaussianFunctionType::MeanVectorType mu = (this->m_GaussianModel[i])->GetMean();
-        (xi[i]).SetSize(mu.Size(),1);
-        for(unsigned int j = 0; j < mu.Size(); j++)
-        {
-            (xi[i])(j,0) = mu[j];
-        }
+        m_ConcentrationValues[entry] = std::log(concentrationValue);
     }
+}
 
-    GaussianFunctionType::CovarianceMatrixType x,xT;
-    for(histoIt = this->m_OriginalJointHistogram.begin(); histoIt != this->m_OriginalJointHistogram.end(); ++histoIt)
-    {
-        //We set the intensities of the histogram in a vector
-        for(unsigned int i = 0; i < histoIt->first.size(); i++)
-        {
-            intensities(i,0) = static_cast<double>(histoIt->first[i]);
-        }
-
-        double concentrationValue = 0.0;
+template <typename TInputImage, typename TMaskImage>
+bool GaussianREMEstimator<TInputImage,TMaskImage>::concentration()
+{
+    //1. We calculate covariance inverse and determinant
+    if (!this->PrepareModelParameters(1e-12))
+        return false;
 
-        //Calculate the exponential term and the minimum of them
-        for(unsigned int i = 0; i < probas.size(); i++)
-        {
-            x = intensities - xi[i];
-            xT = (x.GetTranspose());
-            vnl_matrix<GaussianREMEstimator::NumericType> result = xT.GetVnlMatrix() * inverseCovariance[i] * x.GetVnlMatrix();
-            probas[i] = result(0,0)/2;
-            concentrationValue += this->m_Alphas[i] * std::exp(-probas[i]) / std::sqrt( determinantCovariance[i] );
-        }
+    //2. Mixture log-density (residual) of all original histogram entries
+    unsigned int numEntries = this->m_OriginalJointHistogram.size();
+    m_ConcentrationValues.resize(numEntries);
+    this->RunThreadedStep(EMEstimatorType::ConcentrationStep);
 
-        //Add value to the GenericContainer
-        // We are storing the value inside of the exponential( it will be use in expectation)
-        //this->m_APosterioriProbability.insert(GenericContainer::value_type(histoIt->first,probas));
-        //Fill residualmap with probabilities of the mixed gaussian (probability = constant * concentrationvalue)
-        residualMap.insert(ResidualMap::value_type(std::log(concentrationValue),histoIt->first));
-        numberOfPixels+=histoIt->second;
+    double numberOfPixels = 0;
+    std::vector<unsigned int> residualOrder(numEntries);
+    for (unsigned int i = 0;i < numEntries;++i)
+    {
+        residualOrder[i] = i;
+        numberOfPixels += this->m_OriginalJointHistogram[i];
     }
 
-    ResidualMap::iterator it = residualMap.begin();
+    const std::vector<double> &concentrationValues = m_ConcentrationValues;
+    std::stable_sort(residualOrder.begin(),residualOrder.end(),[&concentrationValues](unsigned int a, unsigned int b) {
+        return concentrationValues[a] < concentrationValues[b];
+    });
 
-    //number of rejected pixels
+    //3. Reject the least likely pixels
     double numberOfRejections = this->m_RejectionRatio * numberOfPixels;
     double rejected = 0;
     this->m_JointHistogram = this->m_OriginalJointHistogram;
 
-    for(it=residualMap.begin(); it != residualMap.end(); ++it)
+    for (unsigned int i = 0;i < numEntries;++i)
     {
         if(rejected >= numberOfRejections)
             break;
-        histoIt = this->m_JointHistogram.find(it->second);
-        if(histoIt == this->m_JointHistogram.end())
-        {
-            return false;
-        }
-        double actual = histoIt->second;
+
+        unsigned int entry = residualOrder[i];
+        double actual = this->m_JointHistogram[entry];
         if(actual+rejected >= numberOfRejections)
         {
             //We pass the limit...we get only some points of this Intensities
-            histoIt->second = actual+rejected-numberOfRejections;
+            this->m_JointHistogram[entry] = actual+rejected-numberOfRejections;
             break;
         }
         else
         {
             //We don't pass the limit... we eliminate this Intensities
-            this->m_JointHistogram.erase(histoIt);
+            this->m_JointHistogram[entry] = 0;
             rejected += actual;
         }
     }
 
-    delete[] determinantCovariance;
-    determinantCovariance = NULL;
-
-    delete[] xi;
-    xi = NULL;
-
     return true;
 }
 
@@ -59,7 +59,7 @@ public:
     typedef itk::ImageRegionIterator< TMask > MaskRegionIteratorType;
     typedef itk::ImageRegionConstIterator< TMask > MaskRegionConstIteratorType;
 
-    typedef Graph<double,double,double> GraphType;
+    typedef GridMaxFlow<double> GraphType;
 
     typedef double NumericType;
     typedef itk::VariableSizeMatrix<NumericType> doubleVariableSizeMatrixType;
@@ -166,6 +166,8 @@ protected:
 
     void GenerateData() ITK_OVERRIDE;
     bool CheckMemory();
+    //! Tries to allocate the graph built by NLinksFilter on the given mask
+    bool CheckGraphAllocation(const TMask *mask);
     void ProcessGraphCut();
     void FindDownsampleFactor();
     void InitResampleFilters();
@@ -182,10 +184,6 @@ private:
      */
     double m_Sigma;
 
-    /** the created graph
-     */
-    GraphType *m_graph;
-
     /** transformation matrix (from im1,im2,im3 to e,el,ell)
      */
     std::string m_MatFilename;
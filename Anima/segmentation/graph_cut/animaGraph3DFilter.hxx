@@ -253,36 +253,32 @@ bool
 Graph3DFilter<TInput, TOutput>
 ::CheckMemory()
 {
-    unsigned int nb_vox = 0;
-    bool mem = true;
-    MaskRegionConstIteratorType maskIt (this->GetMask(),this->GetMask()->GetLargestPossibleRegion() );
-    while (!maskIt.IsAtEnd())
-    {
-        if (maskIt.Get() != 0)
-        {
-            nb_vox++;
-        }
-        ++maskIt;
-    }
+    bool mem = this->CheckGraphAllocation(this->GetMask());
+    if (!mem)
+        std::cerr << "-- In Graph3DFilter: insufficient memory to create the graph" << std::endl;
+
+    return mem;
+}
 
-    unsigned int nb_edges = 7*nb_vox;
+template <typename TInput, typename TOutput>
+bool
+Graph3DFilter<TInput, TOutput>
+::CheckGraphAllocation(const TMask *mask)
+{
+    // The grid graph covers the bounding box of the mask
+    TMask::RegionType graphRegion = NLinksFilterType::GetMaskBoundingRegion(mask);
 
     try
     {
-        m_graph = new GraphType(nb_vox, nb_edges);
+        GraphType graph;
+        graph.Allocate(graphRegion.GetSize()[0], graphRegion.GetSize()[1], graphRegion.GetSize()[2]);
     }
-    catch (std::bad_alloc& ba)
+    catch (std::bad_alloc&)
     {
-        std::cerr << "-- In Graph3DFilter: insufficient memory to create the graph: " << ba.what() << '\n';
-        mem = false;
+        return false;
     }
 
-    if (m_graph)
-    {
-        delete m_graph;
-        m_graph = NULL;
-    }
-    return mem;
+    return true;
 }
 
 template <typename TInput, typename TOutput>
@@ -361,36 +357,13 @@ Graph3DFilter<TInput, TOutput>::FindDownsampleFactor()
         resampleMask->SetDirectionTolerance( m_Tol );
         resampleMask->Update();
 
-        unsigned int nb_vox = 0;
-        MaskRegionIteratorType maskIt (resampleMask->GetOutput(),resampleMask->GetOutput()->GetLargestPossibleRegion() );
-        while (!maskIt.IsAtEnd())
-        {
-            if (maskIt.Get() != 0)
-            {
-                nb_vox++;
-            }
-            ++maskIt;
-        }
-
-        unsigned int nb_edges = 7*nb_vox;
-        mem2 = true;
-        try
-        {
-            m_graph = new GraphType(nb_vox, nb_edges);
-        }
-        catch (std::bad_alloc& ba)
+        mem2 = this->CheckGraphAllocation(resampleMask->GetOutput());
+        if (!mem2)
         {
-            std::cerr << "-- In Graph3DFilter: insufficient memory to create the graph ICI: " << ba.what() << '\n';
-            mem2 = false;
+            std::cerr << "-- In Graph3DFilter: insufficient memory to create the graph at downsampling factor " << m_DownsamplingFactor << std::endl;
             m_Count++;
             m_DownsamplingFactor*=2.0;
         }
-
-        if (m_graph)
-        {
-            delete m_graph;
-            m_graph = NULL;
-        }
     }
 }
 
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+
+namespace anima
+{
+
+/**
+ * @brief Max-flow / min-cut on a 6-connected 3D grid graph, using the Boykov-Kolmogorov augmenting paths
+ * algorithm (same search trees, growth, augmentation and adoption stages as in animaGraph.h).
+ *
+ * Contrary to Graph, the neighbourhood is implicit: nodes are the voxels of a grid, arcs are not stored as
+ * linked structures but as residual capacities in one array holding the six directions of each node. Parents in
+ * the search trees are stored as a direction code. A node thus costs six capacities plus about 20 bytes, instead of
+ * a node and six arcs with pointers. The grid is padded by one node on each side so that no bound check is needed,
+ * padding nodes have no capacity and never enter the search trees.
+ */
+template <typename TCapacityType>
+class GridMaxFlow
+{
+public:
+    typedef TCapacityType CapacityType;
+    typedef double FlowType;
+
+    //! Arc directions, the opposite of direction d is d ^ 1
+    enum Direction
+    {
+        XPlus = 0,
+        XMinus,
+        YPlus,
+        YMinus,
+        ZPlus,
+        ZMinus
+    };
+
+    GridMaxFlow();
+    ~GridMaxFlow() {}
+
+    //! Allocates a grid of the given size, throws std::bad_alloc if it does not fit into memory
+    void Allocate(unsigned int sizeX, unsigned int sizeY, unsigned int sizeZ);
+
+    //! Node index of grid position (x,y,z)
+    int GetNodeIndex(unsigned int x, unsigned int y, unsigned int z) const
+    {
+        return (x + 1) + (y + 1) * m_Offsets[YPlus] + (z + 1) * m_Offsets[ZPlus];
+    }
+
+    //! Sets capacities of the arc from node to its neighbour in direction dir (cap) and of the reverse arc (revCap)
+    void SetEdgeCapacities(int node, Direction dir, CapacityType cap, CapacityType revCap);
+
+    //! Adds terminal capacities to a node, same semantics as Graph::add_tweights
+    void AddTerminalWeights(int node, CapacityType sourceCap, CapacityType sinkCap);
+
+    //! Computes the maximum flow, nodes are then labeled by the minimum cut
+    FlowType ComputeMaxFlow();
+
+    //! True if node belongs to the source side of the cut (free nodes are assigned to the source as in Graph::what_segment)
+    bool IsSource(int node) const
+    {
+        return (m_Parents[node] == NoParent) || (!m_IsSink[node]);
+    }
+
+    FlowType GetFlow() const {return m_Flow;}
+
+private:
+    //! Parent codes, values 0 to 5 being the direction of the parent node
+    enum ParentCode
+    {
+        TerminalParent = 6,
+        OrphanParent,
+        NoParent
+    };
+
+    enum
+    {
+        InfiniteDistance = 0x7fffffff
+    };
+
+    CapacityType &ResidualCapacity(int node, unsigned int dir) {return m_ResidualCapacities[6 * node + dir];}
+
+    void Initialize();
+    void SetActive(int node);
+    int GetNextActive();
+
+    void SetOrphanFront(int node);
+    void SetOrphanRear(int node);
+
+    //! Augments along the path going through the arc from sourceNode (source tree) in direction dir
+    void Augment(int sourceNode, unsigned int dir);
+    void ProcessSourceOrphan(int node);
+    void ProcessSinkOrphan(int node);
+
+    //! Distance to the terminal of a node by following its parents, InfiniteDistance if it comes from an orphan
+    int ComputeOriginDistance(int node);
+
+    int m_Offsets[6];
+    unsigned int m_NumberOfNodes;
+
+    std::vector <CapacityType> m_ResidualCapacities;
+    //! Positive values are residual capacities from the source, negative ones to the sink
+    std::vector <CapacityType> m_TerminalCapacities;
+
+    std::vector <unsigned char> m_Parents;
+    std::vector <unsigned char> m_IsSink;
+
+    //! Active queues as linked lists in an array, -1 for nodes not in a queue, the last node points to itself
+    std::vector <int> m_NextActive;
+    int m_QueueFirst[2], m_QueueLast[2];
+
+    std::vector <int> m_TimeStamps;
+    std::vector <int> m_Distances;
+    int m_Time;
+
+    std::deque <int> m_Orphans;
+    FlowType m_Flow;
+};
+
+} // end namespace anima
+
+#include "animaGridMaxFlow.hxx"
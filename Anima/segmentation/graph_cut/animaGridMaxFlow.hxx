@@ -0,0 +1,477 @@
+#pragma once
+
+#include "animaGridMaxFlow.h"
+
+namespace anima
+{
+
+template <typename TCapacityType>
+GridMaxFlow<TCapacityType>::GridMaxFlow()
+{
+    for (unsigned int i = 0;i < 6;++i)
+        m_Offsets[i] = 0;
+
+    m_NumberOfNodes = 0;
+    m_QueueFirst[0] = m_QueueFirst[1] = -1;
+    m_QueueLast[0] = m_QueueLast[1] = -1;
+    m_Time = 0;
+    m_Flow = 0;
+}
+
+template <typename TCapacityType>
+void GridMaxFlow<TCapacityType>::Allocate(unsigned int sizeX, unsigned int sizeY, unsigned int sizeZ)
+{
+    unsigned int paddedSizeX = sizeX + 2;
+    unsigned int paddedSizeY = sizeY + 2;
+    unsigned int paddedSizeZ = sizeZ + 2;
+
+    m_Offsets[XPlus] = 1;
+    m_Offsets[XMinus] = -1;
+    m_Offsets[YPlus] = paddedSizeX;
+    m_Offsets[YMinus] = - m_Offsets[YPlus];
+    m_Offsets[ZPlus] = paddedSizeX * paddedSizeY;
+    m_Offsets[ZMinus] = - m_Offsets[ZPlus];
+
+    m_NumberOfNodes = paddedSizeX * paddedSizeY * paddedSizeZ;
+
+    m_ResidualCapacities.assign(6 * m_NumberOfNodes, 0);
+    m_TerminalCapacities.assign(m_NumberOfNodes, 0);
+    m_Parents.assign(m_NumberOfNodes, NoParent);
+    m_IsSink.assign(m_NumberOfNodes, 0);
+    m_NextActive.assign(m_NumberOfNodes, -1);
+    m_TimeStamps.assign(m_NumberOfNodes, 0);
+    m_Distances.assign(m_NumberOfNodes, 0);
+
+    m_Orphans.clear();
+    m_Flow = 0;
+}
+
+template <typename TCapacityType>
+void GridMaxFlow<TCapacityType>::SetEdgeCapacities(int node, Direction dir, CapacityType cap, CapacityType revCap)
+{
+    this->ResidualCapacity(node,dir) = cap;
+    this->ResidualCapacity(node + m_Offsets[dir],dir ^ 1) = revCap;
+}
+
+template <typename TCapacityType>
+void GridMaxFlow<TCapacityType>::AddTerminalWeights(int node, CapacityType sourceCap, CapacityType sinkCap)
+{
+    CapacityType delta = m_TerminalCapacities[node];
+    if (delta > 0)
+        sourceCap += delta;
+    else
+        sinkCap -= delta;
+
+    m_Flow += (sourceCap < sinkCap) ? sourceCap : sinkCap;
+    m_TerminalCapacities[node] = sourceCap - sinkCap;
+}
+
+template <typename TCapacityType>
+void GridMaxFlow<TCapacityType>::SetActive(int node)
+{
+    if (m_NextActive[node] >= 0)
+        return;
+
+    if (m_QueueLast[1] >= 0)
+        m_NextActive[m_QueueLast[1]] = node;
+    else
+        m_QueueFirst[1] = node;
+
+    m_QueueLast[1] = node;
+    m_NextActive[node] = node;
+}
+
+template <typename TCapacityType>
+int GridMaxFlow<TCapacityType>::GetNextActive()
+{
+    while (true)
+    {
+        int node = m_QueueFirst[0];
+        if (node < 0)
+        {
+            m_QueueFirst[0] = node = m_QueueFirst[1];
+            m_QueueLast[0] = m_QueueLast[1];
+            m_QueueFirst[1] = m_QueueLast[1] = -1;
+            if (node < 0)
+                return -1;
+        }
+
+        if (m_NextActive[node] == node)
+            m_QueueFirst[0] = m_QueueLast[0] = -1;
+        else
+            m_QueueFirst[0] = m_NextActive[node];
+
+        m_NextActive[node] = -1;
+
+        // A node in the queues is active only if it has a parent
+        if (m_Parents[node] != NoParent)
+            return node;
+    }
+}
+
+template <typename TCapacityType>
+void GridMaxFlow<TCapacityType>::SetOrphanFront(int node)
+{
+    m_Parents[node] = OrphanParent;
+    m_Orphans.push_front(node);
+}
+
+template <typename TCapacityType>
+void GridMaxFlow<TCapacityType>::SetOrphanRear(int node)
+{
+    m_Parents[node] = OrphanParent;
+    m_Orphans.push_back(node);
+}
+
+template <typename TCapacityType>
+void GridMaxFlow<TCapacityType>::Initialize()
+{
+    m_QueueFirst[0] = m_QueueFirst[1] = -1;
+    m_QueueLast[0] = m_QueueLast[1] = -1;
+    m_Orphans.clear();
+    m_Time = 0;
+
+    for (unsigned int i = 0;i < m_NumberOfNodes;++i)
+    {
+        m_NextActive[i] = -1;
+        m_TimeStamps[i] = m_Time;
+
+        if (m_TerminalCapacities[i] == 0)
+        {
+            m_Parents[i] = NoParent;
+            continue;
+        }
+
+        m_IsSink[i] = (m_TerminalCapacities[i] < 0);
+        m_Parents[i] = TerminalParent;
+        m_Distances[i] = 1;
+        this->SetActive(i);
+    }
+}
+
+template <typename TCapacityType>
+void GridMaxFlow<TCapacityType>::Augment(int sourceNode, unsigned int dir)
+{
+    int sinkNode = sourceNode + m_Offsets[dir];
+
+    // Bottleneck capacity, source tree then sink tree
+    CapacityType bottleneck = this->ResidualCapacity(sourceNode,dir);
+    int i = sourceNode;
+    while (m_Parents[i] != TerminalParent)
+    {
+        int parent = i + m_Offsets[m_Parents[i]];
+        CapacityType parentCap = this->ResidualCapacity(parent,m_Parents[i] ^ 1);
+        if (bottleneck > parentCap)
+            bottleneck = parentCap;
+        i = parent;
+    }
+
+    if (bottleneck > m_TerminalCapacities[i])
+        bottleneck = m_TerminalCapacities[i];
+
+    i = sinkNode;
+    while (m_Parents[i] != TerminalParent)
+    {
+        CapacityType parentCap = this->ResidualCapacity(i,m_Parents[i]);
+        if (bottleneck > parentCap)
+            bottleneck = parentCap;
+        i += m_Offsets[m_Parents[i]];
+    }
+
+    if (bottleneck > - m_TerminalCapacities[i])
+        bottleneck = - m_TerminalCapacities[i];
+
+    // Augmentation, saturated tree arcs produce orphans
+    this->ResidualCapacity(sinkNode,dir ^ 1) += bottleneck;
+    this->ResidualCapacity(sourceNode,dir) -= bottleneck;
+
+    i = sourceNode;
+    while (m_Parents[i] != TerminalParent)
+    {
+        unsigned int parentDir = m_Parents[i];
+        int parent = i + m_Offsets[parentDir];
+        this->ResidualCapacity(i,parentDir) += bottleneck;
+        this->ResidualCapacity(parent,parentDir ^ 1) -= bottleneck;
+        if (!this->ResidualCapacity(parent,parentDir ^ 1))
+            this->SetOrphanFront(i);
+        i = parent;
+    }
+
+    m_TerminalCapacities[i] -= bottleneck;
+    if (!m_TerminalCapacities[i])
+        this->SetOrphanFront(i);
+
+    i = sinkNode;
+    while (m_Parents[i] != TerminalParent)
+    {
+        unsigned int parentDir = m_Parents[i];
+        int parent = i + m_Offsets[parentDir];
+        this->ResidualCapacity(parent,parentDir ^ 1) += bottleneck;
+        this->ResidualCapacity(i,parentDir) -= bottleneck;
+        if (!this->ResidualCapacity(i,parentDir))
+            this->SetOrphanFront(i);
+        i = parent;
+    }
+
+    m_TerminalCapacities[i] += bottleneck;
+    if (!m_TerminalCapacities[i])
+        this->SetOrphanFront(i);
+
+    m_Flow += bottleneck;
+}
+
+template <typename TCapacityType>
+int GridMaxFlow<TCapacityType>::ComputeOriginDistance(int node)
+{
+    int distance = 0;
+    while (true)
+    {
+        if (m_TimeStamps[node] == m_Time)
+            return distance + m_Distances[node];
+
+        unsigned char parentCode = m_Parents[node];
+        ++distance;
+        if (parentCode == TerminalParent)
+        {
+            m_TimeStamps[node] = m_Time;
+            m_Distances[node] = 1;
+            return distance;
+        }
+
+        if (parentCode == OrphanParent)
+            return InfiniteDistance;
+
+        node += m_Offsets[parentCode];
+    }
+}
+
+template <typename TCapacityType>
+void GridMaxFlow<TCapacityType>::ProcessSourceOrphan(int node)
+{
+    unsigned char bestDir = NoParent;
+    int bestDistance = InfiniteDistance;
+
+    // Trying to find a new parent coming from the source
+    for (unsigned int d = 0;d < 6;++d)
+    {
+        int neighbour = node + m_Offsets[d];
+        if (!this->ResidualCapacity(neighbour,d ^ 1) || m_IsSink[neighbour] || (m_Parents[neighbour] == NoParent))
+            continue;
+
+        int distance = this->ComputeOriginDistance(neighbour);
+        if (distance >= InfiniteDistance)
+            continue;
+
+        if (distance < bestDistance)
+        {
+            bestDir = d;
+            bestDistance = distance;
+        }
+
+        // Set marks along the path
+        for (int j = neighbour;m_TimeStamps[j] != m_Time;j += m_Offsets[m_Parents[j]])
+        {
+            m_TimeStamps[j] = m_Time;
+            m_Distances[j] = distance--;
+        }
+    }
+
+    m_Parents[node] = bestDir;
+    if (bestDir != NoParent)
+    {
+        m_TimeStamps[node] = m_Time;
+        m_Distances[node] = bestDistance + 1;
+        return;
+    }
+
+    // No parent found, neighbours become active and their children orphans
+    for (unsigned int d = 0;d < 6;++d)
+    {
+        int neighbour = node + m_Offsets[d];
+        unsigned char parentCode = m_Parents[neighbour];
+        if (m_IsSink[neighbour] || (parentCode == NoParent))
+            continue;
+
+        if (this->ResidualCapacity(neighbour,d ^ 1))
+            this->SetActive(neighbour);
+
+        if ((parentCode < 6) && (parentCode == (d ^ 1)))
+            this->SetOrphanRear(neighbour);
+    }
+}
+
+template <typename TCapacityType>
+void GridMaxFlow<TCapacityType>::ProcessSinkOrphan(int node)
+{
+    unsigned char bestDir = NoParent;
+    int bestDistance = InfiniteDistance;
+
+    // Trying to find a new parent coming from the sink
+    for (unsigned int d = 0;d < 6;++d)
+    {
+        int neighbour = node + m_Offsets[d];
+        if (!this->ResidualCapacity(node,d) || !m_IsSink[neighbour] || (m_Parents[neighbour] == NoParent))
+            continue;
+
+        int distance = this->ComputeOriginDistance(neighbour);
+        if (distance >= InfiniteDistance)
+            continue;
+
+        if (distance < bestDistance)
+        {
+            bestDir = d;
+            bestDistance = distance;
+        }
+
+        for (int j = neighbour;m_TimeStamps[j] != m_Time;j += m_Offsets[m_Parents[j]])
+        {
+            m_TimeStamps[j] = m_Time;
+            m_Distances[j] = distance--;
+        }
+    }
+
+    m_Parents[node] = bestDir;
+    if (bestDir != NoParent)
+    {
+        m_TimeStamps[node] = m_Time;
+        m_Distances[node] = bestDistance + 1;
+        return;
+    }
+
+    for (unsigned int d = 0;d < 6;++d)
+    {
+        int neighbour = node + m_Offsets[d];
+        unsigned char parentCode = m_Parents[neighbour];
+        if (!m_IsSink[neighbour] || (parentCode == NoParent))
+            continue;
+
+        if (this->ResidualCapacity(node,d))
+            this->SetActive(neighbour);
+
+        if ((parentCode < 6) && (parentCode == (d ^ 1)))
+            this->SetOrphanRear(neighbour);
+    }
+}
+
+template <typename TCapacityType>
+typename GridMaxFlow<TCapacityType>::FlowType
+GridMaxFlow<TCapacityType>::ComputeMaxFlow()
+{
+    this->Initialize();
+
+    int currentNode = -1;
+    while (true)
+    {
+        int i = currentNode;
+        if (i >= 0)
+        {
+            // Remove active flag
+            m_NextActive[i] = -1;
+            if (m_Parents[i] == NoParent)
+                i = -1;
+        }
+
+        if (i < 0)
+        {
+            i = this->GetNextActive();
+            if (i < 0)
+                break;
+        }
+
+        // Growth, stops when reaching the other tree
+        int pathSourceNode = -1;
+        unsigned int pathDir = 0;
+        if (!m_IsSink[i])
+        {
+            for (unsigned int d = 0;d < 6;++d)
+            {
+                if (!this->ResidualCapacity(i,d))
+                    continue;
+
+                int j = i + m_Offsets[d];
+                if (m_Parents[j] == NoParent)
+                {
+                    m_IsSink[j] = 0;
+                    m_Parents[j] = d ^ 1;
+                    m_TimeStamps[j] = m_TimeStamps[i];
+                    m_Distances[j] = m_Distances[i] + 1;
+                    this->SetActive(j);
+                }
+                else if (m_IsSink[j])
+                {
+                    pathSourceNode = i;
+                    pathDir = d;
+                    break;
+                }
+                else if ((m_TimeStamps[j] <= m_TimeStamps[i]) && (m_Distances[j] > m_Distances[i]))
+                {
+                    // Heuristic trying to make the distance from j to the source shorter
+                    m_Parents[j] = d ^ 1;
+                    m_TimeStamps[j] = m_TimeStamps[i];
+                    m_Distances[j] = m_Distances[i] + 1;
+                }
+            }
+        }
+        else
+        {
+            for (unsigned int d = 0;d < 6;++d)
+            {
+                int j = i + m_Offsets[d];
+                if (!this->ResidualCapacity(j,d ^ 1))
+                    continue;
+
+                if (m_Parents[j] == NoParent)
+                {
+                    m_IsSink[j] = 1;
+                    m_Parents[j] = d ^ 1;
+                    m_TimeStamps[j] = m_TimeStamps[i];
+                    m_Distances[j] = m_Distances[i] + 1;
+                    this->SetActive(j);
+                }
+                else if (!m_IsSink[j])
+                {
+                    pathSourceNode = j;
+                    pathDir = d ^ 1;
+                    break;
+                }
+                else if ((m_TimeStamps[j] <= m_TimeStamps[i]) && (m_Distances[j] > m_Distances[i]))
+                {
+                    // Heuristic trying to make the distance from j to the sink shorter
+                    m_Parents[j] = d ^ 1;
+                    m_TimeStamps[j] = m_TimeStamps[i];
+                    m_Distances[j] = m_Distances[i] + 1;
+                }
+            }
+        }
+
+        ++m_Time;
+
+        if (pathSourceNode < 0)
+        {
+            currentNode = -1;
+            continue;
+        }
+
+        // Keep i active, it may still have unexplored arcs
+        m_NextActive[i] = i;
+        currentNode = i;
+
+        this->Augment(pathSourceNode,pathDir);
+
+        // Adoption
+        while (!m_Orphans.empty())
+        {
+            int orphan = m_Orphans.front();
+            m_Orphans.pop_front();
+
+            if (m_IsSink[orphan])
+                this->ProcessSinkOrphan(orphan);
+            else
+                this->ProcessSourceOrphan(orphan);
+        }
+    }
+
+    return m_Flow;
+}
+
+} // end namespace anima
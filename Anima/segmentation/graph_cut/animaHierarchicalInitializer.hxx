@@ -115,6 +115,7 @@ void HierarchicalInitializer<TInputImage,TMaskImage>
     estimator ->SetMask( this->GetMask() );
     estimator ->SetInputImage1( this->GetInputImage1() );
     estimator ->SetVerbose( false );
+    estimator ->SetNumberOfWorkUnits( this->GetNumberOfWorkUnits() );
 
     std::vector<unsigned int> emSteps( 1, 60 );
     std::vector<unsigned int> iterSteps( 1, 60 );
@@ -5,7 +5,9 @@
 #include <itkImageRegionConstIterator.h>
 #include <itkVariableSizeMatrix.h>
 #include <itkCSVArray2DFileReader.h>
-#include "animaGraph.h"
+#include "animaGridMaxFlow.h"
+
+#include <algorithm>
 
 namespace anima
 {
@@ -63,7 +65,9 @@ public:
     typedef itk::ImageRegionIterator< TMask > MaskRegionIteratorType;
     typedef itk::ImageRegionConstIterator< TMask > MaskRegionConstIteratorType;
 
-    typedef Graph<double,double,double> GraphType;
+    typedef TMask::RegionType MaskRegionType;
+
+    typedef GridMaxFlow<double> GraphType;
 
     typedef double NumericType;
     typedef itk::VariableSizeMatrix<NumericType> doubleVariableSizeMatrixType;
@@ -87,6 +91,9 @@ public:
     void SetMatFilename(std::string mat){m_MatFilename=mat;}
     void SetMatrix(doubleVariableSizeMatrixType mat){m_Matrix=mat;}
 
+    //! Smallest region containing all non zero voxels of the mask, on which the graph is built
+    static MaskRegionType GetMaskBoundingRegion(const TMask *mask);
+
     OutputImagePointer GetOutput();
     OutputImagePointer GetOutputBackground();
 
@@ -127,6 +134,7 @@ protected:
         m_IndexImage1=m_NbMaxImage,m_IndexImage2=m_NbMaxImage,m_IndexImage3=m_NbMaxImage, m_IndexImage4=m_NbMaxImage,m_IndexImage5=m_NbMaxImage;
 
         m_Tol = 0.0001;
+        m_graph = NULL;
 
         this->SetNumberOfRequiredOutputs(2);
         this->SetNumberOfRequiredInputs(4);
@@ -160,6 +168,7 @@ protected:
     void GenerateData() ITK_OVERRIDE;
     void SetGraph();
     bool isInside (unsigned int x,unsigned int y,unsigned int z ) const;
+    int GetGraphNodeIndex(const pixelIndexInt &index) const;
     void CreateGraph();
     double computeNLink(int i1, int j1, int k1, int i2, int j2, int k2);
 
@@ -174,9 +183,10 @@ private:
      */
     double m_Sigma;
 
-    /** the created graph
+    /** the created graph, a grid covering m_GraphRegion
      */
     GraphType *m_graph;
+    MaskRegionType m_GraphRegion;
 
     /** transformation matrix (from im1,im2,im3 to e,el,ell)
      */
@@ -191,8 +201,6 @@ private:
 
     bool m_Verbose;
 
-    ImageTypeInt::Pointer pix;
-
     /** spectral derivatives (e,el,ell)
      */
     TSeedProba::Pointer m_e1, m_e2; // Precomputed spectral grad quantities (keep track of 2 images instead of 3...
@@ -291,9 +291,8 @@ NLinksFilter<TInput, TOutput>
     this->CreateGraph();
     this->SetGraph();
 
-    m_graph -> maxflow();
+    m_graph->ComputeMaxFlow();
 
-    int cpt=0;
     MaskRegionConstIteratorType maskIt (this->GetMask(),this->GetMask()->GetLargestPossibleRegion());
     OutputIteratorType outIt (output,output->GetLargestPossibleRegion() );
     OutputIteratorType outBackgroundIt (outputBackground,outputBackground->GetLargestPossibleRegion() );
@@ -303,11 +302,9 @@ NLinksFilter<TInput, TOutput>
         outIt.Set(0);
         if (maskIt.Get() != 0)
         {
-            int v = m_graph->what_segment(cpt);
-            unsigned char buff = (v == GraphType::SOURCE) ? 1 : 0;
+            unsigned char buff = m_graph->IsSource(this->GetGraphNodeIndex(maskIt.GetIndex())) ? 1 : 0;
             outIt.Set(static_cast<OutputPixelType>(buff));
             outBackgroundIt.Set(1-buff);
-            cpt++;
         }
         ++maskIt;
         ++outBackgroundIt;
@@ -318,7 +315,7 @@ NLinksFilter<TInput, TOutput>
     m_NbInputs = 3;
     m_ListImages.clear();
     if (m_graph) delete m_graph;
-
+    m_graph = NULL;
 }
 
 
@@ -417,26 +414,71 @@ bool NLinksFilter<TInput, TOutput>::isInside (unsigned int x, unsigned int y, un
 }
 
 template <typename TInput, typename TOutput>
-void NLinksFilter<TInput, TOutput>::SetGraph()
+typename NLinksFilter<TInput, TOutput>::MaskRegionType
+NLinksFilter<TInput, TOutput>::GetMaskBoundingRegion(const TMask *mask)
 {
-    // allocate only necessary memory
-    int nb_vox = 0;
+    MaskRegionType boundingRegion;
+    TMask::IndexType minIndex, maxIndex;
+    bool emptyMask = true;
 
-    MaskRegionConstIteratorType maskIt (this->GetMask(),this->GetMask()->GetLargestPossibleRegion() );
+    MaskRegionConstIteratorType maskIt (mask,mask->GetLargestPossibleRegion());
     while (!maskIt.IsAtEnd())
     {
         if (maskIt.Get() != 0)
         {
-            nb_vox++;
+            TMask::IndexType index = maskIt.GetIndex();
+            if (emptyMask)
+            {
+                minIndex = index;
+                maxIndex = index;
+                emptyMask = false;
+            }
+
+            for (unsigned int i = 0;i < 3;++i)
+            {
+                minIndex[i] = std::min(minIndex[i],index[i]);
+                maxIndex[i] = std::max(maxIndex[i],index[i]);
+            }
         }
         ++maskIt;
     }
 
-    int nb_edges = 7*nb_vox;
+    if (emptyMask)
+    {
+        boundingRegion.SetIndex(mask->GetLargestPossibleRegion().GetIndex());
+        TMask::SizeType emptySize;
+        emptySize.Fill(0);
+        boundingRegion.SetSize(emptySize);
+        return boundingRegion;
+    }
+
+    TMask::SizeType boundingSize;
+    for (unsigned int i = 0;i < 3;++i)
+        boundingSize[i] = maxIndex[i] - minIndex[i] + 1;
+
+    boundingRegion.SetIndex(minIndex);
+    boundingRegion.SetSize(boundingSize);
+    return boundingRegion;
+}
+
+template <typename TInput, typename TOutput>
+int NLinksFilter<TInput, TOutput>::GetGraphNodeIndex(const pixelIndexInt &index) const
+{
+    return m_graph->GetNodeIndex(index[0] - m_GraphRegion.GetIndex()[0],
+                                 index[1] - m_GraphRegion.GetIndex()[1],
+                                 index[2] - m_GraphRegion.GetIndex()[2]);
+}
+
+template <typename TInput, typename TOutput>
+void NLinksFilter<TInput, TOutput>::SetGraph()
+{
+    // allocate only the grid bounding the mask, neighborhoods are implicit
+    m_GraphRegion = GetMaskBoundingRegion(this->GetMask());
 
     try
     {
-        m_graph = new GraphType(nb_vox, nb_edges);
+        m_graph = new GraphType;
+        m_graph->Allocate(m_GraphRegion.GetSize()[0], m_GraphRegion.GetSize()[1], m_GraphRegion.GetSize()[2]);
     }
     catch (std::bad_alloc& ba)
     {
@@ -444,32 +486,7 @@ void NLinksFilter<TInput, TOutput>::SetGraph()
         exit(-1);
     }
 
-    // Create the nodes of the graph and set the correspondences with the original image
-    int compt = 0;
-    ImageTypeInt::Pointer pix = ImageTypeInt::New();
-    pix->SetRegions(this->GetMask()->GetLargestPossibleRegion());
-    pix->CopyInformation(this->GetMask());
-    pix->Allocate();
-    pix->FillBuffer(-1);
-
-    ImageIteratorTypeInt pixIt (pix,pix->GetLargestPossibleRegion());
-
-    maskIt.GoToBegin();
-    while (!maskIt.IsAtEnd())
-    {
-        if (maskIt.Get() != 0)
-        {
-            m_graph -> add_node();
-            pixIt.Set(compt++);
-        }
-        ++maskIt;
-        ++pixIt;
-    }
-
-
-    maskIt.GoToBegin();
-    pixIt.GoToBegin();
-
+    MaskRegionConstIteratorType maskIt (this->GetMask(),m_GraphRegion);
 
     // Create the t-links and n-links
     while (!maskIt.IsAtEnd())
@@ -481,8 +498,7 @@ void NLinksFilter<TInput, TOutput>::SetGraph()
             index[1]=maskIt.GetIndex()[1];
             index[2]=maskIt.GetIndex()[2];
 
-            int pix_ref = pix->GetPixel(index);
-            int pix_courant;
+            int pix_ref = this->GetGraphNodeIndex(index);
             double cap, rcap;
 
             // Compute the 6 n-links of each standard node (gradients between the current voxel and its neighbors)
@@ -491,12 +507,11 @@ void NLinksFilter<TInput, TOutput>::SetGraph()
             index1[2]=index[2];
             if ( (isInside(index[0]+1, index[1] , index[2])) && (this->GetMask()->GetPixel(index1)!=0) )
             {
-                pix_courant = pix->GetPixel(index1);
                 cap  = computeNLink(index[0]+1, index[1], index[2], index[0], index[1], index[2]);
                 rcap = cap;
                 if (!(cap >= 0))
                     cap = rcap = 0;
-                m_graph -> add_edge(pix_ref, pix_courant, cap, rcap);
+                m_graph -> SetEdgeCapacities(pix_ref, GraphType::XPlus, cap, rcap);
             }
 
 
@@ -505,12 +520,11 @@ void NLinksFilter<TInput, TOutput>::SetGraph()
             index1[2]=index[2];
             if ( (isInside(index[0], index[1]+1 , index[2])) && (this->GetMask()->GetPixel(index1)!=0) )
             {
-                pix_courant = pix->GetPixel(index1);
                 cap  = computeNLink(index[0], index[1]+1, index[2], index[0], index[1], index[2]);
                 rcap = cap;
                 if (!(cap >= 0)) // eq cap < 0 ? no ???
                     cap = rcap = 0;
-                m_graph -> add_edge(pix_ref, pix_courant, cap, rcap);
+                m_graph -> SetEdgeCapacities(pix_ref, GraphType::YPlus, cap, rcap);
             }
 
             index1[0]=index[0];
@@ -518,22 +532,20 @@ void NLinksFilter<TInput, TOutput>::SetGraph()
             index1[2]=index[2]+1;
             if ( (isInside(index[0], index[1] , index[2]+1)) && (this->GetMask()->GetPixel(index1)!=0) )
             {
-                pix_courant = pix->GetPixel(index1);
                 cap  = computeNLink(index[0], index[1], index[2]+1, index[0], index[1], index[2]);
                 rcap = cap;
                 if (!(cap >= 0))
                     cap = rcap = 0;
-                m_graph -> add_edge(pix_ref, pix_courant, cap, rcap);
+                m_graph -> SetEdgeCapacities(pix_ref, GraphType::ZPlus, cap, rcap);
             }
 
             // Create the t-links to the source and the sink
             double t_source = static_cast<double>(this->GetInputSeedProbaSources()->GetPixel(index));
             double t_sink   = static_cast<double>(this->GetInputSeedProbaSinks()->GetPixel(index));
-            m_graph -> add_tweights(pix_ref, t_source, t_sink);
+            m_graph -> AddTerminalWeights(pix_ref, t_source, t_sink);
 
         }
 
-        ++pixIt;
         ++maskIt;
     }
 }
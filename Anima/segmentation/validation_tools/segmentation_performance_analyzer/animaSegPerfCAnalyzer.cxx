@@ -9,6 +9,7 @@
 #include <itkImageIterator.h>
 #include <itkMultiThreaderBase.h>
 #include <itkImageDuplicator.h>
+#include <limits>
 
 namespace anima
 {
@@ -88,6 +89,11 @@ SegPerfCAnalyzer::SegPerfCAnalyzer(std::string &pi_pchImageTestName, std::string
 
     m_bValuesComputed = false;
     m_bContourDetected = false;
+    m_bSurfaceDistancesComputed = false;
+
+    m_dfHausdorffDistance = std::numeric_limits<double>::quiet_NaN();
+    m_dfContourMeanDistance = std::numeric_limits<double>::quiet_NaN();
+    m_dfAverageSurfaceDistance = std::numeric_limits<double>::quiet_NaN();
 }
 
 /**
@@ -221,6 +227,10 @@ void SegPerfCAnalyzer::selectCluster(unsigned int iCluster)
             }
         }
         this->m_uiNbLabels = 2;
+
+        // Contours and distances of the previous selection are outdated
+        m_bContourDetected = false;
+        m_bSurfaceDistancesComputed = false;
     }
 
     return;
@@ -630,163 +640,209 @@ void SegPerfCAnalyzer::formatLabels()
 }
 
 /**
-@brief  Compute Haussdorf distance
-@return hausdorffDistance in double
+@brief  Compute the distance map to the contour voxels of a given label (any non zero contour voxel if label is 0)
+@param  [in] contourImage contour image
+@param  [in] label contour label
+@return distance map in physical units, non positive on the contour
 */
-double SegPerfCAnalyzer::computeHausdorffDist()
+SegPerfCAnalyzer::DistanceImageType::Pointer SegPerfCAnalyzer::computeContourDistanceMap(ImageType *contourImage, unsigned int label)
 {
-    FilterType::RealType hausdorffDistance = std::numeric_limits<double>::quiet_NaN();
+    ImageType::Pointer binaryContour = contourImage;
 
-    if (m_uiNbLabels>1)
+    if (label != 0)
     {
-        // compute the Hausdorff distance
-        typedef itk::HausdorffDistanceImageFilter<ImageType, ImageType> FilterType;
-        FilterType::Pointer filter = FilterType::New();
-
-        filter->SetInput1(m_imageTest);
-        filter->SetInput2(m_imageRef);
+        typedef itk::BinaryThresholdImageFilter <ImageType, ImageType> ThresholdFilterType;
+        ThresholdFilterType::Pointer thresholdFilter = ThresholdFilterType::New();
+        thresholdFilter->SetInput(contourImage);
+        thresholdFilter->SetLowerThreshold(label);
+        thresholdFilter->SetUpperThreshold(label);
+        thresholdFilter->SetInsideValue(1);
+        thresholdFilter->SetOutsideValue(0);
+        thresholdFilter->SetNumberOfWorkUnits(m_ThreadNb);
+        thresholdFilter->Update();
+
+        binaryContour = thresholdFilter->GetOutput();
+        binaryContour->DisconnectPipeline();
+    }
 
-        try
-        {
-            filter->Update();
-        }
-        catch (itk::ExceptionObject& e)
-        {
-            std::cerr << "exception in filter " << std::endl;
-            std::cerr << e << std::endl;
-            return EXIT_FAILURE;
-        }
+    typedef itk::SignedMaurerDistanceMapImageFilter <ImageType, DistanceImageType> DistanceFilterType;
+    DistanceFilterType::Pointer distanceFilter = DistanceFilterType::New();
+    distanceFilter->SetInput(binaryContour);
+    distanceFilter->SetBackgroundValue(0);
+    distanceFilter->SetUseImageSpacing(true);
+    distanceFilter->SetSquaredDistance(false);
+    distanceFilter->SetInsideIsPositive(false);
+    distanceFilter->SetNumberOfWorkUnits(m_ThreadNb);
+    distanceFilter->Update();
 
-        hausdorffDistance = filter->GetHausdorffDistance();
-    }
+    DistanceImageType::Pointer distanceMap = distanceFilter->GetOutput();
+    distanceMap->DisconnectPipeline();
 
-    return hausdorffDistance;
+    return distanceMap;
 }
 
 /**
-@brief   Compute mean distance
-@return  meanDistance
+@brief  Compute Hausdorff distance, contour mean distance and average surface distance
+@details Each contour is turned once into a Maurer distance map, all distances being then read from those maps
+in linear time (instead of pairwise distances between contour voxels). Hausdorff and contour mean distances
+consider all labels as a single object, as the ITK filters they replace. The average surface distance is
+computed label by label; in the binary case, the same two maps are used for all measures.
 */
-double SegPerfCAnalyzer::computeMeanDist()
+void SegPerfCAnalyzer::computeSurfaceDistances()
 {
-    FilterType::RealType meanDistance = std::numeric_limits<double>::quiet_NaN();
+    m_dfHausdorffDistance = std::numeric_limits<double>::quiet_NaN();
+    m_dfContourMeanDistance = std::numeric_limits<double>::quiet_NaN();
+    m_dfAverageSurfaceDistance = std::numeric_limits<double>::quiet_NaN();
+    m_bSurfaceDistancesComputed = true;
+
+    if (m_uiNbLabels <= 1)
+        return;
+
+    if (!this->m_bContourDetected)
+        this->contourDectection();
+
+    ImageType::RegionType region = m_imageRef->GetLargestPossibleRegion();
 
-    if (m_uiNbLabels > 1)
+    // Distances to all contour voxels, any label
+    DistanceImageType::Pointer refDistanceMap = this->computeContourDistanceMap(m_imageRefContour, 0);
+    DistanceImageType::Pointer testDistanceMap = this->computeContourDistanceMap(m_imageTestContour, 0);
+
+    ImageIteratorType refIt(m_imageRef, region);
+    ImageIteratorType testIt(m_imageTest, region);
+    ImageIteratorType refContourIt(m_imageRefContour, region);
+    ImageIteratorType testContourIt(m_imageTestContour, region);
+    DistanceIteratorType refDistanceIt(refDistanceMap, region);
+    DistanceIteratorType testDistanceIt(testDistanceMap, region);
+
+    double hausdorffTestToRef = 0, hausdorffRefToTest = 0;
+    double sumTestToRef = 0, sumRefToTest = 0;
+    double nbTestContourPoints = 0, nbRefContourPoints = 0;
+
+    while (!refIt.IsAtEnd())
     {
-        if (!this->m_bContourDetected)
-            this->contourDectection();
+        double refDistance = std::max(0.0f, refDistanceIt.Get());
+        double testDistance = std::max(0.0f, testDistanceIt.Get());
 
-        // compute the Hausdorff distance H(image1,image2)
-        typedef itk::ContourMeanDistanceImageFilter<ImageType, ImageType> FilterType;
-        FilterType::Pointer filter = FilterType::New();
+        if ((testIt.Get() != 0) && (refIt.Get() == 0))
+            hausdorffTestToRef = std::max(hausdorffTestToRef, refDistance);
 
-        filter->SetInput1(m_imageTestContour);
-        filter->SetInput2(m_imageRefContour);
+        if ((refIt.Get() != 0) && (testIt.Get() == 0))
+            hausdorffRefToTest = std::max(hausdorffRefToTest, testDistance);
 
-        try
+        if (testContourIt.Get() != 0)
         {
-            filter->Update();
+            sumTestToRef += refDistance;
+            ++nbTestContourPoints;
         }
 
-        catch (itk::ExceptionObject& e)
+        if (refContourIt.Get() != 0)
         {
-            std::cerr << "exception in filter " << std::endl;
-            std::cerr << e << std::endl;
-            return EXIT_FAILURE;
+            sumRefToTest += testDistance;
+            ++nbRefContourPoints;
         }
 
-        meanDistance = filter->GetMeanDistance();
+        ++refIt;
+        ++testIt;
+        ++refContourIt;
+        ++testContourIt;
+        ++refDistanceIt;
+        ++testDistanceIt;
     }
 
-    return meanDistance;
-}
+    // Distances to an empty object are undefined
+    if ((nbTestContourPoints == 0) || (nbRefContourPoints == 0))
+        return;
 
-/**
-@brief   Compute average surface distance
-@return  average surface distance
-*/
-double SegPerfCAnalyzer::computeAverageSurfaceDistance()
-{
-    double meanDistance = std::numeric_limits<double>::quiet_NaN();
+    m_dfHausdorffDistance = std::max(hausdorffTestToRef, hausdorffRefToTest);
+    m_dfContourMeanDistance = std::max(sumTestToRef / nbTestContourPoints, sumRefToTest / nbRefContourPoints);
+
+    if (m_uiNbLabels == 2)
+    {
+        m_dfAverageSurfaceDistance = (sumTestToRef + sumRefToTest) / (nbTestContourPoints + nbRefContourPoints);
+        return;
+    }
 
-    if (m_uiNbLabels > 1)
+    double sumDistances = 0;
+    double nbContourPoints = 0;
+
+    for (unsigned int i = 1; i < m_uiNbLabels; i++)
     {
-        if (!this->m_bContourDetected)
-            this->contourDectection();
+        DistanceImageType::Pointer refLabelDistanceMap = this->computeContourDistanceMap(m_imageRefContour, i);
+        DistanceImageType::Pointer testLabelDistanceMap = this->computeContourDistanceMap(m_imageTestContour, i);
 
-        double sum_dist = 0;
-        double sum_size = 0;
+        refContourIt.GoToBegin();
+        testContourIt.GoToBegin();
+        DistanceIteratorType refLabelDistanceIt(refLabelDistanceMap, region);
+        DistanceIteratorType testLabelDistanceIt(testLabelDistanceMap, region);
 
-        for (int i = 1; i < m_uiNbLabels; i++)
+        double sumLabelDistances = 0;
+        double nbTestLabelPoints = 0, nbRefLabelPoints = 0;
+        while (!refContourIt.IsAtEnd())
         {
-            std::vector <ImageType::PointType> coordRef;
-            coordRef.clear();
-            ImageIteratorType refContourIt(m_imageRefContour, m_imageRefContour->GetLargestPossibleRegion());
+            if (testContourIt.Get() == i)
+            {
+                sumLabelDistances += std::max(0.0f, refLabelDistanceIt.Get());
+                ++nbTestLabelPoints;
+            }
 
-            while (!refContourIt.IsAtEnd())
+            if (refContourIt.Get() == i)
             {
-                if (refContourIt.Get() == i)
-                {
-                    ImageType::IndexType oIndex = refContourIt.GetIndex();
-                    ImageType::PointType oPoint;
-                    m_imageRefContour->TransformIndexToPhysicalPoint(oIndex, oPoint);
-                    coordRef.push_back(oPoint);
-                }
-                ++refContourIt;
+                sumLabelDistances += std::max(0.0f, testLabelDistanceIt.Get());
+                ++nbRefLabelPoints;
             }
 
-            std::vector <ImageType::PointType> coordTest;
-            coordTest.clear();
+            ++refContourIt;
+            ++testContourIt;
+            ++refLabelDistanceIt;
+            ++testLabelDistanceIt;
+        }
 
-            ImageIteratorType testContourIt(m_imageTestContour, m_imageTestContour->GetLargestPossibleRegion());
+        // Labels missing from one of the images have no defined surface distance
+        if ((nbTestLabelPoints == 0) || (nbRefLabelPoints == 0))
+            continue;
 
-            while (!testContourIt.IsAtEnd())
-            {
-                if (testContourIt.Get() == i)
-                {
-                    ImageType::IndexType oIndex = testContourIt.GetIndex();
-                    ImageType::PointType oPoint;
-                    m_imageTestContour->TransformIndexToPhysicalPoint(oIndex, oPoint);
-                    coordTest.push_back(oPoint);
-                }
-                ++testContourIt;
-            }
+        sumDistances += sumLabelDistances;
+        nbContourPoints += nbTestLabelPoints + nbRefLabelPoints;
+    }
 
-            std::vector <double> distance1, distance2;
-            double fDistanceTemp1 = 1000000, fDistanceTemp2 = 1000000;
-            double distanceValue = 0;
-            for (int m = 0; m < coordRef.size(); m++)
-            {
-                for (int n = 0; n < coordTest.size(); n++)
-                {
-                    distanceValue = sqrt(pow((double)(coordRef[m][0] - coordTest[n][0]), 2) + pow((double)(coordRef[m][1] - coordTest[n][1]), 2) + pow((double)(coordRef[m][2] - coordTest[n][2]), 2));
-                    if (distanceValue < fDistanceTemp1)
-                        fDistanceTemp1 = distanceValue;
-                }
+    if (nbContourPoints > 0)
+        m_dfAverageSurfaceDistance = sumDistances / nbContourPoints;
+}
 
-                distance1.push_back(fDistanceTemp1);
-            }
+/**
+@brief  Compute Haussdorf distance
+@return hausdorffDistance in double
+*/
+double SegPerfCAnalyzer::computeHausdorffDist()
+{
+    if (!m_bSurfaceDistancesComputed)
+        this->computeSurfaceDistances();
 
-            for (int m = 0; m < coordTest.size(); m++)
-            {
-                for (int n = 0; n < coordRef.size(); n++)
-                {
-                    distanceValue = sqrt(pow((double)(coordTest[m][0] - coordRef[n][0]), 2) + pow((double)(coordTest[m][1] - coordRef[n][1]), 2) + pow((double)(coordTest[m][2] - coordRef[n][2]), 2));
+    return m_dfHausdorffDistance;
+}
 
-                    if (distanceValue < fDistanceTemp2)
-                        fDistanceTemp2 = distanceValue;
-                }
+/**
+@brief   Compute mean distance
+@return  meanDistance
+*/
+double SegPerfCAnalyzer::computeMeanDist()
+{
+    if (!m_bSurfaceDistancesComputed)
+        this->computeSurfaceDistances();
 
-                distance2.push_back(fDistanceTemp2);
-            }
+    return m_dfContourMeanDistance;
+}
 
-            sum_dist = sum_dist + (double)accumulate(distance1.begin(), distance1.end(), 0.0) + (double)accumulate(distance2.begin(), distance2.end(), 0.0);
-            sum_size = sum_size + (double)distance1.size() + (double)distance2.size();
-        }
+/**
+@brief   Compute average surface distance
+@return  average surface distance
+*/
+double SegPerfCAnalyzer::computeAverageSurfaceDistance()
+{
+    if (!m_bSurfaceDistancesComputed)
+        this->computeSurfaceDistances();
 
-        meanDistance = sum_dist / sum_size;
-    }
-    return meanDistance;
+    return m_dfAverageSurfaceDistance;
 }
 
 /**
@@ -9,9 +9,8 @@
 #include <itkLabelContourImageFilter.h>
 #include <itkBinaryContourImageFilter.h>
 #include <itkSimpleFilterWatcher.h>
-#include <itkHausdorffDistanceImageFilter.h>
-#include <itkDirectedHausdorffDistanceImageFilter.h>
-#include <itkContourMeanDistanceImageFilter.h>
+#include <itkSignedMaurerDistanceMapImageFilter.h>
+#include <itkBinaryThresholdImageFilter.h>
 #include <itkFlipImageFilter.h>
 #include <itkImageDuplicator.h>
 
@@ -78,6 +77,7 @@ public:
 protected:
     void formatLabels();
     void contourDectection();
+    void computeSurfaceDistances();
     void checkNumberOfLabels(int, int);
 
     int getTruePositiveLesions(int pi_iNbLabelsRef, int pi_iNbLabelsTest, int **pi_ppiOverlapTab);
@@ -92,6 +92,11 @@ private:
     unsigned int m_uiNbLabels;   /*!<Number of Labels. */
     bool m_bValuesComputed;      /*!<Boolean to check if values have been computed. */
     bool m_bContourDetected;     /*!<Boolean to check if contour detection have been done. */
+    bool m_bSurfaceDistancesComputed; /*!<Boolean to check if surface distances have been computed. */
+
+    double m_dfHausdorffDistance;
+    double m_dfContourMeanDistance;
+    double m_dfAverageSurfaceDistance;
 
     double m_dfDetectionThresholdAlpha;
     double m_dfDetectionThresholdBeta;
@@ -102,6 +107,10 @@ private:
     typedef itk::ImageFileReader <ImageType> ImageReaderType;
     typedef itk::ImageRegionConstIterator <ImageType> ImageIteratorType;
     typedef anima::SegmentationMeasuresImageFilter<ImageType> FilterType;
+    typedef itk::Image <float, 3> DistanceImageType;
+    typedef itk::ImageRegionConstIterator <DistanceImageType> DistanceIteratorType;
+
+    DistanceImageType::Pointer computeContourDistanceMap(ImageType *contourImage, unsigned int label);
 
     ImageType::Pointer m_imageTest;
     ImageType::Pointer m_imageRef;